@@ -92,12 +92,26 @@ typedef struct lvgl_port_ctx_s
     } lvgl_task;
 } lvgl_port_ctx_t;
 
+typedef struct
+{
+    bool active;                            /* Display is in video mode */
+    volatile bool drawing;                  /* Color transfers in flight belong to the video path */
+    lv_area_t osd[LVGL_PORT_VIDEO_OSD_MAX]; /* Areas still drawn by LVGL */
+    int osd_count;                          /* Number of OSD areas */
+    uint8_t *bounce[2];                     /* DMA bounce buffers */
+    uint32_t bounce_lines;                  /* Lines per bounce buffer */
+    int bounce_next;                        /* Bounce buffer filled next */
+    int in_flight;                          /* Bounce buffers queued to the panel */
+    SemaphoreHandle_t done;                 /* Given from ISR each time a bounce buffer is transferred */
+} lvgl_port_video_ctx_t;
+
 typedef struct
 {
     esp_lcd_panel_io_handle_t io_handle; /* LCD panel IO handle */
     esp_lcd_panel_handle_t panel_handle; /* LCD panel handle */
     lvgl_port_rotation_cfg_t rotation;   /* Default values of the screen rotation */
     lv_disp_drv_t disp_drv;              /* LVGL display driver */
+    lvgl_port_video_ctx_t video;         /* Video mode */
 } lvgl_port_display_ctx_t;
 
 #ifdef ESP_LVGL_PORT_TOUCH_COMPONENT
@@ -116,6 +130,10 @@ typedef struct
     button_handle_t btn_handle; /* Encoder button handlers */
     lv_indev_drv_t indev_drv;   /* LVGL input device driver */
     bool btn_enter;             /* Encoder button enter state */
+    button_cb_t btn_down_cb;    /* User callback for press down, called after lvgl saw it */
+    void *btn_down_user_data;   /* User data of btn_down_cb */
+    button_cb_t btn_up_cb;      /* User callback for press up, called after lvgl saw it */
+    void *btn_up_user_data;     /* User data of btn_up_cb */
 } lvgl_port_encoder_ctx_t;
 #endif
 
@@ -156,6 +174,9 @@ static void lvgl_port_task_deinit(void);
 static bool lvgl_port_flush_ready_callback(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx);
 #endif
 static void lvgl_port_flush_callback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
+static void lvgl_port_video_push(lvgl_port_display_ctx_t *disp_ctx, const lv_area_t *area, const uint8_t *src, int stride);
+static void lvgl_port_video_drain(lvgl_port_display_ctx_t *disp_ctx);
+static void lvgl_port_video_release(lvgl_port_display_ctx_t *disp_ctx);
 static void lvgl_port_update_callback(lv_disp_drv_t *drv);
 #ifdef ESP_LVGL_PORT_TOUCH_COMPONENT
 static void lvgl_port_touchpad_read(lv_indev_drv_t *indev_drv, lv_indev_data_t *data);
@@ -303,7 +324,7 @@ lv_disp_t *lvgl_port_add_disp(const lvgl_port_display_cfg_t *disp_cfg)
     assert(disp_cfg->vres > 0);
 
     /* Display context */
-    lvgl_port_display_ctx_t *disp_ctx = malloc(sizeof(lvgl_port_display_ctx_t));
+    lvgl_port_display_ctx_t *disp_ctx = calloc(1, sizeof(lvgl_port_display_ctx_t));
     ESP_GOTO_ON_FALSE(disp_ctx, ESP_ERR_NO_MEM, err, TAG, "Not enough memory for display context allocation!");
     disp_ctx->io_handle = disp_cfg->io_handle;
     disp_ctx->panel_handle = disp_cfg->panel_handle;
@@ -501,6 +522,10 @@ lv_indev_t *lvgl_port_add_encoder(const lvgl_port_encoder_cfg_t *encoder_cfg)
     ESP_ERROR_CHECK(iot_button_register_cb(encoder_ctx->btn_handle, BUTTON_PRESS_UP, lvgl_port_encoder_btn_up_handler, encoder_ctx));
 
     encoder_ctx->btn_enter = false;
+    encoder_ctx->btn_down_cb = NULL;
+    encoder_ctx->btn_down_user_data = NULL;
+    encoder_ctx->btn_up_cb = NULL;
+    encoder_ctx->btn_up_user_data = NULL;
 
     /* Register a encoder input device */
     lv_indev_drv_init(&encoder_ctx->indev_drv);
@@ -576,10 +601,18 @@ esp_err_t lvgl_port_encoder_btn_register_event_cb(lv_indev_t *encoder, button_ev
     assert(indev_drv);
     lvgl_port_encoder_ctx_t *encoder_ctx = (lvgl_port_encoder_ctx_t *)indev_drv->user_data;
     assert(encoder_ctx);
-    if (event == BUTTON_PRESS_DOWN || event == BUTTON_PRESS_UP)
+    /* Press down and up drive lvgl, the user callback is chained from the lvgl handlers */
+    if (event == BUTTON_PRESS_DOWN)
     {
-        ESP_LOGW(TAG, "Button Press down or up event is reserved for lvgl");
-        return ESP_ERR_NOT_SUPPORTED;
+        encoder_ctx->btn_down_user_data = user_data;
+        encoder_ctx->btn_down_cb = cb;
+        return ESP_OK;
+    }
+    if (event == BUTTON_PRESS_UP)
+    {
+        encoder_ctx->btn_up_user_data = user_data;
+        encoder_ctx->btn_up_cb = cb;
+        return ESP_OK;
     }
     return iot_button_register_cb(encoder_ctx->btn_handle, event, cb, user_data);
 }
@@ -788,6 +821,167 @@ void lvgl_port_flush_ready(lv_disp_t *disp)
     lv_disp_flush_ready(disp->driver);
 }
 
+esp_err_t lvgl_port_video_start(lv_disp_t *disp, const lvgl_port_video_cfg_t *video_cfg)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(disp && disp->driver && video_cfg, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(video_cfg->bounce_lines > 0, ESP_ERR_INVALID_ARG, TAG, "invalid bounce lines");
+    ESP_RETURN_ON_FALSE(video_cfg->osd_count >= 0 && video_cfg->osd_count <= LVGL_PORT_VIDEO_OSD_MAX, ESP_ERR_INVALID_ARG, TAG, "too many OSD areas");
+    ESP_RETURN_ON_FALSE(video_cfg->osd_count == 0 || video_cfg->osd, ESP_ERR_INVALID_ARG, TAG, "invalid OSD areas");
+    /* the video path needs the transfer done callback of the panel IO */
+    ESP_RETURN_ON_FALSE(LVGL_PORT_HANDLE_FLUSH_READY, ESP_ERR_NOT_SUPPORTED, TAG, "video mode needs flush ready handled by the port");
+    ESP_RETURN_ON_FALSE(disp->driver->rotated == LV_DISP_ROT_NONE, ESP_ERR_NOT_SUPPORTED, TAG, "video mode does not support rotation");
+
+    lvgl_port_display_ctx_t *disp_ctx = (lvgl_port_display_ctx_t *)disp->driver->user_data;
+    lvgl_port_video_ctx_t *video = &disp_ctx->video;
+    ESP_RETURN_ON_FALSE(!video->active, ESP_ERR_INVALID_STATE, TAG, "already in video mode");
+
+    lvgl_port_lock(0);
+
+    size_t bounce_size = disp->driver->hor_res * video_cfg->bounce_lines * sizeof(lv_color_t);
+    for (int i = 0; i < 2; i++)
+    {
+        video->bounce[i] = heap_caps_malloc(bounce_size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        ESP_GOTO_ON_FALSE(video->bounce[i], ESP_ERR_NO_MEM, err, TAG, "Not enough memory for video bounce buffer allocation!");
+    }
+    video->done = xSemaphoreCreateCounting(2, 0);
+    ESP_GOTO_ON_FALSE(video->done, ESP_ERR_NO_MEM, err, TAG, "Create video semaphore fail!");
+
+    video->bounce_lines = video_cfg->bounce_lines;
+    video->bounce_next = 0;
+    video->in_flight = 0;
+    video->osd_count = video_cfg->osd_count;
+    for (int i = 0; i < video->osd_count; i++)
+    {
+        /* same column alignment as the rounder of the panel */
+        video->osd[i] = video_cfg->osd[i];
+        video->osd[i].x1 = (video->osd[i].x1 >> 2) << 2;
+        video->osd[i].x2 = ((video->osd[i].x2 >> 2) << 2) + 3;
+    }
+    video->active = true;
+
+err:
+    if (ret != ESP_OK)
+    {
+        lvgl_port_video_release(disp_ctx);
+    }
+    lvgl_port_unlock();
+
+    return ret;
+}
+
+esp_err_t lvgl_port_video_draw(lv_disp_t *disp, const void *frame, int width, int height)
+{
+    ESP_RETURN_ON_FALSE(disp && disp->driver && frame && width > 0 && height > 0, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    lvgl_port_display_ctx_t *disp_ctx = (lvgl_port_display_ctx_t *)disp->driver->user_data;
+    lvgl_port_video_ctx_t *video = &disp_ctx->video;
+    const int hres = disp->driver->hor_res;
+    const int vres = disp->driver->ver_res;
+
+    /* center the frame, cropped or letterboxed, columns aligned to 4 for the panel */
+    const int copy_w = (width < hres ? width : hres) & ~3;
+    const int copy_h = height < vres ? height : vres;
+    const int src_x = (width - copy_w) / 2;
+    const int src_y = (height - copy_h) / 2;
+    const int dst_x = ((hres - copy_w) / 2) & ~3;
+    const int dst_y = (vres - copy_h) / 2;
+    const uint8_t *pixels = frame;
+
+    lvgl_port_lock(0);
+    if (!video->active)
+    {
+        /* not an error worth a log, video mode may have just been left by another task */
+        lvgl_port_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* LVGL cannot start a new flush while the mutex is held, wait for the last one to finish */
+    while (disp->driver->draw_buf->flushing)
+    {
+        vTaskDelay(1);
+    }
+    video->drawing = true;
+
+    for (int y = dst_y; y < dst_y + copy_h;)
+    {
+        /* band of rows with the same set of OSD areas crossing it */
+        int y_end = y + video->bounce_lines;
+        y_end = y_end < dst_y + copy_h ? y_end : dst_y + copy_h;
+        for (int i = 0; i < video->osd_count; i++)
+        {
+            if (video->osd[i].y1 > y && video->osd[i].y1 < y_end)
+            {
+                y_end = video->osd[i].y1;
+            }
+            if (video->osd[i].y2 + 1 > y && video->osd[i].y2 + 1 < y_end)
+            {
+                y_end = video->osd[i].y2 + 1;
+            }
+        }
+
+        /* push the columns of the band not covered by an OSD area */
+        for (int x = dst_x; x < dst_x + copy_w;)
+        {
+            int x_end = dst_x + copy_w;
+            bool covered = false;
+            for (int i = 0; i < video->osd_count; i++)
+            {
+                const lv_area_t *osd = &video->osd[i];
+                if (osd->y1 >= y_end || osd->y2 < y)
+                {
+                    continue;
+                }
+                if (osd->x1 <= x && osd->x2 >= x)
+                {
+                    x = osd->x2 + 1;
+                    covered = true;
+                    break;
+                }
+                if (osd->x1 > x && osd->x1 < x_end)
+                {
+                    x_end = osd->x1;
+                }
+            }
+            if (covered)
+            {
+                continue;
+            }
+
+            const lv_area_t area = { .x1 = x, .y1 = y, .x2 = x_end - 1, .y2 = y_end - 1 };
+            lvgl_port_video_push(disp_ctx, &area, pixels + ((size_t)(src_y + y - dst_y) * width + src_x + x - dst_x) * sizeof(lv_color_t), width);
+            x = x_end;
+        }
+        y = y_end;
+    }
+
+    lvgl_port_video_drain(disp_ctx);
+    video->drawing = false;
+    lvgl_port_unlock();
+
+    return ESP_OK;
+}
+
+esp_err_t lvgl_port_video_stop(lv_disp_t *disp)
+{
+    ESP_RETURN_ON_FALSE(disp && disp->driver, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    lvgl_port_display_ctx_t *disp_ctx = (lvgl_port_display_ctx_t *)disp->driver->user_data;
+
+    lvgl_port_lock(0);
+    if (!disp_ctx->video.active)
+    {
+        lvgl_port_unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    lvgl_port_video_release(disp_ctx);
+    /* the screen under the video is stale, redraw all of it */
+    lv_obj_invalidate(lv_disp_get_scr_act(disp));
+    lvgl_port_unlock();
+
+    return ESP_OK;
+}
+
 /*******************************************************************************
  * Private functions
  *******************************************************************************/
@@ -851,17 +1045,101 @@ static bool lvgl_port_flush_ready_callback(esp_lcd_panel_io_handle_t panel_io, e
 {
     lv_disp_drv_t *disp_drv = (lv_disp_drv_t *)user_ctx;
     assert(disp_drv != NULL);
+    lvgl_port_display_ctx_t *disp_ctx = (lvgl_port_display_ctx_t *)disp_drv->user_data;
+    if (disp_ctx->video.drawing)
+    {
+        BaseType_t need_yield = pdFALSE;
+        xSemaphoreGiveFromISR(disp_ctx->video.done, &need_yield);
+        return need_yield == pdTRUE;
+    }
     lv_disp_flush_ready(disp_drv);
     return false;
 }
 #endif
 
+static void lvgl_port_video_push(lvgl_port_display_ctx_t *disp_ctx, const lv_area_t *area, const uint8_t *src, int stride)
+{
+    lvgl_port_video_ctx_t *video = &disp_ctx->video;
+    const size_t line_size = lv_area_get_width(area) * sizeof(lv_color_t);
+    const int lines = lv_area_get_height(area);
+
+    /* both bounce buffers are queued, wait for the older one */
+    if (video->in_flight == 2)
+    {
+        xSemaphoreTake(video->done, portMAX_DELAY);
+        video->in_flight--;
+    }
+
+    uint8_t *bounce = video->bounce[video->bounce_next];
+    for (int i = 0; i < lines; i++)
+    {
+        memcpy(bounce + i * line_size, src + (size_t)i * stride * sizeof(lv_color_t), line_size);
+    }
+    video->in_flight++;
+    esp_lcd_panel_draw_bitmap(disp_ctx->panel_handle, area->x1, area->y1, area->x2 + 1, area->y2 + 1, bounce);
+    video->bounce_next ^= 1;
+}
+
+static void lvgl_port_video_drain(lvgl_port_display_ctx_t *disp_ctx)
+{
+    while (disp_ctx->video.in_flight > 0)
+    {
+        xSemaphoreTake(disp_ctx->video.done, portMAX_DELAY);
+        disp_ctx->video.in_flight--;
+    }
+}
+
+static void lvgl_port_video_release(lvgl_port_display_ctx_t *disp_ctx)
+{
+    lvgl_port_video_ctx_t *video = &disp_ctx->video;
+
+    video->active = false;
+    for (int i = 0; i < 2; i++)
+    {
+        if (video->bounce[i])
+        {
+            free(video->bounce[i]);
+            video->bounce[i] = NULL;
+        }
+    }
+    if (video->done)
+    {
+        vSemaphoreDelete(video->done);
+        video->done = NULL;
+    }
+}
+
 static void lvgl_port_flush_callback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
 {
     assert(drv != NULL);
     lvgl_port_display_ctx_t *disp_ctx = (lvgl_port_display_ctx_t *)drv->user_data;
     assert(disp_ctx != NULL);
 
+    if (disp_ctx->video.active)
+    {
+        /* only the OSD areas are LVGL's, the rest of the screen shows the video */
+        const int stride = lv_area_get_width(area);
+        disp_ctx->video.drawing = true;
+        for (int i = 0; i < disp_ctx->video.osd_count; i++)
+        {
+            lv_area_t clip;
+            if (_lv_area_intersect(&clip, area, &disp_ctx->video.osd[i]))
+            {
+                for (int y = clip.y1; y <= clip.y2; y += disp_ctx->video.bounce_lines)
+                {
+                    lv_area_t band = clip;
+                    band.y1 = y;
+                    band.y2 = LV_MIN(y + (int)disp_ctx->video.bounce_lines - 1, clip.y2);
+                    lvgl_port_video_push(disp_ctx, &band, (const uint8_t *)(color_map + (band.y1 - area->y1) * stride + (band.x1 - area->x1)), stride);
+                }
+            }
+        }
+        lvgl_port_video_drain(disp_ctx);
+        disp_ctx->video.drawing = false;
+        lv_disp_flush_ready(drv);
+        return;
+    }
+
     const int offsetx1 = area->x1;
     const int offsetx2 = area->x2;
     const int offsety1 = area->y1;
@@ -1004,6 +1282,10 @@ static void lvgl_port_encoder_btn_down_handler(void *arg, void *arg2)
         if (button == ctx->btn_handle)
         {
             ctx->btn_enter = true;
+            if (ctx->btn_down_cb)
+            {
+                ctx->btn_down_cb(arg, ctx->btn_down_user_data);
+            }
         }
     }
 }
@@ -1018,6 +1300,10 @@ static void lvgl_port_encoder_btn_up_handler(void *arg, void *arg2)
         if (button == ctx->btn_handle)
         {
             ctx->btn_enter = false;
+            if (ctx->btn_up_cb)
+            {
+                ctx->btn_up_cb(arg, ctx->btn_up_user_data);
+            }
         }
     }
 }
@@ -142,6 +142,18 @@ typedef struct
 } lvgl_port_hid_keyboard_cfg_t;
 #endif
 
+#define LVGL_PORT_VIDEO_OSD_MAX 4
+
+/**
+ * @brief Configuration of the video mode
+ */
+typedef struct
+{
+    uint32_t bounce_lines; /*!< Lines per DMA bounce buffer, two of them are allocated in internal RAM */
+    const lv_area_t *osd;  /*!< Screen areas still drawn by LVGL on top of the video, NULL if none */
+    int osd_count;         /*!< Number of OSD areas, at most LVGL_PORT_VIDEO_OSD_MAX */
+} lvgl_port_video_cfg_t;
+
 /**
  * @brief LVGL port configuration structure
  *
@@ -151,6 +163,15 @@ typedef struct
         .task_priority = 4, .task_stack = 4096, .task_affinity = -1, .task_max_sleep_ms = 500, .timer_period_ms = 5,                                                                                   \
     }
 
+/**
+ * @brief Video mode configuration structure
+ *
+ */
+#define LVGL_PORT_VIDEO_CONFIG_DEFAULT()                 \
+    {                                                    \
+        .bounce_lines = 20, .osd = NULL, .osd_count = 0, \
+    }
+
 /**
  * @brief Initialize LVGL portation
  *
@@ -239,6 +260,9 @@ esp_err_t lvgl_port_encoder_register_event_cb(lv_indev_t *encoder, knob_event_t
 /**
  * @brief Register event callback for encoder button
  *
+ * @note BUTTON_PRESS_DOWN and BUTTON_PRESS_UP keep driving lvgl, one user callback each is called right after.
+ *       Registering one of them again replaces its callback.
+ *
  * @return
  *      - ESP_OK                    on success
  */
@@ -354,6 +378,53 @@ esp_err_t lvgl_port_stop(void);
  */
 esp_err_t lvgl_port_resume(void);
 
+/**
+ * @brief Enter video mode
+ *
+ * Frames passed to lvgl_port_video_draw go straight to the panel through DMA bounce buffers.
+ * LVGL keeps running, but its flushes only reach the OSD areas, everything else on the screen
+ * belongs to the video until lvgl_port_video_stop.
+ *
+ * @note OSD areas are widened to the 4 pixel column alignment of the panel.
+ *
+ * @param disp          LVGL display handle (returned from lvgl_port_add_disp)
+ * @param video_cfg     Video mode configuration
+ * @return
+ *      - ESP_OK                    on success
+ *      - ESP_ERR_INVALID_ARG       if some of the arguments are not valid
+ *      - ESP_ERR_INVALID_STATE     if the display is already in video mode
+ *      - ESP_ERR_NOT_SUPPORTED     if the display is rotated or flush ready is not handled by the port
+ *      - ESP_ERR_NO_MEM            if memory allocation fails
+ */
+esp_err_t lvgl_port_video_start(lv_disp_t *disp, const lvgl_port_video_cfg_t *video_cfg);
+
+/**
+ * @brief Draw one video frame
+ *
+ * The frame is centered on the screen, cropped when it is larger and letterboxed when it is smaller.
+ * Returns once the frame has been transferred, takes the LVGL mutex while drawing.
+ *
+ * @param disp          LVGL display handle (returned from lvgl_port_add_disp)
+ * @param frame         Pixels in the display color format, rows of width pixels
+ * @param width         Frame width
+ * @param height        Frame height
+ * @return
+ *      - ESP_OK                    on success
+ *      - ESP_ERR_INVALID_ARG       if some of the arguments are not valid
+ *      - ESP_ERR_INVALID_STATE     if the display is not in video mode
+ */
+esp_err_t lvgl_port_video_draw(lv_disp_t *disp, const void *frame, int width, int height);
+
+/**
+ * @brief Leave video mode and let LVGL redraw the whole screen
+ *
+ * @param disp          LVGL display handle (returned from lvgl_port_add_disp)
+ * @return
+ *      - ESP_OK                    on success
+ *      - ESP_ERR_INVALID_STATE     if the display is not in video mode
+ */
+esp_err_t lvgl_port_video_stop(lv_disp_t *disp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,7 +52,7 @@ static void bsp_btn_cb(void *arg, void *arg2)
     }
 }
 
-void bsp_set_btn_long_press_cb(void (*cb)(void))
+static esp_err_t bsp_set_btn_event_cb(button_event_t event, void (*cb)(void))
 {
     lv_indev_t *tp = NULL;
     while (1)
@@ -64,34 +64,29 @@ void bsp_set_btn_long_press_cb(void (*cb)(void))
         }
     }
 
-    if (tp == NULL)
-    {
-        ESP_LOGE(TAG, "No encoder found");
-        return;
-    }
+    ESP_RETURN_ON_FALSE(tp, ESP_ERR_NOT_FOUND, TAG, "No encoder found");
 
-    lvgl_port_encoder_btn_register_event_cb(tp, BUTTON_LONG_PRESS_START, bsp_btn_cb, cb);
+    return lvgl_port_encoder_btn_register_event_cb(tp, event, bsp_btn_cb, cb);
 }
 
-void bsp_set_btn_long_release_cb(void (*cb)(void))
+esp_err_t bsp_set_btn_long_press_cb(void (*cb)(void))
 {
-    lv_indev_t *tp = NULL;
-    while (1)
-    {
-        tp = lv_indev_get_next(tp);
-        if (tp == NULL || tp->driver->type == LV_INDEV_TYPE_ENCODER)
-        {
-            break;
-        }
-    }
+    return bsp_set_btn_event_cb(BUTTON_LONG_PRESS_START, cb);
+}
 
-    if (tp == NULL)
-    {
-        ESP_LOGE(TAG, "No encoder found");
-        return;
-    }
+esp_err_t bsp_set_btn_long_release_cb(void (*cb)(void))
+{
+    return bsp_set_btn_event_cb(BUTTON_LONG_PRESS_UP, cb);
+}
+
+esp_err_t bsp_set_btn_press_cb(void (*cb)(void))
+{
+    return bsp_set_btn_event_cb(BUTTON_PRESS_DOWN, cb);
+}
 
-    lvgl_port_encoder_btn_register_event_cb(tp, BUTTON_LONG_PRESS_UP, bsp_btn_cb, cb);
+esp_err_t bsp_set_btn_release_cb(void (*cb)(void))
+{
+    return bsp_set_btn_event_cb(BUTTON_PRESS_UP, cb);
 }
 
 esp_err_t bsp_i2c_detect(i2c_port_t i2c_num)
@@ -142,6 +137,15 @@ esp_err_t bsp_i2c_check(i2c_port_t i2c_num, uint8_t address)
     return ret;
 }
 
+static void bsp_io_expander_isr_cb(void *arg)
+{
+    // the SSCMA SYNC line sits behind the expander, so its interrupt is the data ready signal
+    if (sscma_client_handle != NULL)
+    {
+        sscma_client_notify(sscma_client_handle);
+    }
+}
+
 esp_io_expander_handle_t bsp_io_expander_init()
 {
     if (io_exp_handle != NULL)
@@ -157,7 +161,7 @@ esp_io_expander_handle_t bsp_io_expander_init()
 
         .int_gpio = BSP_IO_EXPANDER_INT,
         .update_interval_us = 1000000, // 1s
-        .isr_cb = NULL,
+        .isr_cb = bsp_io_expander_isr_cb,
         .user_ctx = NULL,
     };
 
@@ -1273,6 +1277,10 @@ sscma_client_handle_t bsp_sscma_client_init()
         .user_ctx = NULL,
         .io_expander = io_exp_handle,
         .flags.sync_use_expander = BSP_SSCMA_CLIENT_RST_USE_EXPANDER,
+#ifdef CONFIG_SSCMA_SPI_QUEUED_TRANS
+        .trans_queue_depth = CONFIG_SSCMA_SPI_TRANS_QUEUE_DEPTH,
+        .flags.queued_trans = true,
+#endif
     };
 
     sscma_client_new_io_spi_bus((sscma_client_spi_bus_handle_t)BSP_SSCMA_CLIENT_SPI_NUM, &spi_io_config, &sscma_client_io_handle);
@@ -1280,8 +1288,16 @@ sscma_client_handle_t bsp_sscma_client_init()
     sscma_client_config_t sscma_client_config = SSCMA_CLIENT_CONFIG_DEFAULT();
 
     sscma_client_config.event_queue_size = CONFIG_SSCMA_EVENT_QUEUE_SIZE;
+    sscma_client_config.rx_poll_interval_ms = CONFIG_SSCMA_RX_POLL_INTERVAL_MS;
+    sscma_client_config.ready_timeout_ms = CONFIG_SSCMA_READY_TIMEOUT_MS;
+    sscma_client_config.target_fps = CONFIG_SSCMA_TARGET_FPS;
     sscma_client_config.tx_buffer_size = CONFIG_SSCMA_TX_BUFFER_SIZE;
     sscma_client_config.rx_buffer_size = CONFIG_SSCMA_RX_BUFFER_SIZE;
+    sscma_client_config.reply_pool_size = CONFIG_SSCMA_REPLY_POOL_SIZE;
+#if CONFIG_SSCMA_REPLY_POOL_SIZE > 0
+    sscma_client_config.reply_pool_slot_size = CONFIG_SSCMA_REPLY_POOL_SLOT_SIZE;
+    sscma_client_config.reply_arena_size = CONFIG_SSCMA_REPLY_ARENA_SIZE;
+#endif
     sscma_client_config.process_task_stack = CONFIG_SSCMA_PROCESS_TASK_STACK_SIZE;
     sscma_client_config.process_task_affinity = CONFIG_SSCMA_PROCESS_TASK_AFFINITY;
     sscma_client_config.process_task_priority = CONFIG_SSCMA_PROCESS_TASK_PRIORITY;
@@ -1291,6 +1307,15 @@ sscma_client_handle_t bsp_sscma_client_init()
     sscma_client_config.reset_gpio_num = BSP_SSCMA_CLIENT_RST;
     sscma_client_config.io_expander = io_exp_handle;
     sscma_client_config.flags.reset_use_expander = BSP_SSCMA_CLIENT_RST_USE_EXPANDER;
+#ifdef CONFIG_SSCMA_LAZY_EVENT_PAYLOAD
+    sscma_client_config.flags.lazy_event_payload = true;
+#endif
+#ifdef CONFIG_SSCMA_EVENT_MAILBOX
+    sscma_client_config.flags.event_mailbox = true;
+#endif
+#ifdef CONFIG_SSCMA_PERSIST_INFO
+    sscma_client_config.flags.persist_info = true;
+#endif
 
     sscma_client_new(sscma_client_io_handle, &sscma_client_config, &sscma_client_handle);
 
@@ -0,0 +1,288 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host_heap.h"
+
+#include "sscma_client_io.h"
+#include "sscma_client_io_interface.h"
+#include "sscma_client_ops.h"
+#include "sscma_client_commands.h"
+
+/*
+ * Runs the client against the loopback IO and reports what a board would:
+ * boot to ready, request round trips, then a streaming INVOKE with frame
+ * rate, bytes/s, end-to-end event latency and heap churn per frame.
+ */
+
+#define BENCH_REQUESTS   200
+#define BENCH_MAX_FRAMES 100000
+
+typedef struct
+{
+    int seconds;
+    int boot_ms;
+    int interval_ms;
+    int image_size;
+    int boxes;
+    int chunk_size;
+    int target_fps;
+    int arena_size;
+    bool mailbox;
+    bool fetch;
+    bool verbose;
+} bench_config_t;
+
+static struct
+{
+    bool fetch;
+    int64_t *latency_us;
+    size_t frames;
+    size_t decoded_boxes;
+    size_t decode_errors;
+} s_events;
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_percentiles(const char *what, int64_t *samples, size_t count)
+{
+    if (count == 0)
+    {
+        printf("%-18s no samples\n", what);
+        return;
+    }
+    qsort(samples, count, sizeof(int64_t), compare_int64);
+    printf("%-18s p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms  (%zu samples)\n", what, samples[count / 2] / 1000.0, samples[count * 9 / 10] / 1000.0, samples[count * 99 / 100] / 1000.0,
+        samples[count - 1] / 1000.0, count);
+}
+
+static void on_event(sscma_client_handle_t client, const sscma_client_reply_t *reply, void *user_ctx)
+{
+    static sscma_client_result_t result;
+    int64_t now = esp_timer_get_time();
+    const char *timestamp = strstr(reply->data, "\"timestamp\": ");
+
+    if (reply->index.name_len != strlen(EVENT_INVOKE) || memcmp(reply->index.name, EVENT_INVOKE, reply->index.name_len) != 0)
+    {
+        return;
+    }
+
+    // what a consumer does with a frame: boxes out, image located
+    if (s_events.fetch)
+    {
+        sscma_client_box_t *boxes = NULL;
+        int num_boxes = 0;
+        char *image = NULL;
+        int image_size = 0;
+        if (sscma_utils_fetch_boxes_from_reply(reply, &boxes, &num_boxes) == ESP_OK && sscma_utils_fetch_image_from_reply(reply, &image, &image_size) == ESP_OK)
+        {
+            s_events.decoded_boxes += num_boxes;
+        }
+        else
+        {
+            s_events.decode_errors++;
+        }
+        free(boxes);
+        free(image);
+    }
+    else if (sscma_utils_decode_result(reply, &result) == ESP_OK)
+    {
+        s_events.decoded_boxes += result.num_boxes;
+    }
+    else
+    {
+        s_events.decode_errors++;
+    }
+
+    if (timestamp != NULL && s_events.frames < BENCH_MAX_FRAMES)
+    {
+        s_events.latency_us[s_events.frames] = now - strtoll(timestamp + strlen("\"timestamp\": "), NULL, 10);
+    }
+    s_events.frames++;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-s seconds] [-r boot_ms] [-i interval_ms] [-m image_bytes] [-b boxes] [-c chunk_bytes] [-f target_fps] [-a arena_bytes] [-j] [-q] [-v]\n", name);
+    printf("  -r  time the loopback device takes to boot before it announces INIT@STAT\n");
+    printf("  -a  cJSON arena per reply pool slot, 0 parses replies on the heap\n");
+    printf("  -j  decode events with the cJSON sscma_utils_fetch_* helpers instead of sscma_utils_decode_result\n");
+    printf("  -q  deliver events through the FIFO queue instead of the latest-frame mailbox\n");
+}
+
+int main(int argc, char **argv)
+{
+    bench_config_t bench = {
+        .seconds = 5,
+        .interval_ms = 33,
+        .image_size = 24 * 1024,
+        .boxes = 10,
+        .chunk_size = 4096,
+        .target_fps = 0,
+        .arena_size = CONFIG_SSCMA_REPLY_ARENA_SIZE,
+        .mailbox = true,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:r:i:m:b:c:f:a:jqvh")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            bench.seconds = atoi(optarg);
+            break;
+        case 'r':
+            bench.boot_ms = atoi(optarg);
+            break;
+        case 'i':
+            bench.interval_ms = atoi(optarg);
+            break;
+        case 'm':
+            bench.image_size = atoi(optarg);
+            break;
+        case 'b':
+            bench.boxes = atoi(optarg);
+            break;
+        case 'c':
+            bench.chunk_size = atoi(optarg);
+            break;
+        case 'f':
+            bench.target_fps = atoi(optarg);
+            break;
+        case 'a':
+            bench.arena_size = atoi(optarg);
+            break;
+        case 'j':
+            bench.fetch = true;
+            break;
+        case 'q':
+            bench.mailbox = false;
+            break;
+        case 'v':
+            bench.verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    esp_log_level_set("*", bench.verbose ? ESP_LOG_INFO : ESP_LOG_WARN);
+
+    s_events.fetch = bench.fetch;
+    s_events.latency_us = calloc(BENCH_MAX_FRAMES, sizeof(int64_t));
+    int64_t *request_us = calloc(BENCH_REQUESTS, sizeof(int64_t));
+    if (s_events.latency_us == NULL || request_us == NULL)
+    {
+        return 1;
+    }
+
+    printf("loopback: %d ms interval, %d byte image, %d boxes, %d byte chunks, %d byte arena, %s, %s, target %d fps, %d s\n", bench.interval_ms, bench.image_size, bench.boxes,
+        bench.chunk_size, bench.arena_size, bench.fetch ? "fetch" : "decode",
+        bench.mailbox ? "mailbox" : "queue", bench.target_fps, bench.seconds);
+
+    sscma_client_io_loopback_config_t io_config = {
+        .image_size = bench.image_size,
+        .num_boxes = bench.boxes,
+        .frame_interval_ms = bench.interval_ms,
+        .chunk_size = bench.chunk_size,
+        .boot_time_ms = bench.boot_ms,
+    };
+    sscma_client_io_handle_t io = NULL;
+    // power on, the device starts booting with its IO
+    int64_t start = esp_timer_get_time();
+    ESP_ERROR_CHECK(sscma_client_new_io_loopback(&io_config, &io));
+
+    // the same settings the BSP applies from sdkconfig
+    sscma_client_config_t config = SSCMA_CLIENT_CONFIG_DEFAULT();
+    config.event_queue_size = CONFIG_SSCMA_EVENT_QUEUE_SIZE;
+    config.rx_poll_interval_ms = CONFIG_SSCMA_RX_POLL_INTERVAL_MS;
+    config.ready_timeout_ms = CONFIG_SSCMA_READY_TIMEOUT_MS;
+    config.target_fps = bench.target_fps;
+    config.tx_buffer_size = CONFIG_SSCMA_TX_BUFFER_SIZE;
+    config.rx_buffer_size = CONFIG_SSCMA_RX_BUFFER_SIZE;
+    config.reply_pool_size = CONFIG_SSCMA_REPLY_POOL_SIZE;
+    config.reply_pool_slot_size = CONFIG_SSCMA_REPLY_POOL_SLOT_SIZE;
+    config.reply_arena_size = bench.arena_size;
+    config.flags.lazy_event_payload = true;
+    config.flags.event_mailbox = bench.mailbox;
+
+    sscma_client_handle_t client = NULL;
+    ESP_ERROR_CHECK(sscma_client_new(io, &config, &client));
+
+    const sscma_client_callback_t callback = {
+        .on_event = on_event,
+    };
+    sscma_client_register_callback(client, &callback, NULL);
+
+    esp_err_t ret = sscma_client_init(client);
+    printf("%-18s %s in %.1f ms, device boots in %d ms\n", "boot to ready", esp_err_to_name(ret), (esp_timer_get_time() - start) / 1000.0, bench.boot_ms);
+
+    // sequential round trips, nothing else on the wire
+    size_t requests = 0;
+    for (int i = 0; i < BENCH_REQUESTS; i++)
+    {
+        sscma_client_reply_t reply;
+        int64_t begin = esp_timer_get_time();
+        if (sscma_client_request(client, CMD_PREFIX CMD_AT_ID CMD_QUERY CMD_SUFFIX, &reply, true, pdMS_TO_TICKS(CMD_WAIT_DELAY)) == ESP_OK)
+        {
+            request_us[requests++] = esp_timer_get_time() - begin;
+            sscma_client_reply_clear(&reply);
+        }
+    }
+    print_percentiles("AT+ID? round trip", request_us, requests);
+
+    sscma_client_stats_t stats_before;
+    sscma_client_stats_t stats_after;
+    host_heap_stats_t heap_before;
+    host_heap_stats_t heap_after;
+
+    sscma_client_reset_stats(client);
+    sscma_client_get_stats(client, &stats_before);
+    host_heap_get_stats(&heap_before);
+    start = esp_timer_get_time();
+
+    ESP_ERROR_CHECK(sscma_client_invoke(client, -1, false, true));
+    vTaskDelay(pdMS_TO_TICKS(bench.seconds * 1000));
+    sscma_client_break(client);
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    host_heap_get_stats(&heap_after);
+    sscma_client_get_stats(client, &stats_after);
+
+    size_t frames = s_events.frames;
+    size_t samples = frames < BENCH_MAX_FRAMES ? frames : BENCH_MAX_FRAMES;
+    double seconds = elapsed / 1e6;
+    uint64_t allocs = heap_after.allocs - heap_before.allocs;
+    uint64_t bytes = heap_after.bytes - heap_before.bytes;
+
+    printf("%-18s %zu in %.2f s, %.1f frames/s, %zu boxes, %zu decode errors\n", "frames", frames, seconds, frames / seconds, s_events.decoded_boxes, s_events.decode_errors);
+    printf("%-18s %.2f MB/s read, %lu frames parsed, %lu invalid\n", "transport", (stats_after.bytes_read - stats_before.bytes_read) / seconds / 1e6,
+        (unsigned long)(stats_after.frames_parsed - stats_before.frames_parsed), (unsigned long)(stats_after.frames_invalid - stats_before.frames_invalid));
+    print_percentiles("event latency", s_events.latency_us, samples);
+    printf("%-18s %.1f allocs/frame, %.0f bytes/frame, peak %zu bytes in use\n", "heap churn", frames ? (double)allocs / frames : 0.0, frames ? (double)bytes / frames : 0.0, heap_after.peak);
+
+    sscma_client_event_stats_t event_stats;
+    sscma_client_reply_pool_stats_t pool_stats;
+    sscma_client_get_event_stats(client, &event_stats);
+    sscma_client_get_reply_pool_stats(client, &pool_stats);
+    printf("%-18s %lu replaced, %lu dropped\n", "delivery", (unsigned long)(event_stats.invoke_replaced + event_stats.sample_replaced), (unsigned long)event_stats.queue_dropped);
+    printf("%-18s %zu/%zu slots high water, %lu heap fallbacks, %lu arena allocs, %lu arena misses\n", "reply pool", pool_stats.high_water, pool_stats.slots, (unsigned long)pool_stats.fallbacks,
+        (unsigned long)pool_stats.arena_allocs, (unsigned long)pool_stats.arena_misses);
+
+    sscma_client_del(client);
+    io->del(io); // sscma_client_del_io() is declared but never defined
+    free(request_us);
+    free(s_events.latency_us);
+
+    return 0;
+}
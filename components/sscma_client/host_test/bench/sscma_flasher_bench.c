@@ -0,0 +1,445 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "sscma_client_io_interface.h"
+#include "sscma_client_flasher.h"
+#include "sscma_client_flasher_interface.h"
+
+/*
+ * Runs the WE2 UART flasher against a simulated bootloader: the OTA menu
+ * prompt, an XMODEM-CRC receiver that checks framing, ids and CRC of every
+ * block, and the reboot prompt. Each case checks the image that arrived and
+ * the block sizes used, then a multi-MB image is timed. The host has no UART,
+ * so the time on the wire is modelled from the bytes exchanged.
+ */
+
+#define OTA_ENTER_HINT "Send data using the xmodem protocol from your terminal"
+#define OTA_DONE_HINT  "Do you want to end file transmission and reboot system?"
+
+#define XSOH  0x01
+#define XSTX  0x02
+#define XEOT  0x04
+#define XACK  0x06
+#define XNACK 0x15
+#define XCAN  0x18
+#define XC    0x43
+
+#define BENCH_CHUNK_SIZE    (32 * 1024) // what sscma_client_ota_from_file() hands the flasher
+#define BENCH_C_INTERVAL_US 10000       // the bootloader repeats 'C' until the first block
+#define BENCH_RESET_GPIO    21
+
+typedef enum {
+    RX_MENU,
+    RX_WAIT,
+    RX_PACKETS,
+    RX_DONE_PROMPT,
+    RX_ABORTED,
+    RX_REBOOTED,
+} rx_state_t;
+
+typedef struct
+{
+    bool accept_1k; // NAK every STX block, a receiver with 128-byte XMODEM only
+    int nak_every;  // NAK every Nth good block as if it arrived corrupted, 0 never
+} receiver_config_t;
+
+typedef struct
+{
+    sscma_client_io_t base;
+    receiver_config_t config;
+    rx_state_t state;
+    uint8_t out[256];
+    size_t out_head;
+    size_t out_len;
+    uint8_t packet[3 + 1024 + 2];
+    size_t packet_len;
+    uint8_t expected_id;
+    int64_t last_c;
+    uint8_t *image;
+    size_t image_len;
+    size_t capacity;
+    size_t offset;
+    uint32_t good;
+    struct
+    {
+        uint32_t blocks_1k;
+        uint32_t blocks_128;
+        uint32_t naks;
+        uint32_t duplicates;
+        uint64_t wire_bytes; // both directions
+        uint32_t turnarounds;
+    } stats;
+} receiver_t;
+
+static uint16_t crc16_xmodem(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static void receiver_send(receiver_t *rx, const void *data, size_t len)
+{
+    if (rx->out_head > 0)
+    {
+        memmove(rx->out, rx->out + rx->out_head, rx->out_len - rx->out_head);
+        rx->out_len -= rx->out_head;
+        rx->out_head = 0;
+    }
+    if (rx->out_len + len > sizeof(rx->out))
+    {
+        len = sizeof(rx->out) - rx->out_len;
+    }
+    memcpy(rx->out + rx->out_len, data, len);
+    rx->out_len += len;
+    rx->stats.wire_bytes += len;
+}
+
+static void receiver_reply(receiver_t *rx, uint8_t ctrl)
+{
+    receiver_send(rx, &ctrl, 1);
+    rx->stats.turnarounds++;
+    if (ctrl == XNACK)
+    {
+        rx->stats.naks++;
+    }
+}
+
+static void receiver_block(receiver_t *rx)
+{
+    size_t size = rx->packet[0] == XSTX ? 1024 : 128;
+    const uint8_t *data = rx->packet + 3;
+    uint16_t crc = (uint16_t)(data[size] << 8) | data[size + 1];
+
+    if (size == 1024 && !rx->config.accept_1k)
+    {
+        receiver_reply(rx, XNACK);
+        return;
+    }
+    if (rx->packet[1] != (uint8_t)(0xFF - rx->packet[2]) || crc16_xmodem(data, size) != crc)
+    {
+        receiver_reply(rx, XNACK);
+        return;
+    }
+    if (rx->packet[1] == (uint8_t)(rx->expected_id - 1))
+    {
+        // our ACK was lost, the sender repeats the block
+        rx->stats.duplicates++;
+        receiver_reply(rx, XACK);
+        return;
+    }
+    if (rx->packet[1] != rx->expected_id || rx->image_len + size > rx->capacity)
+    {
+        receiver_reply(rx, XCAN);
+        rx->state = RX_ABORTED;
+        return;
+    }
+    if (rx->config.nak_every > 0 && ++rx->good % rx->config.nak_every == 0)
+    {
+        receiver_reply(rx, XNACK);
+        return;
+    }
+
+    memcpy(rx->image + rx->image_len, data, size);
+    rx->image_len += size;
+    rx->expected_id++;
+    if (size == 1024)
+    {
+        rx->stats.blocks_1k++;
+    }
+    else
+    {
+        rx->stats.blocks_128++;
+    }
+    receiver_reply(rx, XACK);
+}
+
+static void receiver_eot(receiver_t *rx)
+{
+    static const char prompt[] = "\r\n" OTA_DONE_HINT " (y/n)\r\n";
+
+    receiver_reply(rx, XACK);
+    // a 12-byte offset record framed by C0 5A .. 5A C0 configures the next transfer
+    if (rx->image_len == 128 && rx->image[0] == 0xC0 && rx->image[1] == 0x5A && rx->image[10] == 0x5A && rx->image[11] == 0xC0)
+    {
+        rx->offset = rx->image[2] | rx->image[3] << 8 | rx->image[4] << 16 | (size_t)rx->image[5] << 24;
+        rx->image_len = 0;
+    }
+    receiver_send(rx, prompt, sizeof(prompt) - 1);
+    rx->state = RX_DONE_PROMPT;
+}
+
+static esp_err_t receiver_write(sscma_client_io_t *io, const void *data, size_t size)
+{
+    static const char hint[] = "\r\n" OTA_ENTER_HINT "\r\n";
+    receiver_t *rx = __containerof(io, receiver_t, base);
+    const uint8_t *p = data;
+
+    rx->stats.wire_bytes += size;
+    for (size_t i = 0; i < size; i++)
+    {
+        uint8_t c = p[i];
+        switch (rx->state)
+        {
+            case RX_MENU:
+                if (c == '1')
+                {
+                    receiver_send(rx, hint, sizeof(hint) - 1);
+                    rx->state = RX_WAIT;
+                    rx->last_c = 0;
+                }
+                break;
+            case RX_WAIT:
+            case RX_PACKETS:
+                if (rx->packet_len == 0)
+                {
+                    if (c == XEOT)
+                    {
+                        receiver_eot(rx);
+                        break;
+                    }
+                    if (c == XCAN)
+                    {
+                        rx->state = RX_ABORTED;
+                        break;
+                    }
+                    if (c != XSOH && c != XSTX)
+                    {
+                        // menu keys sent before the prompt was seen
+                        break;
+                    }
+                    rx->state = RX_PACKETS;
+                }
+                rx->packet[rx->packet_len++] = c;
+                if (rx->packet_len == 3 + (rx->packet[0] == XSTX ? 1024 : 128) + 2)
+                {
+                    receiver_block(rx);
+                    rx->packet_len = 0;
+                }
+                break;
+            case RX_DONE_PROMPT:
+                if (c == 'y')
+                {
+                    rx->state = RX_REBOOTED;
+                }
+                else if (c == 'n')
+                {
+                    rx->state = RX_WAIT;
+                    rx->expected_id = 1;
+                    rx->last_c = 0;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t receiver_available(sscma_client_io_t *io, size_t *ret_avail)
+{
+    receiver_t *rx = __containerof(io, receiver_t, base);
+    int64_t now = esp_timer_get_time();
+
+    if (rx->state == RX_WAIT && rx->out_head == rx->out_len && now - rx->last_c >= BENCH_C_INTERVAL_US)
+    {
+        uint8_t c = XC;
+        receiver_send(rx, &c, 1);
+        rx->last_c = now;
+    }
+    *ret_avail = rx->out_len - rx->out_head;
+
+    return ESP_OK;
+}
+
+static esp_err_t receiver_read(sscma_client_io_t *io, void *data, size_t size)
+{
+    receiver_t *rx = __containerof(io, receiver_t, base);
+
+    if (size > rx->out_len - rx->out_head)
+    {
+        size = rx->out_len - rx->out_head;
+    }
+    memcpy(data, rx->out + rx->out_head, size);
+    rx->out_head += size;
+
+    return ESP_OK;
+}
+
+static esp_err_t receiver_flush(sscma_client_io_t *io)
+{
+    receiver_t *rx = __containerof(io, receiver_t, base);
+
+    rx->out_head = 0;
+    rx->out_len = 0;
+
+    return ESP_OK;
+}
+
+static void receiver_init(receiver_t *rx, const receiver_config_t *config, size_t capacity)
+{
+    memset(rx, 0, sizeof(receiver_t));
+    rx->config = *config;
+    rx->state = RX_MENU;
+    rx->expected_id = 1;
+    rx->capacity = capacity;
+    rx->image = malloc(capacity);
+    rx->base.write = receiver_write;
+    rx->base.read = receiver_read;
+    rx->base.available = receiver_available;
+    rx->base.flush = receiver_flush;
+}
+
+typedef struct
+{
+    const char *name;
+    receiver_config_t receiver;
+    size_t image_size;
+    size_t offset;
+    bool expect_ok;
+    bool expect_1k; // 1K blocks up to the tail, 128-byte blocks only otherwise
+} flasher_case_t;
+
+static bool run_case(const flasher_case_t *test, int baud, int turnaround_us, bool timed)
+{
+    receiver_t rx;
+    sscma_client_flasher_handle_t flasher = NULL;
+    sscma_client_flasher_we2_config_t config = {
+        .reset_gpio_num = BENCH_RESET_GPIO,
+    };
+    size_t len = (test->image_size + 127) & ~(size_t)127;
+    uint8_t *image = malloc(len);
+    esp_err_t ret = ESP_OK;
+
+    // the padding the OTA path adds to the last chunk
+    for (size_t i = 0; i < len; i++)
+    {
+        image[i] = i < test->image_size ? (uint8_t)(i * 2654435761u >> 24) : 0xFF;
+    }
+    receiver_init(&rx, &test->receiver, len + 1024);
+    ESP_ERROR_CHECK(sscma_client_new_flasher_we2_uart(&rx.base, &config, &flasher));
+
+    int64_t start = esp_timer_get_time();
+    ret = sscma_client_flasher_start(flasher, test->offset);
+    for (size_t pos = 0; ret == ESP_OK && pos < len; pos += BENCH_CHUNK_SIZE)
+    {
+        ret = sscma_client_flasher_write(flasher, image + pos, len - pos < BENCH_CHUNK_SIZE ? len - pos : BENCH_CHUNK_SIZE);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = sscma_client_flasher_finish(flasher);
+    }
+    else
+    {
+        sscma_client_flasher_abort(flasher);
+    }
+    double ms = (esp_timer_get_time() - start) / 1000.0;
+
+    bool ok;
+    if (test->expect_ok)
+    {
+        // only the tail short of 1K goes out in 128-byte blocks, and the offset record
+        uint32_t expected_1k = test->expect_1k ? len / 1024 : 0;
+        uint32_t expected_128 = (len - expected_1k * 1024) / 128 + (test->offset != 0 ? 1 : 0);
+        ok = ret == ESP_OK && rx.state == RX_REBOOTED && rx.image_len == len && memcmp(rx.image, image, len) == 0 && rx.offset == test->offset && rx.stats.blocks_1k == expected_1k
+             && rx.stats.blocks_128 == expected_128;
+    }
+    else
+    {
+        ok = ret != ESP_OK && rx.state == RX_ABORTED;
+    }
+
+    printf("%-26s %8zu  %-13s %5lu x 1K %5lu x 128  %3lu NAKs  %s\n", test->name, test->image_size, esp_err_to_name(ret), (unsigned long)rx.stats.blocks_1k, (unsigned long)rx.stats.blocks_128,
+        (unsigned long)rx.stats.naks, ok ? "ok" : "FAILED");
+    if (timed)
+    {
+        // 8N1 framing plus the receiver's turnaround before every ACK or NAK
+        double wire_s = rx.stats.wire_bytes * 10.0 / baud + rx.stats.turnarounds * turnaround_us / 1e6;
+        printf("  host %.1f ms (%.1f MB/s), %llu bytes on the wire, %.1f%% payload, at %d baud with %d us turnaround: %.1f s, %.1f KB/s\n", ms, len / 1048576.0 / (ms / 1000.0),
+            (unsigned long long)rx.stats.wire_bytes, 100.0 * len / rx.stats.wire_bytes, baud, turnaround_us, wire_s, len / 1024.0 / wire_s);
+    }
+
+    sscma_client_flasher_delete(flasher);
+    free(rx.image);
+    free(image);
+
+    return ok;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-m image_mb] [-b baud] [-t turnaround_us]\n", name);
+    printf("  -b, -t  UART model for the timed image, 921600 baud and 500 us by default\n");
+}
+
+int main(int argc, char **argv)
+{
+    size_t image_mb = 4;
+    int baud = 921600;
+    int turnaround_us = 500;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:b:t:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm':
+                image_mb = atoi(optarg);
+                break;
+            case 'b':
+                baud = atoi(optarg);
+                break;
+            case 't':
+                turnaround_us = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    const flasher_case_t cases[] = {
+        { "1K blocks", { .accept_1k = true }, 64 * 1024, 0, true, true },
+        { "1K blocks, 128 tail", { .accept_1k = true }, 5 * 1024 + 384, 0, true, true },
+        { "odd size, padded", { .accept_1k = true }, 3 * 1024 + 100, 0, true, true },
+        { "offset record", { .accept_1k = true }, 16 * 1024, 0x400000, true, true },
+        { "128-byte receiver", { .accept_1k = false }, 32 * 1024, 0, true, false },
+        { "NAK every 7th block", { .accept_1k = true, .nak_every = 7 }, 64 * 1024, 0, true, true },
+        { "NAK every 128 block", { .accept_1k = false, .nak_every = 5 }, 16 * 1024, 0, true, false },
+        { "NAK every block", { .accept_1k = true, .nak_every = 1 }, 8 * 1024, 0, false, false },
+    };
+    int failures = 0;
+
+    printf("%-26s %8s  %-13s %s\n", "case", "bytes", "result", "blocks accepted and NAKs sent by the receiver");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        failures += run_case(&cases[i], baud, turnaround_us, false) ? 0 : 1;
+    }
+
+    printf("\n");
+    const flasher_case_t timed[] = {
+        { "image, 1K blocks", { .accept_1k = true }, image_mb * 1024 * 1024, 0, true, true },
+        { "image, 128-byte receiver", { .accept_1k = false }, image_mb * 1024 * 1024, 0, true, false },
+    };
+    for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); i++)
+    {
+        failures += run_case(&timed[i], baud, turnaround_us, true) ? 0 : 1;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
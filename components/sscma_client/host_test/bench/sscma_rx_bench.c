@@ -0,0 +1,313 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+// the ring scanner is static, bench the shipped code rather than a copy of it
+#include "../../src/sscma_client_ops.c"
+
+/*
+ * Replays the recorded replies in fixtures/ as the device frames them, cut
+ * into transport reads of a fixed size, through the RX framing loop the
+ * process task used before the ring buffer (NUL compaction, strnstr from the
+ * start of the buffer and a memmove after every frame) and through
+ * sscma_client_rx_feed(). Both copy every frame out of the RX buffer, events
+ * are only indexed, so the numbers are the framing cost alone.
+ */
+
+#define BENCH_MAX_FIXTURES 32
+
+static const size_t s_read_sizes[] = { 64, 256, 4095, 32768 };
+
+typedef struct
+{
+    char *data;
+    size_t len;
+    size_t frames;
+} stream_t;
+
+typedef struct
+{
+    char *data;
+    size_t pos;
+    size_t len;
+} old_rx_t;
+
+static size_t load_stream(const char *dir, size_t min_len, stream_t *stream)
+{
+    char *replies[BENCH_MAX_FIXTURES];
+    size_t lens[BENCH_MAX_FIXTURES];
+    size_t count = 0;
+    size_t cycle = 0;
+    struct dirent *entry;
+
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        perror(dir);
+        return 0;
+    }
+    while ((entry = readdir(d)) != NULL && count < BENCH_MAX_FIXTURES)
+    {
+        char path[512];
+        size_t name_len = strlen(entry->d_name);
+        if (name_len < 5 || strcmp(&entry->d_name[name_len - 5], ".json") != 0)
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL)
+        {
+            continue;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        replies[count] = malloc(size);
+        lens[count] = fread(replies[count], 1, size, f);
+        fclose(f);
+        while (lens[count] > 0 && (replies[count][lens[count] - 1] == '\n' || replies[count][lens[count] - 1] == '\r'))
+        {
+            lens[count]--;
+        }
+        cycle += lens[count] + 2;
+        count++;
+    }
+    closedir(d);
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // the fixtures back to back as "\r{...}\n", repeated until the stream is long enough
+    size_t cycles = (min_len + cycle - 1) / cycle;
+    stream->data = malloc(cycles * cycle);
+    stream->len = 0;
+    stream->frames = 0;
+    for (size_t c = 0; c < cycles; c++)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            stream->data[stream->len++] = '\r';
+            memcpy(stream->data + stream->len, replies[i], lens[i]);
+            stream->len += lens[i];
+            stream->data[stream->len++] = '\n';
+            stream->frames++;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        free(replies[i]);
+    }
+
+    return count;
+}
+
+/*
+ * The process task loop before the ring buffer, reduced to framing: each
+ * frame is copied out and released where it used to be parsed and routed.
+ */
+static size_t old_rx_read(old_rx_t *rx, const char *src, size_t rlen)
+{
+    size_t frames = 0;
+    char *suffix = NULL;
+    char *prefix = NULL;
+
+    if (rlen + rx->pos > rx->len)
+    {
+        rlen = rx->len - rx->pos;
+        if (rlen <= 0)
+        {
+            rx->pos = 0;
+            return 0;
+        }
+    }
+
+    memcpy(rx->data + rx->pos, src, rlen);
+    rx->pos += rlen;
+
+    int new_pos = 0;
+    for (int i = 0; i < rx->pos; i++)
+    {
+        if (rx->data[i] != '\0')
+        {
+            rx->data[new_pos++] = rx->data[i];
+        }
+    }
+    rx->pos = new_pos;
+
+    rx->data[rx->pos] = 0;
+    while ((suffix = strnstr(rx->data, RESPONSE_SUFFIX, rx->pos)) != NULL)
+    {
+        if ((prefix = strnstr(rx->data, RESPONSE_PREFIX, suffix - rx->data)) != NULL)
+        {
+            int len = suffix - prefix + RESPONSE_SUFFIX_LEN;
+            char *reply = malloc(len + 1);
+            if (reply != NULL)
+            {
+                memcpy(reply, prefix, len);
+                memmove(rx->data, suffix + RESPONSE_SUFFIX_LEN, rx->pos - (suffix - rx->data) - RESPONSE_PREFIX_LEN);
+                rx->pos -= len;
+                reply[len] = 0;
+                free(reply);
+                frames++;
+            }
+            else
+            {
+                rx->pos -= len;
+            }
+        }
+        else
+        {
+            memmove(rx->data, suffix + RESPONSE_SUFFIX_LEN, rx->pos - (suffix - rx->data) - RESPONSE_PREFIX_LEN);
+            rx->pos -= suffix - rx->data + RESPONSE_SUFFIX_LEN;
+            rx->data[rx->pos] = 0;
+        }
+    }
+
+    return frames;
+}
+
+static double run_old(const stream_t *stream, size_t read_size, size_t rx_size, size_t *frames)
+{
+    old_rx_t rx = {
+        .data = malloc(rx_size + 1),
+        .len = rx_size,
+    };
+
+    *frames = 0;
+    int64_t start = esp_timer_get_time();
+    for (size_t offset = 0; offset < stream->len; offset += read_size)
+    {
+        size_t rlen = stream->len - offset < read_size ? stream->len - offset : read_size;
+        *frames += old_rx_read(&rx, stream->data + offset, rlen);
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    free(rx.data);
+
+    return elapsed / 1000.0;
+}
+
+static double run_new(const stream_t *stream, size_t read_size, sscma_client_handle_t client, size_t *frames)
+{
+    sscma_client_stats_t before;
+    sscma_client_stats_t after;
+
+    sscma_client_rx_reset(client);
+    sscma_client_get_stats(client, &before);
+    int64_t start = esp_timer_get_time();
+    for (size_t offset = 0; offset < stream->len;)
+    {
+        size_t rlen = stream->len - offset < read_size ? stream->len - offset : read_size;
+        // the same clamps as sscma_client_process(), with the read replaced by a copy
+        size_t space = client->rx_buffer.len - client->rx_buffer.fill - 1;
+        if (space == 0)
+        {
+            sscma_client_rx_reset(client);
+            continue;
+        }
+        if (rlen > space)
+        {
+            rlen = space;
+        }
+        if (rlen > client->rx_buffer.len - client->rx_buffer.head)
+        {
+            rlen = client->rx_buffer.len - client->rx_buffer.head;
+        }
+        memcpy(client->rx_buffer.data + client->rx_buffer.head, stream->data + offset, rlen);
+        sscma_client_rx_feed(client, rlen);
+        offset += rlen;
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    sscma_client_get_stats(client, &after);
+    *frames = after.frames_parsed - before.frames_parsed;
+
+    return elapsed / 1000.0;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-m stream_mb] [-c read_bytes] [-d fixtures_dir]\n", name);
+    printf("  -c  one transport read size, by default 64, 256, 4095 and 32768\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = SSCMA_BENCH_FIXTURES_DIR;
+    size_t stream_mb = 8;
+    size_t read_size = 0;
+    stream_t stream;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:c:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            stream_mb = atoi(optarg);
+            break;
+        case 'c':
+            read_size = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    size_t count = load_stream(dir, stream_mb * 1024 * 1024, &stream);
+    if (count == 0)
+    {
+        printf("no fixtures in %s\n", dir);
+        return 1;
+    }
+
+    sscma_client_io_handle_t io = NULL;
+    sscma_client_handle_t client = NULL;
+    sscma_client_io_loopback_config_t io_config = { 0 };
+    sscma_client_config_t config = SSCMA_CLIENT_CONFIG_DEFAULT();
+    config.rx_buffer_size = CONFIG_SSCMA_RX_BUFFER_SIZE;
+    config.reply_pool_size = CONFIG_SSCMA_REPLY_POOL_SIZE;
+    config.reply_pool_slot_size = CONFIG_SSCMA_REPLY_POOL_SLOT_SIZE;
+    config.flags.lazy_event_payload = true;
+    // never inited, the process task stays idle and the bench feeds the ring itself
+    if (sscma_client_new_io_loopback(&io_config, &io) != ESP_OK || sscma_client_new(io, &config, &client) != ESP_OK)
+    {
+        printf("client setup failed\n");
+        return 1;
+    }
+
+    printf("%d fixtures, %zu frames in %.1f MB, %d byte RX buffer, framing only:\n", (int)count, stream.frames, stream.len / 1048576.0, CONFIG_SSCMA_RX_BUFFER_SIZE);
+    printf("%-10s %10s %9s  %10s %9s  %8s  %s\n", "read", "strnstr ms", "MB/s", "ring ms", "MB/s", "speedup", "frames");
+
+    int mismatches = 0;
+    size_t num_sizes = read_size > 0 ? 1 : sizeof(s_read_sizes) / sizeof(s_read_sizes[0]);
+    for (size_t i = 0; i < num_sizes; i++)
+    {
+        size_t size = read_size > 0 ? read_size : s_read_sizes[i];
+        size_t old_frames = 0;
+        size_t new_frames = 0;
+        double old_ms = run_old(&stream, size, CONFIG_SSCMA_RX_BUFFER_SIZE, &old_frames);
+        double new_ms = run_new(&stream, size, client, &new_frames);
+        bool match = old_frames == stream.frames && new_frames == stream.frames;
+        mismatches += match ? 0 : 1;
+
+        printf("%-10zu %10.1f %9.1f  %10.1f %9.1f  %7.1fx  %s\n", size, old_ms, stream.len / 1048576.0 / (old_ms / 1000.0), new_ms, stream.len / 1048576.0 / (new_ms / 1000.0),
+            old_ms / new_ms, match ? "match" : "MISMATCH");
+    }
+
+    sscma_client_del(client);
+    io->del(io);
+    free(stream.data);
+
+    return mismatches == 0 ? 0 : 1;
+}
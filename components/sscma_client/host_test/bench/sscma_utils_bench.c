@@ -0,0 +1,440 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host_heap.h"
+
+#include "mbedtls/base64.h"
+#include "sscma_client_ops.h"
+
+/*
+ * Decodes the replies in fixtures/ with sscma_utils_decode_result() and with
+ * the per-field sscma_utils_fetch_*() helpers on a parsed cJSON payload, the
+ * payload built on the heap or in a reply arena, and reports the time and
+ * heap allocations each takes per reply. Replies with an image are also
+ * decoded to JPEG the way the preview used to (parse, strdup the base64 and
+ * decode the copy), through the fetch helper, and straight from the reply
+ * with sscma_utils_decode_image_from_reply().
+ */
+
+#define BENCH_MAX_FIXTURES 32
+#define BENCH_ARENA_SIZE   (64 * 1024)
+#define BENCH_JPEG_SIZE    (64 * 1024)
+
+typedef esp_err_t (*bench_fn_t)(sscma_client_reply_t *reply, void *summary);
+
+typedef struct
+{
+    char name[64];
+    char *data;
+    size_t len;
+} fixture_t;
+
+typedef struct
+{
+    int num_boxes;
+    int num_classes;
+    int num_points;
+    int num_keypoints;
+    int checksum;
+    size_t image_len;
+} summary_t;
+
+static int compare_fixture(const void *a, const void *b)
+{
+    return strcmp(((const fixture_t *)a)->name, ((const fixture_t *)b)->name);
+}
+
+static size_t load_fixtures(const char *dir, fixture_t *fixtures, size_t max)
+{
+    size_t count = 0;
+    struct dirent *entry;
+
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        perror(dir);
+        return 0;
+    }
+    while ((entry = readdir(d)) != NULL && count < max)
+    {
+        char path[512];
+        size_t name_len = strlen(entry->d_name);
+        if (name_len < 5 || strcmp(&entry->d_name[name_len - 5], ".json") != 0)
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        FILE *f = fopen(path, "rb");
+        if (f == NULL)
+        {
+            continue;
+        }
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+
+        fixture_t *fixture = &fixtures[count];
+        fixture->data = malloc(size + 1);
+        fixture->len = fread(fixture->data, 1, size, f);
+        fclose(f);
+        // one reply per file, as the device frames it without the \r and \n
+        while (fixture->len > 0 && (fixture->data[fixture->len - 1] == '\n' || fixture->data[fixture->len - 1] == '\r'))
+        {
+            fixture->len--;
+        }
+        fixture->data[fixture->len] = '\0';
+        snprintf(fixture->name, sizeof(fixture->name), "%.*s", (int)(name_len - 5), entry->d_name);
+        count++;
+    }
+    closedir(d);
+    qsort(fixtures, count, sizeof(fixture_t), compare_fixture);
+
+    return count;
+}
+
+static void make_reply(const fixture_t *fixture, sscma_client_reply_t *reply, char *arena, sscma_client_reply_pool_t *pool)
+{
+    static const char key[] = "\"image\": \"";
+    const char *image = strstr(fixture->data, key);
+
+    memset(reply, 0, sizeof(sscma_client_reply_t));
+    reply->data = fixture->data;
+    reply->len = fixture->len;
+    if (arena != NULL)
+    {
+        reply->pool = pool;
+        reply->arena.base = arena;
+        reply->arena.size = BENCH_ARENA_SIZE;
+    }
+
+    // the client indexes data.image of every reply as it arrives
+    if (image != NULL)
+    {
+        reply->index.image = image + strlen(key);
+        reply->index.image_len = strchr(reply->index.image, '"') - reply->index.image;
+    }
+}
+
+static esp_err_t decode(sscma_client_reply_t *reply, void *out)
+{
+    summary_t *summary = out;
+    static sscma_client_result_t result;
+
+    esp_err_t ret = sscma_utils_decode_result(reply, &result);
+    if (summary != NULL)
+    {
+        memset(summary, 0, sizeof(summary_t));
+        summary->num_boxes = result.num_boxes;
+        summary->num_classes = result.num_classes;
+        summary->num_points = result.num_points;
+        summary->num_keypoints = result.num_keypoints;
+        summary->image_len = result.image_len;
+        for (int i = 0; i < result.num_boxes; i++)
+        {
+            summary->checksum += result.boxes[i].x + result.boxes[i].y + result.boxes[i].w + result.boxes[i].h + result.boxes[i].score + result.boxes[i].target;
+        }
+        for (int i = 0; i < result.num_classes; i++)
+        {
+            summary->checksum += result.classes[i].score + result.classes[i].target;
+        }
+        for (int i = 0; i < result.num_points; i++)
+        {
+            summary->checksum += result.points[i].x + result.points[i].y + result.points[i].score + result.points[i].target;
+        }
+        for (int i = 0; i < result.num_keypoints; i++)
+        {
+            summary->checksum += result.keypoints[i].box.x + result.keypoints[i].box.score;
+            for (int j = 0; j < result.keypoints[i].points_num; j++)
+            {
+                summary->checksum += result.keypoints[i].points[j].x + result.keypoints[i].points[j].y + result.keypoints[i].points[j].score;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static esp_err_t fetch(sscma_client_reply_t *reply, void *out)
+{
+    summary_t *summary = out;
+    sscma_client_box_t *boxes = NULL;
+    sscma_client_class_t *classes = NULL;
+    sscma_client_point_t *points = NULL;
+    sscma_client_keypoint_t *keypoints = NULL;
+    char *image = NULL;
+    int num_boxes = 0;
+    int num_classes = 0;
+    int num_points = 0;
+    int num_keypoints = 0;
+    int image_size = 0;
+
+    // what a consumer of the per-field helpers does for every event
+    esp_err_t ret = sscma_utils_fetch_boxes_from_reply(reply, &boxes, &num_boxes);
+    if (ret == ESP_OK)
+    {
+        ret = sscma_utils_fetch_classes_from_reply(reply, &classes, &num_classes);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = sscma_utils_fetch_points_from_reply(reply, &points, &num_points);
+    }
+    if (ret == ESP_OK)
+    {
+        ret = sscma_utils_fetch_keypoints_from_reply(reply, &keypoints, &num_keypoints);
+    }
+    if (ret == ESP_OK && reply->index.image != NULL)
+    {
+        ret = sscma_utils_fetch_image_from_reply(reply, &image, &image_size);
+    }
+
+    if (summary != NULL)
+    {
+        memset(summary, 0, sizeof(summary_t));
+        summary->num_boxes = num_boxes;
+        summary->num_classes = num_classes;
+        summary->num_points = num_points;
+        summary->num_keypoints = num_keypoints;
+        summary->image_len = image_size;
+        for (int i = 0; i < num_boxes; i++)
+        {
+            summary->checksum += boxes[i].x + boxes[i].y + boxes[i].w + boxes[i].h + boxes[i].score + boxes[i].target;
+        }
+        for (int i = 0; i < num_classes; i++)
+        {
+            summary->checksum += classes[i].score + classes[i].target;
+        }
+        for (int i = 0; i < num_points; i++)
+        {
+            summary->checksum += points[i].x + points[i].y + points[i].score + points[i].target;
+        }
+        for (int i = 0; i < num_keypoints; i++)
+        {
+            summary->checksum += keypoints[i].box.x + keypoints[i].box.score;
+            for (int j = 0; j < keypoints[i].points_num; j++)
+            {
+                summary->checksum += keypoints[i].points[j].x + keypoints[i].points[j].y + keypoints[i].points[j].score;
+            }
+        }
+    }
+
+    free(boxes);
+    free(classes);
+    free(points);
+    free(keypoints);
+    free(image);
+    // a fresh payload for the next event, released the way sscma_client_reply_clear() does
+    if (reply->arena.size == 0 || reply->arena.fallbacks > 0)
+    {
+        cJSON_Delete(reply->payload);
+    }
+    reply->payload = NULL;
+    reply->arena.used = 0;
+    reply->arena.fallbacks = 0;
+
+    return ret;
+}
+
+static uint8_t s_jpeg[BENCH_JPEG_SIZE];
+
+static esp_err_t image_parse(sscma_client_reply_t *reply, void *out)
+{
+    esp_err_t ret = ESP_FAIL;
+    size_t jpeg_len = 0;
+
+    // the preview before sscma_utils_decode_image_from_reply(): every frame parsed, the image duplicated, then decoded
+    cJSON *payload = cJSON_Parse(reply->data);
+    const char *image = cJSON_GetStringValue(cJSON_GetObjectItem(cJSON_GetObjectItem(payload, "data"), "image"));
+    char *copy = image != NULL ? strdup(image) : NULL;
+    if (copy != NULL && mbedtls_base64_decode(s_jpeg, sizeof(s_jpeg), &jpeg_len, (const unsigned char *)copy, strlen(copy)) == 0)
+    {
+        ret = ESP_OK;
+    }
+    free(copy);
+    cJSON_Delete(payload);
+
+    if (out != NULL)
+    {
+        *(size_t *)out = jpeg_len;
+    }
+    return ret;
+}
+
+static esp_err_t image_fetch(sscma_client_reply_t *reply, void *out)
+{
+    char *image = NULL;
+    int image_size = 0;
+    size_t jpeg_len = 0;
+
+    esp_err_t ret = sscma_utils_fetch_image_from_reply(reply, &image, &image_size);
+    if (ret == ESP_OK && mbedtls_base64_decode(s_jpeg, sizeof(s_jpeg), &jpeg_len, (const unsigned char *)image, strlen(image)) != 0)
+    {
+        ret = ESP_FAIL;
+    }
+    free(image);
+
+    if (out != NULL)
+    {
+        *(size_t *)out = jpeg_len;
+    }
+    return ret;
+}
+
+static esp_err_t image_decode(sscma_client_reply_t *reply, void *out)
+{
+    size_t jpeg_len = 0;
+
+    esp_err_t ret = sscma_utils_decode_image_from_reply(reply, s_jpeg, sizeof(s_jpeg), &jpeg_len);
+
+    if (out != NULL)
+    {
+        *(size_t *)out = jpeg_len;
+    }
+    return ret;
+}
+
+static double measure(bench_fn_t fn, sscma_client_reply_t *reply, int iterations, double *allocs)
+{
+    host_heap_stats_t before;
+    host_heap_stats_t after;
+
+    host_heap_get_stats(&before);
+    int64_t start = esp_timer_get_time();
+    for (int n = 0; n < iterations; n++)
+    {
+        fn(reply, NULL);
+    }
+    double us = (double)(esp_timer_get_time() - start) / iterations;
+    host_heap_get_stats(&after);
+    *allocs = (double)(after.allocs - before.allocs) / iterations;
+
+    return us;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-n iterations] [-d fixtures_dir]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    static fixture_t fixtures[BENCH_MAX_FIXTURES];
+    const char *dir = SSCMA_BENCH_FIXTURES_DIR;
+    int iterations = 2000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iterations = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_WARN);
+
+    size_t count = load_fixtures(dir, fixtures, BENCH_MAX_FIXTURES);
+    if (count == 0)
+    {
+        printf("no fixtures in %s\n", dir);
+        return 1;
+    }
+
+    printf("%d iterations per fixture, per reply, fetch with the payload on the heap and in a %d byte arena:\n", iterations, BENCH_ARENA_SIZE);
+    printf("%-28s %6s  %9s %6s  %9s %6s  %9s %6s  %s\n", "fixture", "bytes", "decode us", "allocs", "fetch us", "allocs", "arena us", "allocs", "result");
+
+    static char arena[BENCH_ARENA_SIZE] __attribute__((aligned(8)));
+    sscma_client_reply_pool_t pool = { 0 };
+    int mismatches = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        sscma_client_reply_t reply;
+        sscma_client_reply_t arena_reply;
+        summary_t decoded;
+        summary_t fetched;
+        summary_t arena_fetched;
+        double decode_allocs;
+        double fetch_allocs;
+        double arena_allocs;
+
+        make_reply(&fixtures[i], &reply, NULL, NULL);
+        make_reply(&fixtures[i], &arena_reply, arena, &pool);
+        esp_err_t ret = decode(&reply, &decoded);
+        if (ret == ESP_OK)
+        {
+            ret = fetch(&reply, &fetched);
+        }
+        if (ret == ESP_OK)
+        {
+            ret = fetch(&arena_reply, &arena_fetched);
+        }
+        bool match = ret == ESP_OK && memcmp(&decoded, &fetched, sizeof(summary_t)) == 0 && memcmp(&decoded, &arena_fetched, sizeof(summary_t)) == 0;
+        mismatches += match ? 0 : 1;
+
+        double decode_us = measure(decode, &reply, iterations, &decode_allocs);
+        double fetch_us = measure(fetch, &reply, iterations, &fetch_allocs);
+        double arena_us = measure(fetch, &arena_reply, iterations, &arena_allocs);
+
+        printf("%-28s %6zu  %9.2f %6.1f  %9.2f %6.1f  %9.2f %6.1f  %s\n", fixtures[i].name, fixtures[i].len, decode_us, decode_allocs, fetch_us, fetch_allocs, arena_us, arena_allocs,
+            match ? "match" : ret != ESP_OK ? esp_err_to_name(ret) : "MISMATCH");
+    }
+    printf("arena: %lu nodes and strings, %lu payloads parsed on the heap\n", (unsigned long)pool.arena_allocs, (unsigned long)pool.arena_misses);
+
+    printf("\nper reply with an image, to JPEG in a %d byte buffer:\n", BENCH_JPEG_SIZE);
+    printf("%-28s %6s  %9s %6s  %9s %6s  %9s %6s  %s\n", "fixture", "jpeg", "parse us", "allocs", "fetch us", "allocs", "direct us", "allocs", "result");
+    for (size_t i = 0; i < count; i++)
+    {
+        static uint8_t expected[BENCH_JPEG_SIZE];
+        sscma_client_reply_t reply;
+        size_t parsed_len = 0;
+        size_t fetched_len = 0;
+        size_t decoded_len = 0;
+        double parse_allocs;
+        double fetch_allocs;
+        double decode_allocs;
+
+        make_reply(&fixtures[i], &reply, NULL, NULL);
+        if (reply.index.image == NULL)
+        {
+            continue;
+        }
+        esp_err_t ret = image_parse(&reply, &parsed_len);
+        memcpy(expected, s_jpeg, parsed_len);
+        bool match = ret == ESP_OK;
+        if (ret == ESP_OK)
+        {
+            ret = image_fetch(&reply, &fetched_len);
+            match = match && ret == ESP_OK && fetched_len == parsed_len && memcmp(expected, s_jpeg, parsed_len) == 0;
+        }
+        if (ret == ESP_OK)
+        {
+            ret = image_decode(&reply, &decoded_len);
+            match = match && ret == ESP_OK && decoded_len == parsed_len && memcmp(expected, s_jpeg, parsed_len) == 0;
+        }
+        mismatches += match ? 0 : 1;
+
+        double parse_us = measure(image_parse, &reply, iterations, &parse_allocs);
+        double fetch_us = measure(image_fetch, &reply, iterations, &fetch_allocs);
+        double decode_us = measure(image_decode, &reply, iterations, &decode_allocs);
+
+        printf("%-28s %6zu  %9.2f %6.1f  %9.2f %6.1f  %9.2f %6.1f  %s\n", fixtures[i].name, parsed_len, parse_us, parse_allocs, fetch_us, fetch_allocs, decode_us, decode_allocs,
+            match ? "match" : ret != ESP_OK ? esp_err_to_name(ret) : "MISMATCH");
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        free(fixtures[i].data);
+    }
+
+    return mismatches == 0 ? 0 : 1;
+}
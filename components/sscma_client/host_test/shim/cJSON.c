@@ -0,0 +1,902 @@
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cJSON.h"
+
+/*
+ * A small reimplementation of the upstream cJSON calls used by the client.
+ * Parsing is strict enough for device replies, printing is compact only.
+ */
+
+static struct
+{
+    void *(*allocate)(size_t size);
+    void (*deallocate)(void *ptr);
+} s_hooks = {
+    malloc,
+    free,
+};
+
+typedef struct
+{
+    const unsigned char *content;
+    size_t length;
+    size_t offset;
+} parse_buffer;
+
+#define can_read(buffer, size) ((buffer)->offset + (size) <= (buffer)->length)
+#define buffer_at(buffer)      ((buffer)->content + (buffer)->offset)
+
+static cJSON_bool parse_value(cJSON *item, parse_buffer *buffer);
+
+void cJSON_InitHooks(cJSON_Hooks *hooks)
+{
+    s_hooks.allocate = hooks && hooks->malloc_fn ? hooks->malloc_fn : malloc;
+    s_hooks.deallocate = hooks && hooks->free_fn ? hooks->free_fn : free;
+}
+
+void cJSON_free(void *object)
+{
+    s_hooks.deallocate(object);
+}
+
+static cJSON *cJSON_New_Item(void)
+{
+    cJSON *node = (cJSON *)s_hooks.allocate(sizeof(cJSON));
+    if (node)
+    {
+        memset(node, 0, sizeof(cJSON));
+    }
+    return node;
+}
+
+static char *cJSON_strdup(const char *string)
+{
+    size_t length = strlen(string) + 1;
+    char *copy = (char *)s_hooks.allocate(length);
+    return copy ? memcpy(copy, string, length) : NULL;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    cJSON *next = NULL;
+    while (item != NULL)
+    {
+        next = item->next;
+        if (!(item->type & cJSON_IsReference) && item->child != NULL)
+        {
+            cJSON_Delete(item->child);
+        }
+        if (!(item->type & cJSON_IsReference) && item->valuestring != NULL)
+        {
+            s_hooks.deallocate(item->valuestring);
+        }
+        if (!(item->type & cJSON_StringIsConst) && item->string != NULL)
+        {
+            s_hooks.deallocate(item->string);
+        }
+        s_hooks.deallocate(item);
+        item = next;
+    }
+}
+
+static void skip_whitespace(parse_buffer *buffer)
+{
+    while (can_read(buffer, 1) && buffer_at(buffer)[0] <= 32)
+    {
+        buffer->offset++;
+    }
+}
+
+static cJSON_bool parse_number(cJSON *item, parse_buffer *buffer)
+{
+    char number[64];
+    size_t i = 0;
+    char *end = NULL;
+
+    while (can_read(buffer, i + 1) && i < sizeof(number) - 1 && strchr("0123456789+-eE.", buffer_at(buffer)[i]) != NULL)
+    {
+        number[i] = (char)buffer_at(buffer)[i];
+        i++;
+    }
+    number[i] = '\0';
+
+    double value = strtod(number, &end);
+    if (end == number)
+    {
+        return 0;
+    }
+
+    item->valuedouble = value;
+    item->valueint = value >= INT_MAX ? INT_MAX : value <= (double)INT_MIN ? INT_MIN : (int)value;
+    item->type = cJSON_Number;
+    buffer->offset += (size_t)(end - number);
+    return 1;
+}
+
+static unsigned parse_hex4(const unsigned char *input)
+{
+    unsigned h = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        h <<= 4;
+        if (input[i] >= '0' && input[i] <= '9')
+        {
+            h += input[i] - '0';
+        }
+        else if (input[i] >= 'A' && input[i] <= 'F')
+        {
+            h += 10 + input[i] - 'A';
+        }
+        else if (input[i] >= 'a' && input[i] <= 'f')
+        {
+            h += 10 + input[i] - 'a';
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return h;
+}
+
+/* Decode \uXXXX (and a following low surrogate) to UTF-8, returns input consumed or 0 */
+static size_t utf16_to_utf8(const unsigned char *input, const unsigned char *end, unsigned char **output)
+{
+    unsigned long codepoint = 0;
+    size_t consumed = 6;
+
+    if (end - input < 6)
+    {
+        return 0;
+    }
+    unsigned first = parse_hex4(input + 2);
+    if (first >= 0xDC00 && first <= 0xDFFF)
+    {
+        return 0;
+    }
+    if (first >= 0xD800 && first <= 0xDBFF)
+    {
+        if (end - input < 12 || input[6] != '\\' || input[7] != 'u')
+        {
+            return 0;
+        }
+        unsigned second = parse_hex4(input + 8);
+        if (second < 0xDC00 || second > 0xDFFF)
+        {
+            return 0;
+        }
+        codepoint = 0x10000 + (((first & 0x3FF) << 10) | (second & 0x3FF));
+        consumed = 12;
+    }
+    else
+    {
+        codepoint = first;
+    }
+
+    unsigned char *out = *output;
+    if (codepoint < 0x80)
+    {
+        *out++ = (unsigned char)codepoint;
+    }
+    else if (codepoint < 0x800)
+    {
+        *out++ = (unsigned char)(0xC0 | (codepoint >> 6));
+        *out++ = (unsigned char)(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        *out++ = (unsigned char)(0xE0 | (codepoint >> 12));
+        *out++ = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (unsigned char)(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        *out++ = (unsigned char)(0xF0 | (codepoint >> 18));
+        *out++ = (unsigned char)(0x80 | ((codepoint >> 12) & 0x3F));
+        *out++ = (unsigned char)(0x80 | ((codepoint >> 6) & 0x3F));
+        *out++ = (unsigned char)(0x80 | (codepoint & 0x3F));
+    }
+    *output = out;
+    return consumed;
+}
+
+static cJSON_bool parse_string(cJSON *item, parse_buffer *buffer)
+{
+    const unsigned char *input = buffer_at(buffer) + 1;
+    const unsigned char *end = buffer->content + buffer->length;
+    const unsigned char *scan = input;
+    size_t skipped = 0;
+
+    if (buffer_at(buffer)[0] != '\"')
+    {
+        return 0;
+    }
+    // find the closing quote, counting escapes to size the output like upstream does
+    while (scan < end && *scan != '\"')
+    {
+        if (*scan == '\\')
+        {
+            if (scan + 1 >= end)
+            {
+                return 0;
+            }
+            skipped++;
+            scan++;
+        }
+        scan++;
+    }
+    if (scan >= end)
+    {
+        return 0;
+    }
+
+    unsigned char *output = (unsigned char *)s_hooks.allocate((size_t)(scan - input) - skipped + 1);
+    unsigned char *out = output;
+    if (output == NULL)
+    {
+        return 0;
+    }
+    while (input < scan)
+    {
+        if (*input != '\\')
+        {
+            *out++ = *input++;
+            continue;
+        }
+        switch (input[1])
+        {
+        case 'b':
+            *out++ = '\b';
+            break;
+        case 'f':
+            *out++ = '\f';
+            break;
+        case 'n':
+            *out++ = '\n';
+            break;
+        case 'r':
+            *out++ = '\r';
+            break;
+        case 't':
+            *out++ = '\t';
+            break;
+        case '\"':
+        case '\\':
+        case '/':
+            *out++ = input[1];
+            break;
+        case 'u':
+        {
+            size_t consumed = utf16_to_utf8(input, scan, &out);
+            if (consumed == 0)
+            {
+                s_hooks.deallocate(output);
+                return 0;
+            }
+            input += consumed;
+            continue;
+        }
+        default:
+            s_hooks.deallocate(output);
+            return 0;
+        }
+        input += 2;
+    }
+    *out = '\0';
+
+    item->type = cJSON_String;
+    item->valuestring = (char *)output;
+    buffer->offset = (size_t)(scan - buffer->content) + 1;
+    return 1;
+}
+
+static cJSON_bool parse_array(cJSON *item, parse_buffer *buffer)
+{
+    cJSON *head = NULL;
+    cJSON *current = NULL;
+
+    buffer->offset++;
+    skip_whitespace(buffer);
+    if (can_read(buffer, 1) && buffer_at(buffer)[0] == ']')
+    {
+        buffer->offset++;
+        item->type = cJSON_Array;
+        return 1;
+    }
+
+    do
+    {
+        cJSON *node = cJSON_New_Item();
+        if (node == NULL)
+        {
+            goto fail;
+        }
+        if (head == NULL)
+        {
+            head = current = node;
+        }
+        else
+        {
+            current->next = node;
+            node->prev = current;
+            current = node;
+        }
+        buffer->offset += head == node ? 0 : 1;
+        skip_whitespace(buffer);
+        if (!parse_value(current, buffer))
+        {
+            goto fail;
+        }
+        skip_whitespace(buffer);
+    } while (can_read(buffer, 1) && buffer_at(buffer)[0] == ',');
+
+    if (!can_read(buffer, 1) || buffer_at(buffer)[0] != ']')
+    {
+        goto fail;
+    }
+    buffer->offset++;
+    if (head != NULL)
+    {
+        head->prev = current;
+    }
+    item->type = cJSON_Array;
+    item->child = head;
+    return 1;
+
+fail:
+    cJSON_Delete(head);
+    return 0;
+}
+
+static cJSON_bool parse_object(cJSON *item, parse_buffer *buffer)
+{
+    cJSON *head = NULL;
+    cJSON *current = NULL;
+
+    buffer->offset++;
+    skip_whitespace(buffer);
+    if (can_read(buffer, 1) && buffer_at(buffer)[0] == '}')
+    {
+        buffer->offset++;
+        item->type = cJSON_Object;
+        return 1;
+    }
+
+    do
+    {
+        cJSON *node = cJSON_New_Item();
+        if (node == NULL)
+        {
+            goto fail;
+        }
+        if (head == NULL)
+        {
+            head = current = node;
+        }
+        else
+        {
+            current->next = node;
+            node->prev = current;
+            current = node;
+        }
+        buffer->offset += head == node ? 0 : 1;
+        skip_whitespace(buffer);
+        if (!can_read(buffer, 1) || !parse_string(current, buffer))
+        {
+            goto fail;
+        }
+        // the key was parsed as a string value, move it over
+        current->string = current->valuestring;
+        current->valuestring = NULL;
+        skip_whitespace(buffer);
+        if (!can_read(buffer, 1) || buffer_at(buffer)[0] != ':')
+        {
+            goto fail;
+        }
+        buffer->offset++;
+        skip_whitespace(buffer);
+        if (!parse_value(current, buffer))
+        {
+            goto fail;
+        }
+        skip_whitespace(buffer);
+    } while (can_read(buffer, 1) && buffer_at(buffer)[0] == ',');
+
+    if (!can_read(buffer, 1) || buffer_at(buffer)[0] != '}')
+    {
+        goto fail;
+    }
+    buffer->offset++;
+    if (head != NULL)
+    {
+        head->prev = current;
+    }
+    item->type = cJSON_Object;
+    item->child = head;
+    return 1;
+
+fail:
+    cJSON_Delete(head);
+    return 0;
+}
+
+static cJSON_bool parse_value(cJSON *item, parse_buffer *buffer)
+{
+    if (!can_read(buffer, 1))
+    {
+        return 0;
+    }
+    if (can_read(buffer, 4) && strncmp((const char *)buffer_at(buffer), "null", 4) == 0)
+    {
+        item->type = cJSON_NULL;
+        buffer->offset += 4;
+        return 1;
+    }
+    if (can_read(buffer, 5) && strncmp((const char *)buffer_at(buffer), "false", 5) == 0)
+    {
+        item->type = cJSON_False;
+        buffer->offset += 5;
+        return 1;
+    }
+    if (can_read(buffer, 4) && strncmp((const char *)buffer_at(buffer), "true", 4) == 0)
+    {
+        item->type = cJSON_True;
+        item->valueint = 1;
+        buffer->offset += 4;
+        return 1;
+    }
+    switch (buffer_at(buffer)[0])
+    {
+    case '\"':
+        return parse_string(item, buffer);
+    case '[':
+        return parse_array(item, buffer);
+    case '{':
+        return parse_object(item, buffer);
+    case '-':
+    case '0' ... '9':
+        return parse_number(item, buffer);
+    default:
+        return 0;
+    }
+}
+
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length)
+{
+    parse_buffer buffer = {
+        .content = (const unsigned char *)value,
+        .length = buffer_length,
+    };
+    cJSON *item = NULL;
+
+    if (value == NULL || buffer_length == 0)
+    {
+        return NULL;
+    }
+    item = cJSON_New_Item();
+    if (item == NULL)
+    {
+        return NULL;
+    }
+    skip_whitespace(&buffer);
+    if (!parse_value(item, &buffer))
+    {
+        cJSON_Delete(item);
+        return NULL;
+    }
+    return item;
+}
+
+cJSON *cJSON_Parse(const char *value)
+{
+    return value ? cJSON_ParseWithLength(value, strlen(value) + 1) : NULL;
+}
+
+typedef struct
+{
+    char *buffer;
+    size_t length;
+    size_t offset;
+} printbuffer;
+
+static char *ensure(printbuffer *p, size_t needed)
+{
+    if (p->buffer == NULL)
+    {
+        return NULL;
+    }
+    needed += p->offset + 1;
+    if (needed > p->length)
+    {
+        // grow with malloc and copy, upstream does the same when the hooks have no realloc
+        size_t length = needed * 2;
+        char *buffer = (char *)s_hooks.allocate(length);
+        if (buffer == NULL)
+        {
+            s_hooks.deallocate(p->buffer);
+            p->buffer = NULL;
+            return NULL;
+        }
+        memcpy(buffer, p->buffer, p->offset + 1);
+        s_hooks.deallocate(p->buffer);
+        p->buffer = buffer;
+        p->length = length;
+    }
+    return p->buffer + p->offset;
+}
+
+static cJSON_bool print_string(const char *str, printbuffer *p)
+{
+    size_t escaped = 0;
+    const unsigned char *s = (const unsigned char *)(str ? str : "");
+
+    for (const unsigned char *c = s; *c; c++)
+    {
+        if (*c == '\"' || *c == '\\' || *c == '\b' || *c == '\f' || *c == '\n' || *c == '\r' || *c == '\t')
+        {
+            escaped += 1;
+        }
+        else if (*c < 32)
+        {
+            escaped += 5;
+        }
+    }
+    char *out = ensure(p, strlen((const char *)s) + escaped + 2);
+    if (out == NULL)
+    {
+        return 0;
+    }
+    *out++ = '\"';
+    for (const unsigned char *c = s; *c; c++)
+    {
+        if (*c >= 32 && *c != '\"' && *c != '\\')
+        {
+            *out++ = (char)*c;
+            continue;
+        }
+        *out++ = '\\';
+        switch (*c)
+        {
+        case '\"':
+        case '\\':
+            *out++ = (char)*c;
+            break;
+        case '\b':
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = 'f';
+            break;
+        case '\n':
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = 't';
+            break;
+        default:
+            out += sprintf(out, "u%04x", *c);
+            break;
+        }
+    }
+    *out++ = '\"';
+    *out = '\0';
+    p->offset = (size_t)(out - p->buffer);
+    return 1;
+}
+
+static cJSON_bool print_value(const cJSON *item, printbuffer *p)
+{
+    char number[32];
+    const char *literal = NULL;
+
+    switch (item->type & 0xFF)
+    {
+    case cJSON_NULL:
+        literal = "null";
+        break;
+    case cJSON_False:
+        literal = "false";
+        break;
+    case cJSON_True:
+        literal = "true";
+        break;
+    case cJSON_Number:
+        if (isnan(item->valuedouble) || isinf(item->valuedouble))
+        {
+            literal = "null";
+        }
+        else if (item->valuedouble == (double)item->valueint)
+        {
+            snprintf(number, sizeof(number), "%d", item->valueint);
+            literal = number;
+        }
+        else
+        {
+            snprintf(number, sizeof(number), "%1.15g", item->valuedouble);
+            if (strtod(number, NULL) != item->valuedouble)
+            {
+                snprintf(number, sizeof(number), "%1.17g", item->valuedouble);
+            }
+            literal = number;
+        }
+        break;
+    case cJSON_String:
+        return print_string(item->valuestring, p);
+    case cJSON_Array:
+    case cJSON_Object:
+    {
+        cJSON_bool object = (item->type & 0xFF) == cJSON_Object;
+        char *out = ensure(p, 1);
+        if (out == NULL)
+        {
+            return 0;
+        }
+        *out = object ? '{' : '[';
+        p->offset++;
+        for (const cJSON *child = item->child; child; child = child->next)
+        {
+            if (object)
+            {
+                if (!print_string(child->string, p) || (out = ensure(p, 1)) == NULL)
+                {
+                    return 0;
+                }
+                *out = ':';
+                p->offset++;
+            }
+            if (!print_value(child, p))
+            {
+                return 0;
+            }
+            if (child->next)
+            {
+                if ((out = ensure(p, 1)) == NULL)
+                {
+                    return 0;
+                }
+                *out = ',';
+                p->offset++;
+            }
+        }
+        if ((out = ensure(p, 1)) == NULL)
+        {
+            return 0;
+        }
+        out[0] = object ? '}' : ']';
+        out[1] = '\0';
+        p->offset++;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+
+    char *out = ensure(p, strlen(literal));
+    if (out == NULL)
+    {
+        return 0;
+    }
+    strcpy(out, literal);
+    p->offset += strlen(literal);
+    return 1;
+}
+
+char *cJSON_PrintUnformatted(const cJSON *item)
+{
+    printbuffer p = {
+        .buffer = (char *)s_hooks.allocate(256),
+        .length = 256,
+    };
+
+    if (p.buffer == NULL || item == NULL)
+    {
+        cJSON_free(p.buffer);
+        return NULL;
+    }
+    p.buffer[0] = '\0';
+    if (!print_value(item, &p))
+    {
+        cJSON_free(p.buffer);
+        return NULL;
+    }
+    return p.buffer;
+}
+
+int cJSON_GetArraySize(const cJSON *array)
+{
+    int size = 0;
+    for (const cJSON *child = array ? array->child : NULL; child; child = child->next)
+    {
+        size++;
+    }
+    return size;
+}
+
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index)
+{
+    cJSON *child = array && index >= 0 ? array->child : NULL;
+    while (child && index-- > 0)
+    {
+        child = child->next;
+    }
+    return child;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *const object, const char *const string)
+{
+    if (object == NULL || string == NULL)
+    {
+        return NULL;
+    }
+    // upstream compares keys case insensitively here
+    for (cJSON *child = object->child; child; child = child->next)
+    {
+        if (child->string && strcasecmp(child->string, string) == 0)
+        {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+char *cJSON_GetStringValue(const cJSON *const item)
+{
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+double cJSON_GetNumberValue(const cJSON *const item)
+{
+    return cJSON_IsNumber(item) ? item->valuedouble : NAN;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *const item)
+{
+    return item && (item->type & 0xFF) == cJSON_Number;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *const item)
+{
+    return item && (item->type & 0xFF) == cJSON_String;
+}
+
+cJSON_bool cJSON_IsArray(const cJSON *const item)
+{
+    return item && (item->type & 0xFF) == cJSON_Array;
+}
+
+cJSON_bool cJSON_IsObject(const cJSON *const item)
+{
+    return item && (item->type & 0xFF) == cJSON_Object;
+}
+
+cJSON *cJSON_CreateObject(void)
+{
+    cJSON *item = cJSON_New_Item();
+    if (item)
+    {
+        item->type = cJSON_Object;
+    }
+    return item;
+}
+
+cJSON *cJSON_CreateArray(void)
+{
+    cJSON *item = cJSON_New_Item();
+    if (item)
+    {
+        item->type = cJSON_Array;
+    }
+    return item;
+}
+
+cJSON *cJSON_CreateString(const char *string)
+{
+    cJSON *item = cJSON_New_Item();
+    if (item)
+    {
+        item->type = cJSON_String;
+        item->valuestring = cJSON_strdup(string ? string : "");
+        if (item->valuestring == NULL)
+        {
+            cJSON_Delete(item);
+            return NULL;
+        }
+    }
+    return item;
+}
+
+cJSON *cJSON_CreateNumber(double num)
+{
+    cJSON *item = cJSON_New_Item();
+    if (item)
+    {
+        item->type = cJSON_Number;
+        item->valuedouble = num;
+        item->valueint = num >= INT_MAX ? INT_MAX : num <= (double)INT_MIN ? INT_MIN : (int)num;
+    }
+    return item;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item)
+{
+    if (array == NULL || item == NULL || array == item)
+    {
+        return 0;
+    }
+    if (array->child == NULL)
+    {
+        array->child = item;
+        item->prev = item;
+        item->next = NULL;
+    }
+    else
+    {
+        // the head's prev points at the tail
+        cJSON *tail = array->child->prev;
+        tail->next = item;
+        item->prev = tail;
+        array->child->prev = item;
+    }
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item)
+{
+    char *key = NULL;
+
+    if (object == NULL || string == NULL || item == NULL)
+    {
+        return 0;
+    }
+    key = cJSON_strdup(string);
+    if (key == NULL)
+    {
+        return 0;
+    }
+    if (!(item->type & cJSON_StringIsConst) && item->string != NULL)
+    {
+        s_hooks.deallocate(item->string);
+    }
+    item->string = key;
+    item->type &= ~cJSON_StringIsConst;
+    return cJSON_AddItemToArray(object, item);
+}
+
+static cJSON *add_to_object(cJSON *object, const char *name, cJSON *item)
+{
+    if (item != NULL && cJSON_AddItemToObject(object, name, item))
+    {
+        return item;
+    }
+    cJSON_Delete(item);
+    return NULL;
+}
+
+cJSON *cJSON_AddStringToObject(cJSON *const object, const char *const name, const char *const string)
+{
+    return add_to_object(object, name, cJSON_CreateString(string));
+}
+
+cJSON *cJSON_AddNumberToObject(cJSON *const object, const char *const name, const double number)
+{
+    return add_to_object(object, name, cJSON_CreateNumber(number));
+}
+
+cJSON *cJSON_AddObjectToObject(cJSON *const object, const char *const name)
+{
+    return add_to_object(object, name, cJSON_CreateObject());
+}
+
+cJSON *cJSON_AddArrayToObject(cJSON *const object, const char *const name)
+{
+    return add_to_object(object, name, cJSON_CreateArray());
+}
@@ -0,0 +1,581 @@
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_io_expander.h"
+#include "driver/gpio.h"
+#include "nvs.h"
+#include "host_heap.h"
+
+#define LOG_TAGS 16
+#define NVS_KEYS 16
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NOT_FINISHED:
+        return "ESP_ERR_NOT_FINISHED";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+char *strnstr(const char *haystack, const char *needle, size_t len)
+{
+    size_t needle_len = strlen(needle);
+
+    if (needle_len == 0)
+    {
+        return (char *)haystack;
+    }
+    for (size_t i = 0; i + needle_len <= len && haystack[i] != '\0'; i++)
+    {
+        if (haystack[i] == needle[0] && strncmp(haystack + i, needle, needle_len) == 0)
+        {
+            return (char *)haystack + i;
+        }
+    }
+    return NULL;
+}
+
+/* log */
+
+static struct
+{
+    pthread_mutex_t lock;
+    esp_log_level_t level;
+    struct
+    {
+        const char *tag;
+        esp_log_level_t level;
+    } tags[LOG_TAGS];
+} s_log = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .level = ESP_LOG_INFO,
+};
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&s_log.lock);
+    if (strcmp(tag, "*") == 0)
+    {
+        s_log.level = level;
+        memset(s_log.tags, 0, sizeof(s_log.tags));
+    }
+    else
+    {
+        for (int i = 0; i < LOG_TAGS; i++)
+        {
+            if (s_log.tags[i].tag == NULL || strcmp(s_log.tags[i].tag, tag) == 0)
+            {
+                s_log.tags[i].tag = tag;
+                s_log.tags[i].level = level;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&s_log.lock);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    esp_log_level_t limit;
+    va_list args;
+
+    pthread_mutex_lock(&s_log.lock);
+    limit = s_log.level;
+    for (int i = 0; i < LOG_TAGS && s_log.tags[i].tag != NULL; i++)
+    {
+        if (strcmp(s_log.tags[i].tag, tag) == 0)
+        {
+            limit = s_log.tags[i].level;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&s_log.lock);
+
+    if (level > limit)
+    {
+        return;
+    }
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+/* timer, every timer gets a thread that runs its callback */
+
+struct esp_timer
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    esp_timer_cb_t callback;
+    void *arg;
+    uint64_t period_us; // 0 for one shot
+    int64_t due_us;     // 0 when stopped
+    bool deleted;
+};
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void *timer_thread(void *arg)
+{
+    esp_timer_handle_t timer = (esp_timer_handle_t)arg;
+
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->deleted)
+    {
+        if (timer->due_us == 0)
+        {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now < timer->due_us)
+        {
+            struct timespec deadline = {
+                .tv_sec = timer->due_us / 1000000,
+                .tv_nsec = (timer->due_us % 1000000) * 1000,
+            };
+            pthread_cond_timedwait(&timer->cond, &timer->lock, &deadline);
+            continue;
+        }
+
+        // like skip_unhandled_events, a late periodic timer fires once and realigns
+        timer->due_us = timer->period_us > 0 ? now + timer->period_us : 0;
+        pthread_mutex_unlock(&timer->lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    pthread_condattr_t attr;
+    esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+
+    if (create_args == NULL || create_args->callback == NULL || out_handle == NULL)
+    {
+        free(timer);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&timer->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&timer->thread, NULL, timer_thread, timer) != 0)
+    {
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+    *out_handle = timer;
+
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&timer->lock);
+    if (timer->due_us != 0)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else
+    {
+        timer->period_us = period_us;
+        timer->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+        pthread_cond_signal(&timer->cond);
+    }
+    pthread_mutex_unlock(&timer->lock);
+
+    return ret;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return timer_arm(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&timer->lock);
+    if (timer->due_us == 0)
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = 0;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+
+    return ret;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    timer->deleted = true;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+
+    pthread_join(timer->thread, NULL);
+    pthread_mutex_destroy(&timer->lock);
+    pthread_cond_destroy(&timer->cond);
+    free(timer);
+
+    return ESP_OK;
+}
+
+/* heap */
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return calloc(n, size);
+}
+
+void *heap_caps_malloc_prefer(size_t size, size_t num, ...)
+{
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return SIZE_MAX;
+}
+
+/*
+ * Link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free,--wrap=strdup.
+ * Blocks are measured with malloc_usable_size(), so a block that libc allocated
+ * internally can still be freed through the wrapper.
+ */
+static struct
+{
+    pthread_mutex_t lock;
+    host_heap_stats_t stats;
+} s_heap = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static void *heap_account(void *ptr, size_t size, size_t released)
+{
+    if (ptr == NULL)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&s_heap.lock);
+    s_heap.stats.allocs++;
+    s_heap.stats.bytes += size;
+    s_heap.stats.in_use += malloc_usable_size(ptr) - released;
+    if (s_heap.stats.in_use > s_heap.stats.peak)
+    {
+        s_heap.stats.peak = s_heap.stats.in_use;
+    }
+    pthread_mutex_unlock(&s_heap.lock);
+
+    return ptr;
+}
+
+void *__wrap_malloc(size_t size)
+{
+    return heap_account(__real_malloc(size), size, 0);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    return heap_account(__real_calloc(n, size), n * size, 0);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t released = ptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = __real_realloc(ptr, size);
+
+    if (new_ptr == NULL)
+    {
+        return NULL;
+    }
+    return heap_account(new_ptr, size, released);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&s_heap.lock);
+    s_heap.stats.frees++;
+    s_heap.stats.in_use -= malloc_usable_size(ptr);
+    pthread_mutex_unlock(&s_heap.lock);
+
+    __real_free(ptr);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *copy = __wrap_malloc(len);
+    return copy ? memcpy(copy, s, len) : NULL;
+}
+
+void host_heap_get_stats(host_heap_stats_t *stats)
+{
+    pthread_mutex_lock(&s_heap.lock);
+    *stats = s_heap.stats;
+    pthread_mutex_unlock(&s_heap.lock);
+}
+
+/* crc */
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* nvs, one volatile namespace-less store */
+
+static struct
+{
+    pthread_mutex_t lock;
+    struct
+    {
+        char key[16];
+        void *value;
+        size_t length;
+    } keys[NVS_KEYS];
+} s_nvs = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+static int nvs_find(const char *key)
+{
+    for (int i = 0; i < NVS_KEYS; i++)
+    {
+        if (s_nvs.keys[i].value != NULL && strncmp(s_nvs.keys[i].key, key, sizeof(s_nvs.keys[i].key)) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock(&s_nvs.lock);
+    int i = nvs_find(key);
+    if (i < 0)
+    {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if (out_value == NULL)
+    {
+        *length = s_nvs.keys[i].length;
+    }
+    else if (*length < s_nvs.keys[i].length)
+    {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    else
+    {
+        memcpy(out_value, s_nvs.keys[i].value, s_nvs.keys[i].length);
+        *length = s_nvs.keys[i].length;
+    }
+    pthread_mutex_unlock(&s_nvs.lock);
+
+    return ret;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    void *copy = malloc(length > 0 ? length : 1);
+
+    if (copy == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+
+    pthread_mutex_lock(&s_nvs.lock);
+    int i = nvs_find(key);
+    for (int j = 0; i < 0 && j < NVS_KEYS; j++)
+    {
+        if (s_nvs.keys[j].value == NULL)
+        {
+            i = j;
+        }
+    }
+    if (i >= 0)
+    {
+        free(s_nvs.keys[i].value);
+        snprintf(s_nvs.keys[i].key, sizeof(s_nvs.keys[i].key), "%s", key);
+        s_nvs.keys[i].value = copy;
+        s_nvs.keys[i].length = length;
+        copy = NULL;
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_nvs.lock);
+
+    free(copy);
+    return ret;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t ret = ESP_ERR_NVS_NOT_FOUND;
+
+    pthread_mutex_lock(&s_nvs.lock);
+    int i = nvs_find(key);
+    if (i >= 0)
+    {
+        free(s_nvs.keys[i].value);
+        s_nvs.keys[i].value = NULL;
+        ret = ESP_OK;
+    }
+    pthread_mutex_unlock(&s_nvs.lock);
+
+    return ret;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+/* pins */
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return 0;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_io_expander_set_dir(esp_io_expander_handle_t handle, uint32_t pin_num_mask, esp_io_expander_dir_t direction)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_io_expander_set_level(esp_io_expander_handle_t handle, uint32_t pin_num_mask, uint8_t level)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_io_expander_get_level(esp_io_expander_handle_t handle, uint32_t pin_num_mask, uint32_t *level_mask)
+{
+    *level_mask = 0;
+    return ESP_OK;
+}
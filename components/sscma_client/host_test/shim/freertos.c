@@ -0,0 +1,499 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+struct tskTaskControlBlock
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    TaskFunction_t code;
+    void *parameters;
+    UBaseType_t priority;
+    uint32_t notify;
+    bool suspended;
+    char name[16];
+};
+
+struct QueueDefinition
+{
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+};
+
+struct EventGroupDef_t
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+static __thread TaskHandle_t s_current;
+
+static void deadline_of(TickType_t ticks, struct timespec *deadline)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += ticks / configTICK_RATE_HZ;
+    deadline->tv_nsec += (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ);
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void unlock_cleanup(void *mutex)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)mutex);
+}
+
+/**
+ * Wait on `cond` until woken or the deadline passes. Waits are the points
+ * where vTaskDelete() takes effect, the cleanup handler releases the mutex.
+ */
+static bool cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t ticks, const struct timespec *deadline)
+{
+    int rc = 0;
+
+    pthread_cleanup_push(unlock_cleanup, mutex);
+    if (ticks == portMAX_DELAY)
+    {
+        rc = pthread_cond_wait(cond, mutex);
+    }
+    else
+    {
+        rc = pthread_cond_timedwait(cond, mutex, deadline);
+    }
+    pthread_cleanup_pop(0);
+
+    return rc != ETIMEDOUT;
+}
+
+static TaskHandle_t task_new(TaskFunction_t code, const char *name, void *parameters, UBaseType_t priority)
+{
+    TaskHandle_t task = calloc(1, sizeof(struct tskTaskControlBlock));
+    if (task == NULL)
+    {
+        return NULL;
+    }
+    pthread_mutex_init(&task->lock, NULL);
+    cond_init(&task->cond);
+    task->code = code;
+    task->parameters = parameters;
+    task->priority = priority;
+    strncpy(task->name, name ? name : "", sizeof(task->name) - 1);
+    return task;
+}
+
+static void *task_entry(void *arg)
+{
+    TaskHandle_t task = (TaskHandle_t)arg;
+
+    s_current = task;
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    task->code(task->parameters);
+
+    // returning from a task function is an error in FreeRTOS, treat it as vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created_task,
+    BaseType_t core_id)
+{
+    TaskHandle_t task = task_new(task_code, name, parameters, priority);
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    if (created_task)
+    {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created_task)
+{
+    return xTaskCreatePinnedToCore(task_code, name, stack_depth, parameters, priority, created_task, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (s_current == NULL)
+    {
+        // threads not created through xTaskCreate(), such as main(), get a handle on first use
+        s_current = task_new(NULL, "main", NULL, 1);
+        s_current->thread = pthread_self();
+    }
+    return s_current;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == xTaskGetCurrentTaskHandle())
+    {
+        task = xTaskGetCurrentTaskHandle();
+        pthread_detach(task->thread);
+        s_current = NULL;
+        free(task);
+        pthread_exit(NULL);
+    }
+
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    pthread_mutex_destroy(&task->lock);
+    pthread_cond_destroy(&task->cond);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / configTICK_RATE_HZ,
+        .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * (1000000000L / configTICK_RATE_HZ),
+    };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+    {
+    }
+}
+
+/*
+ * A suspended task keeps running until it blocks on its notification, where
+ * it then waits for vTaskResume(). The client only suspends the process task,
+ * which blocks there on every pass.
+ */
+void vTaskSuspend(TaskHandle_t task)
+{
+    task = task ? task : xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    task->suspended = true;
+    pthread_mutex_unlock(&task->lock);
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->suspended = false;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (TickType_t)((uint64_t)now.tv_sec * configTICK_RATE_HZ + (uint64_t)now.tv_nsec / (1000000000L / configTICK_RATE_HZ));
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return (task ? task : xTaskGetCurrentTaskHandle())->priority;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    xTaskNotifyGive(task);
+    if (higher_priority_task_woken)
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline;
+    uint32_t value = 0;
+
+    deadline_of(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&task->lock);
+    while (task->suspended || (task->notify == 0 && ticks_to_wait > 0))
+    {
+        if (!cond_wait(&task->cond, &task->lock, task->suspended ? portMAX_DELAY : ticks_to_wait, &deadline) && !task->suspended)
+        {
+            break;
+        }
+    }
+    value = task->notify;
+    if (value > 0)
+    {
+        task->notify = clear_count_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct QueueDefinition));
+    if (queue == NULL || length == 0)
+    {
+        free(queue);
+        return NULL;
+    }
+    if (item_size > 0)
+    {
+        queue->items = malloc((size_t)length * item_size);
+        if (queue->items == NULL)
+        {
+            free(queue);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init(&queue->readable);
+    cond_init(&queue->writable);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->readable);
+    pthread_cond_destroy(&queue->writable);
+    free(queue->items);
+    free(queue);
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait, bool front)
+{
+    struct timespec deadline;
+
+    deadline_of(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length)
+    {
+        if (ticks_to_wait == 0 || !cond_wait(&queue->writable, &queue->lock, ticks_to_wait, &deadline))
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFAIL;
+        }
+    }
+    if (front)
+    {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        if (queue->item_size > 0)
+        {
+            memcpy(queue->items + (size_t)queue->head * queue->item_size, item, queue->item_size);
+        }
+    }
+    else if (queue->item_size > 0)
+    {
+        memcpy(queue->items + (size_t)((queue->head + queue->count) % queue->length) * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->readable);
+    pthread_mutex_unlock(&queue->lock);
+
+    return pdPASS;
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait, bool peek)
+{
+    struct timespec deadline;
+
+    deadline_of(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0)
+    {
+        if (ticks_to_wait == 0 || !cond_wait(&queue->readable, &queue->lock, ticks_to_wait, &deadline))
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFAIL;
+        }
+    }
+    if (queue->item_size > 0 && buffer != NULL)
+    {
+        memcpy(buffer, queue->items + (size_t)queue->head * queue->item_size, queue->item_size);
+    }
+    if (!peek)
+    {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->writable);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_send(queue, item, ticks_to_wait, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    return queue_send(queue, item, ticks_to_wait, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return queue_receive(queue, buffer, ticks_to_wait, false);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    return queue_receive(queue, buffer, ticks_to_wait, true);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;
+    queue->head = 0;
+    pthread_cond_broadcast(&queue->writable);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    return queue->length - uxQueueMessagesWaiting(queue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    SemaphoreHandle_t sem = xQueueCreate(max_count, 0);
+    for (UBaseType_t i = 0; sem != NULL && i < initial_count; i++)
+    {
+        xQueueSend(sem, NULL, 0);
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+/* No priority inheritance and no owner check, a mutex is a binary semaphore that starts given */
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    EventGroupHandle_t group = calloc(1, sizeof(struct EventGroupDef_t));
+    if (group != NULL)
+    {
+        pthread_mutex_init(&group->lock, NULL);
+        cond_init(&group->changed);
+    }
+    return group;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->changed);
+    free(group);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t value;
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    value = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t value;
+    pthread_mutex_lock(&group->lock);
+    value = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    EventBits_t value;
+    pthread_mutex_lock(&group->lock);
+    value = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    EventBits_t value;
+
+    deadline_of(ticks_to_wait, &deadline);
+    pthread_mutex_lock(&group->lock);
+    while (wait_for_all ? (group->bits & bits) != bits : (group->bits & bits) == 0)
+    {
+        if (ticks_to_wait == 0 || !cond_wait(&group->changed, &group->lock, ticks_to_wait, &deadline))
+        {
+            break;
+        }
+    }
+    value = group->bits;
+    if (clear_on_exit && (wait_for_all ? (value & bits) == bits : (value & bits) != 0))
+    {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return value;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The subset of the cJSON API the client uses. Node layout, type flags and
+ * the allocation pattern (one node per value, one buffer per string and per
+ * key) follow upstream cJSON, so allocation counts measured here carry over.
+ */
+#define cJSON_Invalid (0)
+#define cJSON_False   (1 << 0)
+#define cJSON_True    (1 << 1)
+#define cJSON_NULL    (1 << 2)
+#define cJSON_Number  (1 << 3)
+#define cJSON_String  (1 << 4)
+#define cJSON_Array   (1 << 5)
+#define cJSON_Object  (1 << 6)
+#define cJSON_Raw     (1 << 7)
+
+#define cJSON_IsReference   256
+#define cJSON_StringIsConst 512
+
+typedef int cJSON_bool;
+
+typedef struct cJSON
+{
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+typedef struct cJSON_Hooks
+{
+    void *(*malloc_fn)(size_t sz);
+    void (*free_fn)(void *ptr);
+} cJSON_Hooks;
+
+void cJSON_InitHooks(cJSON_Hooks *hooks);
+
+cJSON *cJSON_Parse(const char *value);
+cJSON *cJSON_ParseWithLength(const char *value, size_t buffer_length);
+char *cJSON_PrintUnformatted(const cJSON *item);
+void cJSON_Delete(cJSON *item);
+void cJSON_free(void *object);
+
+int cJSON_GetArraySize(const cJSON *array);
+cJSON *cJSON_GetArrayItem(const cJSON *array, int index);
+cJSON *cJSON_GetObjectItem(const cJSON *const object, const char *const string);
+char *cJSON_GetStringValue(const cJSON *const item);
+double cJSON_GetNumberValue(const cJSON *const item);
+
+cJSON_bool cJSON_IsNumber(const cJSON *const item);
+cJSON_bool cJSON_IsString(const cJSON *const item);
+cJSON_bool cJSON_IsArray(const cJSON *const item);
+cJSON_bool cJSON_IsObject(const cJSON *const item);
+
+cJSON *cJSON_CreateObject(void);
+cJSON *cJSON_CreateArray(void);
+cJSON *cJSON_CreateString(const char *string);
+cJSON *cJSON_CreateNumber(double num);
+cJSON_bool cJSON_AddItemToArray(cJSON *array, cJSON *item);
+cJSON_bool cJSON_AddItemToObject(cJSON *object, const char *string, cJSON *item);
+cJSON *cJSON_AddStringToObject(cJSON *const object, const char *const name, const char *const string);
+cJSON *cJSON_AddNumberToObject(cJSON *const object, const char *const name, const double number);
+cJSON *cJSON_AddObjectToObject(cJSON *const object, const char *const name);
+cJSON *cJSON_AddArrayToObject(cJSON *const object, const char *const name);
+
+#define cJSON_ArrayForEach(element, array) for (element = (array != NULL) ? (array)->child : NULL; element != NULL; element = element->next)
+
+#ifdef __cplusplus
+}
+#endif
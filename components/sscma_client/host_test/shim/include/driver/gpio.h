@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int gpio_num_t;
+
+typedef enum
+{
+    GPIO_MODE_DISABLE,
+    GPIO_MODE_INPUT,
+    GPIO_MODE_OUTPUT,
+} gpio_mode_t;
+
+typedef struct
+{
+    uint64_t pin_bit_mask;
+    gpio_mode_t mode;
+    int pull_up_en;
+    int pull_down_en;
+    int intr_type;
+} gpio_config_t;
+
+/* There are no pins on the host, every call succeeds and does nothing */
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num);
+
+#ifdef __cplusplus
+}
+#endif
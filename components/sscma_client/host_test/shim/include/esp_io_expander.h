@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_io_expander_s *esp_io_expander_handle_t;
+
+typedef enum
+{
+    IO_EXPANDER_INPUT,
+    IO_EXPANDER_OUTPUT,
+} esp_io_expander_dir_t;
+
+esp_err_t esp_io_expander_set_dir(esp_io_expander_handle_t handle, uint32_t pin_num_mask, esp_io_expander_dir_t direction);
+esp_err_t esp_io_expander_set_level(esp_io_expander_handle_t handle, uint32_t pin_num_mask, uint8_t level);
+esp_err_t esp_io_expander_get_level(esp_io_expander_handle_t handle, uint32_t pin_num_mask, uint32_t *level_mask);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_heap_caps.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * FreeRTOS on POSIX threads: one thread per task, a 1 ms tick, and no
+ * priorities. Good enough to run the client's tasks on a workstation, not a
+ * scheduler model.
+ */
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+
+typedef struct
+{
+    uint8_t dummy;
+} StaticTask_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  pdFALSE
+#define pdPASS  pdTRUE
+
+#define configTICK_RATE_HZ 1000
+#define portMAX_DELAY      ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define pdTICKS_TO_MS(t)   ((TickType_t)(((uint64_t)(t) * 1000U) / configTICK_RATE_HZ))
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED \
+    {                                \
+        PTHREAD_MUTEX_INITIALIZER    \
+    }
+#define portMUX_INITIALIZE(mux) pthread_mutex_init(&(mux)->mutex, NULL)
+
+#define taskENTER_CRITICAL(mux)     pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux)      pthread_mutex_unlock(&(mux)->mutex)
+#define taskENTER_CRITICAL_ISR(mux) taskENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL_ISR(mux)  taskEXIT_CRITICAL(mux)
+
+/* Nothing runs in interrupt context on the host */
+#define xPortInIsrContext()     pdFALSE
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Like FreeRTOS, a semaphore is a queue of empty items */
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+
+#define xSemaphoreTake(sem, ticks)        xQueueReceive((QueueHandle_t)(sem), NULL, ticks)
+#define xSemaphoreGive(sem)               xQueueSend((QueueHandle_t)(sem), NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken) xQueueSend((QueueHandle_t)(sem), NULL, 0)
+#define vSemaphoreDelete(sem)             vQueueDelete((QueueHandle_t)(sem))
+#define uxSemaphoreGetCount(sem)          uxQueueMessagesWaiting((QueueHandle_t)(sem))
+
+#ifdef __cplusplus
+}
+#endif
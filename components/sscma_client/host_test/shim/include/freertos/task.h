@@ -0,0 +1,34 @@
+#pragma once
+
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskNO_AFFINITY INT_MAX
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created_task);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name, uint32_t stack_depth, void *parameters, UBaseType_t priority, TaskHandle_t *created_task,
+    BaseType_t core_id);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TickType_t xTaskGetTickCount(void);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken);
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+
+#define taskYIELD() sched_yield()
+
+#ifdef __cplusplus
+}
+#endif
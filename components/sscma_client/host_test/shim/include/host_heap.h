@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Heap counters of the host build
+ *
+ * malloc, calloc, realloc, free and strdup are wrapped at link time
+ * (-Wl,--wrap), so every allocation made by the client, the shims and the
+ * benchmarks is counted. Allocations made inside libc itself are not.
+ */
+typedef struct
+{
+    uint64_t allocs; /*!< Successful malloc/calloc/realloc/strdup calls */
+    uint64_t frees;  /*!< free calls with a non-NULL pointer */
+    uint64_t bytes;  /*!< Bytes requested by those allocations */
+    size_t in_use;   /*!< Usable bytes currently allocated */
+    size_t peak;     /*!< Most usable bytes allocated at once */
+} host_heap_stats_t;
+
+void host_heap_get_stats(host_heap_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+ * Host build configuration, mirrors mainapp/sdkconfig except that the
+ * performance counters are enabled so the benchmarks can read them.
+ */
+#define CONFIG_SSCMA_ENABLE_STATS              1
+#define CONFIG_SSCMA_EVENT_QUEUE_SIZE          2
+#define CONFIG_SSCMA_RX_POLL_INTERVAL_MS       50
+#define CONFIG_SSCMA_READY_TIMEOUT_MS          3000
+#define CONFIG_SSCMA_TX_BUFFER_SIZE            8192
+#define CONFIG_SSCMA_RX_BUFFER_SIZE            98304
+#define CONFIG_SSCMA_REPLY_POOL_SIZE           4
+#define CONFIG_SSCMA_REPLY_POOL_SLOT_SIZE      65536
+#define CONFIG_SSCMA_REPLY_ARENA_SIZE          16384
+#define CONFIG_SSCMA_LAZY_EVENT_PAYLOAD        1
+#define CONFIG_SSCMA_EVENT_MAILBOX             1
+#define CONFIG_SSCMA_TARGET_FPS                15
+#define CONFIG_SSCMA_PROCESS_TASK_STACK_SIZE   4096
+#define CONFIG_SSCMA_PROCESS_TASK_PRIORITY     5
+#define CONFIG_SSCMA_PROCESS_TASK_AFFINITY     -1
+#define CONFIG_SSCMA_MONITOR_TASK_STACK_SIZE   4096
+#define CONFIG_SSCMA_MONITOR_TASK_PRIORITY     4
+#define CONFIG_SSCMA_MONITOR_TASK_AFFINITY     -1
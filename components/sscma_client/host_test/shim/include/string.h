@@ -0,0 +1,6 @@
+#pragma once
+
+#include_next <string.h>
+
+/* newlib provides this, glibc does not */
+char *strnstr(const char *haystack, const char *needle, size_t len);
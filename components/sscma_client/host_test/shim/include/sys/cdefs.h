@@ -0,0 +1,10 @@
+#pragma once
+
+#include_next <sys/cdefs.h>
+
+#include <stddef.h>
+
+/* newlib provides this, glibc does not */
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
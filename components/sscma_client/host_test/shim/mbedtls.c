@@ -0,0 +1,153 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "mbedtls/base64.h"
+#include "mbedtls/md.h"
+
+static const unsigned char s_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    size_t n = (slen + 2) / 3 * 4;
+
+    *olen = n + 1;
+    if (dst == NULL || dlen < n + 1)
+    {
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+
+    unsigned char *p = dst;
+    for (size_t i = 0; i < slen; i += 3)
+    {
+        uint32_t v = (uint32_t)src[i] << 16;
+        v |= i + 1 < slen ? (uint32_t)src[i + 1] << 8 : 0;
+        v |= i + 2 < slen ? src[i + 2] : 0;
+        *p++ = s_alphabet[(v >> 18) & 0x3F];
+        *p++ = s_alphabet[(v >> 12) & 0x3F];
+        *p++ = i + 1 < slen ? s_alphabet[(v >> 6) & 0x3F] : '=';
+        *p++ = i + 2 < slen ? s_alphabet[v & 0x3F] : '=';
+    }
+    *p = '\0';
+    *olen = n;
+
+    return 0;
+}
+
+// a table like mbedtls' own, a strchr per symbol would dominate any decode benchmark
+static int base64_value(unsigned char c)
+{
+    static signed char s_values[256];
+    static int s_ready = 0;
+
+    if (!s_ready)
+    {
+        memset(s_values, -1, sizeof(s_values));
+        for (int i = 0; i < 64; i++)
+        {
+            s_values[s_alphabet[i]] = (signed char)i;
+        }
+        s_ready = 1;
+    }
+    return s_values[c];
+}
+
+/* Same contract as mbedtls: whitespace and '\r\n' are skipped, a NULL dst queries the size */
+int mbedtls_base64_decode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen)
+{
+    size_t symbols = 0;
+    size_t equals = 0;
+
+    for (size_t i = 0; i < slen; i++)
+    {
+        if (src[i] == ' ' || src[i] == '\t' || src[i] == '\r' || src[i] == '\n')
+        {
+            continue;
+        }
+        if (src[i] == '=')
+        {
+            if (++equals > 2)
+            {
+                return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+            }
+        }
+        else if (equals > 0 || base64_value(src[i]) < 0)
+        {
+            return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+        }
+        symbols++;
+    }
+    if (symbols == 0)
+    {
+        *olen = 0;
+        return 0;
+    }
+    if (symbols % 4 != 0)
+    {
+        return MBEDTLS_ERR_BASE64_INVALID_CHARACTER;
+    }
+
+    size_t n = symbols / 4 * 3 - equals;
+    if (dst == NULL || dlen < n)
+    {
+        *olen = n;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+
+    uint32_t v = 0;
+    int count = 0;
+    unsigned char *p = dst;
+    for (size_t i = 0; i < slen; i++)
+    {
+        int value = base64_value(src[i]);
+        if (src[i] != '=' && value < 0)
+        {
+            continue;
+        }
+        v = (v << 6) | (uint32_t)(value < 0 ? 0 : value);
+        if (++count == 4)
+        {
+            *p++ = (unsigned char)(v >> 16);
+            *p++ = (unsigned char)(v >> 8);
+            *p++ = (unsigned char)v;
+            v = 0;
+            count = 0;
+        }
+    }
+    *olen = n;
+
+    return 0;
+}
+
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t md_type)
+{
+    return NULL;
+}
+
+void mbedtls_md_init(mbedtls_md_context_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void mbedtls_md_free(mbedtls_md_context_t *ctx)
+{
+}
+
+int mbedtls_md_setup(mbedtls_md_context_t *ctx, const mbedtls_md_info_t *md_info, int hmac)
+{
+    return MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE;
+}
+
+int mbedtls_md_starts(mbedtls_md_context_t *ctx)
+{
+    return MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE;
+}
+
+int mbedtls_md_update(mbedtls_md_context_t *ctx, const unsigned char *input, size_t ilen)
+{
+    return MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE;
+}
+
+int mbedtls_md_finish(mbedtls_md_context_t *ctx, unsigned char *output)
+{
+    return MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE;
+}
@@ -36,6 +36,7 @@ typedef struct
         unsigned int cs_high_active : 1;    /*!< CS line is high active */
         unsigned int sync_high_active : 1;  /*!< SYNC line is high active */
         unsigned int sync_use_expander : 1; /*!< SYNC line use IO expander */
+        unsigned int queued_trans : 1;      /*!< Queue up to trans_queue_depth packets on DMA-capable buffers instead of transmitting them one by one */
     } flags;
 } sscma_client_io_spi_config_t;
 
@@ -99,6 +100,39 @@ typedef struct
  */
 esp_err_t sscma_client_new_io_uart_bus(sscma_client_uart_bus_handle_t bus, const sscma_client_io_uart_config_t *io_config, sscma_client_io_handle_t *ret_io);
 
+/**
+ * @brief Client IO configuration structure, for the loopback interface
+ *
+ * The loopback device answers AT commands and, while INVOKE/SAMPLE is running, emits events from a timer so
+ * the client stack can be exercised and measured without hardware.
+ */
+typedef struct
+{
+    const char *const *frames;  /*!< Recorded event payloads (JSON objects) replayed in a loop, NULL to synthesize events */
+    size_t num_frames;          /*!< Number of recorded frames */
+    size_t image_size;          /*!< Size of the JPEG carried by each synthetic event, before base64 encoding */
+    int num_boxes;              /*!< Boxes in each synthetic event */
+    uint32_t frame_interval_ms; /*!< Interval between events */
+    size_t chunk_size;          /*!< Most bytes reported available at once, 0 for no fragmentation */
+    size_t buffer_size;         /*!< Size of the device side buffer, 0 to fit two synthetic events */
+    int log_every;              /*!< Emit a log before every Nth event, 0 to disable */
+    int error_every;            /*!< Fail every Nth request with CMD_EBUSY, 0 to disable */
+    uint32_t boot_time_ms;      /*!< Time before the device announces INIT@STAT and answers requests, 0 to be up at once */
+    void *user_ctx;             /*!< User private data, passed directly to user_ctx */
+} sscma_client_io_loopback_config_t;
+
+/**
+ * @brief Create SSCMA client IO handle, for the loopback interface
+ *
+ * @param[in] io_config IO configuration, for the loopback interface
+ * @param[out] ret_io Returned IO handle
+ * @return
+ *          - ESP_ERR_INVALID_ARG   if parameter is invalid
+ *          - ESP_ERR_NO_MEM        if out of memory
+ *          - ESP_OK                on success
+ */
+esp_err_t sscma_client_new_io_loopback(const sscma_client_io_loopback_config_t *io_config, sscma_client_io_handle_t *ret_io);
+
 /**
  * @brief Destory SSCMA client IO handle
  *
@@ -152,6 +186,34 @@ esp_err_t sscma_client_io_available(sscma_client_io_handle_t io, size_t *len);
  */
 esp_err_t sscma_client_io_flush(sscma_client_io_handle_t io);
 
+/**
+ * @brief Write data produced piece by piece
+ *
+ * Transports that support it hand the producer their TX packet buffer directly, others go through a
+ * small staging buffer and issue one write per piece.
+ *
+ * @param[in] io IO handle
+ * @param[in] fill Producer called for every piece until it returns 0
+ * @param[in] user_ctx User context passed to the producer
+ * @return
+ *          - ESP_ERR_INVALID_ARG   if parameter is invalid
+ *          - ESP_FAIL              if the producer returned SSCMA_CLIENT_IO_FILL_ERROR
+ *          - ESP_OK
+ */
+esp_err_t sscma_client_io_write_chunked(sscma_client_io_handle_t io, sscma_client_io_fill_cb_t fill, void *user_ctx);
+
+/**
+ * @brief Register data ready callback
+ *
+ * @param[in] io IO handle
+ * @param[in] cb Callback raised when data may be available
+ * @param[in] user_ctx User context passed to the callback
+ * @return
+ *          - ESP_ERR_NOT_SUPPORTED if the transport cannot signal data
+ *          - ESP_OK
+ */
+esp_err_t sscma_client_io_set_notify(sscma_client_io_handle_t io, sscma_client_io_notify_cb_t cb, void *user_ctx);
+
 #ifdef __cplusplus
 }
 #endif
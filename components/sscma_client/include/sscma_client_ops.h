@@ -26,6 +26,12 @@ typedef struct
     int monitor_task_affinity;            /* SSCMA monitor task pinned to core (-1 is no
                                              affinity) */
     int event_queue_size;                 /* Event queue size */
+    int rx_poll_interval_ms;              /* Fallback RX poll interval, the process task otherwise sleeps until notified */
+    int reply_pool_size;                  /* Number of pooled reply buffers (0 to allocate every reply from heap) */
+    int reply_pool_slot_size;             /* Size of each pooled reply buffer (0 to use rx_buffer_size) */
+    int reply_arena_size;                 /* Bytes reserved behind each pooled reply for its cJSON nodes (0 to allocate them from heap) */
+    int ready_timeout_ms;                 /* Upper bound for reset to wait for INIT@STAT or a probe reply (0 for 3000 ms) */
+    int target_fps;                       /* Rate the frame governor paces continuous INVOKE/SAMPLE streams to (0 to stream at the device rate) */
     void *user_ctx;                       /* User context */
     esp_io_expander_handle_t io_expander; /*!< IO expander handle */
     struct
@@ -33,13 +39,17 @@ typedef struct
         unsigned int reset_active_high : 1;  /*!< Setting this if the panel reset is
                                                 high level active */
         unsigned int reset_use_expander : 1; /*!< Reset line use IO expander */
+        unsigned int lazy_event_payload : 1; /*!< Only index INVOKE/SAMPLE events, build the cJSON payload when a consumer asks for it */
+        unsigned int event_mailbox : 1;      /*!< Deliver only the latest INVOKE/SAMPLE event, replacing older unconsumed ones */
+        unsigned int persist_info : 1;       /*!< Cache device and model info in NVS, revalidated by ID and the model id, address and size */
     } flags;                                 /*!< SSCMA client config flags */
 } sscma_client_config_t;
 
 #define SSCMA_CLIENT_CONFIG_DEFAULT()                                                                                                                                                                  \
     {                                                                                                                                                                                                  \
         .reset_gpio_num = -1, .tx_buffer_size = 4096, .rx_buffer_size = 65536, .process_task_priority = 5, .process_task_stack = 4096, .process_task_affinity = -1, .monitor_task_priority = 4,        \
-        .monitor_task_stack = 10240, .monitor_task_affinity = -1, .event_queue_size = 2, .user_ctx = NULL,                                                                                             \
+        .monitor_task_stack = 10240, .monitor_task_affinity = -1, .event_queue_size = 2, .rx_poll_interval_ms = 10, .reply_pool_size = 0, .reply_pool_slot_size = 0, .user_ctx = NULL,                 \
+        .reply_arena_size = 0, .ready_timeout_ms = 3000, .target_fps = 0,                                                                                                                              \
         .flags = {                                                                                                                                                                                     \
             .reset_active_high = false,                                                                                                                                                                \
         },                                                                                                                                                                                             \
@@ -77,13 +87,29 @@ esp_err_t sscma_client_del(sscma_client_handle_t client);
 esp_err_t sscma_client_init(sscma_client_handle_t client);
 
 /**
- * @brief Reset SCCMA client
+ * @brief Reset SCCMA client, returns once the device is ready again
  *
  * @param[in] client SCCMA client handle
  * @return
  *          - ESP_OK on success
+ *          - ESP_ERR_TIMEOUT if the device was not ready within ready_timeout_ms
  */
 esp_err_t sscma_client_reset(sscma_client_handle_t client);
+
+/**
+ * @brief Wait until the device is ready
+ *
+ * Returns as soon as the device has emitted INIT@STAT since the last reset, or answers an AT+STAT probe.
+ * Probes are sent every 50 ms, after a 200 ms boot grace period following a reset pulse, or right away
+ * when the client has no reset GPIO.
+ *
+ * @param[in] client SCCMA client handle
+ * @param[in] timeout Upper bound in ticks
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_TIMEOUT if the device did not become ready in time
+ */
+esp_err_t sscma_client_wait_ready(sscma_client_handle_t client, TickType_t timeout);
 /**
  * @brief Read data from SCCMA client
  *
@@ -121,6 +147,17 @@ esp_err_t sscma_client_write(sscma_client_handle_t client, const void *data, siz
  */
 esp_err_t sscma_client_available(sscma_client_handle_t client, size_t *ret_avail);
 
+/**
+ * @brief Wake up the SSCMA client process task to read pending data
+ *
+ * @note Safe to call from ISR context, e.g. from the SYNC line or IO expander interrupt
+ *
+ * @param[in] client SCCMA client handle
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t sscma_client_notify(sscma_client_handle_t client);
+
 /**
  * @brief Register callback
  *
@@ -140,6 +177,67 @@ esp_err_t sscma_client_register_callback(sscma_client_handle_t client, const ssc
  */
 void sscma_client_reply_clear(sscma_client_reply_t *reply);
 
+/**
+ * @brief Get the cJSON payload of a reply, parsing it first if it was delivered lazily
+ *
+ * @param[in] reply Reply
+ * @return cJSON payload, NULL if the reply is not valid JSON
+ */
+cJSON *sscma_client_reply_get_payload(const sscma_client_reply_t *reply);
+
+/**
+ * @brief Get reply buffer pool statistics
+ *
+ * @param[in] client SCCMA client handle
+ * @param[out] stats Pool statistics
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t sscma_client_get_reply_pool_stats(sscma_client_handle_t client, sscma_client_reply_pool_stats_t *stats);
+
+/**
+ * @brief Get event delivery statistics
+ *
+ * @param[in] client SCCMA client handle
+ * @param[out] stats Event statistics
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t sscma_client_get_event_stats(sscma_client_handle_t client, sscma_client_event_stats_t *stats);
+
+/**
+ * @brief Get performance counters
+ *
+ * @param[in] client SCCMA client handle
+ * @param[out] stats Performance counters
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NOT_SUPPORTED if CONFIG_SSCMA_ENABLE_STATS is not set
+ */
+esp_err_t sscma_client_get_stats(sscma_client_handle_t client, sscma_client_stats_t *stats);
+
+/**
+ * @brief Reset performance counters
+ *
+ * @param[in] client SCCMA client handle
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NOT_SUPPORTED if CONFIG_SSCMA_ENABLE_STATS is not set
+ */
+esp_err_t sscma_client_reset_stats(sscma_client_handle_t client);
+
+/**
+ * @brief Register trace callback, NULL to unregister
+ *
+ * @param[in] client SCCMA client handle
+ * @param[in] trace Trace callback, keep it short as it runs on the process and monitor tasks
+ * @param[in] user_ctx User context
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NOT_SUPPORTED if CONFIG_SSCMA_ENABLE_STATS is not set
+ */
+esp_err_t sscma_client_register_trace(sscma_client_handle_t client, sscma_client_trace_cb_t trace, void *user_ctx);
+
 /**
  * @brief Send request to SCCMA client
  *
@@ -150,6 +248,32 @@ void sscma_client_reply_clear(sscma_client_reply_t *reply);
  */
 esp_err_t sscma_client_request(sscma_client_handle_t client, const char *cmd, sscma_client_reply_t *reply, bool wait, TickType_t timeout);
 
+/**
+ * @brief Send request to SCCMA client without waiting for the reply
+ *
+ * Several requests may be in flight at once, replies to the same command are matched in issue order.
+ *
+ * @param[in] client SCCMA client handle
+ * @param[in] cmd Command string
+ * @param[out] future Pending request, must be passed to sscma_client_request_wait
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t sscma_client_request_async(sscma_client_handle_t client, const char *cmd, sscma_client_future_t *future);
+
+/**
+ * @brief Wait for the reply of a pending request and release it
+ *
+ * @param[in] client SCCMA client handle
+ * @param[in] future Pending request returned by sscma_client_request_async
+ * @param[out] reply Reply, or NULL to discard it
+ * @param[in] timeout Timeout in ticks
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_TIMEOUT if no reply arrived in time
+ */
+esp_err_t sscma_client_request_wait(sscma_client_handle_t client, sscma_client_future_t future, sscma_client_reply_t *reply, TickType_t timeout);
+
 /**
  * @brief Get SCCMA client info
  *
@@ -233,6 +357,23 @@ esp_err_t sscma_client_invoke(sscma_client_handle_t client, int times, bool flit
 
 esp_err_t sscma_client_break(sscma_client_handle_t client);
 
+/**
+ * @brief Capture one still image in another sensor mode
+ *
+ * Switches the sensor to opt_id, samples a single frame and switches back to the previous sensor mode,
+ * restarting the sample or invoke task that was running. Commands are pipelined, and SAMPLE events still
+ * in flight from the previous mode are dropped instead of being delivered.
+ *
+ * @param[in] client SCCMA client handle
+ * @param[in] opt_id sensor config of the still
+ * @param[in] timeout Upper bound in ticks to wait for the still
+ * @param[out] out_jpeg Decoded JPEG, out_jpeg->data must be released with free()
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_TIMEOUT if no frame arrived in time
+ */
+esp_err_t sscma_client_capture_still(sscma_client_handle_t client, int opt_id, TickType_t timeout, sscma_client_jpeg_t *out_jpeg);
+
 /**
  * @brief Set iou threshold
  * @param[in] client SCCMA client handle
@@ -362,6 +503,28 @@ esp_err_t sscma_utils_fetch_keypoints_from_reply(const sscma_client_reply_t *rep
  */
 esp_err_t sscma_utils_copy_keypoints_from_reply(const sscma_client_reply_t *reply, sscma_client_keypoint_t *keypoints, int max_keypoints, int *num_keypoints);
 
+/**
+ * Decode boxes, classes, points, keypoints and the image span of a sscma client reply in one pass, without heap allocation
+ * @param[in] reply sscma client reply
+ * @param[out] result decoded result, arrays beyond their capacity are dropped and flagged as truncated
+ * @return
+ *    - ESP_OK
+ *    - ESP_ERR_INVALID_RESPONSE if the reply is malformed
+ */
+esp_err_t sscma_utils_decode_result(const sscma_client_reply_t *reply, sscma_client_result_t *result);
+
+/**
+ * Decode the base64 image of a sscma client reply straight into a JPEG buffer
+ * @param[in] reply sscma client reply
+ * @param[out] jpeg buffer receiving the decoded JPEG
+ * @param[in] max_jpeg_size size of the JPEG buffer
+ * @param[out] jpeg_size size of the decoded JPEG
+ * @return
+ *    - ESP_OK
+ *    - ESP_ERR_INVALID_SIZE if the JPEG buffer is too small
+ */
+esp_err_t sscma_utils_decode_image_from_reply(const sscma_client_reply_t *reply, uint8_t *jpeg, size_t max_jpeg_size, size_t *jpeg_size);
+
 /**
  * Fetch image from sscma client reply
  * @param[in] reply sscma client reply
@@ -419,6 +582,36 @@ esp_err_t sscma_client_ota_finish(sscma_client_handle_t client);
  */
 esp_err_t sscma_client_ota_abort(sscma_client_handle_t client);
 
+/**
+ * @brief Configuration of an OTA streamed from a file
+ */
+typedef struct
+{
+    const char *path;                           /* !< Image file, e.g. on /sdcard */
+    size_t offset;                              /* !< Offset passed to sscma_client_ota_start() */
+    size_t chunk_size;                          /* !< Bytes per buffer, rounded up to 128 (0 for SSCMA_CLIENT_OTA_CHUNK_SIZE) */
+    const char *checksum;                       /* !< Expected CRC32, MD5 or SHA256 of the file as hex, e.g. model.checksum (NULL to skip) */
+    sscma_client_ota_progress_cb_t on_progress; /* !< Progress callback, called after every chunk (optional) */
+    void *user_ctx;                             /* !< User context passed to on_progress */
+} sscma_client_ota_file_config_t;
+
+/**
+ * Stream an image from a file to the flasher
+ *
+ * A reader task fills one of two PSRAM buffers while the other one is written to the flasher, so the
+ * transfer takes as long as the slower of the file and the transport. The checksum is computed while
+ * reading; on mismatch the OTA is aborted instead of finished.
+ * @param[in] client SCCMA client handle
+ * @param[in] flasher flasher handle
+ * @param[in] config file OTA configuration
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NOT_FOUND if the file cannot be opened
+ *          - ESP_ERR_NOT_SUPPORTED if the checksum format is unknown
+ *          - ESP_ERR_INVALID_CRC if the checksum does not match
+ */
+esp_err_t sscma_client_ota_from_file(sscma_client_handle_t client, const sscma_client_flasher_handle_t flasher, const sscma_client_ota_file_config_t *config);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 
 #include "cJSON.h"
@@ -15,8 +16,18 @@
 
 #include "esp_io_expander.h"
 
-#define SSCMA_CLIENT_MODEL_MAX_CLASSES   80
-#define SSCMA_CLIENT_MODEL_KEYPOINTS_MAX 80
+#define SSCMA_CLIENT_CMD_NAME_LEN          32
+#define SSCMA_CLIENT_MODEL_MAX_CLASSES     80
+#define SSCMA_CLIENT_MODEL_KEYPOINTS_MAX   80
+#define SSCMA_CLIENT_REQUEST_BUCKETS       8
+#define SSCMA_CLIENT_EVENT_MAILBOXES       2
+#define SSCMA_CLIENT_RESULT_MAX_BOXES      32
+#define SSCMA_CLIENT_RESULT_MAX_CLASSES    32
+#define SSCMA_CLIENT_RESULT_MAX_POINTS     32
+#define SSCMA_CLIENT_RESULT_MAX_KEYPOINTS  8
+#define SSCMA_CLIENT_STATS_COMMANDS        16
+#define SSCMA_CLIENT_STATS_LATENCY_BUCKETS 16
+#define SSCMA_CLIENT_OTA_CHUNK_SIZE        (32 * 1024)
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,27 +36,105 @@ extern "C" {
 typedef struct sscma_client_t *sscma_client_handle_t;                 /*!< Type of SCCMA client handle */
 typedef struct sscma_client_io_t *sscma_client_io_handle_t;           /*!< Type of SSCMA client IO handle */
 typedef struct sscma_client_flasher_t *sscma_client_flasher_handle_t; /*!< Type of SCCMA client flasher handle */
+typedef struct sscma_client_reply_pool_t sscma_client_reply_pool_t;   /*!< Type of SSCMA reply buffer pool */
+
+/**
+ * @brief Top-level fields of a reply, located in place without building a cJSON tree
+ *
+ * @note String spans point into the reply data and are not NUL terminated.
+ */
+typedef struct
+{
+    int type;          /* !< Value of "type", -1 if missing */
+    int code;          /* !< Value of "code", -1 if missing */
+    const char *name;  /* !< Value of "name" */
+    size_t name_len;   /* !< Length of "name" */
+    const char *image; /* !< Value of "data.image" (base64), NULL if missing */
+    size_t image_len;  /* !< Length of "data.image" */
+} sscma_client_reply_index_t;
 
 /**
  * @brief Reply message
+ *
+ * @note payload may be NULL for events delivered lazily, use sscma_client_reply_get_payload() to build it on demand.
  */
 typedef struct
 {
     cJSON *payload;
     char *data;
     size_t len;
+    sscma_client_reply_pool_t *pool;  /* !< Pool owning data, NULL if heap allocated */
+    sscma_client_reply_index_t index; /* !< In-place index of the top-level fields */
+    struct
+    {
+        char *base;         /* !< Arena storage, behind data in the pool slot */
+        size_t size;        /* !< Arena capacity, 0 if the reply has no arena */
+        size_t used;        /* !< Bytes handed out */
+        uint32_t fallbacks; /* !< Parses that did not fit, the payload then lives on the heap */
+    } arena;                /* !< Bump allocator for the cJSON payload */
 } sscma_client_reply_t;
 
 /**
- * @brief Request message
+ * @brief Fixed-capacity pool of reply buffers
+ */
+struct sscma_client_reply_pool_t
+{
+    char *base;              /* !< Slot storage */
+    size_t slot_size;        /* !< Size of each slot */
+    size_t slots;            /* !< Number of slots */
+    size_t high_water;       /* !< Most slots ever in use at once */
+    uint32_t fallbacks;      /* !< Replies that had to fall back to the heap */
+    QueueHandle_t free_list; /* !< Indexes of free slots */
+    size_t arena_size;       /* !< Bytes reserved behind each reply for its cJSON nodes */
+    uint32_t arena_allocs;   /* !< cJSON nodes and strings built in reply arenas */
+    uint32_t arena_misses;   /* !< Payloads that did not fit their arena and were parsed on the heap */
+};
+
+/**
+ * @brief Reply buffer pool statistics
+ */
+typedef struct
+{
+    size_t slots;          /* !< Number of slots */
+    size_t slot_size;      /* !< Size of each slot */
+    size_t in_use;         /* !< Slots currently held by replies */
+    size_t high_water;     /* !< Most slots ever in use at once */
+    uint32_t fallbacks;    /* !< Replies that had to fall back to the heap */
+    uint32_t arena_allocs; /* !< cJSON nodes and strings built in reply arenas */
+    uint32_t arena_misses; /* !< Payloads that did not fit their arena and were parsed on the heap */
+} sscma_client_reply_pool_stats_t;
+
+/**
+ * @brief Event delivery statistics
  */
 typedef struct
 {
-    char cmd[32];
+    uint32_t invoke_replaced; /* !< INVOKE events replaced by a newer one before being consumed */
+    uint32_t sample_replaced; /* !< SAMPLE events replaced by a newer one before being consumed */
+    uint32_t queue_dropped;   /* !< Replies dropped because the reply queue was full */
+} sscma_client_event_stats_t;
+
+/**
+ * @brief Request message
+ */
+typedef struct sscma_client_request_t
+{
+    char cmd[SSCMA_CLIENT_CMD_NAME_LEN];
     QueueHandle_t reply;
-    ListItem_t item;
+    uint32_t hash;                       /* !< Hash of cmd */
+    bool pending;                        /* !< Whether still waiting in the request table */
+    bool detached;                       /* !< Nobody waits for the reply, the process task retires the request */
+    struct sscma_client_request_t *next; /* !< Next request in the same bucket, oldest first */
+#if CONFIG_SSCMA_ENABLE_STATS
+    int64_t start_us; /* !< Time the request was issued */
+#endif
 } sscma_client_request_t;
 
+/**
+ * @brief Handle of an outstanding asynchronous request
+ */
+typedef sscma_client_request_t *sscma_client_future_t;
+
 /**
  *
  */
@@ -69,6 +158,14 @@ typedef struct
     char *classes[SSCMA_CLIENT_MODEL_MAX_CLASSES]; /*!< Classes */
 } sscma_client_model_t;
 
+typedef struct
+{
+    int id;      /* !< Model id */
+    int type;    /* !< Model type */
+    int address; /* !< Flash address of the model */
+    int size;    /* !< Size of the model in flash */
+} sscma_client_model_key_t;
+
 typedef struct
 {
     int id;
@@ -78,6 +175,17 @@ typedef struct
     char *opt_detail;
 } sscma_client_sensor_t;
 
+/**
+ * @brief Still image captured by sscma_client_capture_still()
+ */
+typedef struct
+{
+    uint8_t *data;      /*!< JPEG data, release with free() */
+    size_t size;        /*!< JPEG size */
+    int64_t latency_us; /*!< Time from the mode switch to the decoded frame */
+    uint32_t discarded; /*!< Stale SAMPLE events dropped before the still arrived */
+} sscma_client_jpeg_t;
+
 typedef struct
 {
     uint16_t x;
@@ -110,6 +218,82 @@ typedef struct
     sscma_client_point_t points[SSCMA_CLIENT_MODEL_KEYPOINTS_MAX];
 } sscma_client_keypoint_t;
 
+/**
+ * @brief Client performance counters, collected when CONFIG_SSCMA_ENABLE_STATS is set
+ *
+ * Request latencies are log2 histograms, bucket i counts round trips of [2^i, 2^(i+1)) ms (bucket 0 also counts < 1 ms).
+ */
+typedef struct
+{
+    uint64_t bytes_read;       /* !< Bytes read from the transport */
+    uint64_t bytes_written;    /* !< Bytes written to the transport */
+    uint32_t frames_parsed;    /* !< Frames indexed successfully */
+    uint32_t frames_invalid;   /* !< Frames rejected as truncated or malformed */
+    uint32_t replies_dropped;  /* !< Replies dropped because a queue was full */
+    uint32_t queue_high_water; /* !< Most replies waiting in the reply queue at once */
+    uint32_t parse_count;      /* !< cJSON_Parse calls on the process task */
+    uint64_t parse_time_us;    /* !< Time spent in those calls */
+    struct
+    {
+        uint32_t count;   /* !< Callback invocations */
+        uint64_t time_us; /* !< Total time spent in the callback */
+        uint32_t max_us;  /* !< Longest invocation */
+    } callbacks[3];       /* !< Indexed by reply type (CMD_TYPE_RESPONSE, CMD_TYPE_EVENT, CMD_TYPE_LOG) */
+    struct
+    {
+        char cmd[SSCMA_CLIENT_CMD_NAME_LEN];                  /* !< Command name as in sscma_client_request_t, empty if unused */
+        uint32_t count;                                       /* !< Completed requests */
+        uint32_t latency[SSCMA_CLIENT_STATS_LATENCY_BUCKETS]; /* !< Round trip histogram */
+    } requests[SSCMA_CLIENT_STATS_COMMANDS];                  /* !< Per command, first come first served */
+} sscma_client_stats_t;
+
+/**
+ * @brief Kind of a trace record
+ */
+typedef enum
+{
+    SSCMA_CLIENT_TRACE_FRAME,    /* !< A frame was indexed, value is its length */
+    SSCMA_CLIENT_TRACE_INVALID,  /* !< A frame was rejected, value is its length */
+    SSCMA_CLIENT_TRACE_DROP,     /* !< A reply was dropped on a full queue */
+    SSCMA_CLIENT_TRACE_PARSE,    /* !< A payload was parsed, value is the duration in us */
+    SSCMA_CLIENT_TRACE_CALLBACK, /* !< A user callback returned, value is the duration in us */
+    SSCMA_CLIENT_TRACE_REQUEST,  /* !< A request completed, value is the round trip in us */
+} sscma_client_trace_type_t;
+
+/**
+ * @brief Trace record
+ *
+ * @note name is not NUL terminated and is only valid during the trace callback.
+ */
+typedef struct
+{
+    sscma_client_trace_type_t type; /* !< Kind of record */
+    int reply_type;                 /* !< Reply type, -1 if unknown */
+    const char *name;               /* !< Reply or command name, NULL if unknown */
+    size_t name_len;                /* !< Length of name */
+    uint32_t value;                 /* !< Length or duration, see sscma_client_trace_type_t */
+} sscma_client_trace_t;
+
+/**
+ * @brief Inference result decoded from a single reply
+ *
+ * @note image points into the reply data (base64, not NUL terminated) and is only valid while the reply is held.
+ */
+typedef struct
+{
+    sscma_client_box_t boxes[SSCMA_CLIENT_RESULT_MAX_BOXES];              /* !< Boxes */
+    int num_boxes;                                                        /* !< Number of boxes */
+    sscma_client_class_t classes[SSCMA_CLIENT_RESULT_MAX_CLASSES];        /* !< Classes */
+    int num_classes;                                                      /* !< Number of classes */
+    sscma_client_point_t points[SSCMA_CLIENT_RESULT_MAX_POINTS];          /* !< Points */
+    int num_points;                                                       /* !< Number of points */
+    sscma_client_keypoint_t keypoints[SSCMA_CLIENT_RESULT_MAX_KEYPOINTS]; /* !< Keypoints */
+    int num_keypoints;                                                    /* !< Number of keypoints */
+    const char *image;                                                    /* !< Base64 image, NULL if missing */
+    size_t image_len;                                                     /* !< Length of image */
+    bool truncated;                                                       /* !< Whether any array held more items than its capacity */
+} sscma_client_result_t;
+
 /**
  * @brief Callback function of SCCMA client
  * @param[in] client SCCMA client handle
@@ -119,6 +303,26 @@ typedef struct
  */
 typedef void (*sscma_client_reply_cb_t)(sscma_client_handle_t client, const sscma_client_reply_t *reply, void *user_ctx);
 
+/**
+ * @brief Trace callback of SCCMA client, called from the process and monitor tasks
+ * @param[in] client SCCMA client handle
+ * @param[in] trace Trace record
+ * @param[in] user_ctx User context
+ * @return None
+ */
+typedef void (*sscma_client_trace_cb_t)(sscma_client_handle_t client, const sscma_client_trace_t *trace, void *user_ctx);
+
+/**
+ * @brief OTA progress callback of SCCMA client, called from the task running the OTA
+ * @param[in] client SCCMA client handle
+ * @param[in] written Bytes written to the flasher so far
+ * @param[in] total Total bytes of the image
+ * @param[in] throughput Average throughput in bytes per second
+ * @param[in] user_ctx User context
+ * @return None
+ */
+typedef void (*sscma_client_ota_progress_cb_t)(sscma_client_handle_t client, size_t written, size_t total, uint32_t throughput, void *user_ctx);
+
 /**
  * @brief Type of SCCMA client callback
  */
@@ -146,6 +350,51 @@ struct sscma_client_t
     sscma_client_reply_cb_t on_event;      /* !< Callback function */
     sscma_client_reply_cb_t on_log;        /* !< Callback function */
     void *user_ctx;                        /* !< User context */
+    bool lazy_event_payload;               /* !< Whether INVOKE/SAMPLE events skip the cJSON parse */
+    struct
+    {
+        EventGroupHandle_t group; /* !< SSCMA_CLIENT_READY_BIT once INIT@STAT or a probe reply was seen */
+        TickType_t timeout;       /* !< Upper bound for sscma_client_reset() to wait for the device */
+        TickType_t reset_tick;    /* !< Tick the reset line was released at */
+        bool booting;             /* !< Whether the device is booting from a reset pulse, no probes during the grace period */
+    } ready;                      /* !< Device readiness */
+    struct
+    {
+        bool enabled;                   /* !< Whether info and model are persisted in NVS */
+        bool fresh;                     /* !< Model was revalidated with the info, next get_model() may skip MODEL? */
+        sscma_client_model_key_t model; /* !< Last MODEL? reply, a reflash by any tool changes its address or size */
+    } cache;                            /* !< Persistent info cache */
+    char task[64];                         /* !< Last AT+SAMPLE/AT+INVOKE running until stopped, empty if none */
+    struct
+    {
+        bool known;  /* !< Whether the mode below was set through this client */
+        int id;      /* !< Sensor id of the last AT+SENSOR= */
+        int opt_id;  /* !< Sensor config of the last AT+SENSOR= */
+        bool enable; /* !< Whether the last AT+SENSOR= enabled the sensor */
+    } sensor;        /* !< Sensor mode restored after a still capture */
+    struct
+    {
+        QueueHandle_t frame; /* !< Receives the still SAMPLE event, NULL when no capture is in flight */
+        bool armed;          /* !< The capture AT+SAMPLE was answered, the next SAMPLE event is the still */
+        uint32_t discarded;  /* !< Stale SAMPLE events dropped while waiting */
+    } still;                 /* !< Still capture, guarded by the request lock */
+    struct
+    {
+        int64_t period_us;               /* !< Frame budget from target_fps, 0 if the governor is off */
+        bool paced;                      /* !< Streaming task replaced by single shots */
+        bool want_shot;                  /* !< Last single shot was consumed, the next one may go out */
+        char shot[64];                   /* !< Single shot variant of the streaming task */
+        sscma_client_request_t *pending; /* !< Last command sent by the governor, detached until answered */
+        int64_t sent_us;                 /* !< Time the pending command went out */
+        int64_t shot_us;                 /* !< Time the last single shot went out */
+        int64_t last_us;                 /* !< Arrival of the last streaming event */
+        int64_t busy_us;                 /* !< Moving average of the consumer time per frame */
+        int64_t interval_us;             /* !< Moving average of the streaming event interval */
+        int64_t latency_us;              /* !< Moving average of the single shot round trip */
+        uint32_t calm;                   /* !< Consecutive frames continuous streaming would keep up with */
+        uint32_t replaced;               /* !< Mailbox replacements seen at the last frame */
+    } governor;                          /* !< Frame governor, guarded by the request lock */
+    TickType_t rx_poll_interval;           /* !< Fallback RX poll interval when no notification arrives */
     esp_io_expander_handle_t io_expander;  /* !< IO expander handle */
     struct
     {
@@ -165,12 +414,47 @@ struct sscma_client_t
     } process_task;
     struct
     {
-        char *data;            /* !< Data buffer */
-        size_t len;            /* !< Data length */
-        size_t pos;            /* !< Data position */
-    } rx_buffer, tx_buffer;    /* !< RX and TX buffer */
-    QueueHandle_t reply_queue; /* !< Queue for reply message */
-    List_t *request_list;      /* !< Request list */
+        char *data; /* !< Data buffer */
+        size_t len; /* !< Data length */
+        size_t pos; /* !< Data position */
+    } tx_buffer;    /* !< TX buffer */
+    struct
+    {
+        char *data;            /* !< Ring storage */
+        size_t len;            /* !< Ring capacity */
+        size_t head;           /* !< Next write position */
+        size_t fill;           /* !< Bytes retained behind head (unfinished frame) */
+        size_t start;          /* !< Position of the current frame prefix */
+        size_t mark;           /* !< Position of the last '\r' seen */
+        bool in_frame;         /* !< Whether a frame prefix has been seen */
+        char last;             /* !< Last non-NUL byte scanned */
+    } rx_buffer;               /* !< RX ring buffer, scanned incrementally */
+    QueueHandle_t reply_queue;            /* !< Queue for reply message */
+    struct
+    {
+        SemaphoreHandle_t lock;                                        /* !< Lock */
+        sscma_client_request_t *buckets[SSCMA_CLIENT_REQUEST_BUCKETS]; /* !< Pending requests hashed by command name */
+        int break_pending;                                             /* !< Pending AT+BREAK requests */
+    } requests;                                                        /* !< Pending request table */
+    sscma_client_reply_pool_t reply_pool; /* !< Reply buffer pool */
+    struct
+    {
+        bool enabled;                                            /* !< Whether INVOKE/SAMPLE use latest-wins mailboxes */
+        SemaphoreHandle_t lock;                                  /* !< Lock */
+        sscma_client_reply_t slot[SSCMA_CLIENT_EVENT_MAILBOXES]; /* !< Latest unconsumed event per name */
+        bool full[SSCMA_CLIENT_EVENT_MAILBOXES];                 /* !< Whether the slot holds an event */
+        uint32_t replaced[SSCMA_CLIENT_EVENT_MAILBOXES];         /* !< Events replaced before being consumed */
+        uint32_t dropped;                                        /* !< Replies dropped on a full reply queue */
+    } events;                                                    /* !< Event delivery */
+#if CONFIG_SSCMA_ENABLE_STATS
+    struct
+    {
+        portMUX_TYPE lock;             /* !< Lock */
+        sscma_client_stats_t counters; /* !< Counters */
+        sscma_client_trace_cb_t trace; /* !< Trace callback */
+        void *trace_ctx;               /* !< Trace callback context */
+    } stats;                           /* !< Performance counters */
+#endif
 };
 
 #ifdef __cplusplus
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -9,6 +10,22 @@ extern "C" {
 
 typedef struct sscma_client_io_t sscma_client_io_t; /*!< Type of SSCMA client IO */
 
+/**
+ * @brief Callback raised by the transport when data may be available, may be called from ISR context
+ */
+typedef void (*sscma_client_io_notify_cb_t)(void *user_ctx);
+
+/**
+ * @brief Returned by a chunked write producer that failed, the write stops with ESP_FAIL
+ */
+#define SSCMA_CLIENT_IO_FILL_ERROR SIZE_MAX
+
+/**
+ * @brief Producer of a chunked write, fills buf with up to size bytes and returns the count, 0 once exhausted
+ *        or SSCMA_CLIENT_IO_FILL_ERROR on failure
+ */
+typedef size_t (*sscma_client_io_fill_cb_t)(void *buf, size_t size, void *user_ctx);
+
 /**
  * @brief SSCMA IO interface
  */
@@ -41,6 +58,19 @@ struct sscma_client_io_t
      */
     esp_err_t (*write)(sscma_client_io_t *io, const void *data, size_t size);
 
+    /**
+     * @brief Write data produced piece by piece, as one uninterrupted write (optional)
+     *
+     * @param[in] io SCCMA client handle
+     * @param[in] fill Producer called for every piece until it returns 0
+     * @param[in] user_ctx User context passed to the producer
+     * @return
+     *          - ESP_ERR_NOT_SUPPORTED if chunked write is not supported by transport
+     *          - ESP_FAIL              if the producer returned SSCMA_CLIENT_IO_FILL_ERROR
+     *          - ESP_OK                on success
+     */
+    esp_err_t (*write_chunked)(sscma_client_io_t *io, sscma_client_io_fill_cb_t fill, void *user_ctx);
+
     /**
      * @brief Read data from SCCMA client
      *
@@ -75,6 +105,18 @@ struct sscma_client_io_t
      *          - ESP_OK
      */
     esp_err_t (*flush)(sscma_client_io_t *io);
+
+    /**
+     * @brief Register data ready callback (optional)
+     *
+     * @param[in] io IO handle
+     * @param[in] cb Callback raised when data may be available
+     * @param[in] user_ctx User context passed to the callback
+     * @return
+     *          - ESP_ERR_NOT_SUPPORTED if the transport cannot signal data
+     *          - ESP_OK
+     */
+    esp_err_t (*set_notify)(sscma_client_io_t *io, sscma_client_io_notify_cb_t cb, void *user_ctx);
 };
 
 #ifdef __cplusplus
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stddef.h>
 #include <sys/cdefs.h>
 #include "sdkconfig.h"
 #if CONFIG_SSCMA_ENABLE_DEBUG_LOG
@@ -44,8 +45,11 @@ static const char *TAG = "sscma_client.flasher.we2.uart";
 #define XEOF  0x1A
 
 #define XMODEM_BLOCK_SIZE     128
+#define XMODEM_1K_BLOCK_SIZE  1024
 #define XMODEM_RX_BUFFER_SIZE 1024
 
+#define XMODEM_1K_FALLBACK_RETRIES 2 // NACKs on the first 1K block before falling back to 128-byte blocks
+
 #define WRITE_BLOCK_MAX_RETRIES      15
 #define TRANSFER_ACK_TIMEOUT         30000 // 30 seconds
 #define TRANSFER_EOT_TIMEOUT         30000 // 30 seconds
@@ -85,14 +89,17 @@ typedef struct xmodem_packet_t
     uint8_t preamble;
     uint8_t id;
     uint8_t id_complement;
-    uint8_t data[XMODEM_BLOCK_SIZE];
-    union
-    {
-        uint8_t data[2];
-        uint16_t value;
-    } crc;
+    uint8_t data[XMODEM_1K_BLOCK_SIZE + 2]; // payload followed by the big-endian CRC
 } __attribute__((packed, aligned(1))) xmodem_packet_t;
 
+typedef struct
+{
+    xmodem_packet_t packet; /*!< Framed packet, ready to be written */
+    size_t size;            /*!< Payload size, XMODEM_BLOCK_SIZE or XMODEM_1K_BLOCK_SIZE */
+    size_t xfer;            /*!< Bytes of tx_buffer carried by the packet */
+    bool ready;             /*!< Packet has been prepared */
+} xmodem_block_t;
+
 typedef struct
 {
     sscma_client_flasher_t base;          /*!< The base class. */
@@ -103,7 +110,8 @@ typedef struct
     void *user_ctx;                       /* !< User context */
     SemaphoreHandle_t lock;               /*!< The lock. */
     xmodem_state_t state;                 /*!< The state of the flasher. */
-    xmodem_packet_t cur_packet;           /*!< The current packet being transmitted. */
+    xmodem_block_t blocks[2];             /*!< The block being transmitted and the next one. */
+    uint8_t cur_block;                    /*!< Index of the block being transmitted. */
     uint8_t cur_packet_id;                /*!< The ID of the current packet. */
     int64_t cur_time;                     /*!< The current time. */
     struct
@@ -112,60 +120,104 @@ typedef struct
         size_t len;         /* !< Data length */
         size_t pos;         /* !< Data position */
     } rx_buffer, tx_buffer; /* !< RX and TX buffer */
-    uint32_t xfer_size;
+    struct
+    {
+        unsigned int use_1k : 1;   /*!< Send XMODEM-1K (STX) blocks */
+        unsigned int acked_1k : 1; /*!< The receiver has accepted a 1K block */
+    } flags;
     uint8_t write_block_retries; /*!< The write block retries. */
 } sscma_client_flasher_we2_uart_t;
 
+static const uint16_t xmodem_crc_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
 static inline bool xmodem_calculate_crc(const uint8_t *data, const uint32_t size, uint16_t *result)
 {
     uint16_t crc = 0x0;
-    uint32_t count = size;
-    bool status = false;
-    uint8_t i = 0;
 
-    if (0 != data && 0 != result)
+    if (0 == data || 0 == result)
     {
-        status = true;
-
-        while (0 < count--)
-        {
-            crc = crc ^ (uint16_t)*data << 8;
-            data++;
-            i = 8;
+        return false;
+    }
 
-            do
-            {
-                if (0x8000 & crc)
-                {
-                    crc = crc << 1 ^ 0x1021;
-                }
-                else
-                {
-                    crc = crc << 1;
-                }
-            }
-            while (0 < --i);
-        }
-        *result = ((crc & 0xFF) << 8) + ((crc >> 8) & 0xFF);
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc = (crc << 8) ^ xmodem_crc_table[(crc >> 8) ^ data[i]];
     }
+    *result = crc;
 
-    return status;
+    return true;
 }
 
-static inline bool xmodem_verify_packet(const xmodem_packet_t packet, uint8_t expected_packet_id)
+static inline bool xmodem_verify_packet(const xmodem_packet_t *packet, size_t size, uint8_t expected_packet_id)
 {
-    bool status = false;
-    uint8_t crc_status = false;
     uint16_t calculated_crc = 0;
+    uint8_t preamble = size == XMODEM_1K_BLOCK_SIZE ? XSTX : XSOH;
 
-    crc_status = xmodem_calculate_crc(packet.data, XMODEM_BLOCK_SIZE, &calculated_crc);
-
-    if (packet.preamble == XSOH && packet.id == expected_packet_id && packet.id_complement == 0xFF - packet.id && crc_status && calculated_crc == packet.crc.value)
+    if (!xmodem_calculate_crc(packet->data, size, &calculated_crc))
     {
-        status = true;
+        return false;
     }
 
-    return status;
+    return packet->preamble == preamble && packet->id == expected_packet_id && packet->id_complement == 0xFF - packet->id && packet->data[size] == (calculated_crc >> 8)
+           && packet->data[size + 1] == (calculated_crc & 0xFF);
+}
+
+static void xmodem_prepare_block(sscma_client_flasher_we2_uart_t *flasher, xmodem_block_t *block, uint8_t id, size_t pos)
+{
+    size_t remain = flasher->tx_buffer.len - pos;
+    uint16_t crc = 0;
+
+    // the tail goes out in 128-byte blocks so it is not padded to 1K
+    block->size = flasher->flags.use_1k && remain >= XMODEM_1K_BLOCK_SIZE ? XMODEM_1K_BLOCK_SIZE : XMODEM_BLOCK_SIZE;
+    block->xfer = remain > block->size ? block->size : remain;
+    block->packet.preamble = block->size == XMODEM_1K_BLOCK_SIZE ? XSTX : XSOH;
+    block->packet.id = id;
+    block->packet.id_complement = 0xFF - id;
+    memcpy(block->packet.data, flasher->tx_buffer.data + pos, block->xfer);
+    memset(block->packet.data + block->xfer, 0xFF, block->size - block->xfer);
+    xmodem_calculate_crc(block->packet.data, block->size, &crc);
+    block->packet.data[block->size] = crc >> 8;
+    block->packet.data[block->size + 1] = crc & 0xFF;
+    block->ready = true;
+}
+
+static inline void xmodem_reset_blocks(sscma_client_flasher_we2_uart_t *flasher)
+{
+    flasher->blocks[0].ready = false;
+    flasher->blocks[1].ready = false;
 }
 
 static inline bool xmodem_timeout(sscma_client_flasher_we2_uart_t *flasher_we2, int64_t timeout)
@@ -185,7 +237,6 @@ static xmodem_state_t xmodem_process(sscma_client_flasher_we2_uart_t *flasher)
     uint8_t response = 0;
     uint8_t ctrl = 0;
     size_t rlen = 0;
-    uint16_t crc = 0;
 
     switch (flasher->state)
     {
@@ -211,25 +262,16 @@ static xmodem_state_t xmodem_process(sscma_client_flasher_we2_uart_t *flasher)
             break;
         }
         case WRITE_BLOCK: {
+            xmodem_block_t *block = &flasher->blocks[flasher->cur_block];
             if (flasher->tx_buffer.data == NULL || flasher->tx_buffer.len == 0)
             {
                 break;
             }
-            /* setup current packet */
-            if (flasher->cur_packet.id != flasher->cur_packet_id || flasher->cur_packet_id == 1)
+            if (!block->ready)
             {
-                flasher->cur_packet.preamble = XSOH;
-                flasher->cur_packet.id = flasher->cur_packet_id;
-                flasher->cur_packet.id_complement = 0xFF - flasher->cur_packet_id;
-                memset(flasher->cur_packet.data, 0xFF, XMODEM_BLOCK_SIZE);
-                flasher->xfer_size = flasher->tx_buffer.len - flasher->tx_buffer.pos > XMODEM_BLOCK_SIZE ? XMODEM_BLOCK_SIZE : flasher->tx_buffer.len - flasher->tx_buffer.pos;
-                memcpy(flasher->cur_packet.data, flasher->tx_buffer.data + flasher->tx_buffer.pos, flasher->xfer_size);
-                xmodem_calculate_crc(flasher->cur_packet.data, XMODEM_BLOCK_SIZE, &crc);
-                flasher->cur_packet.crc.value = crc;
+                xmodem_prepare_block(flasher, block, flasher->cur_packet_id, flasher->tx_buffer.pos);
             }
-            sscma_client_io_write(flasher->io, (uint8_t *)&flasher->cur_packet, sizeof(xmodem_packet_t));
-            flasher->cur_packet_id++;
-            flasher->tx_buffer.pos += flasher->xfer_size;
+            sscma_client_io_write(flasher->io, (uint8_t *)&block->packet, offsetof(xmodem_packet_t, data) + block->size + 2);
             flasher->state = WAIT_FOR_C_ACK;
             flasher->cur_time = esp_timer_get_time();
 
@@ -265,6 +307,12 @@ static xmodem_state_t xmodem_process(sscma_client_flasher_we2_uart_t *flasher)
                         break;
                 }
             }
+            else if (!flasher->blocks[flasher->cur_block ^ 1].ready && flasher->tx_buffer.pos + flasher->blocks[flasher->cur_block].xfer < flasher->tx_buffer.len)
+            {
+                // use the ACK round trip to frame the next block
+                const xmodem_block_t *block = &flasher->blocks[flasher->cur_block];
+                xmodem_prepare_block(flasher, &flasher->blocks[flasher->cur_block ^ 1], flasher->cur_packet_id + 1, flasher->tx_buffer.pos + block->xfer);
+            }
             else if (xmodem_timeout(flasher, TRANSFER_ACK_TIMEOUT))
             {
                 flasher->state = WRITE_BLOCK_TIMEOUT;
@@ -278,14 +326,29 @@ static xmodem_state_t xmodem_process(sscma_client_flasher_we2_uart_t *flasher)
             }
             else
             {
-                flasher->state = WRITE_BLOCK;
-                flasher->cur_packet_id--;
-                flasher->tx_buffer.pos -= flasher->xfer_size;
                 flasher->write_block_retries++;
+                if (flasher->blocks[flasher->cur_block].size == XMODEM_1K_BLOCK_SIZE && !flasher->flags.acked_1k && flasher->write_block_retries >= XMODEM_1K_FALLBACK_RETRIES)
+                {
+                    ESP_LOGW(TAG, "receiver rejects 1K blocks, falling back to %d-byte blocks", XMODEM_BLOCK_SIZE);
+                    flasher->flags.use_1k = false;
+                    flasher->write_block_retries = 0;
+                    xmodem_reset_blocks(flasher);
+                }
+                flasher->state = WRITE_BLOCK;
             }
             break;
         }
         case C_ACK_RECEIVED: {
+            xmodem_block_t *block = &flasher->blocks[flasher->cur_block];
+            if (block->size == XMODEM_1K_BLOCK_SIZE)
+            {
+                flasher->flags.acked_1k = true;
+            }
+            flasher->tx_buffer.pos += block->xfer;
+            flasher->cur_packet_id++;
+            flasher->write_block_retries = 0;
+            block->ready = false;
+            flasher->cur_block ^= 1;
             if (flasher->tx_buffer.pos >= flasher->tx_buffer.len)
             {
                 flasher->tx_buffer.len = 0;
@@ -294,7 +357,6 @@ static xmodem_state_t xmodem_process(sscma_client_flasher_we2_uart_t *flasher)
             }
             else
             {
-                flasher->write_block_retries = 0;
                 flasher->state = WRITE_BLOCK;
             }
 
@@ -363,10 +425,13 @@ esp_err_t xmodem_start(sscma_client_flasher_we2_uart_t *flasher)
 
     flasher->state = INITIAL;
     flasher->cur_packet_id = 1;
+    flasher->cur_block = 0;
+    flasher->flags.use_1k = true;
+    flasher->flags.acked_1k = false;
     flasher->tx_buffer.data = NULL;
     flasher->tx_buffer.len = 0;
     flasher->tx_buffer.pos = 0;
-    flasher->xfer_size = 0;
+    xmodem_reset_blocks(flasher);
     flasher->cur_time = esp_timer_get_time();
     do
     {
@@ -394,7 +459,7 @@ esp_err_t xmodem_write(sscma_client_flasher_we2_uart_t *flasher, const void *dat
     flasher->tx_buffer.data = (char *)data;
     flasher->tx_buffer.pos = 0;
     flasher->tx_buffer.len = len;
-    flasher->xfer_size = 0;
+    xmodem_reset_blocks(flasher);
 
     do
     {
@@ -409,7 +474,8 @@ esp_err_t xmodem_write(sscma_client_flasher_we2_uart_t *flasher, const void *dat
             ret = ESP_ERR_TIMEOUT;
             break;
         }
-        if (flasher->state == FAILED)
+        // out of retries or a NAKed EOT cancels the transfer and ends in FINAL
+        if (flasher->state == FAILED || flasher->state == FINAL)
         {
             ret = ESP_FAIL;
             break;
@@ -429,7 +495,7 @@ esp_err_t xmodem_finish(sscma_client_flasher_we2_uart_t *flasher)
     flasher->tx_buffer.data = NULL;
     flasher->tx_buffer.len = 0;
     flasher->tx_buffer.pos = 0;
-    flasher->xfer_size = 0;
+    xmodem_reset_blocks(flasher);
     do
     {
         xmodem_process(flasher);
@@ -443,7 +509,8 @@ esp_err_t xmodem_finish(sscma_client_flasher_we2_uart_t *flasher)
             ret = ESP_ERR_TIMEOUT;
             break;
         }
-        if (flasher->state == FAILED)
+        // out of retries or a NAKed EOT cancels the transfer and ends in FINAL
+        if (flasher->state == FAILED || flasher->state == FINAL)
         {
             ret = ESP_FAIL;
             break;
@@ -462,7 +529,7 @@ esp_err_t xmodem_abort(sscma_client_flasher_we2_uart_t *flasher)
     flasher->tx_buffer.data = NULL;
     flasher->tx_buffer.len = 0;
     flasher->tx_buffer.pos = 0;
-    flasher->xfer_size = 0;
+    xmodem_reset_blocks(flasher);
 
     do
     {
@@ -507,10 +574,12 @@ esp_err_t sscma_client_new_flasher_we2_uart(const sscma_client_io_handle_t io, c
     flasher_we2->tx_buffer.data = NULL;
     flasher_we2->tx_buffer.len = 0;
     flasher_we2->tx_buffer.pos = 0;
-    flasher_we2->xfer_size = 0;
+    xmodem_reset_blocks(flasher_we2);
 
     flasher_we2->state = INITIAL;
     flasher_we2->cur_packet_id = 0;
+    flasher_we2->cur_block = 0;
+    flasher_we2->flags.use_1k = true;
     flasher_we2->cur_time = esp_timer_get_time();
     flasher_we2->write_block_retries = 0;
 
@@ -4,6 +4,8 @@
 
 static const char *TAG = "sscma_client.io";
 
+#define SSCMA_CLIENT_IO_CHUNK_SIZE 256 // staging for transports without write_chunked
+
 esp_err_t sscma_client_io_del(sscma_client_io_t *io)
 {
     ESP_RETURN_ON_FALSE(io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
@@ -20,6 +22,26 @@ esp_err_t sscma_client_io_write(sscma_client_io_t *io, const void *data, size_t
     return io->write(io, data, len);
 }
 
+esp_err_t sscma_client_io_write_chunked(sscma_client_io_t *io, sscma_client_io_fill_cb_t fill, void *user_ctx)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t staging[SSCMA_CLIENT_IO_CHUNK_SIZE];
+    size_t len = 0;
+
+    ESP_RETURN_ON_FALSE(io && fill, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    if (io->write_chunked)
+    {
+        return io->write_chunked(io, fill, user_ctx);
+    }
+    ESP_RETURN_ON_FALSE(io->write, ESP_ERR_NOT_SUPPORTED, TAG, "write not supported");
+    while (ret == ESP_OK && (len = fill(staging, sizeof(staging), user_ctx)) > 0)
+    {
+        ESP_RETURN_ON_FALSE(len != SSCMA_CLIENT_IO_FILL_ERROR, ESP_FAIL, TAG, "fill failed");
+        ret = io->write(io, staging, len);
+    }
+    return ret;
+}
+
 esp_err_t sscma_client_io_read(sscma_client_io_t *io, void *data, size_t len)
 {
     ESP_RETURN_ON_FALSE(io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
@@ -41,3 +63,13 @@ esp_err_t sscma_client_io_flush(sscma_client_io_t *io)
     ESP_RETURN_ON_FALSE(io->flush, ESP_ERR_NOT_SUPPORTED, TAG, "flush not supported");
     return io->flush(io);
 }
+
+esp_err_t sscma_client_io_set_notify(sscma_client_io_t *io, sscma_client_io_notify_cb_t cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    if (io->set_notify == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    return io->set_notify(io, cb, user_ctx);
+}
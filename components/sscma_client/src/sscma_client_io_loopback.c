@@ -0,0 +1,428 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/cdefs.h>
+#include "sdkconfig.h"
+#if CONFIG_SSCMA_ENABLE_DEBUG_LOG
+// The local log level must be defined before including esp_log.h
+// Set the maximum log level for this source file
+#define LOG_LOCAL_LEVEL ESP_LOG_DEBUG
+#endif
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "sscma_client_io_interface.h"
+#include "sscma_client_io.h"
+#include "sscma_client_commands.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+
+static const char *TAG = "sscma_client.io.loopback";
+
+#define FRAME_OVERHEAD 256 // envelope of a synthetic event, excluding boxes and image
+#define BOX_OVERHEAD   48  // one synthetic box
+
+static esp_err_t client_io_loopback_del(sscma_client_io_t *io);
+static esp_err_t client_io_loopback_write(sscma_client_io_t *io, const void *data, size_t len);
+static esp_err_t client_io_loopback_read(sscma_client_io_t *io, void *data, size_t len);
+static esp_err_t client_io_loopback_available(sscma_client_io_t *io, size_t *len);
+static esp_err_t client_io_loopback_flush(sscma_client_io_t *io);
+static esp_err_t client_io_loopback_set_notify(sscma_client_io_t *io, sscma_client_io_notify_cb_t cb, void *user_ctx);
+
+typedef struct
+{
+    sscma_client_io_t base;
+    SemaphoreHandle_t lock;                   // Mutex lock
+    sscma_client_io_loopback_config_t config; // Traffic configuration
+    esp_timer_handle_t timer;                 // Event timer
+    esp_timer_handle_t boot_timer;            // Ends the boot, NULL when up at once
+    bool booted;                              // Whether the device answers requests
+    char *out;                                // Device to host data
+    size_t out_size;                          // Capacity of out
+    size_t out_len;                           // Bytes queued in out
+    size_t out_pos;                           // Bytes of out already read
+    char event[16];                           // Name of the streaming event, empty when idle
+    int remaining;                            // Events left in the running task, -1 until stopped
+    uint32_t events;                          // Events generated
+    uint32_t dropped;                         // Events dropped because the host fell behind
+    uint32_t requests;                        // Requests answered
+    sscma_client_io_notify_cb_t notify;       // Data ready callback
+    void *notify_ctx;                         // Data ready callback context
+} sscma_client_io_loopback_t;
+
+static size_t loopback_space(sscma_client_io_loopback_t *loopback_io)
+{
+    if (loopback_io->out_pos > 0)
+    {
+        memmove(loopback_io->out, loopback_io->out + loopback_io->out_pos, loopback_io->out_len - loopback_io->out_pos);
+        loopback_io->out_len -= loopback_io->out_pos;
+        loopback_io->out_pos = 0;
+    }
+    return loopback_io->out_size - loopback_io->out_len;
+}
+
+static void loopback_printf(sscma_client_io_loopback_t *loopback_io, const char *fmt, ...)
+{
+    size_t space = loopback_io->out_size - loopback_io->out_len;
+    va_list args;
+
+    if (space == 0)
+    {
+        return;
+    }
+    va_start(args, fmt);
+    int n = vsnprintf(loopback_io->out + loopback_io->out_len, space, fmt, args);
+    va_end(args);
+
+    if (n > 0)
+    {
+        loopback_io->out_len += (size_t)n < space ? (size_t)n : space - 1;
+    }
+}
+
+static void loopback_reply(sscma_client_io_loopback_t *loopback_io, const char *name, size_t name_len)
+{
+    int code = CMD_OK;
+    const char *data = "{}";
+
+    loopback_io->requests++;
+    if (loopback_io->config.error_every > 0 && loopback_io->requests % loopback_io->config.error_every == 0)
+    {
+        code = CMD_EBUSY;
+    }
+    else if (name_len == strlen(CMD_AT_ID) && memcmp(name, CMD_AT_ID, name_len) == 0)
+    {
+        data = "\"00000000\"";
+    }
+    else if (name_len == strlen(CMD_AT_NAME) && memcmp(name, CMD_AT_NAME, name_len) == 0)
+    {
+        data = "\"loopback\"";
+    }
+    else if (name_len == strlen(CMD_AT_VERSION) && memcmp(name, CMD_AT_VERSION, name_len) == 0)
+    {
+        data = "{\"at_api\": \"v0\", \"software\": \"loopback\", \"hardware\": \"0\"}";
+    }
+
+    if (loopback_space(loopback_io) < FRAME_OVERHEAD + name_len)
+    {
+        ESP_LOGW(TAG, "reply to %.*s dropped, host is not reading", (int)name_len, name);
+        return;
+    }
+    loopback_printf(loopback_io, "\r{\"type\": %d, \"name\": \"%.*s\", \"code\": %d, \"data\": %s}\n", CMD_TYPE_RESPONSE, (int)name_len, name, code, data);
+}
+
+static void loopback_event(sscma_client_io_loopback_t *loopback_io)
+{
+    const sscma_client_io_loopback_config_t *config = &loopback_io->config;
+    size_t image_len = (config->image_size + 2) / 3 * 4;
+    size_t need = FRAME_OVERHEAD + config->num_boxes * BOX_OVERHEAD + image_len;
+    uint32_t seq = loopback_io->events++;
+
+    if (config->num_frames > 0)
+    {
+        const char *frame = config->frames[seq % config->num_frames];
+        need = strlen(frame) + 3;
+    }
+    if (config->log_every > 0 && seq % config->log_every == 0)
+    {
+        need += FRAME_OVERHEAD;
+    }
+    if (loopback_space(loopback_io) < need)
+    {
+        loopback_io->dropped++;
+        return;
+    }
+
+    if (config->log_every > 0 && seq % config->log_every == 0)
+    {
+        loopback_printf(loopback_io, "\r{\"type\": %d, \"name\": \"LOG\", \"code\": %d, \"data\": \"loopback event %lu\"}\n", CMD_TYPE_LOG, CMD_OK, (unsigned long)seq);
+    }
+
+    if (config->num_frames > 0)
+    {
+        loopback_printf(loopback_io, "\r%s\n", config->frames[seq % config->num_frames]);
+        return;
+    }
+
+    // timestamp is not part of the device protocol, it lets a benchmark measure end-to-end latency
+    loopback_printf(loopback_io, "\r{\"type\": %d, \"name\": \"%s\", \"code\": %d, \"data\": {\"count\": %lu, \"timestamp\": %lld, \"perf\": [1, 2, 3], \"boxes\": [", CMD_TYPE_EVENT,
+        loopback_io->event, CMD_OK, (unsigned long)seq, (long long)esp_timer_get_time());
+    for (int i = 0; i < config->num_boxes; i++)
+    {
+        loopback_printf(loopback_io, "%s[%d, %d, %d, %d, %d, %d]", i ? ", " : "", 16 + i, 32 + i, 64, 48, 90 - i % 50, i % 80);
+    }
+    loopback_printf(loopback_io, "], \"image\": \"");
+    // base64 of a JPEG starts with "/9j/", the rest is filler
+    for (size_t i = 0; i < image_len; i++)
+    {
+        loopback_io->out[loopback_io->out_len++] = i < 4 ? "/9j/"[i] : 'A';
+    }
+    loopback_printf(loopback_io, "\"}}\n");
+}
+
+static void loopback_timer_cb(void *arg)
+{
+    sscma_client_io_loopback_t *loopback_io = (sscma_client_io_loopback_t *)arg;
+    bool queued = false;
+
+    xSemaphoreTake(loopback_io->lock, portMAX_DELAY);
+    if (loopback_io->event[0] != '\0')
+    {
+        loopback_event(loopback_io);
+        queued = true;
+        if (loopback_io->remaining > 0 && --loopback_io->remaining == 0)
+        {
+            loopback_io->event[0] = '\0';
+        }
+    }
+    xSemaphoreGive(loopback_io->lock);
+
+    if (queued && loopback_io->notify)
+    {
+        loopback_io->notify(loopback_io->notify_ctx);
+    }
+}
+
+static void loopback_boot(sscma_client_io_loopback_t *loopback_io)
+{
+    // the device announces itself once it is up
+    loopback_printf(loopback_io, "\r{\"type\": %d, \"name\": \"%s\", \"code\": %d, \"data\": {\"boot_count\": 0, \"is_ready\": 1}}\n", CMD_TYPE_EVENT, EVENT_INIT, CMD_OK);
+    loopback_io->booted = true;
+}
+
+static void loopback_boot_timer_cb(void *arg)
+{
+    sscma_client_io_loopback_t *loopback_io = (sscma_client_io_loopback_t *)arg;
+
+    xSemaphoreTake(loopback_io->lock, portMAX_DELAY);
+    loopback_boot(loopback_io);
+    xSemaphoreGive(loopback_io->lock);
+
+    if (loopback_io->notify)
+    {
+        loopback_io->notify(loopback_io->notify_ctx);
+    }
+}
+
+esp_err_t sscma_client_new_io_loopback(const sscma_client_io_loopback_config_t *io_config, sscma_client_io_handle_t *ret_io)
+{
+#if CONFIG_SSCMA_ENABLE_DEBUG_LOG
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+#endif
+    esp_err_t ret = ESP_OK;
+    sscma_client_io_loopback_t *loopback_io = NULL;
+    ESP_GOTO_ON_FALSE(io_config && ret_io, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+    ESP_GOTO_ON_FALSE(io_config->num_frames == 0 || io_config->frames, ESP_ERR_INVALID_ARG, err, TAG, "invalid frames");
+
+    loopback_io = (sscma_client_io_loopback_t *)calloc(1, sizeof(sscma_client_io_loopback_t));
+    ESP_GOTO_ON_FALSE(loopback_io, ESP_ERR_NO_MEM, err, TAG, "no mem for loopback client io");
+
+    loopback_io->config = *io_config;
+    loopback_io->out_size = io_config->buffer_size;
+    if (loopback_io->out_size == 0)
+    {
+        loopback_io->out_size = 2 * (FRAME_OVERHEAD + io_config->num_boxes * BOX_OVERHEAD + (io_config->image_size + 2) / 3 * 4);
+    }
+    loopback_io->out = (char *)heap_caps_malloc_prefer(loopback_io->out_size, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_DEFAULT);
+    ESP_GOTO_ON_FALSE(loopback_io->out, ESP_ERR_NO_MEM, err, TAG, "no mem for loopback buffer");
+
+    loopback_io->base.del = client_io_loopback_del;
+    loopback_io->base.write = client_io_loopback_write;
+    loopback_io->base.read = client_io_loopback_read;
+    loopback_io->base.available = client_io_loopback_available;
+    loopback_io->base.flush = client_io_loopback_flush;
+    loopback_io->base.set_notify = client_io_loopback_set_notify;
+    loopback_io->base.handle = loopback_io;
+
+    loopback_io->lock = xSemaphoreCreateMutex();
+    ESP_GOTO_ON_FALSE(loopback_io->lock, ESP_ERR_NO_MEM, err, TAG, "no mem for mutex");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = loopback_timer_cb,
+        .arg = loopback_io,
+        .name = "sscma_loopback",
+    };
+    ESP_GOTO_ON_ERROR(esp_timer_create(&timer_args, &loopback_io->timer), err, TAG, "create timer failed");
+    ESP_GOTO_ON_ERROR(esp_timer_start_periodic(loopback_io->timer, (io_config->frame_interval_ms > 0 ? io_config->frame_interval_ms : 1) * 1000), err, TAG, "start timer failed");
+
+    if (io_config->boot_time_ms > 0)
+    {
+        const esp_timer_create_args_t boot_timer_args = {
+            .callback = loopback_boot_timer_cb,
+            .arg = loopback_io,
+            .name = "sscma_loopback_boot",
+        };
+        ESP_GOTO_ON_ERROR(esp_timer_create(&boot_timer_args, &loopback_io->boot_timer), err, TAG, "create boot timer failed");
+        ESP_GOTO_ON_ERROR(esp_timer_start_once(loopback_io->boot_timer, io_config->boot_time_ms * 1000), err, TAG, "start boot timer failed");
+    }
+    else
+    {
+        loopback_boot(loopback_io);
+    }
+
+    *ret_io = &loopback_io->base;
+    ESP_LOGI(TAG, "new loopback sscma client io @%p", loopback_io);
+
+    return ESP_OK;
+
+err:
+    if (loopback_io)
+    {
+        if (loopback_io->timer)
+        {
+            esp_timer_delete(loopback_io->timer);
+        }
+        if (loopback_io->boot_timer)
+        {
+            esp_timer_stop(loopback_io->boot_timer);
+            esp_timer_delete(loopback_io->boot_timer);
+        }
+        if (loopback_io->lock)
+        {
+            vSemaphoreDelete(loopback_io->lock);
+        }
+        free(loopback_io->out);
+        free(loopback_io);
+    }
+
+    return ret;
+}
+
+static esp_err_t client_io_loopback_del(sscma_client_io_t *io)
+{
+    sscma_client_io_loopback_t *loopback_io = __containerof(io, sscma_client_io_loopback_t, base);
+
+    esp_timer_stop(loopback_io->timer);
+    esp_timer_delete(loopback_io->timer);
+    if (loopback_io->boot_timer)
+    {
+        esp_timer_stop(loopback_io->boot_timer);
+        esp_timer_delete(loopback_io->boot_timer);
+    }
+    vSemaphoreDelete(loopback_io->lock);
+
+    ESP_LOGI(TAG, "del loopback sscma client io @%p, events: %lu, dropped: %lu, requests: %lu", loopback_io, (unsigned long)loopback_io->events, (unsigned long)loopback_io->dropped,
+        (unsigned long)loopback_io->requests);
+
+    free(loopback_io->out);
+    free(loopback_io);
+
+    return ESP_OK;
+}
+
+static esp_err_t client_io_loopback_write(sscma_client_io_t *io, const void *data, size_t len)
+{
+    sscma_client_io_loopback_t *loopback_io = __containerof(io, sscma_client_io_loopback_t, base);
+    const char *p = (const char *)data;
+    const char *end = p + len;
+
+    ESP_RETURN_ON_FALSE(data, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    xSemaphoreTake(loopback_io->lock, portMAX_DELAY);
+
+    // a booting device does not listen yet
+    if (!loopback_io->booted)
+    {
+        p = end;
+    }
+
+    // every "AT+NAME[?|=args]\r\n" in the buffer gets a reply
+    while ((p = memchr(p, '+', end - p)) != NULL)
+    {
+        const char *name = ++p;
+        while (p < end && *p != '?' && *p != '=' && *p != '\r' && *p != '\n')
+        {
+            p++;
+        }
+        size_t name_len = p - name;
+
+        if ((name_len == strlen(CMD_AT_INVOKE) && memcmp(name, CMD_AT_INVOKE, name_len) == 0) || (name_len == strlen(CMD_AT_SAMPLE) && memcmp(name, CMD_AT_SAMPLE, name_len) == 0))
+        {
+            // the first argument is the number of events, negative to run until AT+BREAK
+            snprintf(loopback_io->event, sizeof(loopback_io->event), "%.*s", (int)name_len, name);
+            loopback_io->remaining = p < end && *p == '=' ? atoi(p + 1) : -1;
+            if (loopback_io->remaining <= 0)
+            {
+                loopback_io->remaining = -1;
+            }
+        }
+        else if (name_len == strlen(CMD_AT_BREAK) && memcmp(name, CMD_AT_BREAK, name_len) == 0)
+        {
+            loopback_io->event[0] = '\0';
+        }
+        // the device answers a query under its name with the '?' kept, e.g. "ID?"
+        loopback_reply(loopback_io, name, p < end && *p == '?' ? name_len + 1 : name_len);
+    }
+
+    xSemaphoreGive(loopback_io->lock);
+
+    if (loopback_io->notify)
+    {
+        loopback_io->notify(loopback_io->notify_ctx);
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t client_io_loopback_read(sscma_client_io_t *io, void *data, size_t len)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_io_loopback_t *loopback_io = __containerof(io, sscma_client_io_loopback_t, base);
+
+    ESP_RETURN_ON_FALSE(data, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    xSemaphoreTake(loopback_io->lock, portMAX_DELAY);
+    if (len > loopback_io->out_len - loopback_io->out_pos)
+    {
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    else
+    {
+        memcpy(data, loopback_io->out + loopback_io->out_pos, len);
+        loopback_io->out_pos += len;
+    }
+    xSemaphoreGive(loopback_io->lock);
+
+    return ret;
+}
+
+static esp_err_t client_io_loopback_available(sscma_client_io_t *io, size_t *len)
+{
+    sscma_client_io_loopback_t *loopback_io = __containerof(io, sscma_client_io_loopback_t, base);
+
+    xSemaphoreTake(loopback_io->lock, portMAX_DELAY);
+    *len = loopback_io->out_len - loopback_io->out_pos;
+    // fragment the stream like a real transport would
+    if (loopback_io->config.chunk_size > 0 && *len > loopback_io->config.chunk_size)
+    {
+        *len = loopback_io->config.chunk_size;
+    }
+    xSemaphoreGive(loopback_io->lock);
+
+    return ESP_OK;
+}
+
+static esp_err_t client_io_loopback_flush(sscma_client_io_t *io)
+{
+    sscma_client_io_loopback_t *loopback_io = __containerof(io, sscma_client_io_loopback_t, base);
+
+    xSemaphoreTake(loopback_io->lock, portMAX_DELAY);
+    loopback_io->out_len = 0;
+    loopback_io->out_pos = 0;
+    xSemaphoreGive(loopback_io->lock);
+
+    return ESP_OK;
+}
+
+static esp_err_t client_io_loopback_set_notify(sscma_client_io_t *io, sscma_client_io_notify_cb_t cb, void *user_ctx)
+{
+    sscma_client_io_loopback_t *loopback_io = __containerof(io, sscma_client_io_loopback_t, base);
+
+    loopback_io->notify_ctx = user_ctx;
+    loopback_io->notify = cb;
+
+    return ESP_OK;
+}
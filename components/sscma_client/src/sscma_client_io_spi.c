@@ -14,6 +14,8 @@
 #include "sscma_client_io.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "esp_log.h"
 #include "esp_check.h"
 
@@ -27,6 +29,9 @@ static const char *TAG = "sscma_client.io.spi";
 
 #define MAX_RECIEVE_SIZE (uint16_t)4095
 
+#define RX_STAGING_SIZE  ((MAX_RECIEVE_SIZE + 3) & ~3)
+#define MIN_QUEUE_DEPTH  4 // command and data transaction of two read chunks
+
 #define FEATURE_TRANSPORT               0x10
 #define FEATURE_TRANSPORT_CMD_READ      0x01
 #define FEATURE_TRANSPORT_CMD_WRITE     0x02
@@ -37,9 +42,12 @@ static const char *TAG = "sscma_client.io.spi";
 
 static esp_err_t client_io_spi_del(sscma_client_io_t *io);
 static esp_err_t client_io_spi_write(sscma_client_io_t *io, const void *data, size_t len);
+static esp_err_t client_io_spi_write_chunked(sscma_client_io_t *io, sscma_client_io_fill_cb_t fill, void *user_ctx);
 static esp_err_t client_io_spi_read(sscma_client_io_t *io, void *data, size_t len);
 static esp_err_t client_io_spi_available(sscma_client_io_t *io, size_t *len);
 static esp_err_t client_io_spi_flush(sscma_client_io_t *io);
+static esp_err_t client_io_spi_set_notify(sscma_client_io_t *io, sscma_client_io_notify_cb_t cb, void *user_ctx);
+static void client_io_spi_sync_isr(void *arg);
 
 typedef struct
 {
@@ -51,6 +59,14 @@ typedef struct
     void *user_ctx;                       // User context
     esp_io_expander_handle_t io_expander; // IO expander
     SemaphoreHandle_t lock;               // Lock
+    SemaphoreHandle_t sync;               // Given on every SYNC rising edge, NULL without a direct SYNC GPIO
+    sscma_client_io_notify_cb_t notify;   // Data ready callback
+    void *notify_ctx;                     // Data ready callback context
+    bool queued;                          // Queue transactions instead of transmitting them one by one
+    size_t queue_depth;                   // Transactions in flight in queued mode
+    spi_transaction_t *trans;             // Transaction descriptors, one per staging packet
+    uint8_t *staging;                     // DMA-capable packet staging, queue_depth packets
+    uint8_t *rx_staging[2];               // DMA-capable ping-pong read buffers
     uint8_t buffer[PACKET_SIZE];
 } sscma_client_io_spi_t;
 
@@ -73,6 +89,13 @@ esp_err_t sscma_client_new_io_spi_bus(sscma_client_spi_bus_handle_t bus, const s
         .queue_size = 1,
     };
 
+    if (io_config->flags.queued_trans)
+    {
+        spi_client_io->queued = true;
+        spi_client_io->queue_depth = io_config->trans_queue_depth > MIN_QUEUE_DEPTH ? io_config->trans_queue_depth : MIN_QUEUE_DEPTH;
+        dev_config.queue_size = spi_client_io->queue_depth;
+    }
+
     ret = spi_bus_add_device((spi_host_device_t)bus, &dev_config, &spi_client_io->spi_dev);
     ESP_GOTO_ON_ERROR(ret, err, TAG, "adding spi device to bus failed");
 
@@ -104,19 +127,53 @@ esp_err_t sscma_client_new_io_spi_bus(sscma_client_spi_bus_handle_t bus, const s
     spi_client_io->user_ctx = io_config->user_ctx;
     spi_client_io->base.del = client_io_spi_del;
     spi_client_io->base.write = client_io_spi_write;
+    spi_client_io->base.write_chunked = client_io_spi_write_chunked;
     spi_client_io->base.read = client_io_spi_read;
     spi_client_io->base.available = client_io_spi_available;
     spi_client_io->base.flush = client_io_spi_flush;
+    spi_client_io->base.set_notify = client_io_spi_set_notify;
     spi_client_io->base.handle = spi_client_io->spi_dev;
 
     spi_client_io->lock = xSemaphoreCreateMutex();
     ESP_GOTO_ON_FALSE(spi_client_io->lock, ESP_ERR_NO_MEM, err, TAG, "no mem for mutex");
 
+    // a sync line behind an IO expander can only be polled
+    if (spi_client_io->sync_gpio_num >= 0 && spi_client_io->io_expander == NULL)
+    {
+        spi_client_io->sync = xSemaphoreCreateBinary();
+        ESP_GOTO_ON_FALSE(spi_client_io->sync, ESP_ERR_NO_MEM, err, TAG, "no mem for sync semaphore");
+        ret = gpio_install_isr_service(0);
+        ESP_GOTO_ON_FALSE(ret == ESP_OK || ret == ESP_ERR_INVALID_STATE, ret, err, TAG, "install isr service failed");
+        ESP_GOTO_ON_ERROR(gpio_set_intr_type(spi_client_io->sync_gpio_num, GPIO_INTR_POSEDGE), err, TAG, "set sync intr type failed");
+        ESP_GOTO_ON_ERROR(gpio_isr_handler_add(spi_client_io->sync_gpio_num, client_io_spi_sync_isr, spi_client_io), err, TAG, "add sync isr failed");
+        ESP_GOTO_ON_ERROR(gpio_intr_enable(spi_client_io->sync_gpio_num), err, TAG, "enable sync intr failed");
+    }
+
     size_t max_trans_bytes = 0;
     ESP_GOTO_ON_ERROR(spi_bus_get_max_transaction_len((spi_host_device_t)bus, &max_trans_bytes), err, TAG, "get spi max transaction len failed");
     spi_client_io->spi_trans_max_bytes = max_trans_bytes;
     ESP_LOGI(TAG, "spi max trans bytes: %d", spi_client_io->spi_trans_max_bytes);
 
+    if (spi_client_io->queued && spi_client_io->spi_trans_max_bytes < MAX_RECIEVE_SIZE)
+    {
+        ESP_LOGW(TAG, "spi max trans bytes too small for queued mode, falling back to blocking transfers");
+        spi_client_io->queued = false;
+    }
+
+    if (spi_client_io->queued)
+    {
+        spi_client_io->trans = (spi_transaction_t *)calloc(spi_client_io->queue_depth, sizeof(spi_transaction_t));
+        ESP_GOTO_ON_FALSE(spi_client_io->trans, ESP_ERR_NO_MEM, err, TAG, "no mem for spi transactions");
+        spi_client_io->staging = (uint8_t *)heap_caps_calloc(spi_client_io->queue_depth, PACKET_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        ESP_GOTO_ON_FALSE(spi_client_io->staging, ESP_ERR_NO_MEM, err, TAG, "no mem for spi staging");
+        for (int i = 0; i < 2; i++)
+        {
+            spi_client_io->rx_staging[i] = (uint8_t *)heap_caps_malloc(RX_STAGING_SIZE, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+            ESP_GOTO_ON_FALSE(spi_client_io->rx_staging[i], ESP_ERR_NO_MEM, err, TAG, "no mem for spi rx staging");
+        }
+        ESP_LOGI(TAG, "spi queued mode, depth: %d", spi_client_io->queue_depth);
+    }
+
     *ret_io = &spi_client_io->base;
     ESP_LOGD(TAG, "new spi sscma client io @%p", spi_client_io);
 
@@ -130,10 +187,19 @@ err:
             spi_bus_remove_device(spi_client_io->spi_dev);
             spi_bus_free((spi_host_device_t)bus);
         }
+        if (spi_client_io->sync)
+        {
+            gpio_isr_handler_remove(spi_client_io->sync_gpio_num);
+            vSemaphoreDelete(spi_client_io->sync);
+        }
         if (spi_client_io->lock)
         {
             vSemaphoreDelete(spi_client_io->lock);
         }
+        free(spi_client_io->trans);
+        free(spi_client_io->staging);
+        free(spi_client_io->rx_staging[0]);
+        free(spi_client_io->rx_staging[1]);
         free(spi_client_io);
     }
     return ret;
@@ -149,24 +215,236 @@ static esp_err_t client_io_spi_del(sscma_client_io_t *io)
     }
     spi_bus_remove_device(spi_client_io->spi_dev);
     spi_bus_free((spi_host_device_t)spi_client_io->spi_dev);
-    if (spi_client_io->sync_gpio_num >= 0)
+    if (spi_client_io->sync)
+    {
+        gpio_isr_handler_remove(spi_client_io->sync_gpio_num);
+        vSemaphoreDelete(spi_client_io->sync);
+    }
+    if (spi_client_io->sync_gpio_num >= 0 && spi_client_io->io_expander == NULL)
     {
         gpio_reset_pin(spi_client_io->sync_gpio_num);
     }
     ESP_LOGD(TAG, "del spi sscma client io @%p", spi_client_io);
 
+    free(spi_client_io->trans);
+    free(spi_client_io->staging);
+    free(spi_client_io->rx_staging[0]);
+    free(spi_client_io->rx_staging[1]);
     free(spi_client_io);
     return ret;
 }
 
-static esp_err_t client_io_spi_write(sscma_client_io_t *io, const void *data, size_t len)
+static void client_io_spi_log_throughput(const char *dir, size_t len, int64_t start)
+{
+    int64_t elapsed = esp_timer_get_time() - start;
+    if (len >= PACKET_SIZE && elapsed > 0)
+    {
+        ESP_LOGD(TAG, "%s %d bytes in %lld us (%lld B/s)", dir, len, elapsed, (int64_t)len * 1000000 / elapsed);
+    }
+}
+
+static void client_io_spi_wait_ready(sscma_client_io_spi_t *spi_client_io)
+{
+    // the device raises SYNC while it has data to send, sleep until the edge instead of a fixed delay
+    if (spi_client_io->sync)
+    {
+        // drop edges that belong to earlier transfers, a level that is already high needs no wait
+        xSemaphoreTake(spi_client_io->sync, 0);
+        if (gpio_get_level(spi_client_io->sync_gpio_num) == 0)
+        {
+            xSemaphoreTake(spi_client_io->sync, pdMS_TO_TICKS(spi_client_io->wait_delay));
+        }
+    }
+    else if (spi_client_io->wait_delay > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(spi_client_io->wait_delay));
+    }
+}
+
+static esp_err_t client_io_spi_write_queued(sscma_client_io_spi_t *spi_client_io, const uint8_t *data, size_t len)
+{
+    esp_err_t ret = ESP_OK;
+    spi_transaction_t *done = NULL;
+    size_t offset = 0;
+    size_t queued = 0;
+    size_t inflight = 0;
+
+    while (offset < len)
+    {
+        if (inflight == spi_client_io->queue_depth)
+        {
+            ret = spi_device_get_trans_result(spi_client_io->spi_dev, &done, portMAX_DELAY);
+            ESP_GOTO_ON_ERROR(ret, err, TAG, "spi get trans result failed");
+            inflight--;
+        }
+
+        size_t slot = queued % spi_client_io->queue_depth;
+        uint8_t *packet = spi_client_io->staging + slot * PACKET_SIZE;
+        uint16_t payload = len - offset > MAX_PL_LEN ? MAX_PL_LEN : len - offset;
+        packet[0] = FEATURE_TRANSPORT;
+        packet[1] = FEATURE_TRANSPORT_CMD_WRITE;
+        packet[2] = payload >> 8;
+        packet[3] = payload & 0xFF;
+        memcpy(packet + 4, data + offset, payload);
+        packet[4 + payload] = 0xFF;
+        packet[5 + payload] = 0xFF;
+
+        // the device takes one packet at a time, pace them like client_io_spi_transmit_packet() once the previous one is out
+        if (spi_client_io->wait_delay > 0)
+        {
+            while (inflight > 0)
+            {
+                ret = spi_device_get_trans_result(spi_client_io->spi_dev, &done, portMAX_DELAY);
+                ESP_GOTO_ON_ERROR(ret, err, TAG, "spi get trans result failed");
+                inflight--;
+            }
+            vTaskDelay(pdMS_TO_TICKS(spi_client_io->wait_delay));
+        }
+
+        spi_transaction_t *trans = &spi_client_io->trans[slot];
+        memset(trans, 0, sizeof(spi_transaction_t));
+        trans->length = PACKET_SIZE * 8;
+        trans->tx_buffer = packet;
+        trans->user = spi_client_io;
+        ret = spi_device_queue_trans(spi_client_io->spi_dev, trans, portMAX_DELAY);
+        ESP_GOTO_ON_ERROR(ret, err, TAG, "spi queue trans failed");
+
+        inflight++;
+        queued++;
+        offset += payload;
+    }
+
+err:
+    while (inflight > 0 && spi_device_get_trans_result(spi_client_io->spi_dev, &done, portMAX_DELAY) == ESP_OK)
+    {
+        inflight--;
+    }
+    return ret;
+}
+
+static esp_err_t client_io_spi_read_queued(sscma_client_io_spi_t *spi_client_io, uint8_t *data, size_t len)
+{
+    esp_err_t ret = ESP_OK;
+    spi_transaction_t *done = NULL;
+    size_t offset = 0;
+    size_t prev_offset = 0;
+    size_t prev_len = 0;
+    size_t inflight = 0;
+    int chunk = 0;
+
+    // chunk i is read into rx_staging[i % 2] while chunk i - 1 is copied out of the other buffer
+    while (offset < len || prev_len > 0)
+    {
+        while (inflight > 0)
+        {
+            ret = spi_device_get_trans_result(spi_client_io->spi_dev, &done, portMAX_DELAY);
+            ESP_GOTO_ON_ERROR(ret, err, TAG, "spi get trans result failed");
+            inflight--;
+        }
+
+        size_t chunk_len = len - offset > MAX_RECIEVE_SIZE ? MAX_RECIEVE_SIZE : len - offset;
+        if (chunk_len > 0)
+        {
+            uint8_t *packet = spi_client_io->staging + (chunk % 2) * PACKET_SIZE;
+            packet[0] = FEATURE_TRANSPORT;
+            packet[1] = FEATURE_TRANSPORT_CMD_READ;
+            packet[2] = chunk_len >> 8;
+            packet[3] = chunk_len & 0xFF;
+            packet[4] = 0xFF;
+            packet[5] = 0xFF;
+
+            spi_transaction_t *cmd = &spi_client_io->trans[(chunk % 2) * 2];
+            memset(cmd, 0, sizeof(spi_transaction_t));
+            cmd->length = PACKET_SIZE * 8;
+            cmd->tx_buffer = packet;
+            cmd->user = spi_client_io;
+
+            spi_transaction_t *rx = &spi_client_io->trans[(chunk % 2) * 2 + 1];
+            memset(rx, 0, sizeof(spi_transaction_t));
+            rx->length = chunk_len * 8;
+            rx->rxlength = chunk_len * 8;
+            rx->rx_buffer = spi_client_io->rx_staging[chunk % 2];
+            rx->user = spi_client_io;
+
+            ret = spi_device_queue_trans(spi_client_io->spi_dev, cmd, portMAX_DELAY);
+            ESP_GOTO_ON_ERROR(ret, err, TAG, "spi queue trans failed");
+            ret = spi_device_get_trans_result(spi_client_io->spi_dev, &done, portMAX_DELAY);
+            ESP_GOTO_ON_ERROR(ret, err, TAG, "spi get trans result failed");
+            // the device stages the chunk only after the command, gate the data phase on it
+            client_io_spi_wait_ready(spi_client_io);
+            ret = spi_device_queue_trans(spi_client_io->spi_dev, rx, portMAX_DELAY);
+            ESP_GOTO_ON_ERROR(ret, err, TAG, "spi queue trans failed");
+            inflight++;
+        }
+
+        if (prev_len > 0)
+        {
+            memcpy(data + prev_offset, spi_client_io->rx_staging[(chunk + 1) % 2], prev_len);
+        }
+
+        prev_offset = offset;
+        prev_len = chunk_len;
+        offset += chunk_len;
+        chunk++;
+    }
+
+err:
+    while (inflight > 0 && spi_device_get_trans_result(spi_client_io->spi_dev, &done, portMAX_DELAY) == ESP_OK)
+    {
+        inflight--;
+    }
+    return ret;
+}
+
+static esp_err_t client_io_spi_transmit_packet(sscma_client_io_spi_t *spi_client_io, uint16_t len)
 {
     esp_err_t ret = ESP_OK;
     spi_transaction_t spi_trans = {};
+    size_t trans_len = PACKET_SIZE;
+
+    // the payload is already in place behind the header
+    spi_client_io->buffer[0] = FEATURE_TRANSPORT;
+    spi_client_io->buffer[1] = FEATURE_TRANSPORT_CMD_WRITE;
+    spi_client_io->buffer[2] = len >> 8;
+    spi_client_io->buffer[3] = len & 0xFF;
+    spi_client_io->buffer[4 + len] = 0xFF;
+    spi_client_io->buffer[5 + len] = 0xFF;
+    spi_trans.tx_buffer = spi_client_io->buffer;
+    if (spi_client_io->wait_delay > 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(spi_client_io->wait_delay));
+    }
+    do
+    {
+        uint16_t chunk_size = trans_len;
+        if (chunk_size > spi_client_io->spi_trans_max_bytes)
+        {
+            chunk_size = spi_client_io->spi_trans_max_bytes;
+            spi_trans.flags |= SPI_TRANS_CS_KEEP_ACTIVE;
+        }
+        else
+        {
+            chunk_size = trans_len;
+            spi_trans.flags &= ~SPI_TRANS_CS_KEEP_ACTIVE;
+        }
+        spi_trans.length = chunk_size * 8;
+        spi_trans.rxlength = 0;
+        spi_trans.rx_buffer = NULL;
+        spi_trans.user = spi_client_io;
+        ret = spi_device_transmit(spi_client_io->spi_dev, &spi_trans);
+        ESP_RETURN_ON_ERROR(ret, TAG, "spi transmit (queue) failed");
+        spi_trans.tx_buffer = spi_trans.tx_buffer + chunk_size;
+        trans_len -= chunk_size;
+    }
+    while (trans_len > 0);
+
+    return ret;
+}
+
+static esp_err_t client_io_spi_write(sscma_client_io_t *io, const void *data, size_t len)
+{
+    esp_err_t ret = ESP_OK;
     sscma_client_io_spi_t *spi_client_io = __containerof(io, sscma_client_io_spi_t, base);
-    uint16_t packets = len / MAX_PL_LEN;
-    uint16_t remain = len % MAX_PL_LEN;
-    size_t trans_len = 0;
 
     xSemaphoreTake(spi_client_io->lock, portMAX_DELAY);
 
@@ -176,93 +454,59 @@ static esp_err_t client_io_spi_write(sscma_client_io_t *io, const void *data, si
         return ESP_FAIL;
     }
 
-    if (data)
+    if (data && spi_client_io->queued)
     {
-        for (uint16_t i = 0; i < packets; i++)
+        int64_t start = esp_timer_get_time();
+        ret = client_io_spi_write_queued(spi_client_io, data, len);
+        client_io_spi_log_throughput("write", len, start);
+    }
+    else if (data)
+    {
+        for (size_t pos = 0; pos < len && ret == ESP_OK; pos += MAX_PL_LEN)
         {
-            trans_len = PACKET_SIZE;
+            uint16_t pl_len = len - pos > MAX_PL_LEN ? MAX_PL_LEN : len - pos;
             memset(spi_client_io->buffer, 0, sizeof(spi_client_io->buffer));
-            spi_client_io->buffer[0] = FEATURE_TRANSPORT;
-            spi_client_io->buffer[1] = FEATURE_TRANSPORT_CMD_WRITE;
-            spi_client_io->buffer[2] = MAX_PL_LEN >> 8;
-            spi_client_io->buffer[3] = MAX_PL_LEN & 0xFF;
-            spi_client_io->buffer[4 + MAX_PL_LEN] = 0xFF;
-            spi_client_io->buffer[5 + MAX_PL_LEN] = 0xFF;
-            memcpy(spi_client_io->buffer + 4, data + i * MAX_PL_LEN, MAX_PL_LEN);
-            spi_trans.tx_buffer = spi_client_io->buffer;
-            if (spi_client_io->wait_delay > 0)
-            {
-                vTaskDelay(pdMS_TO_TICKS(spi_client_io->wait_delay));
-            }
-            do
-            {
-                uint16_t chunk_size = trans_len;
-                if (chunk_size > spi_client_io->spi_trans_max_bytes)
-                {
-                    chunk_size = spi_client_io->spi_trans_max_bytes;
-                    spi_trans.flags |= SPI_TRANS_CS_KEEP_ACTIVE;
-                }
-                else
-                {
-                    chunk_size = trans_len;
-                    spi_trans.flags &= ~SPI_TRANS_CS_KEEP_ACTIVE;
-                }
-                spi_trans.length = chunk_size * 8;
-                spi_trans.rxlength = 0;
-                spi_trans.rx_buffer = NULL;
-                spi_trans.user = spi_client_io;
-                ret = spi_device_transmit(spi_client_io->spi_dev, &spi_trans);
-                ESP_GOTO_ON_ERROR(ret, err, TAG, "spi transmit (queue) failed");
-                spi_trans.tx_buffer = spi_trans.tx_buffer + chunk_size;
-                trans_len -= chunk_size;
-            }
-            while (trans_len > 0);
+            memcpy(spi_client_io->buffer + HEADER_LEN, (const uint8_t *)data + pos, pl_len);
+            ret = client_io_spi_transmit_packet(spi_client_io, pl_len);
         }
+    }
 
-        if (remain)
+    spi_device_release_bus(spi_client_io->spi_dev);
+    xSemaphoreGive(spi_client_io->lock);
+    return ret;
+}
+
+static esp_err_t client_io_spi_write_chunked(sscma_client_io_t *io, sscma_client_io_fill_cb_t fill, void *user_ctx)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_io_spi_t *spi_client_io = __containerof(io, sscma_client_io_spi_t, base);
+    size_t pl_len = 0;
+
+    xSemaphoreTake(spi_client_io->lock, portMAX_DELAY);
+
+    if (spi_device_acquire_bus(spi_client_io->spi_dev, portMAX_DELAY) != ESP_OK)
+    {
+        xSemaphoreGive(spi_client_io->lock);
+        return ESP_FAIL;
+    }
+
+    // the producer writes each piece straight into the packet payload
+    do
+    {
+        memset(spi_client_io->buffer, 0, sizeof(spi_client_io->buffer));
+        pl_len = fill(spi_client_io->buffer + HEADER_LEN, MAX_PL_LEN, user_ctx);
+        if (pl_len == SSCMA_CLIENT_IO_FILL_ERROR)
         {
-            trans_len = PACKET_SIZE;
-            memset(spi_client_io->buffer, 0, sizeof(spi_client_io->buffer));
-            spi_client_io->buffer[0] = FEATURE_TRANSPORT;
-            spi_client_io->buffer[1] = FEATURE_TRANSPORT_CMD_WRITE;
-            spi_client_io->buffer[2] = remain >> 8;
-            spi_client_io->buffer[3] = remain & 0xFF;
-            spi_client_io->buffer[4 + remain] = 0xFF;
-            spi_client_io->buffer[5 + remain] = 0xFF;
-            memcpy(spi_client_io->buffer + 4, data + packets * MAX_PL_LEN, remain);
-            spi_trans.tx_buffer = spi_client_io->buffer;
-            if (spi_client_io->wait_delay > 0)
-            {
-                vTaskDelay(pdMS_TO_TICKS(spi_client_io->wait_delay));
-            }
-            do
-            {
-                uint16_t chunk_size = trans_len;
-                if (chunk_size > spi_client_io->spi_trans_max_bytes)
-                {
-                    chunk_size = spi_client_io->spi_trans_max_bytes;
-                    spi_trans.flags |= SPI_TRANS_CS_KEEP_ACTIVE;
-                }
-                else
-                {
-                    chunk_size = trans_len;
-                    spi_trans.flags &= ~SPI_TRANS_CS_KEEP_ACTIVE;
-                }
-                spi_trans.length = chunk_size * 8;
-                spi_trans.tx_buffer = spi_client_io->buffer;
-                spi_trans.rxlength = 0;
-                spi_trans.rx_buffer = NULL;
-                spi_trans.user = spi_client_io;
-                ret = spi_device_transmit(spi_client_io->spi_dev, &spi_trans);
-                ESP_GOTO_ON_ERROR(ret, err, TAG, "spi transmit (queue) failed");
-                spi_trans.tx_buffer = spi_trans.tx_buffer + chunk_size;
-                trans_len -= chunk_size;
-            }
-            while (trans_len > 0);
+            ESP_LOGE(TAG, "fill failed");
+            ret = ESP_FAIL;
+        }
+        else if (pl_len > 0)
+        {
+            ret = client_io_spi_transmit_packet(spi_client_io, pl_len);
         }
     }
+    while (pl_len > 0 && ret == ESP_OK);
 
-err:
     spi_device_release_bus(spi_client_io->spi_dev);
     xSemaphoreGive(spi_client_io->lock);
     return ret;
@@ -285,7 +529,13 @@ static esp_err_t client_io_spi_read(sscma_client_io_t *io, void *data, size_t le
         return ESP_FAIL;
     }
 
-    if (data)
+    if (data && spi_client_io->queued)
+    {
+        int64_t start = esp_timer_get_time();
+        ret = client_io_spi_read_queued(spi_client_io, data, len);
+        client_io_spi_log_throughput("read", len, start);
+    }
+    else if (data)
     {
         for (uint16_t i = 0; i < packets; i++)
         {
@@ -619,4 +869,38 @@ err:
     spi_device_release_bus(spi_client_io->spi_dev);
     xSemaphoreGive(spi_client_io->lock);
     return ret;
-}
\ No newline at end of file
+}
+
+static void client_io_spi_sync_isr(void *arg)
+{
+    sscma_client_io_spi_t *spi_client_io = (sscma_client_io_spi_t *)arg;
+    BaseType_t task_woken = pdFALSE;
+
+    xSemaphoreGiveFromISR(spi_client_io->sync, &task_woken);
+    if (spi_client_io->notify)
+    {
+        spi_client_io->notify(spi_client_io->notify_ctx);
+    }
+    if (task_woken == pdTRUE)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static esp_err_t client_io_spi_set_notify(sscma_client_io_t *io, sscma_client_io_notify_cb_t cb, void *user_ctx)
+{
+    sscma_client_io_spi_t *spi_client_io = __containerof(io, sscma_client_io_spi_t, base);
+
+    // a sync line behind an IO expander can only be signalled by the expander's own interrupt
+    if (spi_client_io->sync == NULL)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // the SYNC interrupt is already running, it picks up the callback on its next edge
+    spi_client_io->notify = NULL;
+    spi_client_io->notify_ctx = user_ctx;
+    spi_client_io->notify = cb;
+
+    return ESP_OK;
+}
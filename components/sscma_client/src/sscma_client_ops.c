@@ -1,5 +1,7 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/cdefs.h>
 #include "sdkconfig.h"
 #if CONFIG_SSCMA_ENABLE_DEBUG_LOG
@@ -13,13 +15,16 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
-#include "freertos/list.h"
+#include "freertos/semphr.h"
 #include "cJSON.h"
 #include "mbedtls/base64.h"
+#include "mbedtls/md.h"
 
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
 
 #include "sscma_client_types.h"
 #include "sscma_client_io.h"
@@ -44,6 +49,16 @@ const int error_map[] = {
 
 #define SSCMA_CLIENT_CMD_ERROR_CODE(err) (error_map[(err & 0x0F) > (CMD_EUNKNOWN - 1) ? (CMD_EUNKNOWN - 1) : (err & 0x0F)])
 
+#define SSCMA_CLIENT_READY_BIT        (1 << 0)
+#define SSCMA_CLIENT_READY_TIMEOUT_MS 3000 // used when the config leaves ready_timeout_ms at 0
+#define SSCMA_CLIENT_READY_PROBE_MS   50   // AT+STAT? probe period while waiting for INIT@STAT
+#define SSCMA_CLIENT_READY_GRACE_MS   200  // boot time after a reset pulse during which only INIT@STAT is awaited
+#define SSCMA_CLIENT_RESET_PULSE_MS   100
+
+#define SSCMA_CLIENT_GOVERNOR_MAX_DEPTH       1    // replies tolerated behind a streaming event before pacing
+#define SSCMA_CLIENT_GOVERNOR_CALM_FRAMES     8    // paced frames continuous streaming would keep up with before resuming it
+#define SSCMA_CLIENT_GOVERNOR_SHOT_TIMEOUT_MS 1000 // a single shot or command left unanswered this long is given up
+
 static inline void *__malloc(size_t sz)
 {
 #ifdef CONFIG_SSCMA_ALLOC_SMALL_SHORTTERM_MEM_EXTERNALLY
@@ -136,384 +151,1787 @@ static inline int get_int_from_array(cJSON *object, int index)
     return field->valueint;
 }
 
-void sscma_client_reply_clear(sscma_client_reply_t *reply)
+/**
+ * Minimal in-place JSON cursor. It only knows enough JSON to walk members and
+ * skip values, which is all that is needed to route a reply without cJSON.
+ */
+typedef struct
 {
-    if (reply->payload)
+    const char *p;
+    const char *end;
+    bool error;
+} json_cursor_t;
+
+static inline void json_skip_ws(json_cursor_t *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n'))
     {
-        cJSON_Delete(reply->payload);
-        reply->payload = NULL;
+        c->p++;
     }
-    if (reply->data)
+}
+
+static inline bool json_accept(json_cursor_t *c, char ch)
+{
+    json_skip_ws(c);
+    if (c->p < c->end && *c->p == ch)
     {
-        free(reply->data);
-        reply->data = NULL;
+        c->p++;
+        return true;
     }
-    reply->len = 0;
+    return false;
 }
 
-static void sscma_client_monitor(void *arg)
+static bool json_string(json_cursor_t *c, const char **str, size_t *len)
 {
-    sscma_client_handle_t client = (sscma_client_handle_t)arg;
-    sscma_client_reply_t reply;
-    while (true)
+    json_skip_ws(c);
+    if (c->p >= c->end || *c->p != '"')
+    {
+        c->error = true;
+        return false;
+    }
+    const char *start = ++c->p;
+    while (c->p < c->end && *c->p != '"')
+    {
+        c->p += *c->p == '\\' ? 2 : 1;
+    }
+    if (c->p >= c->end)
+    {
+        c->error = true;
+        return false;
+    }
+    if (str)
+    {
+        *str = start;
+        *len = c->p - start;
+    }
+    c->p++;
+    return true;
+}
+
+static bool json_int(json_cursor_t *c, int *value)
+{
+    bool neg = false;
+    int v = 0;
+
+    json_skip_ws(c);
+    if (c->p < c->end && *c->p == '-')
+    {
+        neg = true;
+        c->p++;
+    }
+    if (c->p >= c->end || *c->p < '0' || *c->p > '9')
+    {
+        c->error = true;
+        return false;
+    }
+    while (c->p < c->end && *c->p >= '0' && *c->p <= '9')
+    {
+        v = v * 10 + (*c->p++ - '0');
+    }
+    // fraction or exponent, truncated like cJSON valueint
+    while (c->p < c->end && (*c->p == '.' || *c->p == 'e' || *c->p == 'E' || *c->p == '+' || *c->p == '-' || (*c->p >= '0' && *c->p <= '9')))
     {
-        xQueueReceive(client->reply_queue, &reply, portMAX_DELAY);
+        c->p++;
+    }
+    *value = neg ? -v : v;
+    return true;
+}
+
+static bool json_skip_value(json_cursor_t *c)
+{
+    int depth = 0;
 
-        cJSON *type = cJSON_GetObjectItem(reply.payload, "type");
-        if (type == NULL)
+    json_skip_ws(c);
+    if (c->p >= c->end)
+    {
+        c->error = true;
+        return false;
+    }
+    if (*c->p == '"')
+    {
+        return json_string(c, NULL, NULL);
+    }
+    if (*c->p != '{' && *c->p != '[')
+    {
+        while (c->p < c->end && *c->p != ',' && *c->p != '}' && *c->p != ']')
         {
-            sscma_client_reply_clear(&reply);
-            continue;
+            c->p++;
         }
-
-        if (client->on_connect)
+        return true;
+    }
+    while (c->p < c->end)
+    {
+        char ch = *c->p;
+        if (ch == '"')
         {
-            cJSON *name = cJSON_GetObjectItem(reply.payload, "name");
-            if (name != NULL && strnstr(name->valuestring, EVENT_INIT, strlen(name->valuestring)) != NULL)
+            if (!json_string(c, NULL, NULL))
             {
-                client->on_connect(client, &reply, client->user_ctx);
-                sscma_client_reply_clear(&reply);
-                continue;
+                return false;
             }
+            continue;
         }
-
-        if (type->valueint == CMD_TYPE_EVENT)
+        c->p++;
+        if (ch == '{' || ch == '[')
         {
-            if (client->on_event)
-            {
-                client->on_event(client, &reply, client->user_ctx);
-            }
+            depth++;
         }
-        else if (type->valueint == CMD_TYPE_LOG)
+        else if ((ch == '}' || ch == ']') && --depth == 0)
         {
-            if (client->on_log)
-            {
-                client->on_log(client, &reply, client->user_ctx);
-            }
+            return true;
+        }
+    }
+    c->error = true;
+    return false;
+}
+
+/**
+ * Advance to the next member of the current object. Returns false once the
+ * closing brace is consumed, or on malformed input (c->error is set).
+ */
+static bool json_object_next(json_cursor_t *c, const char **key, size_t *key_len)
+{
+    json_accept(c, ',');
+    if (json_accept(c, '}'))
+    {
+        return false;
+    }
+    if (!json_string(c, key, key_len) || !json_accept(c, ':'))
+    {
+        c->error = true;
+        return false;
+    }
+    return true;
+}
+
+#define JSON_KEY_IS(key, key_len, lit) ((key_len) == sizeof(lit) - 1 && memcmp((key), (lit), sizeof(lit) - 1) == 0)
+
+/**
+ * Advance to the next element of the current array, the opening bracket must
+ * already be consumed. Returns false once the closing bracket is consumed.
+ */
+static bool json_array_next(json_cursor_t *c)
+{
+    json_accept(c, ',');
+    if (json_accept(c, ']'))
+    {
+        return false;
+    }
+    if (c->error || c->p >= c->end || *c->p == '}')
+    {
+        c->error = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read an array of integers, missing or non-numeric elements read as INT_MIN
+ * like get_int_from_array(). Returns the number of elements in the array.
+ */
+static int json_int_array(json_cursor_t *c, int *values, int max)
+{
+    int n = 0;
+
+    for (int i = 0; i < max; i++)
+    {
+        values[i] = INT_MIN;
+    }
+    if (!json_accept(c, '['))
+    {
+        json_skip_value(c);
+        return 0;
+    }
+    while (json_array_next(c))
+    {
+        int value = INT_MIN;
+        json_skip_ws(c);
+        if (*c->p == '-' || (*c->p >= '0' && *c->p <= '9'))
+        {
+            json_int(c, &value);
         }
         else
         {
-            if (client->on_response)
-            {
-                client->on_response(client, &reply, client->user_ctx);
-            }
+            json_skip_value(c);
+        }
+        if (n < max)
+        {
+            values[n] = value;
+        }
+        n++;
+        if (c->error)
+        {
+            break;
         }
-
-        sscma_client_reply_clear(&reply);
     }
+    return n;
 }
 
-static void sscma_client_process(void *arg)
+/**
+ * Locate type, name, code and the data.image span of a reply in place.
+ */
+static esp_err_t sscma_client_reply_index(sscma_client_reply_t *reply)
 {
-    size_t rlen = 0;
-    char *suffix = NULL;
-    char *prefix = NULL;
-    sscma_client_handle_t client = (sscma_client_handle_t)arg;
-    sscma_client_reply_t reply;
-    while (true)
+    json_cursor_t c = { .p = reply->data, .end = reply->data + reply->len, .error = false };
+    sscma_client_reply_index_t *index = &reply->index;
+    const char *key;
+    size_t key_len;
+
+    index->type = -1;
+    index->code = -1;
+    index->name = NULL;
+    index->name_len = 0;
+    index->image = NULL;
+    index->image_len = 0;
+
+    if (!json_accept(&c, '{'))
     {
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-        if (client->inited == false)
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    while (json_object_next(&c, &key, &key_len))
+    {
+        if (JSON_KEY_IS(key, key_len, "type"))
         {
-            continue;
+            json_int(&c, &index->type);
+        }
+        else if (JSON_KEY_IS(key, key_len, "code"))
+        {
+            json_int(&c, &index->code);
+        }
+        else if (JSON_KEY_IS(key, key_len, "name"))
+        {
+            json_string(&c, &index->name, &index->name_len);
         }
-        if (sscma_client_available(client, &rlen) == ESP_OK && rlen)
+        else if (JSON_KEY_IS(key, key_len, "data") && json_accept(&c, '{'))
         {
-            if (rlen + client->rx_buffer.pos > client->rx_buffer.len)
+            while (json_object_next(&c, &key, &key_len))
             {
-                rlen = client->rx_buffer.len - client->rx_buffer.pos;
-                if (rlen <= 0)
+                if (JSON_KEY_IS(key, key_len, "image"))
                 {
-                    ESP_LOGW(TAG, "rx buffer is full");
-                    client->rx_buffer.pos = 0;
-                    continue;
+                    json_string(&c, &index->image, &index->image_len);
                 }
-            }
-
-            sscma_client_read(client, client->rx_buffer.data + client->rx_buffer.pos, rlen);
-            client->rx_buffer.pos += rlen;
-
-            int new_pos = 0;
-            for (int i = 0; i < client->rx_buffer.pos; i++)
-            {
-                if (client->rx_buffer.data[i] != '\0')
+                else
                 {
-                    client->rx_buffer.data[new_pos++] = client->rx_buffer.data[i];
+                    json_skip_value(&c);
                 }
             }
-            client->rx_buffer.pos = new_pos;
+        }
+        else
+        {
+            json_skip_value(&c);
+        }
+        if (c.error)
+        {
+            break;
+        }
+    }
 
+    return c.error ? ESP_ERR_INVALID_RESPONSE : ESP_OK;
+}
 
-            client->rx_buffer.data[client->rx_buffer.pos] = 0;
-            while ((suffix = strnstr(client->rx_buffer.data, RESPONSE_SUFFIX, client->rx_buffer.pos)) != NULL)
-            {
-                if ((prefix = strnstr(client->rx_buffer.data, RESPONSE_PREFIX, suffix - client->rx_buffer.data)) != NULL)
-                {
-                    int len = suffix - prefix + RESPONSE_SUFFIX_LEN;
-                    reply.data = (char *)__malloc(len + 1);
-                    if (reply.data != NULL)
-                    {
-                        reply.len = len;
-                        memcpy(reply.data, prefix, len);
+static inline bool sscma_client_reply_name_is(const sscma_client_reply_t *reply, const char *name)
+{
+    return reply->index.name_len == strlen(name) && memcmp(reply->index.name, name, reply->index.name_len) == 0;
+}
 
-                        // delete this reply from rx buffer
-                        memmove(client->rx_buffer.data, suffix + RESPONSE_SUFFIX_LEN, client->rx_buffer.pos - (suffix - client->rx_buffer.data) - RESPONSE_PREFIX_LEN);
-                        client->rx_buffer.pos -= len;
+/**
+ * Payloads of pooled replies are built straight in the reply's arena by a
+ * small parser of our own, so cJSON and its global hooks stay untouched.
+ * Arena nodes are never freed one by one, the whole arena goes away with the
+ * pool slot. A payload that does not fit, nests too deep or holds \u escapes
+ * is parsed by cJSON on the heap instead.
+ */
+#define SSCMA_CLIENT_ARENA_ALIGN(x) (((x) + 7) & ~(size_t)7)
+#define SSCMA_CLIENT_ARENA_DEPTH    16
 
-                        reply.data[len] = 0;
-                        reply.payload = cJSON_Parse(reply.data);
-                        if (reply.payload != NULL)
-                        {
-                            cJSON *type = cJSON_GetObjectItem(reply.payload, "type");
-                            cJSON *name = cJSON_GetObjectItem(reply.payload, "name");
+static portMUX_TYPE s_arena_lock = portMUX_INITIALIZER_UNLOCKED; // guards the arena counters of the pools
 
-                            if (type == NULL || name == NULL)
-                            {
-                                ESP_LOGW(TAG, "invalid reply: %s", reply.data);
-                                sscma_client_reply_clear(&reply);
-                                continue;
-                            }
+typedef struct
+{
+    json_cursor_t c;
+    sscma_client_reply_t *reply;
+    uint32_t allocs;
+} arena_parser_t;
 
-                            if (client->on_connect)
-                            {
-                                if (name != NULL && strnstr(name->valuestring, EVENT_INIT, strlen(name->valuestring)) != NULL)
-                                {
-                                    xQueueReset(client->reply_queue); // reset reply queue
-                                    if (xQueueSend(client->reply_queue, &reply, 0) != pdTRUE)
-                                    {
-                                        sscma_client_reply_clear(&reply);
-                                    }
-                                    continue;
-                                }
-                            }
+static void *arena_alloc(arena_parser_t *parser, size_t size)
+{
+    sscma_client_reply_t *reply = parser->reply;
+    size_t aligned = SSCMA_CLIENT_ARENA_ALIGN(size);
 
-                            if (type->valueint == CMD_TYPE_RESPONSE)
-                            {
-                                sscma_client_request_t *first_req, *next_req = NULL;
-                                bool found = false;
-                                if (listCURRENT_LIST_LENGTH(client->request_list) > (UBaseType_t)0)
-                                {
-                                    listGET_OWNER_OF_NEXT_ENTRY(first_req, client->request_list);
-                                    do
-                                    {
-                                        listGET_OWNER_OF_NEXT_ENTRY(next_req, client->request_list);
-                                        if (strncmp(next_req->cmd, name->valuestring, sizeof(next_req->cmd)) == 0)
-                                        {
-                                            if (next_req->reply)
-                                            {
-                                                found = true;
-                                                if (xQueueSend(next_req->reply, &reply, 0) != pdTRUE)
-                                                {
-                                                    sscma_client_reply_clear(&reply); // discard this reply
-                                                }
-                                                break;
-                                            }
-                                        }
-                                    }
-                                    while (next_req != first_req);
-                                }
-                                if (!found)
-                                {
-                                    ESP_LOGW(TAG, "request not found: %s", name->valuestring);
-                                    if (client->on_response == NULL || xQueueSend(client->reply_queue, &reply, 0) != pdTRUE)
-                                    {
-                                        sscma_client_reply_clear(&reply); // discard this reply
-                                    }
-                                }
-                            }
-                            else if (type->valueint == CMD_TYPE_LOG)
-                            {
-                                cJSON *code = cJSON_GetObjectItem(reply.payload, "code");
-                                if (code == NULL)
-                                {
-                                    ESP_LOGW(TAG, "invalid log: %s", reply.data);
-                                    sscma_client_reply_clear(&reply);
-                                    continue;
-                                }
-                                if (code->valueint == CMD_EINVAL)
-                                { // unkown command
-                                    cJSON *data = cJSON_GetObjectItem(reply.payload, "data");
-                                    if (data == NULL)
-                                    {
-                                        ESP_LOGW(TAG, "invalid log: %s", reply.data);
-                                        sscma_client_reply_clear(&reply);
-                                        continue;
-                                    }
-                                    sscma_client_request_t *first_req, *next_req = NULL;
-                                    bool found = false;
-                                    if (listCURRENT_LIST_LENGTH(client->request_list) > (UBaseType_t)0)
-                                    {
-                                        listGET_OWNER_OF_NEXT_ENTRY(first_req, client->request_list);
-                                        do
-                                        {
-                                            listGET_OWNER_OF_NEXT_ENTRY(next_req, client->request_list);
-                                            if (strnstr(data->valuestring, next_req->cmd, strlen(data->valuestring)) != NULL)
-                                            {
-                                                if (next_req->reply)
-                                                {
-                                                    found = true;
-                                                    if (xQueueSend(next_req->reply, &reply, 0) != pdTRUE)
-                                                    {
-                                                        sscma_client_reply_clear(&reply); // discard this reply
-                                                    }
-                                                    break;
-                                                }
-                                            }
-                                        }
-                                        while (next_req != first_req);
-                                    }
-                                    if (!found)
-                                    {
-                                        ESP_LOGW(TAG, "request not found: %s", name->valuestring);
-                                        if (client->on_log == NULL || xQueueSend(client->reply_queue, &reply, 0) != pdTRUE)
-                                        {
-                                            sscma_client_reply_clear(&reply); // discard this reply
-                                        }
-                                    }
-                                }
-                                else
-                                {
-                                    if (client->on_log == NULL || xQueueSend(client->reply_queue, &reply, 0) != pdTRUE)
-                                    {
-                                        sscma_client_reply_clear(&reply); // discard this reply
-                                    }
-                                }
-                            }
-                            else if (type->valueint == CMD_TYPE_EVENT)
-                            {
-                                sscma_client_request_t *first_req, *next_req = NULL;
-                                bool found = false;
-                                // discard all the events while AT+BREAK is found
-                                if (listCURRENT_LIST_LENGTH(client->request_list) > (UBaseType_t)0)
-                                {
-                                    listGET_OWNER_OF_NEXT_ENTRY(first_req, client->request_list);
-                                    do
-                                    {
-                                        listGET_OWNER_OF_NEXT_ENTRY(next_req, client->request_list);
-                                        if (strnstr(next_req->cmd, CMD_AT_BREAK, strlen(next_req->cmd)) != NULL)
-                                        {
-                                            found = true;
-                                            break;
-                                        }
-                                    }
-                                    while (next_req != first_req);
-                                }
-                                if (client->on_event == NULL || found || xQueueSend(client->reply_queue, &reply, 0) != pdTRUE)
-                                {
-                                    sscma_client_reply_clear(&reply); // discard this reply
-                                }
-                            }
-                            else
-                            {
-                                ESP_LOGW(TAG, "Invalid reply: %s", reply.data);
-                                sscma_client_reply_clear(&reply);
-                            }
-                        }
-                        else
-                        {
-                            ESP_LOGW(TAG, "Invalid reply: %s cc", reply.data);
-                            sscma_client_reply_clear(&reply);
-                        }
-                    }else{
-                        printf("reply.data == NULL\r\n");
-                        client->rx_buffer.pos -= len;
-                    }
-                }
-                else
-                {
-                    // discard this reply
-                    ESP_LOGW(TAG, "Invalid reply: %d/%d", client->rx_buffer.pos, client->rx_buffer.len);
-                    memmove(client->rx_buffer.data, suffix + RESPONSE_SUFFIX_LEN, client->rx_buffer.pos - (suffix - client->rx_buffer.data) - RESPONSE_PREFIX_LEN);
-                    client->rx_buffer.pos -= suffix - client->rx_buffer.data + RESPONSE_SUFFIX_LEN;
-                    client->rx_buffer.data[client->rx_buffer.pos] = 0;
-                }
-            }
-        }
+    if (reply->arena.size - reply->arena.used < aligned)
+    {
+        parser->c.error = true;
+        return NULL;
     }
+    void *ptr = reply->arena.base + reply->arena.used;
+    reply->arena.used += aligned;
+    parser->allocs++;
+
+    return ptr;
 }
 
-esp_err_t sscma_client_new(const sscma_client_io_handle_t io, const sscma_client_config_t *config, sscma_client_handle_t *ret_client)
+static char *arena_string(arena_parser_t *parser)
 {
-#if CONFIG_SSCMA_ENABLE_DEBUG_LOG
-    esp_log_level_set(TAG, ESP_LOG_DEBUG);
-#endif
-    esp_err_t ret = ESP_OK;
-    BaseType_t res;
-    sscma_client_handle_t client = NULL;
-    ESP_GOTO_ON_FALSE(io && config && ret_client, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
-    client = (sscma_client_handle_t)malloc(sizeof(struct sscma_client_t));
-    memset(client, 0, sizeof(struct sscma_client_t));
-    ESP_GOTO_ON_FALSE(client, ESP_ERR_NO_MEM, err, TAG, "no mem for sscma client");
-    client->io = io;
-    client->inited = false;
-    client->flasher = NULL;
+    const char *str;
+    size_t len;
+    size_t n = 0;
 
-    if (config->reset_gpio_num >= 0)
+    if (!json_string(&parser->c, &str, &len))
     {
-        if (config->flags.reset_use_expander)
+        return NULL;
+    }
+    char *out = arena_alloc(parser, len + 1);
+    if (out == NULL)
+    {
+        return NULL;
+    }
+    // the base64 image is most of a reply and never escaped
+    if (memchr(str, '\\', len) == NULL)
+    {
+        memcpy(out, str, len);
+        out[len] = '\0';
+        return out;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (str[i] != '\\')
         {
-            client->io_expander = config->io_expander;
-            ESP_GOTO_ON_FALSE(client->io_expander, ESP_ERR_INVALID_ARG, err, TAG, "invalid io expander");
-            ESP_GOTO_ON_ERROR(esp_io_expander_set_dir(client->io_expander, config->reset_gpio_num, IO_EXPANDER_OUTPUT), err, TAG, "set GPIO direction failed");
+            out[n++] = str[i];
+            continue;
         }
-        else
+        switch (str[++i])
         {
-            gpio_config_t io_conf = {
-                .mode = GPIO_MODE_INPUT,
-                .pin_bit_mask = 1ULL << config->reset_gpio_num,
-            };
-            ESP_GOTO_ON_ERROR(gpio_config(&io_conf), err, TAG, "configure GPIO for RST line failed");
+        case 'b':
+            out[n++] = '\b';
+            break;
+        case 'f':
+            out[n++] = '\f';
+            break;
+        case 'n':
+            out[n++] = '\n';
+            break;
+        case 'r':
+            out[n++] = '\r';
+            break;
+        case 't':
+            out[n++] = '\t';
+            break;
+        case '"':
+        case '\\':
+        case '/':
+            out[n++] = str[i];
+            break;
+        default:
+            // \u needs UTF-16 to UTF-8, left to cJSON
+            parser->c.error = true;
+            return NULL;
         }
     }
+    out[n] = '\0';
 
-    client->rx_buffer.data = (char *)malloc(config->rx_buffer_size);
-    ESP_GOTO_ON_FALSE(client->rx_buffer.data, ESP_ERR_NO_MEM, err, TAG, "no mem for rx buffer");
-    client->rx_buffer.pos = 0;
-    client->rx_buffer.len = config->rx_buffer_size;
-
-    client->tx_buffer.data = (char *)malloc(config->tx_buffer_size);
-    ESP_GOTO_ON_FALSE(client->tx_buffer.data, ESP_ERR_NO_MEM, err, TAG, "no mem for tx buffer");
-    client->tx_buffer.pos = 0;
-    client->tx_buffer.len = config->tx_buffer_size;
-
-    client->reset_gpio_num = config->reset_gpio_num;
-    client->reset_level = config->flags.reset_active_high;
-
-    client->user_ctx = config->user_ctx;
-
-    client->request_list = (List_t *)malloc(sizeof(List_t));
-    ESP_GOTO_ON_FALSE(client->request_list, ESP_ERR_NO_MEM, err, TAG, "no mem for request list");
-
-    client->reply_queue = xQueueCreate(config->event_queue_size, sizeof(sscma_client_reply_t));
-    ESP_GOTO_ON_FALSE(client->reply_queue, ESP_ERR_NO_MEM, err, TAG, "no mem for reply queue");
+    return out;
+}
 
-    vListInitialise(client->request_list);
+/**
+ * Parse one value into cJSON nodes from the arena, with the node layout and
+ * values cJSON_Parse() gives. Returns NULL with c.error set on failure.
+ */
+static cJSON *arena_value(arena_parser_t *parser, int depth)
+{
+    json_cursor_t *c = &parser->c;
 
-#ifdef CONFIG_SSCMA_PROCESS_TASK_STACK_ALLOC_EXTERNAL
-    client->process_task.task = heap_caps_calloc(1, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    ESP_GOTO_ON_FALSE(client->process_task.task, ESP_ERR_NO_MEM, err, TAG, "no mem for sscma client process task");
-    client->process_task.stack = heap_caps_calloc(1, config->process_task_stack * sizeof(StackType_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    ESP_GOTO_ON_FALSE(client->process_task.stack, ESP_ERR_NO_MEM, err, TAG, "no mem for sscma client process task stack");
-    if (config->process_task_affinity < 0)
-    {
-        client->process_task.handle
-            = xTaskCreateStatic(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority, client->process_task.stack, client->process_task.task);
-    }
-    else
+    json_skip_ws(c);
+    if (depth > SSCMA_CLIENT_ARENA_DEPTH || c->p >= c->end)
     {
-        client->process_task.handle = xTaskCreateStaticPinnedToCore(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority,
-            client->process_task.stack, client->process_task.task, config->process_task_affinity);
+        c->error = true;
+        return NULL;
     }
-    ESP_GOTO_ON_FALSE(client->process_task.handle, ESP_FAIL, err, TAG, "create process task failed");
-#else
-    if (config->process_task_affinity < 0)
+    cJSON *item = arena_alloc(parser, sizeof(cJSON));
+    if (item == NULL)
     {
-        res = xTaskCreate(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority, &client->process_task.handle);
+        return NULL;
     }
-    else
+    memset(item, 0, sizeof(cJSON));
+
+    if (*c->p == '{' || *c->p == '[')
     {
-        res = xTaskCreatePinnedToCore(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority, &client->process_task.handle,
-            config->process_task_affinity);
+        bool object = *c->p++ == '{';
+        char close = object ? '}' : ']';
+        cJSON *tail = NULL;
+
+        item->type = object ? cJSON_Object : cJSON_Array;
+        if (json_accept(c, close))
+        {
+            return item;
+        }
+        do
+        {
+            char *key = NULL;
+            if (object && ((key = arena_string(parser)) == NULL || !json_accept(c, ':')))
+            {
+                c->error = true;
+                return NULL;
+            }
+            cJSON *child = arena_value(parser, depth + 1);
+            if (child == NULL)
+            {
+                return NULL;
+            }
+            child->string = key;
+            if (tail != NULL)
+            {
+                tail->next = child;
+                child->prev = tail;
+            }
+            else
+            {
+                item->child = child;
+            }
+            tail = child;
+        } while (json_accept(c, ','));
+        if (!json_accept(c, close))
+        {
+            c->error = true;
+            return NULL;
+        }
+        // cJSON keeps the last element in the prev of the first one
+        item->child->prev = tail;
+    }
+    else if (*c->p == '"')
+    {
+        item->type = cJSON_String;
+        item->valuestring = arena_string(parser);
+        if (item->valuestring == NULL)
+        {
+            return NULL;
+        }
+    }
+    else if (*c->p == '-' || (*c->p >= '0' && *c->p <= '9'))
+    {
+        // data is NUL terminated, strtod stops at the delimiter
+        char *end = NULL;
+        double number = strtod(c->p, &end);
+        if (end == c->p || end > c->end)
+        {
+            c->error = true;
+            return NULL;
+        }
+        c->p = end;
+        item->type = cJSON_Number;
+        item->valuedouble = number;
+        item->valueint = number >= INT_MAX ? INT_MAX : number <= (double)INT_MIN ? INT_MIN : (int)number;
+    }
+    else if (c->end - c->p >= 4 && memcmp(c->p, "true", 4) == 0)
+    {
+        c->p += 4;
+        item->type = cJSON_True;
+        item->valueint = 1;
+    }
+    else if (c->end - c->p >= 5 && memcmp(c->p, "false", 5) == 0)
+    {
+        c->p += 5;
+        item->type = cJSON_False;
+    }
+    else if (c->end - c->p >= 4 && memcmp(c->p, "null", 4) == 0)
+    {
+        c->p += 4;
+        item->type = cJSON_NULL;
+    }
+    else
+    {
+        c->error = true;
+        return NULL;
+    }
+
+    return item;
+}
+
+cJSON *sscma_client_reply_get_payload(const sscma_client_reply_t *reply)
+{
+    // the payload is cached in the reply and released by sscma_client_reply_clear()
+    sscma_client_reply_t *mutable_reply = (sscma_client_reply_t *)reply;
+    if (mutable_reply->payload == NULL && mutable_reply->data != NULL)
+    {
+        if (mutable_reply->arena.size > 0)
+        {
+            arena_parser_t parser = {
+                .c = { .p = mutable_reply->data, .end = mutable_reply->data + mutable_reply->len, .error = false },
+                .reply = mutable_reply,
+            };
+            mutable_reply->payload = arena_value(&parser, 0);
+
+            taskENTER_CRITICAL(&s_arena_lock);
+            if (mutable_reply->payload != NULL)
+            {
+                mutable_reply->pool->arena_allocs += parser.allocs;
+            }
+            else
+            {
+                mutable_reply->pool->arena_misses++;
+            }
+            taskEXIT_CRITICAL(&s_arena_lock);
+
+            if (mutable_reply->payload == NULL)
+            {
+                // the heap tree below is deleted by sscma_client_reply_clear()
+                mutable_reply->arena.used = 0;
+                mutable_reply->arena.fallbacks++;
+            }
+        }
+        if (mutable_reply->payload == NULL)
+        {
+            mutable_reply->payload = cJSON_Parse(mutable_reply->data);
+        }
+    }
+    return mutable_reply->payload;
+}
+
+static esp_err_t sscma_client_reply_pool_init(sscma_client_reply_pool_t *pool, size_t slots, size_t slot_size, size_t arena_size)
+{
+    pool->slots = slots;
+    pool->arena_size = slots > 0 ? SSCMA_CLIENT_ARENA_ALIGN(arena_size) : 0;
+    pool->slot_size = SSCMA_CLIENT_ARENA_ALIGN(slot_size) + pool->arena_size;
+    if (slots == 0)
+    {
+        return ESP_OK;
+    }
+
+    pool->base = heap_caps_malloc_prefer(slots * pool->slot_size, 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_DEFAULT);
+    ESP_RETURN_ON_FALSE(pool->base, ESP_ERR_NO_MEM, TAG, "no mem for reply pool");
+    pool->free_list = xQueueCreate(slots, sizeof(uint16_t));
+    ESP_RETURN_ON_FALSE(pool->free_list, ESP_ERR_NO_MEM, TAG, "no mem for reply pool free list");
+    for (uint16_t i = 0; i < slots; i++)
+    {
+        xQueueSend(pool->free_list, &i, 0);
+    }
+
+    return ESP_OK;
+}
+
+static void sscma_client_reply_pool_deinit(sscma_client_reply_pool_t *pool)
+{
+    pool->arena_size = 0;
+    if (pool->free_list)
+    {
+        vQueueDelete(pool->free_list);
+        pool->free_list = NULL;
+    }
+    if (pool->base)
+    {
+        free(pool->base);
+        pool->base = NULL;
+    }
+    pool->slots = 0;
+}
+
+/**
+ * Take a buffer of at least `size` bytes for a reply, from the pool when a
+ * slot is free and large enough, otherwise from the heap.
+ */
+static char *sscma_client_reply_alloc(sscma_client_reply_pool_t *pool, size_t size, sscma_client_reply_pool_t **owner)
+{
+    uint16_t slot;
+
+    *owner = NULL;
+    if (pool->slots == 0)
+    {
+        return (char *)__malloc(size);
+    }
+
+    if (size <= pool->slot_size && xQueueReceive(pool->free_list, &slot, 0) == pdTRUE)
+    {
+        size_t in_use = pool->slots - uxQueueMessagesWaiting(pool->free_list);
+        if (in_use > pool->high_water)
+        {
+            pool->high_water = in_use;
+        }
+        *owner = pool;
+        return pool->base + slot * pool->slot_size;
+    }
+
+    pool->fallbacks++;
+    return (char *)__malloc(size);
+}
+
+void sscma_client_reply_clear(sscma_client_reply_t *reply)
+{
+    if (reply->payload)
+    {
+        // a tree living entirely in the arena is released with the slot
+        if (reply->arena.size == 0 || reply->arena.fallbacks > 0)
+        {
+            cJSON_Delete(reply->payload);
+        }
+        reply->payload = NULL;
+    }
+    reply->arena.base = NULL;
+    reply->arena.size = 0;
+    reply->arena.used = 0;
+    reply->arena.fallbacks = 0;
+    if (reply->data)
+    {
+        if (reply->pool)
+        {
+            uint16_t slot = (reply->data - reply->pool->base) / reply->pool->slot_size;
+            xQueueSend(reply->pool->free_list, &slot, 0);
+        }
+        else
+        {
+            free(reply->data);
+        }
+        reply->data = NULL;
+    }
+    reply->pool = NULL;
+    reply->len = 0;
+}
+
+esp_err_t sscma_client_get_reply_pool_stats(sscma_client_handle_t client, sscma_client_reply_pool_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(client && stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    stats->slots = client->reply_pool.slots;
+    stats->slot_size = client->reply_pool.slot_size;
+    stats->in_use = client->reply_pool.slots ? client->reply_pool.slots - uxQueueMessagesWaiting(client->reply_pool.free_list) : 0;
+    stats->high_water = client->reply_pool.high_water;
+    stats->fallbacks = client->reply_pool.fallbacks;
+    stats->arena_allocs = client->reply_pool.arena_allocs;
+    stats->arena_misses = client->reply_pool.arena_misses;
+
+    return ESP_OK;
+}
+
+#if CONFIG_SSCMA_ENABLE_STATS
+static inline int64_t sscma_client_stats_now(void)
+{
+    return esp_timer_get_time();
+}
+
+static void sscma_client_stats_trace(sscma_client_handle_t client, sscma_client_trace_type_t type, int reply_type, const char *name, size_t name_len, uint32_t value)
+{
+    if (client->stats.trace)
+    {
+        sscma_client_trace_t trace = {
+            .type = type,
+            .reply_type = reply_type,
+            .name = name,
+            .name_len = name_len,
+            .value = value,
+        };
+        client->stats.trace(client, &trace, client->stats.trace_ctx);
+    }
+}
+
+static void sscma_client_stats_io(sscma_client_handle_t client, bool write, size_t len)
+{
+    taskENTER_CRITICAL(&client->stats.lock);
+    if (write)
+    {
+        client->stats.counters.bytes_written += len;
+    }
+    else
+    {
+        client->stats.counters.bytes_read += len;
+    }
+    taskEXIT_CRITICAL(&client->stats.lock);
+}
+
+static void sscma_client_stats_frame(sscma_client_handle_t client, const sscma_client_reply_t *reply, bool valid)
+{
+    taskENTER_CRITICAL(&client->stats.lock);
+    if (valid)
+    {
+        client->stats.counters.frames_parsed++;
+    }
+    else
+    {
+        client->stats.counters.frames_invalid++;
+    }
+    taskEXIT_CRITICAL(&client->stats.lock);
+    sscma_client_stats_trace(client, valid ? SSCMA_CLIENT_TRACE_FRAME : SSCMA_CLIENT_TRACE_INVALID, reply ? reply->index.type : -1, reply ? reply->index.name : NULL, reply ? reply->index.name_len : 0,
+        reply ? reply->len : 0);
+}
+
+static void sscma_client_stats_queued(sscma_client_handle_t client, const sscma_client_reply_t *reply, bool queued)
+{
+    UBaseType_t waiting = uxQueueMessagesWaiting(client->reply_queue);
+    taskENTER_CRITICAL(&client->stats.lock);
+    if (!queued)
+    {
+        client->stats.counters.replies_dropped++;
+    }
+    else if (waiting > client->stats.counters.queue_high_water)
+    {
+        client->stats.counters.queue_high_water = waiting;
+    }
+    taskEXIT_CRITICAL(&client->stats.lock);
+    if (!queued)
+    {
+        sscma_client_stats_trace(client, SSCMA_CLIENT_TRACE_DROP, reply->index.type, reply->index.name, reply->index.name_len, 0);
+    }
+}
+
+static void sscma_client_stats_parse(sscma_client_handle_t client, const sscma_client_reply_t *reply, int64_t start)
+{
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    taskENTER_CRITICAL(&client->stats.lock);
+    client->stats.counters.parse_count++;
+    client->stats.counters.parse_time_us += elapsed;
+    taskEXIT_CRITICAL(&client->stats.lock);
+    sscma_client_stats_trace(client, SSCMA_CLIENT_TRACE_PARSE, reply->index.type, reply->index.name, reply->index.name_len, elapsed);
+}
+
+static void sscma_client_stats_callback(sscma_client_handle_t client, const sscma_client_reply_t *reply, int64_t start)
+{
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+    int type = reply->index.type;
+    if (type < CMD_TYPE_RESPONSE || type > CMD_TYPE_LOG)
+    {
+        return;
+    }
+    taskENTER_CRITICAL(&client->stats.lock);
+    client->stats.counters.callbacks[type].count++;
+    client->stats.counters.callbacks[type].time_us += elapsed;
+    if (elapsed > client->stats.counters.callbacks[type].max_us)
+    {
+        client->stats.counters.callbacks[type].max_us = elapsed;
+    }
+    taskEXIT_CRITICAL(&client->stats.lock);
+    sscma_client_stats_trace(client, SSCMA_CLIENT_TRACE_CALLBACK, type, reply->index.name, reply->index.name_len, elapsed);
+}
+
+static void sscma_client_stats_request(sscma_client_handle_t client, const sscma_client_request_t *request)
+{
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - request->start_us);
+    uint32_t ms = elapsed / 1000;
+    int bucket = 0;
+    while (ms > 1 && bucket < SSCMA_CLIENT_STATS_LATENCY_BUCKETS - 1)
+    {
+        ms >>= 1;
+        bucket++;
+    }
+    taskENTER_CRITICAL(&client->stats.lock);
+    for (int i = 0; i < SSCMA_CLIENT_STATS_COMMANDS; i++)
+    {
+        char *cmd = client->stats.counters.requests[i].cmd;
+        if (cmd[0] == '\0')
+        {
+            // same size as request->cmd, which is always terminated
+            size_t len = strnlen(request->cmd, SSCMA_CLIENT_CMD_NAME_LEN - 1);
+            memcpy(cmd, request->cmd, len);
+            cmd[len] = '\0';
+        }
+        if (strcmp(cmd, request->cmd) == 0)
+        {
+            client->stats.counters.requests[i].count++;
+            client->stats.counters.requests[i].latency[bucket]++;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&client->stats.lock);
+    sscma_client_stats_trace(client, SSCMA_CLIENT_TRACE_REQUEST, CMD_TYPE_RESPONSE, request->cmd, strlen(request->cmd), elapsed);
+}
+#else
+static inline int64_t sscma_client_stats_now(void)
+{
+    return 0;
+}
+
+static inline void sscma_client_stats_io(sscma_client_handle_t client, bool write, size_t len)
+{
+}
+
+static inline void sscma_client_stats_frame(sscma_client_handle_t client, const sscma_client_reply_t *reply, bool valid)
+{
+}
+
+static inline void sscma_client_stats_queued(sscma_client_handle_t client, const sscma_client_reply_t *reply, bool queued)
+{
+}
+
+static inline void sscma_client_stats_parse(sscma_client_handle_t client, const sscma_client_reply_t *reply, int64_t start)
+{
+}
+
+static inline void sscma_client_stats_callback(sscma_client_handle_t client, const sscma_client_reply_t *reply, int64_t start)
+{
+}
+
+static inline void sscma_client_stats_request(sscma_client_handle_t client, const sscma_client_request_t *request)
+{
+}
+#endif
+
+esp_err_t sscma_client_get_stats(sscma_client_handle_t client, sscma_client_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(client && stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+#if CONFIG_SSCMA_ENABLE_STATS
+    taskENTER_CRITICAL(&client->stats.lock);
+    *stats = client->stats.counters;
+    taskEXIT_CRITICAL(&client->stats.lock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t sscma_client_reset_stats(sscma_client_handle_t client)
+{
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+#if CONFIG_SSCMA_ENABLE_STATS
+    taskENTER_CRITICAL(&client->stats.lock);
+    memset(&client->stats.counters, 0, sizeof(client->stats.counters));
+    taskEXIT_CRITICAL(&client->stats.lock);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t sscma_client_register_trace(sscma_client_handle_t client, sscma_client_trace_cb_t trace, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+#if CONFIG_SSCMA_ENABLE_STATS
+    client->stats.trace = NULL;
+    client->stats.trace_ctx = user_ctx;
+    client->stats.trace = trace;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t sscma_client_get_event_stats(sscma_client_handle_t client, sscma_client_event_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(client && stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    stats->invoke_replaced = client->events.replaced[0];
+    stats->sample_replaced = client->events.replaced[1];
+    stats->queue_dropped = client->events.dropped;
+
+    return ESP_OK;
+}
+
+static void sscma_client_request_retire(sscma_client_handle_t client, sscma_client_request_t *request);
+
+static void sscma_client_governor_send(sscma_client_handle_t client, const char *cmd)
+{
+    sscma_client_future_t future = NULL;
+
+    // the monitor task never waits for an answer, one that is still outstanding is given up
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    if (client->governor.pending != NULL)
+    {
+        sscma_client_request_retire(client, client->governor.pending);
+        client->governor.pending = NULL;
+    }
+    xSemaphoreGive(client->requests.lock);
+
+    if (sscma_client_request_async(client, cmd, &future) == ESP_OK)
+    {
+        xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+        if (future->pending)
+        {
+            future->detached = true; // the process task retires it once answered
+            client->governor.pending = future;
+        }
+        else
+        {
+            sscma_client_request_retire(client, future);
+        }
+        client->governor.sent_us = esp_timer_get_time();
+        xSemaphoreGive(client->requests.lock);
+    }
+}
+
+static void sscma_client_governor_frame(sscma_client_handle_t client, int64_t arrival, int64_t busy)
+{
+    char cmd[64] = { 0 };
+    uint32_t replaced = client->events.replaced[0] + client->events.replaced[1];
+    UBaseType_t depth = uxQueueMessagesWaiting(client->reply_queue);
+
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    if (client->task[0] == '\0' || client->still.frame != NULL)
+    {
+        xSemaphoreGive(client->requests.lock);
+        return;
+    }
+
+    client->governor.busy_us = client->governor.busy_us > 0 ? (client->governor.busy_us * 7 + busy) / 8 : busy;
+
+    if (client->governor.paced)
+    {
+        int64_t latency = arrival - client->governor.shot_us;
+        client->governor.latency_us = client->governor.latency_us > 0 ? (client->governor.latency_us * 7 + latency) / 8 : latency;
+        client->governor.want_shot = true;
+        // the device alone is slower than the target and the consumer has room to spare
+        if (client->governor.latency_us >= client->governor.period_us && client->governor.busy_us * 2 < client->governor.latency_us)
+        {
+            client->governor.calm++;
+        }
+        else
+        {
+            client->governor.calm = 0;
+        }
+        if (client->governor.calm >= SSCMA_CLIENT_GOVERNOR_CALM_FRAMES)
+        {
+            client->governor.paced = false;
+            client->governor.want_shot = false;
+            client->governor.last_us = 0;
+            client->governor.interval_us = 0;
+            snprintf(cmd, sizeof(cmd), "%s", client->task);
+        }
+    }
+    else
+    {
+        if (client->governor.last_us > 0)
+        {
+            int64_t interval = arrival - client->governor.last_us;
+            client->governor.interval_us = client->governor.interval_us > 0 ? (client->governor.interval_us * 7 + interval) / 8 : interval;
+        }
+        client->governor.last_us = arrival;
+
+        bool behind = depth > SSCMA_CLIENT_GOVERNOR_MAX_DEPTH || replaced != client->governor.replaced || client->governor.busy_us > client->governor.period_us;
+        bool ahead = client->governor.interval_us > 0 && client->governor.interval_us * 4 < client->governor.period_us * 3;
+        if (behind || ahead)
+        {
+            // the first single shot replaces the continuous task on the device
+            client->governor.paced = true;
+            client->governor.want_shot = true;
+            client->governor.calm = 0;
+            client->governor.latency_us = 0;
+            client->governor.shot_us = 0;
+        }
+    }
+    client->governor.replaced = replaced;
+    xSemaphoreGive(client->requests.lock);
+
+    if (cmd[0] != '\0')
+    {
+        ESP_LOGD(TAG, "governor: resume %s", cmd);
+        sscma_client_governor_send(client, cmd);
+    }
+}
+
+static TickType_t sscma_client_governor_step(sscma_client_handle_t client)
+{
+    char cmd[64] = { 0 };
+    int64_t now = 0;
+    int64_t wait = -1;
+    bool outstanding = false;
+
+    if (client->governor.period_us == 0)
+    {
+        return portMAX_DELAY;
+    }
+
+    now = esp_timer_get_time();
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    if (client->governor.pending != NULL && now - client->governor.sent_us > SSCMA_CLIENT_GOVERNOR_SHOT_TIMEOUT_MS * 1000)
+    {
+        sscma_client_request_retire(client, client->governor.pending);
+        client->governor.pending = NULL;
+    }
+    outstanding = client->governor.pending != NULL;
+    if (client->governor.paced && client->task[0] != '\0' && client->still.frame == NULL)
+    {
+        if (!client->governor.want_shot && now - client->governor.shot_us > SSCMA_CLIENT_GOVERNOR_SHOT_TIMEOUT_MS * 1000)
+        {
+            client->governor.want_shot = true; // the frame got lost, ask again
+        }
+        if (client->governor.want_shot)
+        {
+            wait = client->governor.shot_us + client->governor.period_us - now;
+            if (wait <= 0)
+            {
+                client->governor.want_shot = false;
+                client->governor.shot_us = now;
+                snprintf(cmd, sizeof(cmd), "%s", client->governor.shot);
+                wait = SSCMA_CLIENT_GOVERNOR_SHOT_TIMEOUT_MS * 1000;
+            }
+        }
+        else
+        {
+            wait = client->governor.shot_us + SSCMA_CLIENT_GOVERNOR_SHOT_TIMEOUT_MS * 1000 - now;
+        }
+    }
+    xSemaphoreGive(client->requests.lock);
+
+    if (cmd[0] != '\0')
+    {
+        sscma_client_governor_send(client, cmd);
+    }
+
+    if (wait < 0)
+    {
+        return outstanding ? pdMS_TO_TICKS(SSCMA_CLIENT_GOVERNOR_SHOT_TIMEOUT_MS) : portMAX_DELAY;
+    }
+
+    return pdMS_TO_TICKS(wait / 1000) + 1;
+}
+
+static void sscma_client_deliver(sscma_client_handle_t client, sscma_client_reply_t *reply)
+{
+    if (reply->index.type < 0)
+    {
+        sscma_client_reply_clear(reply);
+        return;
+    }
+
+    if (client->on_connect)
+    {
+        if (reply->index.name != NULL && strnstr(reply->index.name, EVENT_INIT, reply->index.name_len) != NULL)
+        {
+            client->on_connect(client, reply, client->user_ctx);
+            sscma_client_reply_clear(reply);
+            return;
+        }
+    }
+
+    int64_t start = sscma_client_stats_now();
+
+    if (reply->index.type == CMD_TYPE_EVENT)
+    {
+        if (client->on_event)
+        {
+            int64_t begin = esp_timer_get_time();
+            client->on_event(client, reply, client->user_ctx);
+            if (client->governor.period_us > 0 && (sscma_client_reply_name_is(reply, EVENT_INVOKE) || sscma_client_reply_name_is(reply, EVENT_SAMPLE)))
+            {
+                sscma_client_governor_frame(client, begin, esp_timer_get_time() - begin);
+            }
+        }
+    }
+    else if (reply->index.type == CMD_TYPE_LOG)
+    {
+        if (client->on_log)
+        {
+            client->on_log(client, reply, client->user_ctx);
+        }
+    }
+    else
+    {
+        if (client->on_response)
+        {
+            client->on_response(client, reply, client->user_ctx);
+        }
+    }
+
+    sscma_client_stats_callback(client, reply, start);
+    sscma_client_reply_clear(reply);
+}
+
+static void sscma_client_monitor(void *arg)
+{
+    sscma_client_handle_t client = (sscma_client_handle_t)arg;
+    sscma_client_reply_t reply;
+
+    if (!client->events.enabled)
+    {
+        while (true)
+        {
+            if (xQueueReceive(client->reply_queue, &reply, sscma_client_governor_step(client)) == pdTRUE)
+            {
+                sscma_client_deliver(client, &reply);
+            }
+        }
+    }
+
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, sscma_client_governor_step(client));
+
+        while (xQueueReceive(client->reply_queue, &reply, 0) == pdTRUE)
+        {
+            sscma_client_deliver(client, &reply);
+        }
+
+        for (int i = 0; i < SSCMA_CLIENT_EVENT_MAILBOXES; i++)
+        {
+            bool full = false;
+            xSemaphoreTake(client->events.lock, portMAX_DELAY);
+            if (client->events.full[i])
+            {
+                reply = client->events.slot[i];
+                client->events.full[i] = false;
+                full = true;
+            }
+            xSemaphoreGive(client->events.lock);
+            if (full)
+            {
+                sscma_client_deliver(client, &reply);
+            }
+        }
+    }
+}
+
+static inline uint32_t sscma_client_hash(const char *str, size_t len)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Caller must hold requests.lock */
+static void sscma_client_request_link(sscma_client_handle_t client, sscma_client_request_t *request)
+{
+    sscma_client_request_t **slot = &client->requests.buckets[request->hash % SSCMA_CLIENT_REQUEST_BUCKETS];
+    while (*slot != NULL)
+    {
+        slot = &(*slot)->next;
+    }
+    request->next = NULL;
+    request->pending = true;
+    *slot = request;
+    if (strcmp(request->cmd, CMD_AT_BREAK) == 0)
+    {
+        client->requests.break_pending++;
+    }
+}
+
+/* Caller must hold requests.lock */
+static void sscma_client_request_unlink(sscma_client_handle_t client, sscma_client_request_t *request)
+{
+    sscma_client_request_t **slot = &client->requests.buckets[request->hash % SSCMA_CLIENT_REQUEST_BUCKETS];
+    while (*slot != NULL && *slot != request)
+    {
+        slot = &(*slot)->next;
+    }
+    if (*slot == request)
+    {
+        *slot = request->next;
+    }
+    request->next = NULL;
+    request->pending = false;
+    if (strcmp(request->cmd, CMD_AT_BREAK) == 0)
+    {
+        client->requests.break_pending--;
+    }
+}
+
+/**
+ * Hand a reply to a pending request and retire it, so that the next reply
+ * with the same name goes to the next request in FIFO order.
+ * Caller must hold requests.lock.
+ */
+static void sscma_client_request_complete(sscma_client_handle_t client, sscma_client_request_t *request, sscma_client_reply_t *reply)
+{
+    sscma_client_request_unlink(client, request);
+    sscma_client_stats_request(client, request);
+    if (request->detached)
+    {
+        sscma_client_reply_clear(reply);
+        sscma_client_request_retire(client, request);
+        return;
+    }
+    if (xQueueSend(request->reply, reply, 0) != pdTRUE)
+    {
+        sscma_client_stats_queued(client, reply, false);
+        sscma_client_reply_clear(reply); // discard this reply
+    }
+}
+
+/**
+ * Free a request nobody is going to wait for, together with any reply it
+ * already holds.
+ * Caller must hold requests.lock.
+ */
+static void sscma_client_request_retire(sscma_client_handle_t client, sscma_client_request_t *request)
+{
+    sscma_client_reply_t stale;
+
+    if (request->pending)
+    {
+        sscma_client_request_unlink(client, request);
+    }
+    if (client->governor.pending == request)
+    {
+        client->governor.pending = NULL;
+    }
+    while (xQueueReceive(request->reply, &stale, 0) == pdTRUE)
+    {
+        sscma_client_reply_clear(&stale);
+    }
+    vQueueDelete(request->reply);
+    free(request);
+}
+
+static bool sscma_client_post(sscma_client_handle_t client, sscma_client_reply_t *reply)
+{
+    if (xQueueSend(client->reply_queue, reply, 0) != pdTRUE)
+    {
+        client->events.dropped++;
+        sscma_client_stats_queued(client, reply, false);
+        return false;
+    }
+    sscma_client_stats_queued(client, reply, true);
+    if (client->events.enabled && client->monitor_task.handle)
+    {
+        xTaskNotifyGive(client->monitor_task.handle);
+    }
+    return true;
+}
+
+static int sscma_client_mailbox_of(const sscma_client_reply_t *reply)
+{
+    if (sscma_client_reply_name_is(reply, EVENT_INVOKE))
+    {
+        return 0;
+    }
+    if (sscma_client_reply_name_is(reply, EVENT_SAMPLE))
+    {
+        return 1;
+    }
+    return -1;
+}
+
+static void sscma_client_mailbox_post(sscma_client_handle_t client, int mailbox, sscma_client_reply_t *reply)
+{
+    sscma_client_reply_t stale;
+    bool replaced = false;
+
+    xSemaphoreTake(client->events.lock, portMAX_DELAY);
+    if (client->events.full[mailbox])
+    {
+        stale = client->events.slot[mailbox];
+        client->events.replaced[mailbox]++;
+        replaced = true;
+    }
+    client->events.slot[mailbox] = *reply;
+    client->events.full[mailbox] = true;
+    xSemaphoreGive(client->events.lock);
+
+    if (replaced)
+    {
+        sscma_client_reply_clear(&stale); // the consumer never saw it, release its buffer
+    }
+    if (client->monitor_task.handle)
+    {
+        xTaskNotifyGive(client->monitor_task.handle);
+    }
+}
+
+static void sscma_client_mailbox_reset(sscma_client_handle_t client)
+{
+    for (int i = 0; i < SSCMA_CLIENT_EVENT_MAILBOXES; i++)
+    {
+        sscma_client_reply_t stale;
+        bool full = false;
+        xSemaphoreTake(client->events.lock, portMAX_DELAY);
+        if (client->events.full[i])
+        {
+            stale = client->events.slot[i];
+            client->events.full[i] = false;
+            full = true;
+        }
+        xSemaphoreGive(client->events.lock);
+        if (full)
+        {
+            sscma_client_reply_clear(&stale);
+        }
+    }
+}
+
+static bool sscma_client_still_take(sscma_client_handle_t client, sscma_client_reply_t *reply)
+{
+    bool taken = false;
+
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    if (client->still.frame != NULL)
+    {
+        // frames sampled before the capture AT+SAMPLE was answered are from the previous mode
+        if (!client->still.armed || xQueueSend(client->still.frame, reply, 0) != pdTRUE)
+        {
+            client->still.discarded++;
+            sscma_client_reply_clear(reply);
+        }
+        taken = true;
+    }
+    xSemaphoreGive(client->requests.lock);
+
+    return taken;
+}
+
+static void sscma_client_dispatch(sscma_client_handle_t client, sscma_client_reply_t *reply)
+{
+    if (sscma_client_reply_index(reply) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Invalid reply: %s cc", reply->data);
+        sscma_client_stats_frame(client, NULL, false);
+        sscma_client_reply_clear(reply);
+        return;
+    }
+
+    if (reply->index.type < 0 || reply->index.name == NULL)
+    {
+        ESP_LOGW(TAG, "invalid reply: %s", reply->data);
+        sscma_client_stats_frame(client, reply, false);
+        sscma_client_reply_clear(reply);
+        return;
+    }
+
+    // streaming events are only indexed, consumers build the tree on demand
+    if (!(client->lazy_event_payload && reply->index.type == CMD_TYPE_EVENT
+            && (sscma_client_reply_name_is(reply, EVENT_INVOKE) || sscma_client_reply_name_is(reply, EVENT_SAMPLE))))
+    {
+        int64_t start = sscma_client_stats_now();
+        if (sscma_client_reply_get_payload(reply) == NULL)
+        {
+            ESP_LOGW(TAG, "Invalid reply: %s cc", reply->data);
+            sscma_client_stats_frame(client, reply, false);
+            sscma_client_reply_clear(reply);
+            return;
+        }
+        sscma_client_stats_parse(client, reply, start);
+    }
+
+    sscma_client_stats_frame(client, reply, true);
+
+    if (reply->index.name != NULL && strnstr(reply->index.name, EVENT_INIT, reply->index.name_len) != NULL)
+    {
+        xEventGroupSetBits(client->ready.group, SSCMA_CLIENT_READY_BIT);
+    }
+
+    if (client->on_connect)
+    {
+        if (strnstr(reply->index.name, EVENT_INIT, reply->index.name_len) != NULL)
+        {
+            sscma_client_reply_t stale;
+            while (xQueueReceive(client->reply_queue, &stale, 0) == pdTRUE) // reset reply queue
+            {
+                sscma_client_reply_clear(&stale);
+            }
+            if (client->events.enabled)
+            {
+                sscma_client_mailbox_reset(client);
+            }
+            if (!sscma_client_post(client, reply))
+            {
+                sscma_client_reply_clear(reply);
+            }
+            return;
+        }
+    }
+
+    if (reply->index.type == CMD_TYPE_RESPONSE)
+    {
+        sscma_client_request_t *request = NULL;
+        uint32_t hash = sscma_client_hash(reply->index.name, reply->index.name_len);
+        bool found = false;
+        xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+        for (request = client->requests.buckets[hash % SSCMA_CLIENT_REQUEST_BUCKETS]; request != NULL; request = request->next)
+        {
+            if (request->hash == hash && sscma_client_reply_name_is(reply, request->cmd))
+            {
+                found = true;
+                if (client->still.frame != NULL && sscma_client_reply_name_is(reply, CMD_AT_SAMPLE))
+                {
+                    client->still.armed = true; // the next SAMPLE event is the still
+                }
+                sscma_client_request_complete(client, request, reply);
+                break;
+            }
+        }
+        xSemaphoreGive(client->requests.lock);
+        if (!found)
+        {
+            ESP_LOGW(TAG, "request not found: %.*s", (int)reply->index.name_len, reply->index.name);
+            if (client->on_response == NULL || !sscma_client_post(client, reply))
+            {
+                sscma_client_reply_clear(reply); // discard this reply
+            }
+        }
+    }
+    else if (reply->index.type == CMD_TYPE_LOG)
+    {
+        if (reply->index.code < 0)
+        {
+            ESP_LOGW(TAG, "invalid log: %s", reply->data);
+            sscma_client_reply_clear(reply);
+            return;
+        }
+        if (reply->index.code == CMD_EINVAL)
+        { // unkown command
+            cJSON *data = cJSON_GetObjectItem(reply->payload, "data");
+            if (data == NULL)
+            {
+                ESP_LOGW(TAG, "invalid log: %s", reply->data);
+                sscma_client_reply_clear(reply);
+                return;
+            }
+            sscma_client_request_t *request = NULL;
+            bool found = false;
+            xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+            for (int i = 0; i < SSCMA_CLIENT_REQUEST_BUCKETS && !found; i++)
+            {
+                for (request = client->requests.buckets[i]; request != NULL; request = request->next)
+                {
+                    if (strnstr(data->valuestring, request->cmd, strlen(data->valuestring)) != NULL)
+                    {
+                        found = true;
+                        sscma_client_request_complete(client, request, reply);
+                        break;
+                    }
+                }
+            }
+            xSemaphoreGive(client->requests.lock);
+            if (!found)
+            {
+                ESP_LOGW(TAG, "request not found: %.*s", (int)reply->index.name_len, reply->index.name);
+                if (client->on_log == NULL || !sscma_client_post(client, reply))
+                {
+                    sscma_client_reply_clear(reply); // discard this reply
+                }
+            }
+        }
+        else
+        {
+            if (client->on_log == NULL || !sscma_client_post(client, reply))
+            {
+                sscma_client_reply_clear(reply); // discard this reply
+            }
+        }
+    }
+    else if (reply->index.type == CMD_TYPE_EVENT)
+    {
+        if (client->still.frame != NULL && sscma_client_reply_name_is(reply, EVENT_SAMPLE) && sscma_client_still_take(client, reply))
+        {
+            return;
+        }
+        // discard all the events while AT+BREAK is pending
+        bool found = client->requests.break_pending > 0;
+        int mailbox = client->events.enabled ? sscma_client_mailbox_of(reply) : -1;
+        if (client->on_event == NULL || found)
+        {
+            sscma_client_reply_clear(reply); // discard this reply
+        }
+        else if (mailbox >= 0)
+        {
+            sscma_client_mailbox_post(client, mailbox, reply); // latest frame wins
+        }
+        else if (!sscma_client_post(client, reply))
+        {
+            sscma_client_reply_clear(reply); // discard this reply
+        }
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Invalid reply: %s", reply->data);
+        sscma_client_reply_clear(reply);
+    }
+}
+
+static void sscma_client_rx_reset(sscma_client_handle_t client)
+{
+    client->rx_buffer.head = 0;
+    client->rx_buffer.fill = 0;
+    client->rx_buffer.start = 0;
+    client->rx_buffer.mark = 0;
+    client->rx_buffer.in_frame = false;
+    client->rx_buffer.last = 0;
+}
+
+/**
+ * Copy the frame spanning [start, end] out of the RX ring, dropping the NUL
+ * padding some transports insert, and hand it to the dispatcher.
+ */
+static void sscma_client_rx_emit(sscma_client_handle_t client, size_t start, size_t end)
+{
+    sscma_client_reply_t reply;
+    size_t span = (end + client->rx_buffer.len - start) % client->rx_buffer.len + 1;
+    size_t len = 0;
+
+    reply.payload = NULL;
+    reply.arena.base = NULL;
+    reply.arena.size = 0;
+    reply.arena.used = 0;
+    reply.arena.fallbacks = 0;
+    reply.data = sscma_client_reply_alloc(&client->reply_pool, span + 1, &reply.pool);
+    if (reply.data == NULL)
+    {
+        ESP_LOGW(TAG, "no mem for reply: %d", span);
+        return;
+    }
+    if (reply.pool != NULL && reply.pool->arena_size > 0)
+    {
+        // everything in the slot behind the frame serves as the arena
+        reply.arena.base = reply.data + SSCMA_CLIENT_ARENA_ALIGN(span + 1);
+        reply.arena.size = reply.pool->slot_size - SSCMA_CLIENT_ARENA_ALIGN(span + 1);
+    }
+
+    while (span > 0)
+    {
+        size_t chunk = client->rx_buffer.len - start;
+        const char *src = client->rx_buffer.data + start;
+        if (chunk > span)
+        {
+            chunk = span;
+        }
+        if (memchr(src, '\0', chunk) == NULL)
+        {
+            memcpy(reply.data + len, src, chunk);
+            len += chunk;
+        }
+        else
+        {
+            for (size_t i = 0; i < chunk; i++)
+            {
+                if (src[i] != '\0')
+                {
+                    reply.data[len++] = src[i];
+                }
+            }
+        }
+        span -= chunk;
+        start = 0;
+    }
+
+    reply.data[len] = 0;
+    reply.len = len;
+
+    sscma_client_dispatch(client, &reply);
+}
+
+/**
+ * Scan `len` freshly read bytes at the ring head. Only new bytes are visited:
+ * the prefix/suffix state survives across reads, so the cost per call is
+ * proportional to what was read, never to what is already buffered.
+ */
+static void sscma_client_rx_feed(sscma_client_handle_t client, size_t len)
+{
+    size_t pos = client->rx_buffer.head;
+    size_t head = (pos + len) % client->rx_buffer.len;
+    // fill does not count the bytes just read yet, so the oldest kept byte is fill before pos
+    size_t tail = (pos + client->rx_buffer.len - client->rx_buffer.fill) % client->rx_buffer.len;
+    const char *data = client->rx_buffer.data;
+
+    for (size_t i = pos; i < pos + len; i++)
+    {
+        char c = data[i];
+        if (c == '\0')
+        {
+            continue;
+        }
+        if (client->rx_buffer.last == '\r' && c == '{')
+        {
+            if (client->rx_buffer.in_frame)
+            {
+                ESP_LOGW(TAG, "Invalid reply: truncated frame dropped");
+                sscma_client_stats_frame(client, NULL, false);
+            }
+            client->rx_buffer.in_frame = true;
+            client->rx_buffer.start = client->rx_buffer.mark;
+            tail = client->rx_buffer.start;
+        }
+        else if (client->rx_buffer.last == '}' && c == '\n')
+        {
+            if (client->rx_buffer.in_frame)
+            {
+                client->rx_buffer.in_frame = false;
+                sscma_client_rx_emit(client, client->rx_buffer.start, i);
+            }
+            else
+            {
+                ESP_LOGW(TAG, "Invalid reply: %d/%d", client->rx_buffer.fill, client->rx_buffer.len);
+                sscma_client_stats_frame(client, NULL, false);
+            }
+            tail = (i + 1) % client->rx_buffer.len;
+        }
+        else if (!client->rx_buffer.in_frame)
+        {
+            // nothing before a prefix is worth keeping, except a possible '\r'
+            tail = c == '\r' ? i : (i + 1) % client->rx_buffer.len;
+        }
+        if (c == '\r')
+        {
+            client->rx_buffer.mark = i;
+        }
+        client->rx_buffer.last = c;
+    }
+
+    client->rx_buffer.head = head;
+    client->rx_buffer.fill = (head + client->rx_buffer.len - tail) % client->rx_buffer.len;
+}
+
+static void sscma_client_process(void *arg)
+{
+    size_t rlen = 0;
+    size_t space = 0;
+    sscma_client_handle_t client = (sscma_client_handle_t)arg;
+    while (true)
+    {
+        // sleep until the transport signals data, polling only as a fallback
+        ulTaskNotifyTake(pdTRUE, client->rx_poll_interval);
+        if (client->inited == false)
+        {
+            continue;
+        }
+        // drain while data keeps arriving
+        while (sscma_client_available(client, &rlen) == ESP_OK && rlen)
+        {
+            // one byte is kept free so that head == tail always means empty
+            space = client->rx_buffer.len - client->rx_buffer.fill - 1;
+            if (space == 0)
+            {
+                ESP_LOGW(TAG, "rx buffer is full");
+                sscma_client_rx_reset(client);
+                continue;
+            }
+            if (rlen > space)
+            {
+                rlen = space;
+            }
+            // reads never wrap, the remainder is picked up on the next pass
+            if (rlen > client->rx_buffer.len - client->rx_buffer.head)
+            {
+                rlen = client->rx_buffer.len - client->rx_buffer.head;
+            }
+
+            if (sscma_client_read(client, client->rx_buffer.data + client->rx_buffer.head, rlen) != ESP_OK)
+            {
+                break;
+            }
+            sscma_client_rx_feed(client, rlen);
+        }
+    }
+}
+
+static void sscma_client_io_notify(void *user_ctx)
+{
+    sscma_client_notify((sscma_client_handle_t)user_ctx);
+}
+
+esp_err_t sscma_client_notify(sscma_client_handle_t client)
+{
+    if (client == NULL || client->process_task.handle == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xPortInIsrContext())
+    {
+        BaseType_t task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(client->process_task.handle, &task_woken);
+        if (task_woken == pdTRUE)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+    else
+    {
+        xTaskNotifyGive(client->process_task.handle);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t sscma_client_new(const sscma_client_io_handle_t io, const sscma_client_config_t *config, sscma_client_handle_t *ret_client)
+{
+#if CONFIG_SSCMA_ENABLE_DEBUG_LOG
+    esp_log_level_set(TAG, ESP_LOG_DEBUG);
+#endif
+    esp_err_t ret = ESP_OK;
+    BaseType_t res;
+    sscma_client_handle_t client = NULL;
+    ESP_GOTO_ON_FALSE(io && config && ret_client, ESP_ERR_INVALID_ARG, err, TAG, "invalid argument");
+    client = (sscma_client_handle_t)malloc(sizeof(struct sscma_client_t));
+    memset(client, 0, sizeof(struct sscma_client_t));
+    ESP_GOTO_ON_FALSE(client, ESP_ERR_NO_MEM, err, TAG, "no mem for sscma client");
+    client->io = io;
+    client->inited = false;
+    client->flasher = NULL;
+
+    if (config->reset_gpio_num >= 0)
+    {
+        if (config->flags.reset_use_expander)
+        {
+            client->io_expander = config->io_expander;
+            ESP_GOTO_ON_FALSE(client->io_expander, ESP_ERR_INVALID_ARG, err, TAG, "invalid io expander");
+            ESP_GOTO_ON_ERROR(esp_io_expander_set_dir(client->io_expander, config->reset_gpio_num, IO_EXPANDER_OUTPUT), err, TAG, "set GPIO direction failed");
+        }
+        else
+        {
+            gpio_config_t io_conf = {
+                .mode = GPIO_MODE_INPUT,
+                .pin_bit_mask = 1ULL << config->reset_gpio_num,
+            };
+            ESP_GOTO_ON_ERROR(gpio_config(&io_conf), err, TAG, "configure GPIO for RST line failed");
+        }
+    }
+
+    client->rx_buffer.data = (char *)malloc(config->rx_buffer_size);
+    ESP_GOTO_ON_FALSE(client->rx_buffer.data, ESP_ERR_NO_MEM, err, TAG, "no mem for rx buffer");
+    client->rx_buffer.len = config->rx_buffer_size;
+    sscma_client_rx_reset(client);
+
+    client->tx_buffer.data = (char *)malloc(config->tx_buffer_size);
+    ESP_GOTO_ON_FALSE(client->tx_buffer.data, ESP_ERR_NO_MEM, err, TAG, "no mem for tx buffer");
+    client->tx_buffer.pos = 0;
+    client->tx_buffer.len = config->tx_buffer_size;
+
+    client->reset_gpio_num = config->reset_gpio_num;
+    client->reset_level = config->flags.reset_active_high;
+
+    client->user_ctx = config->user_ctx;
+    client->lazy_event_payload = config->flags.lazy_event_payload;
+    client->cache.enabled = config->flags.persist_info;
+    client->cache.fresh = false;
+    client->governor.period_us = config->target_fps > 0 ? 1000000 / config->target_fps : 0;
+    client->rx_poll_interval = config->rx_poll_interval_ms > 0 ? pdMS_TO_TICKS(config->rx_poll_interval_ms) : portMAX_DELAY;
+
+    client->requests.lock = xSemaphoreCreateMutex();
+    ESP_GOTO_ON_FALSE(client->requests.lock, ESP_ERR_NO_MEM, err, TAG, "no mem for request lock");
+
+    client->ready.group = xEventGroupCreate();
+    ESP_GOTO_ON_FALSE(client->ready.group, ESP_ERR_NO_MEM, err, TAG, "no mem for ready event group");
+    client->ready.timeout = pdMS_TO_TICKS(config->ready_timeout_ms > 0 ? config->ready_timeout_ms : SSCMA_CLIENT_READY_TIMEOUT_MS);
+
+#if CONFIG_SSCMA_ENABLE_STATS
+    portMUX_INITIALIZE(&client->stats.lock);
+#endif
+
+    client->reply_queue = xQueueCreate(config->event_queue_size, sizeof(sscma_client_reply_t));
+    ESP_GOTO_ON_FALSE(client->reply_queue, ESP_ERR_NO_MEM, err, TAG, "no mem for reply queue");
+
+    client->events.enabled = config->flags.event_mailbox;
+    if (client->events.enabled)
+    {
+        client->events.lock = xSemaphoreCreateMutex();
+        ESP_GOTO_ON_FALSE(client->events.lock, ESP_ERR_NO_MEM, err, TAG, "no mem for event lock");
+    }
+
+    ESP_GOTO_ON_ERROR(sscma_client_reply_pool_init(&client->reply_pool, config->reply_pool_size, config->reply_pool_slot_size > 0 ? config->reply_pool_slot_size : config->rx_buffer_size,
+                                                    config->reply_arena_size),
+        err, TAG, "init reply pool failed");
+
+#ifdef CONFIG_SSCMA_PROCESS_TASK_STACK_ALLOC_EXTERNAL
+    client->process_task.task = heap_caps_calloc(1, sizeof(StaticTask_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(client->process_task.task, ESP_ERR_NO_MEM, err, TAG, "no mem for sscma client process task");
+    client->process_task.stack = heap_caps_calloc(1, config->process_task_stack * sizeof(StackType_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(client->process_task.stack, ESP_ERR_NO_MEM, err, TAG, "no mem for sscma client process task stack");
+    if (config->process_task_affinity < 0)
+    {
+        client->process_task.handle
+            = xTaskCreateStatic(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority, client->process_task.stack, client->process_task.task);
+    }
+    else
+    {
+        client->process_task.handle = xTaskCreateStaticPinnedToCore(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority,
+            client->process_task.stack, client->process_task.task, config->process_task_affinity);
+    }
+    ESP_GOTO_ON_FALSE(client->process_task.handle, ESP_FAIL, err, TAG, "create process task failed");
+#else
+    if (config->process_task_affinity < 0)
+    {
+        res = xTaskCreate(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority, &client->process_task.handle);
+    }
+    else
+    {
+        res = xTaskCreatePinnedToCore(sscma_client_process, "sscma_client_process", config->process_task_stack, client, config->process_task_priority, &client->process_task.handle,
+            config->process_task_affinity);
     }
     ESP_GOTO_ON_FALSE(res == pdPASS, ESP_FAIL, err, TAG, "create process task failed");
 #endif
@@ -547,6 +1965,11 @@ esp_err_t sscma_client_new(const sscma_client_io_handle_t io, const sscma_client
     ESP_GOTO_ON_FALSE(res == pdPASS, ESP_FAIL, err, TAG, "create monitor task failed");
 #endif
 
+    if (sscma_client_io_set_notify(client->io, sscma_client_io_notify, client) == ESP_OK)
+    {
+        ESP_LOGD(TAG, "rx notify enabled");
+    }
+
     client->on_connect = NULL;
     client->on_disconnect = NULL;
     client->on_response = NULL;
@@ -580,10 +2003,19 @@ err:
         {
             vQueueDelete(client->reply_queue);
         }
-        if (client->request_list)
+        if (client->requests.lock)
+        {
+            vSemaphoreDelete(client->requests.lock);
+        }
+        if (client->ready.group)
+        {
+            vEventGroupDelete(client->ready.group);
+        }
+        if (client->events.lock)
         {
-            free(client->request_list);
+            vSemaphoreDelete(client->events.lock);
         }
+        sscma_client_reply_pool_deinit(&client->reply_pool);
         if (client->process_task.handle)
         {
             vTaskDelete(client->process_task.handle);
@@ -640,27 +2072,36 @@ esp_err_t sscma_client_del(sscma_client_handle_t client)
                 gpio_reset_pin(client->reset_gpio_num);
             }
         }
+        // stop the tasks before freeing what they block on
+        sscma_client_io_set_notify(client->io, NULL, NULL);
+        vTaskDelete(client->process_task.handle);
+        vTaskDelete(client->monitor_task.handle);
+
         vQueueDelete(client->reply_queue);
 
-        sscma_client_request_t *first_req, *next_req = NULL;
-        if (listCURRENT_LIST_LENGTH(client->request_list) > (UBaseType_t)0)
+        for (int i = 0; i < SSCMA_CLIENT_REQUEST_BUCKETS; i++)
         {
-            listGET_OWNER_OF_NEXT_ENTRY(first_req, client->request_list);
-            do
+            sscma_client_request_t *request = client->requests.buckets[i];
+            while (request != NULL)
             {
-                listGET_OWNER_OF_NEXT_ENTRY(next_req, client->request_list);
-                uxListRemove(&(next_req->item));
-                vQueueDelete(next_req->reply);
-                free(next_req);
+                sscma_client_request_t *next = request->next;
+                vQueueDelete(request->reply);
+                free(request);
+                request = next;
             }
-            while (next_req != first_req);
+            client->requests.buckets[i] = NULL;
         }
+        vSemaphoreDelete(client->requests.lock);
+        vEventGroupDelete(client->ready.group);
 
-        free(client->request_list);
         free(client->rx_buffer.data);
         free(client->tx_buffer.data);
-        vTaskDelete(client->process_task.handle);
-        vTaskDelete(client->monitor_task.handle);
+        if (client->events.enabled)
+        {
+            sscma_client_mailbox_reset(client);
+            vSemaphoreDelete(client->events.lock);
+        }
+        sscma_client_reply_pool_deinit(&client->reply_pool);
 
 #ifdef CONFIG_SSCMA_PROCESS_TASK_STACK_ALLOC_EXTERNAL
         free(client->process_task.stack);
@@ -732,35 +2173,48 @@ esp_err_t sscma_client_del(sscma_client_handle_t client)
 
 esp_err_t sscma_client_init(sscma_client_handle_t client)
 {
+    esp_err_t ret = ESP_OK;
+
     if (!client->inited)
     {
-        sscma_client_reset(client);
+        // the process task only reads once inited, and readiness arrives over RX
         client->inited = true;
+        ret = sscma_client_reset(client);
     }
 
     memset(&client->info, 0, sizeof(sscma_client_info_t));
     memset(&client->model, 0, sizeof(sscma_client_model_t));
+    client->cache.fresh = false;
 
-    return ESP_OK;
+    return ret;
 }
 
 esp_err_t sscma_client_reset(sscma_client_handle_t client)
 {
     esp_err_t ret = ESP_OK;
+    int64_t start = esp_timer_get_time();
+
+    // the process task takes requests.lock too, never wait for it once that task is suspended
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    client->task[0] = '\0';
+    client->governor.paced = false;
+    xSemaphoreGive(client->requests.lock);
+
     vTaskSuspend(client->process_task.handle);
 
-    client->rx_buffer.pos = 0;
+    sscma_client_rx_reset(client);
     client->tx_buffer.pos = 0;
+    xEventGroupClearBits(client->ready.group, SSCMA_CLIENT_READY_BIT);
+    client->sensor.known = false;
 
-    // perform hardware reset
+    // perform hardware reset, the device announces itself with INIT@STAT once it is up
     if (client->reset_gpio_num >= 0)
     {
         if (client->io_expander)
         {
             esp_io_expander_set_level(client->io_expander, client->reset_gpio_num, client->reset_level);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            vTaskDelay(SSCMA_CLIENT_RESET_PULSE_MS / portTICK_PERIOD_MS);
             esp_io_expander_set_level(client->io_expander, client->reset_gpio_num, !client->reset_level);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
         }
         else
         {
@@ -770,29 +2224,86 @@ esp_err_t sscma_client_reset(sscma_client_handle_t client)
             };
             gpio_config(&io_conf);
             gpio_set_level(client->reset_gpio_num, client->reset_level);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            vTaskDelay(SSCMA_CLIENT_RESET_PULSE_MS / portTICK_PERIOD_MS);
             gpio_set_level(client->reset_gpio_num, !client->reset_level);
-            vTaskDelay(200 / portTICK_PERIOD_MS);
             gpio_reset_pin(client->reset_gpio_num);
         }
+        client->ready.reset_tick = xTaskGetTickCount();
+        client->ready.booting = true;
+    }
+
+    vTaskResume(client->process_task.handle);
+    // pick up anything the device sent while the process task was suspended
+    sscma_client_notify(client);
+
+    ret = sscma_client_wait_ready(client, client->ready.timeout);
+    if (ret == ESP_OK)
+    {
+        ESP_LOGI(TAG, "sscma ready in %lld ms", (long long)((esp_timer_get_time() - start) / 1000));
     }
     else
     {
-        // ESP_RETURN_ON_ERROR(sscma_client_request(client, CMD_PREFIX CMD_AT_RESET CMD_SUFFIX, NULL, false, 0), TAG, "request reset failed");
-        vTaskDelay(500 / portTICK_PERIOD_MS); // wait for sscma to be ready
+        ESP_LOGW(TAG, "sscma not ready after %lu ms", (unsigned long)pdTICKS_TO_MS(client->ready.timeout));
     }
 
-    vTaskResume(client->process_task.handle);
     return ret;
 }
 
+esp_err_t sscma_client_wait_ready(sscma_client_handle_t client, TickType_t timeout)
+{
+    sscma_client_future_t probe = NULL;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t now = 0;
+    TickType_t wait = 0;
+    TickType_t booted = 0;
+    TickType_t interval = pdMS_TO_TICKS(SSCMA_CLIENT_READY_PROBE_MS) > 0 ? pdMS_TO_TICKS(SSCMA_CLIENT_READY_PROBE_MS) : 1;
+    TickType_t grace = pdMS_TO_TICKS(SSCMA_CLIENT_READY_GRACE_MS);
+
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    while ((xEventGroupGetBits(client->ready.group) & SSCMA_CLIENT_READY_BIT) == 0)
+    {
+        now = xTaskGetTickCount();
+        wait = now - start;
+        if (wait >= timeout)
+        {
+            return ESP_ERR_TIMEOUT;
+        }
+        wait = timeout - wait < interval ? timeout - wait : interval;
+        // a device booting from the reset pulse announces itself, probes would only land in its boot ROM
+        booted = now - client->ready.reset_tick;
+        if (client->ready.booting && booted < grace)
+        {
+            xEventGroupWaitBits(client->ready.group, SSCMA_CLIENT_READY_BIT, pdFALSE, pdTRUE, grace - booted < wait ? grace - booted : wait);
+            continue;
+        }
+        // either INIT@STAT shows up, or a device that is already running answers the probe
+        if (sscma_client_request_async(client, CMD_PREFIX CMD_AT_STATS CMD_QUERY CMD_SUFFIX, &probe) == ESP_OK)
+        {
+            if (sscma_client_request_wait(client, probe, NULL, wait) == ESP_OK)
+            {
+                xEventGroupSetBits(client->ready.group, SSCMA_CLIENT_READY_BIT);
+            }
+        }
+        else
+        {
+            xEventGroupWaitBits(client->ready.group, SSCMA_CLIENT_READY_BIT, pdFALSE, pdTRUE, wait);
+        }
+    }
+    client->ready.booting = false;
+
+    return ESP_OK;
+}
+
 esp_err_t sscma_client_read(sscma_client_handle_t client, void *data, size_t size)
 {
+    sscma_client_stats_io(client, false, size);
     return sscma_client_io_read(client->io, data, size);
 }
 
 esp_err_t sscma_client_write(sscma_client_handle_t client, const void *data, size_t size)
 {
+    sscma_client_stats_io(client, true, size);
     return sscma_client_io_write(client->io, data, size);
 }
 
@@ -826,58 +2337,336 @@ esp_err_t sscma_client_register_callback(sscma_client_handle_t client, const ssc
     return ESP_OK;
 }
 
-esp_err_t sscma_client_request(sscma_client_handle_t client, const char *cmd, sscma_client_reply_t *reply, bool wait, TickType_t timeout)
+static esp_err_t sscma_client_request_start(sscma_client_handle_t client, const char *cmd, sscma_client_io_fill_cb_t fill, void *fill_ctx, size_t fill_len, sscma_client_future_t *future)
 {
     esp_err_t ret = ESP_OK;
     sscma_client_request_t *request = NULL;
 
-    if (wait)
+    request = (sscma_client_request_t *)__malloc(sizeof(sscma_client_request_t));
+    ESP_GOTO_ON_FALSE(request, ESP_ERR_NO_MEM, err, TAG, "no mem for request");
+    request->pending = false;
+    request->detached = false;
+    request->next = NULL;
+    request->reply = xQueueCreate(1, sizeof(sscma_client_reply_t));
+    ESP_GOTO_ON_FALSE(request->reply, ESP_ERR_NO_MEM, err, TAG, "no mem for reply");
+    strncpy(request->cmd, &cmd[CMD_PREFIX_LEN], sizeof(request->cmd) - 1);
+    request->cmd[sizeof(request->cmd) - 1] = '\0';
+    for (int i = 0; i < sizeof(request->cmd); i++)
     {
-        request = (sscma_client_request_t *)__malloc(sizeof(sscma_client_request_t));
-        ESP_GOTO_ON_FALSE(request, ESP_ERR_NO_MEM, err, TAG, "no mem for request");
-        request->reply = xQueueCreate(1, sizeof(sscma_client_reply_t));
-        strncpy(request->cmd, &cmd[CMD_PREFIX_LEN], sizeof(request->cmd) - 1);
-        request->cmd[sizeof(request->cmd) - 1] = '\0';
-        for (int i = 0; i < sizeof(request->cmd); i++)
+        if (request->cmd[i] == '\n' || request->cmd[i] == '\r' || request->cmd[i] == '=')
         {
-            if (request->cmd[i] == '\n' || request->cmd[i] == '\r' || request->cmd[i] == '=')
-            {
-                request->cmd[i] = '\0';
-            }
+            request->cmd[i] = '\0';
         }
-        ESP_GOTO_ON_FALSE(request->reply, ESP_ERR_NO_MEM, err, TAG, "no mem for reply");
-        vListInitialiseItem(&(request->item));
-        listSET_LIST_ITEM_OWNER(&(request->item), request);
-        vListInsertEnd(client->request_list, &(request->item));
+    }
+    request->hash = sscma_client_hash(request->cmd, strlen(request->cmd));
+#if CONFIG_SSCMA_ENABLE_STATS
+    request->start_us = esp_timer_get_time();
+#endif
+
+    // register before writing, the reply may arrive before write returns
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    sscma_client_request_link(client, request);
+    xSemaphoreGive(client->requests.lock);
+
+    if (fill != NULL)
+    {
+        // cmd only names the request, the command itself comes from the producer
+        sscma_client_stats_io(client, true, fill_len);
+        ESP_GOTO_ON_ERROR(sscma_client_io_write_chunked(client->io, fill, fill_ctx), err, TAG, "write command failed");
+    }
+    else
+    {
+        ESP_GOTO_ON_ERROR(sscma_client_write(client, cmd, strlen(cmd)), err, TAG, "write command failed");
     }
 
-    ESP_GOTO_ON_ERROR(sscma_client_write(client, cmd, strlen(cmd)), err, TAG, "write command failed");
+    *future = request;
 
-    if (wait)
+    return ESP_OK;
+
+err:
+    if (request)
     {
-        if (xQueueReceive(request->reply, reply, timeout) == pdTRUE)
+        xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+        if (request->pending)
         {
-            ret = ESP_OK;
+            sscma_client_request_unlink(client, request);
         }
-        else
+        xSemaphoreGive(client->requests.lock);
+        if (request->reply)
+        {
+            vQueueDelete(request->reply);
+        }
+        free(request);
+    }
+    return ret;
+}
+
+esp_err_t sscma_client_request_async(sscma_client_handle_t client, const char *cmd, sscma_client_future_t *future)
+{
+    ESP_RETURN_ON_FALSE(client && cmd && future, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    return sscma_client_request_start(client, cmd, NULL, NULL, 0, future);
+}
+
+esp_err_t sscma_client_request_wait(sscma_client_handle_t client, sscma_client_future_t future, sscma_client_reply_t *reply, TickType_t timeout)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_reply_t stale;
+
+    ESP_RETURN_ON_FALSE(client && future, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    if (xQueueReceive(future->reply, reply ? reply : &stale, timeout) == pdTRUE)
+    {
+        if (reply == NULL)
+        {
+            sscma_client_reply_clear(&stale);
+        }
+    }
+    else
+    {
+        ret = ESP_ERR_TIMEOUT;
+    }
+
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    if (future->pending)
+    {
+        sscma_client_request_unlink(client, future);
+    }
+    xSemaphoreGive(client->requests.lock);
+
+    // a reply may have raced in after the timeout
+    while (xQueueReceive(future->reply, &stale, 0) == pdTRUE)
+    {
+        sscma_client_reply_clear(&stale);
+    }
+    vQueueDelete(future->reply);
+    free(future);
+
+    return ret;
+}
+
+esp_err_t sscma_client_request(sscma_client_handle_t client, const char *cmd, sscma_client_reply_t *reply, bool wait, TickType_t timeout)
+{
+    sscma_client_future_t future = NULL;
+
+    if (!wait)
+    {
+        ESP_RETURN_ON_ERROR(sscma_client_write(client, cmd, strlen(cmd)), TAG, "write command failed");
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(sscma_client_request_async(client, cmd, &future), TAG, "request failed");
+
+    return sscma_client_request_wait(client, future, reply, timeout);
+}
+
+static void sscma_client_model_clear_classes(sscma_client_handle_t client)
+{
+    for (int i = 0; i < SSCMA_CLIENT_MODEL_MAX_CLASSES; i++)
+    {
+        if (client->model.classes[i] != NULL)
+        {
+            free(client->model.classes[i]);
+            client->model.classes[i] = NULL;
+        }
+    }
+}
+
+// MODEL? tells where the model lives, flashing another model moves or resizes it
+static void sscma_client_model_key(cJSON *data, sscma_client_model_key_t *key)
+{
+    key->id = get_int_from_object(data, "id");
+    key->type = get_int_from_object(data, "type");
+    key->address = get_int_from_object(data, "address");
+    key->size = get_int_from_object(data, "size");
+}
+
+static bool sscma_client_model_key_valid(const sscma_client_model_key_t *key)
+{
+    return key->id != INT_MIN && key->address != INT_MIN && key->size != INT_MIN;
+}
+
+#define SSCMA_CLIENT_CACHE_NAMESPACE "sscma_client"
+#define SSCMA_CLIENT_CACHE_KEY       "info"
+
+static void sscma_client_cache_erase(sscma_client_handle_t client)
+{
+    nvs_handle_t nvs = 0;
+
+    client->cache.fresh = false;
+    if (!client->cache.enabled || nvs_open(SSCMA_CLIENT_CACHE_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+    if (nvs_erase_key(nvs, SSCMA_CLIENT_CACHE_KEY) == ESP_OK)
+    {
+        nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+}
+
+static void sscma_client_cache_store(sscma_client_handle_t client)
+{
+    nvs_handle_t nvs = 0;
+    cJSON *root = NULL;
+    cJSON *model = NULL;
+    cJSON *classes = NULL;
+    char *blob = NULL;
+
+    if (!client->cache.enabled || client->info.id == NULL || client->model.uuid == NULL || !sscma_client_model_key_valid(&client->cache.model))
+    {
+        return;
+    }
+
+    root = cJSON_CreateObject();
+    model = cJSON_AddObjectToObject(root, "model");
+    classes = cJSON_AddArrayToObject(model, "classes");
+    if (classes == NULL)
+    {
+        goto err;
+    }
+    cJSON_AddStringToObject(root, "id", client->info.id);
+    cJSON_AddStringToObject(root, "name", client->info.name);
+    cJSON_AddStringToObject(root, "hw_ver", client->info.hw_ver);
+    cJSON_AddStringToObject(root, "sw_ver", client->info.sw_ver);
+    cJSON_AddStringToObject(root, "fw_ver", client->info.fw_ver);
+    cJSON_AddNumberToObject(model, "id", client->model.id);
+    cJSON_AddNumberToObject(model, "type", client->cache.model.type);
+    cJSON_AddNumberToObject(model, "address", client->cache.model.address);
+    cJSON_AddNumberToObject(model, "size", client->cache.model.size);
+    cJSON_AddStringToObject(model, "uuid", client->model.uuid);
+    cJSON_AddStringToObject(model, "name", client->model.name);
+    cJSON_AddStringToObject(model, "ver", client->model.ver);
+    cJSON_AddStringToObject(model, "url", client->model.url);
+    cJSON_AddStringToObject(model, "checksum", client->model.checksum);
+    for (int i = 0; i < SSCMA_CLIENT_MODEL_MAX_CLASSES && client->model.classes[i] != NULL; i++)
+    {
+        cJSON_AddItemToArray(classes, cJSON_CreateString(client->model.classes[i]));
+    }
+
+    blob = cJSON_PrintUnformatted(root);
+    if (blob != NULL && nvs_open(SSCMA_CLIENT_CACHE_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        if (nvs_set_blob(nvs, SSCMA_CLIENT_CACHE_KEY, blob, strlen(blob) + 1) != ESP_OK || nvs_commit(nvs) != ESP_OK)
         {
-            ret = ESP_ERR_TIMEOUT;
+            ESP_LOGW(TAG, "store info cache failed");
         }
+        nvs_close(nvs);
     }
 
 err:
-    if (wait)
+    if (blob != NULL)
+    {
+        cJSON_free(blob);
+    }
+    cJSON_Delete(root);
+}
+
+static bool sscma_client_cache_load(sscma_client_handle_t client, const char *device_id, const sscma_client_model_key_t *key)
+{
+    nvs_handle_t nvs = 0;
+    size_t len = 0;
+    char *blob = NULL;
+    cJSON *root = NULL;
+    cJSON *model = NULL;
+    bool hit = false;
+
+    if (nvs_open(SSCMA_CLIENT_CACHE_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return false;
+    }
+    if (nvs_get_blob(nvs, SSCMA_CLIENT_CACHE_KEY, NULL, &len) == ESP_OK && len > 0)
     {
-        if (listIS_CONTAINED_WITHIN(client->request_list, &(request->item)))
+        blob = __malloc(len);
+        if (blob != NULL && nvs_get_blob(nvs, SSCMA_CLIENT_CACHE_KEY, blob, &len) == ESP_OK)
         {
-            uxListRemove(&(request->item));
+            root = cJSON_ParseWithLength(blob, len);
         }
-        if (request)
+    }
+    nvs_close(nvs);
+
+    // the cache only describes the device and the model image it was written for
+    model = cJSON_GetObjectItem(root, "model");
+    if (model != NULL && cJSON_IsString(cJSON_GetObjectItem(root, "id")) && strcmp(cJSON_GetObjectItem(root, "id")->valuestring, device_id) == 0
+        && get_int_from_object(model, "id") == key->id && get_int_from_object(model, "type") == key->type && get_int_from_object(model, "address") == key->address
+        && get_int_from_object(model, "size") == key->size)
+    {
+        cJSON *classes = cJSON_GetObjectItem(model, "classes");
+        int classes_len = cJSON_GetArraySize(classes) > SSCMA_CLIENT_MODEL_MAX_CLASSES ? SSCMA_CLIENT_MODEL_MAX_CLASSES : cJSON_GetArraySize(classes);
+
+        fetch_string_from_object(root, "id", &client->info.id);
+        fetch_string_from_object(root, "name", &client->info.name);
+        fetch_string_from_object(root, "hw_ver", &client->info.hw_ver);
+        fetch_string_from_object(root, "sw_ver", &client->info.sw_ver);
+        fetch_string_from_object(root, "fw_ver", &client->info.fw_ver);
+        client->model.id = key->id;
+        client->cache.model = *key;
+        fetch_string_from_object(model, "uuid", &client->model.uuid);
+        fetch_string_from_object(model, "name", &client->model.name);
+        fetch_string_from_object(model, "ver", &client->model.ver);
+        fetch_string_from_object(model, "url", &client->model.url);
+        fetch_string_from_object(model, "checksum", &client->model.checksum);
+        sscma_client_model_clear_classes(client);
+        for (int i = 0; i < classes_len; i++)
         {
-            vQueueDelete(request->reply);
-            free(request);
+            fetch_string_from_array(classes, i, &client->model.classes[i]);
         }
+        hit = client->model.uuid != NULL;
+    }
+
+    cJSON_Delete(root);
+    free(blob);
+
+    return hit;
+}
+
+static esp_err_t sscma_client_cache_revalidate(sscma_client_handle_t client)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_reply_t reply;
+    sscma_client_future_t id = NULL, model = NULL;
+    char *device_id = NULL;
+    sscma_client_model_key_t key = { .id = INT_MIN };
+
+    // one pipelined round trip decides whether the cached info still applies
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, CMD_PREFIX CMD_AT_ID CMD_QUERY CMD_SUFFIX, &id), err, TAG, "request id failed");
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, CMD_PREFIX CMD_AT_MODEL CMD_QUERY CMD_SUFFIX, &model), err, TAG, "request model failed");
+
+    ret = sscma_client_request_wait(client, id, &reply, CMD_WAIT_DELAY);
+    id = NULL;
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "request id failed");
+    if (reply.payload != NULL)
+    {
+        fetch_string_from_object(reply.payload, "data", &device_id);
+        sscma_client_reply_clear(&reply);
+    }
+
+    ret = sscma_client_request_wait(client, model, &reply, CMD_WAIT_DELAY);
+    model = NULL;
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "request model failed");
+    if (reply.payload != NULL)
+    {
+        sscma_client_model_key(cJSON_GetObjectItem(reply.payload, "data"), &key);
+        sscma_client_reply_clear(&reply);
+    }
+
+    ret = ESP_ERR_NOT_FOUND;
+    if (device_id != NULL && sscma_client_model_key_valid(&key) && sscma_client_cache_load(client, device_id, &key))
+    {
+        client->cache.fresh = true;
+        ret = ESP_OK;
+    }
+
+err:
+    if (id)
+    {
+        sscma_client_request_wait(client, id, NULL, 0);
+    }
+    if (model)
+    {
+        sscma_client_request_wait(client, model, NULL, 0);
     }
+    free(device_id);
     return ret;
 }
 
@@ -885,6 +2674,7 @@ esp_err_t sscma_client_get_info(sscma_client_handle_t client, sscma_client_info_
 {
     esp_err_t ret = ESP_OK;
     sscma_client_reply_t reply;
+    sscma_client_future_t id = NULL, name = NULL, ver = NULL;
 
     *info = &client->info;
 
@@ -893,7 +2683,19 @@ esp_err_t sscma_client_get_info(sscma_client_handle_t client, sscma_client_info_
         return ret;
     }
 
-    ESP_RETURN_ON_ERROR(sscma_client_request(client, CMD_PREFIX CMD_AT_ID CMD_QUERY CMD_SUFFIX, &reply, true, CMD_WAIT_DELAY), TAG, "request id failed");
+    if (cached && client->cache.enabled && sscma_client_cache_revalidate(client) == ESP_OK)
+    {
+        return ret;
+    }
+
+    // issue all queries back to back, then collect the replies
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, CMD_PREFIX CMD_AT_ID CMD_QUERY CMD_SUFFIX, &id), err, TAG, "request id failed");
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, CMD_PREFIX CMD_AT_NAME CMD_QUERY CMD_SUFFIX, &name), err, TAG, "request name failed");
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, CMD_PREFIX CMD_AT_VERSION CMD_QUERY CMD_SUFFIX, &ver), err, TAG, "request version failed");
+
+    ret = sscma_client_request_wait(client, id, &reply, CMD_WAIT_DELAY);
+    id = NULL;
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "request id failed");
 
     if (reply.payload != NULL)
     {
@@ -902,7 +2704,9 @@ esp_err_t sscma_client_get_info(sscma_client_handle_t client, sscma_client_info_
         sscma_client_reply_clear(&reply);
     }
 
-    ESP_RETURN_ON_ERROR(sscma_client_request(client, CMD_PREFIX CMD_AT_NAME CMD_QUERY CMD_SUFFIX, &reply, true, CMD_WAIT_DELAY), TAG, "request name failed");
+    ret = sscma_client_request_wait(client, name, &reply, CMD_WAIT_DELAY);
+    name = NULL;
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "request name failed");
 
     if (reply.payload != NULL)
     {
@@ -911,7 +2715,9 @@ esp_err_t sscma_client_get_info(sscma_client_handle_t client, sscma_client_info_
         sscma_client_reply_clear(&reply);
     }
 
-    ESP_RETURN_ON_ERROR(sscma_client_request(client, CMD_PREFIX CMD_AT_VERSION CMD_QUERY CMD_SUFFIX, &reply, true, CMD_WAIT_DELAY), TAG, "request version failed");
+    ret = sscma_client_request_wait(client, ver, &reply, CMD_WAIT_DELAY);
+    ver = NULL;
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "request version failed");
 
     if (reply.payload != NULL)
     {
@@ -926,6 +2732,23 @@ esp_err_t sscma_client_get_info(sscma_client_handle_t client, sscma_client_info_
         sscma_client_reply_clear(&reply);
     }
 
+    sscma_client_cache_store(client);
+
+    return ret;
+
+err:
+    if (id)
+    {
+        sscma_client_request_wait(client, id, NULL, 0);
+    }
+    if (name)
+    {
+        sscma_client_request_wait(client, name, NULL, 0);
+    }
+    if (ver)
+    {
+        sscma_client_request_wait(client, ver, NULL, 0);
+    }
     return ret;
 }
 
@@ -938,6 +2761,13 @@ esp_err_t sscma_client_get_model(sscma_client_handle_t client, sscma_client_mode
     size_t len = 0;
     *model = &client->model;
 
+    // the model was just revalidated together with the cached info
+    if (cached && client->cache.fresh && client->model.uuid != NULL)
+    {
+        client->cache.fresh = false;
+        return ret;
+    }
+
     ESP_RETURN_ON_ERROR(sscma_client_request(client, CMD_PREFIX CMD_AT_MODEL CMD_QUERY CMD_SUFFIX, &reply, true, CMD_WAIT_DELAY), TAG, "request model failed");
 
     if (reply.payload != NULL)
@@ -945,10 +2775,14 @@ esp_err_t sscma_client_get_model(sscma_client_handle_t client, sscma_client_mode
         cJSON *data = cJSON_GetObjectItem(reply.payload, "data");
         if (data != NULL)
         {
-            if (client->model.id != get_int_from_object(data, "id"))
+            sscma_client_model_key_t key;
+            sscma_client_model_key(data, &key);
+            // the same id reflashed with another model still changes its address or size
+            if (memcmp(&key, &client->cache.model, sizeof(key)) != 0)
             {
                 is_changed = true;
-                client->model.id = get_int_from_object(data, "id");
+                client->model.id = key.id;
+                client->cache.model = key;
             }
         }
         sscma_client_reply_clear(&reply);
@@ -990,7 +2824,7 @@ esp_err_t sscma_client_get_model(sscma_client_handle_t client, sscma_client_mode
                                 if (classes != NULL && cJSON_IsArray(classes))
                                 {
                                     int classes_len = cJSON_GetArraySize(classes) > SSCMA_CLIENT_MODEL_MAX_CLASSES ? SSCMA_CLIENT_MODEL_MAX_CLASSES : cJSON_GetArraySize(classes);
-                                    memset(client->model.classes, 0, sizeof(client->model.classes));
+                                    sscma_client_model_clear_classes(client);
                                     for (int i = 0; i < classes_len; i++)
                                     {
                                         fetch_string_from_array(classes, i, &client->model.classes[i]);
@@ -1022,7 +2856,7 @@ esp_err_t sscma_client_get_model(sscma_client_handle_t client, sscma_client_mode
                                 if (classes != NULL && cJSON_IsArray(classes))
                                 {
                                     int classes_len = cJSON_GetArraySize(classes) > SSCMA_CLIENT_MODEL_MAX_CLASSES ? SSCMA_CLIENT_MODEL_MAX_CLASSES : cJSON_GetArraySize(classes);
-                                    memset(client->model.classes, 0, sizeof(client->model.classes));
+                                    sscma_client_model_clear_classes(client);
                                     for (int i = 0; i < classes_len; i++)
                                     {
                                         fetch_string_from_array(classes, i, &client->model.classes[i]);
@@ -1039,6 +2873,8 @@ esp_err_t sscma_client_get_model(sscma_client_handle_t client, sscma_client_mode
         sscma_client_reply_clear(&reply);
     }
 
+    sscma_client_cache_store(client);
+
     return ret;
 }
 
@@ -1062,6 +2898,26 @@ esp_err_t sscma_client_set_model(sscma_client_handle_t client, int model)
     return ret;
 }
 
+static void sscma_client_task_track(sscma_client_handle_t client, const char *cmd, int times)
+{
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    // only tasks that run until stopped are restarted after a still capture or paced by the governor
+    if (times < 0)
+    {
+        const char *args = strchr(cmd, '=') + 1;
+        snprintf(client->task, sizeof(client->task), "%s", cmd);
+        snprintf(client->governor.shot, sizeof(client->governor.shot), "%.*s1%s", (int)(args - cmd), cmd, strpbrk(args, ",\r"));
+    }
+    else
+    {
+        client->task[0] = '\0';
+    }
+    client->governor.paced = false;
+    client->governor.last_us = 0;
+    client->governor.interval_us = 0;
+    xSemaphoreGive(client->requests.lock);
+}
+
 esp_err_t sscma_client_sample(sscma_client_handle_t client, int times)
 {
     esp_err_t ret = ESP_OK;
@@ -1078,6 +2934,11 @@ esp_err_t sscma_client_sample(sscma_client_handle_t client, int times)
         sscma_client_reply_clear(&reply);
     }
 
+    if (ret == ESP_OK)
+    {
+        sscma_client_task_track(client, cmd, times);
+    }
+
     return ret;
 }
 
@@ -1099,6 +2960,11 @@ esp_err_t sscma_client_invoke(sscma_client_handle_t client, int times, bool flit
         sscma_client_reply_clear(&reply);
     }
 
+    if (ret == ESP_OK)
+    {
+        sscma_client_task_track(client, cmd, times);
+    }
+
     return ret;
 }
 
@@ -1119,6 +2985,14 @@ esp_err_t sscma_client_set_sensor(sscma_client_handle_t client, int id, int opt_
         sscma_client_reply_clear(&reply);
     }
 
+    if (ret == ESP_OK)
+    {
+        client->sensor.known = true;
+        client->sensor.id = id;
+        client->sensor.opt_id = opt_id;
+        client->sensor.enable = enable;
+    }
+
     return ret;
 }
 
@@ -1169,9 +3043,170 @@ esp_err_t sscma_client_break(sscma_client_handle_t client)
         sscma_client_reply_clear(&reply);
     }
 
+    if (ret == ESP_OK)
+    {
+        xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+        client->task[0] = '\0';
+        client->governor.paced = false;
+        xSemaphoreGive(client->requests.lock);
+    }
+
+    return ret;
+}
+
+static esp_err_t sscma_client_wait_code(sscma_client_handle_t client, sscma_client_future_t future, TickType_t timeout)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_reply_t reply;
+
+    ESP_RETURN_ON_ERROR(sscma_client_request_wait(client, future, &reply, timeout), TAG, "request failed");
+
+    if (reply.payload != NULL)
+    {
+        int code = get_int_from_object(reply.payload, "code");
+        ret = SSCMA_CLIENT_CMD_ERROR_CODE(code);
+        sscma_client_reply_clear(&reply);
+    }
+
     return ret;
 }
 
+esp_err_t sscma_client_capture_still(sscma_client_handle_t client, int opt_id, TickType_t timeout, sscma_client_jpeg_t *out_jpeg)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_reply_t reply;
+    sscma_client_future_t sensor = NULL, sample = NULL;
+    QueueHandle_t frame = NULL;
+    char cmd[64] = { 0 };
+    char task[64] = { 0 };
+    bool busy = false;
+    bool has_frame = false;
+    int64_t start = 0;
+
+    ESP_RETURN_ON_FALSE(client && out_jpeg, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    memset(out_jpeg, 0, sizeof(sscma_client_jpeg_t));
+
+    if (!client->sensor.known)
+    {
+        // the mode to restore was not set through this client, ask the device once
+        sscma_client_sensor_t current = { 0 };
+        ESP_RETURN_ON_ERROR(sscma_client_get_sensor(client, &current), TAG, "get sensor failed");
+        free(current.opt_detail);
+        client->sensor.known = true;
+        client->sensor.id = current.id;
+        client->sensor.opt_id = current.opt_id;
+        client->sensor.enable = true;
+    }
+
+    frame = xQueueCreate(1, sizeof(sscma_client_reply_t));
+    ESP_RETURN_ON_FALSE(frame, ESP_ERR_NO_MEM, TAG, "no mem for still queue");
+
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    busy = client->still.frame != NULL;
+    if (!busy)
+    {
+        client->still.frame = frame;
+        client->still.armed = false;
+        client->still.discarded = 0;
+    }
+    xSemaphoreGive(client->requests.lock);
+    if (busy)
+    {
+        vQueueDelete(frame);
+        ESP_LOGE(TAG, "still capture already in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    snprintf(task, sizeof(task), "%s", client->task);
+    start = esp_timer_get_time();
+
+    // mode switch and single sample in one round trip, AT+SAMPLE also replaces the running task
+    snprintf(cmd, sizeof(cmd), CMD_PREFIX CMD_AT_SENSOR CMD_SET "%d,1,%d" CMD_SUFFIX, client->sensor.id, opt_id);
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, cmd, &sensor), restore, TAG, "request set sensor failed");
+    ESP_GOTO_ON_ERROR(sscma_client_request_async(client, CMD_PREFIX CMD_AT_SAMPLE CMD_SET "1" CMD_SUFFIX, &sample), restore, TAG, "request sample failed");
+
+    ret = sscma_client_wait_code(client, sensor, CMD_WAIT_DELAY);
+    sensor = NULL;
+    ESP_GOTO_ON_ERROR(ret, restore, TAG, "set sensor failed");
+    ret = sscma_client_wait_code(client, sample, CMD_WAIT_DELAY);
+    sample = NULL;
+    ESP_GOTO_ON_ERROR(ret, restore, TAG, "sample failed");
+
+    ESP_GOTO_ON_FALSE(xQueueReceive(frame, &reply, timeout) == pdTRUE, ESP_ERR_TIMEOUT, restore, TAG, "still timeout");
+    has_frame = true;
+
+    // base64 never decodes to more than 3/4 of the frame
+    size_t max_size = (reply.len / 4 + 1) * 3;
+    out_jpeg->data = heap_caps_malloc(max_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(out_jpeg->data, ESP_ERR_NO_MEM, restore, TAG, "no mem for still");
+    ESP_GOTO_ON_ERROR(sscma_utils_decode_image_from_reply(&reply, out_jpeg->data, max_size, &out_jpeg->size), restore, TAG, "decode still failed");
+    out_jpeg->latency_us = esp_timer_get_time() - start;
+
+restore:
+    if (has_frame)
+    {
+        sscma_client_reply_clear(&reply);
+    }
+    if (sensor)
+    {
+        sscma_client_request_wait(client, sensor, NULL, 0);
+    }
+    if (sample)
+    {
+        sscma_client_request_wait(client, sample, NULL, 0);
+    }
+
+    xSemaphoreTake(client->requests.lock, portMAX_DELAY);
+    client->still.frame = NULL;
+    client->still.armed = false;
+    out_jpeg->discarded = client->still.discarded;
+    client->governor.paced = false; // the task is restarted continuous below
+    client->governor.last_us = 0;
+    client->governor.interval_us = 0;
+    xSemaphoreGive(client->requests.lock);
+    while (xQueueReceive(frame, &reply, 0) == pdTRUE)
+    {
+        sscma_client_reply_clear(&reply);
+    }
+    vQueueDelete(frame);
+
+    // previous mode and task go out back to back as well
+    esp_err_t err = ESP_OK;
+    snprintf(cmd, sizeof(cmd), CMD_PREFIX CMD_AT_SENSOR CMD_SET "%d,%d,%d" CMD_SUFFIX, client->sensor.id, client->sensor.enable ? 1 : 0, client->sensor.opt_id);
+    err = sscma_client_request_async(client, cmd, &sensor);
+    if (err == ESP_OK && task[0] != '\0')
+    {
+        err = sscma_client_request_async(client, task, &sample);
+    }
+    if (sensor)
+    {
+        esp_err_t wait = sscma_client_wait_code(client, sensor, CMD_WAIT_DELAY);
+        err = err == ESP_OK ? wait : err;
+    }
+    if (sample)
+    {
+        esp_err_t wait = sscma_client_wait_code(client, sample, CMD_WAIT_DELAY);
+        err = err == ESP_OK ? wait : err;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "restore sensor mode failed: %s", esp_err_to_name(err));
+    }
+
+    if (ret != ESP_OK)
+    {
+        free(out_jpeg->data);
+        out_jpeg->data = NULL;
+        out_jpeg->size = 0;
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "still %u bytes in %lld ms, %lu stale frames dropped", (unsigned)out_jpeg->size, (long long)(out_jpeg->latency_us / 1000), (unsigned long)out_jpeg->discarded);
+
+    return ESP_OK;
+}
+
 esp_err_t sscma_client_set_iou_threshold(sscma_client_handle_t client, int threshold)
 {
     esp_err_t ret = ESP_OK;
@@ -1258,46 +3293,81 @@ esp_err_t sscma_client_get_confidence_threshold(sscma_client_handle_t client, in
     return ret;
 }
 
-esp_err_t sscma_client_set_model_info(sscma_client_handle_t client, const char *model_info)
+typedef struct
 {
-    esp_err_t ret = ESP_OK;
-    sscma_client_reply_t reply;
-    size_t length = 0;
-    ESP_RETURN_ON_FALSE(model_info != NULL, ESP_ERR_INVALID_ARG, TAG, "model_info is NULL");
-    char *cmd = heap_caps_calloc(1, 4000, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    const char *head;    /* !< Command up to the opening quote */
+    size_t head_pos;     /* !< Bytes of head emitted */
+    const uint8_t *data; /* !< Raw info to encode */
+    size_t data_len;     /* !< Length of data */
+    size_t data_pos;     /* !< Bytes of data encoded */
+    const char *tail;    /* !< Closing quote and command suffix */
+    size_t tail_pos;     /* !< Bytes of tail emitted */
+} model_info_stream_t;
+
+static size_t model_info_emit(char *buf, size_t size, const char *str, size_t *pos)
+{
+    size_t len = strlen(str + *pos);
+    if (len > size)
+    {
+        len = size;
+    }
+    memcpy(buf, str + *pos, len);
+    *pos += len;
+    return len;
+}
 
-    // clear info first
-    for (int i = 0; i < 3; i++)
+static size_t model_info_fill(void *buf, size_t size, void *user_ctx)
+{
+    model_info_stream_t *stream = (model_info_stream_t *)user_ctx;
+    char *out = (char *)buf;
+    size_t n = 0;
+
+    n += model_info_emit(out, size, stream->head, &stream->head_pos);
+    if (stream->head[stream->head_pos] == '\0' && stream->data_pos < stream->data_len && size - n > 4)
     {
-        sscma_client_request(client, CMD_PREFIX CMD_AT_INFO CMD_SET "\"\"" CMD_SUFFIX, &reply, true, CMD_WAIT_DELAY);
-        if (reply.payload != NULL)
+        // whole 3-byte groups only, mbedtls also needs room for its terminator
+        size_t in = (size - n - 1) / 4 * 3;
+        size_t olen = 0;
+        if (in > stream->data_len - stream->data_pos)
         {
-            int code = get_int_from_object(reply.payload, "code");
-            sscma_client_reply_clear(&reply);
-            if (code == 0)
-            {
-                break;
-            }
-            else
-            {
-                ESP_LOGW(TAG, "clear info failed %d", code);
-            }
+            in = stream->data_len - stream->data_pos;
         }
+        if (mbedtls_base64_encode((unsigned char *)out + n, size - n, &olen, stream->data + stream->data_pos, in) != 0)
+        {
+            // 0 would read as a finished command
+            return SSCMA_CLIENT_IO_FILL_ERROR;
+        }
+        stream->data_pos += in;
+        n += olen;
     }
-
-    snprintf(cmd, 4000, CMD_PREFIX CMD_AT_INFO CMD_SET "\"");
-
-    if (mbedtls_base64_encode((unsigned char *)&cmd[strlen(cmd)], sizeof(cmd) - strlen(cmd) - CMD_SUFFIX_LEN, &length, (const unsigned char *)model_info, strlen(model_info)) != 0)
+    if (stream->data_pos == stream->data_len)
     {
-        ESP_LOGE(TAG, "mbedtls_base64_encode failed %d %d", sizeof(cmd) - strlen(cmd) - CMD_SUFFIX_LEN, length);
-        ret = ESP_ERR_NO_MEM;
-        goto set_model_info_exit;
+        n += model_info_emit(out + n, size - n, stream->tail, &stream->tail_pos);
     }
 
-    // already restricted to 4000
-    strcat(cmd, "\"" CMD_SUFFIX);
+    return n;
+}
+
+esp_err_t sscma_client_set_model_info(sscma_client_handle_t client, const char *model_info)
+{
+    esp_err_t ret = ESP_OK;
+    sscma_client_reply_t reply;
+    sscma_client_future_t future = NULL;
+    model_info_stream_t stream = {
+        .head = CMD_PREFIX CMD_AT_INFO CMD_SET "\"",
+        .tail = "\"" CMD_SUFFIX,
+    };
+
+    ESP_RETURN_ON_FALSE(model_info != NULL, ESP_ERR_INVALID_ARG, TAG, "model_info is NULL");
+
+    sscma_client_cache_erase(client);
+
+    stream.data = (const uint8_t *)model_info;
+    stream.data_len = strlen(model_info);
 
-    ESP_GOTO_ON_ERROR(sscma_client_request(client, cmd, &reply, true, CMD_WAIT_DELAY), set_model_info_exit, TAG, "request set model info failed");
+    ESP_RETURN_ON_ERROR(sscma_client_request_start(client, stream.head, model_info_fill, &stream, strlen(stream.head) + (stream.data_len + 2) / 3 * 4 + strlen(stream.tail), &future), TAG,
+        "request set model info failed");
+    ESP_RETURN_ON_ERROR(sscma_client_request_wait(client, future, &reply, CMD_WAIT_DELAY), TAG, "request set model info failed");
 
     if (reply.payload != NULL)
     {
@@ -1306,8 +3376,6 @@ esp_err_t sscma_client_set_model_info(sscma_client_handle_t client, const char *
         sscma_client_reply_clear(&reply);
     }
 
-set_model_info_exit:
-    free(cmd);
     return ret;
 }
 
@@ -1318,7 +3386,7 @@ esp_err_t sscma_utils_fetch_boxes_from_reply(const sscma_client_reply_t *reply,
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(boxes != NULL, ESP_ERR_INVALID_ARG, TAG, "boxes is NULL");
     ESP_RETURN_ON_FALSE(num_boxes != NULL, ESP_ERR_INVALID_ARG, TAG, "num_boxes is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *boxes = NULL;
     *num_boxes = 0;
@@ -1359,7 +3427,7 @@ esp_err_t sscma_utils_copy_boxes_from_reply(const sscma_client_reply_t *reply, s
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(boxes != NULL, ESP_ERR_INVALID_ARG, TAG, "classes is NULL");
     ESP_RETURN_ON_FALSE(num_boxes != NULL, ESP_ERR_INVALID_ARG, TAG, "num_classes is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *num_boxes = 0;
 
@@ -1396,7 +3464,7 @@ esp_err_t sscma_utils_fetch_classes_from_reply(const sscma_client_reply_t *reply
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(classes != NULL, ESP_ERR_INVALID_ARG, TAG, "classes is NULL");
     ESP_RETURN_ON_FALSE(num_classes != NULL, ESP_ERR_INVALID_ARG, TAG, "num_classes is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *classes = NULL;
     *num_classes = 0;
@@ -1433,7 +3501,7 @@ esp_err_t sscma_utils_copy_classes_from_reply(const sscma_client_reply_t *reply,
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(classes != NULL, ESP_ERR_INVALID_ARG, TAG, "classes is NULL");
     ESP_RETURN_ON_FALSE(num_classes != NULL, ESP_ERR_INVALID_ARG, TAG, "num_classes is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *num_classes = 0;
 
@@ -1467,7 +3535,7 @@ esp_err_t sscma_utils_fetch_points_from_reply(const sscma_client_reply_t *reply,
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(points != NULL, ESP_ERR_INVALID_ARG, TAG, "points is NULL");
     ESP_RETURN_ON_FALSE(num_points != NULL, ESP_ERR_INVALID_ARG, TAG, "num_points is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *points = NULL;
     *num_points = 0;
@@ -1507,7 +3575,7 @@ esp_err_t sscma_utils_copy_points_from_reply(const sscma_client_reply_t *reply,
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(points != NULL, ESP_ERR_INVALID_ARG, TAG, "points is NULL");
     ESP_RETURN_ON_FALSE(num_points != NULL, ESP_ERR_INVALID_ARG, TAG, "num_points is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *num_points = 0;
 
@@ -1545,7 +3613,7 @@ esp_err_t sscma_utils_fetch_keypoints_from_reply(const sscma_client_reply_t *rep
     ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
     ESP_RETURN_ON_FALSE(keypoints != NULL, ESP_ERR_INVALID_ARG, TAG, "keypoints is NULL");
     ESP_RETURN_ON_FALSE(num_keypoints != NULL, ESP_ERR_INVALID_ARG, TAG, "num_keypoints is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
 
     *keypoints = NULL;
     *num_keypoints = 0;
@@ -1563,108 +3631,344 @@ esp_err_t sscma_utils_fetch_keypoints_from_reply(const sscma_client_reply_t *rep
         ESP_RETURN_ON_FALSE(*keypoints != NULL, ESP_ERR_NO_MEM, TAG, "malloc keypoints failed");
         for (int i = 0; i < *num_keypoints; i++)
         {
-            cJSON *item = cJSON_GetArrayItem(keypoints_data, i);
-            if (item != NULL)
+            cJSON *item = cJSON_GetArrayItem(keypoints_data, i);
+            if (item != NULL)
+            {
+                cJSON *box = cJSON_GetArrayItem(item, 0);
+                cJSON *points = cJSON_GetArrayItem(item, 1);
+                if (box != NULL && points != NULL)
+                {
+                    (*keypoints)[i].box.x = get_int_from_array(box, 0);
+                    (*keypoints)[i].box.y = get_int_from_array(box, 1);
+                    (*keypoints)[i].box.w = get_int_from_array(box, 2);
+                    (*keypoints)[i].box.h = get_int_from_array(box, 3);
+                    (*keypoints)[i].box.score = get_int_from_array(box, 4);
+                    (*keypoints)[i].box.target = get_int_from_array(box, 5);
+                    (*keypoints)[i].points_num = cJSON_GetArraySize(points) > SSCMA_CLIENT_MODEL_KEYPOINTS_MAX ? SSCMA_CLIENT_MODEL_KEYPOINTS_MAX : cJSON_GetArraySize(points);
+                    for (int j = 0; j < (*keypoints)[i].points_num; j++)
+                    {
+                        cJSON *point = cJSON_GetArrayItem(points, j);
+                        if (point != NULL)
+                        {
+                            (*keypoints)[i].points[j].x = get_int_from_array(point, 0);
+                            (*keypoints)[i].points[j].y = get_int_from_array(point, 1);
+                            (*keypoints)[i].points[j].z = 0;
+                            (*keypoints)[i].points[j].score = get_int_from_array(point, 2);
+                            (*keypoints)[i].points[j].target = get_int_from_array(point, 3);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+esp_err_t sscma_utils_copy_keypoints_from_reply(const sscma_client_reply_t *reply, sscma_client_keypoint_t *keypoints, int max_keypoints, int *num_keypoints)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
+    ESP_RETURN_ON_FALSE(keypoints != NULL, ESP_ERR_INVALID_ARG, TAG, "keypoints is NULL");
+    ESP_RETURN_ON_FALSE(num_keypoints != NULL, ESP_ERR_INVALID_ARG, TAG, "num_keypoints is NULL");
+    ESP_RETURN_ON_FALSE(cJSON_IsObject(sscma_client_reply_get_payload(reply)), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+
+    *num_keypoints = 0;
+
+    cJSON *data = cJSON_GetObjectItem(reply->payload, "data");
+    if (data != NULL)
+    {
+        cJSON *keypoints_data = cJSON_GetObjectItem(data, "keypoints");
+        if (keypoints_data == NULL)
+            return ESP_OK;
+        *num_keypoints = cJSON_GetArraySize(keypoints_data) > max_keypoints ? max_keypoints : cJSON_GetArraySize(keypoints_data);
+
+        for (int i = 0; i < *num_keypoints; i++)
+        {
+            cJSON *item = cJSON_GetArrayItem(keypoints_data, i);
+            if (item != NULL)
+            {
+                cJSON *box = cJSON_GetArrayItem(item, 0);
+                cJSON *points = cJSON_GetArrayItem(item, 1);
+                if (box != NULL && points != NULL)
+                {
+                    keypoints[i].box.x = get_int_from_array(box, 0);
+                    keypoints[i].box.y = get_int_from_array(box, 1);
+                    keypoints[i].box.w = get_int_from_array(box, 2);
+                    keypoints[i].box.h = get_int_from_array(box, 3);
+                    keypoints[i].box.score = get_int_from_array(box, 4);
+                    keypoints[i].box.target = get_int_from_array(box, 5);
+                    keypoints[i].points_num = cJSON_GetArraySize(points) > SSCMA_CLIENT_MODEL_KEYPOINTS_MAX ? SSCMA_CLIENT_MODEL_KEYPOINTS_MAX : cJSON_GetArraySize(points);
+                    for (int j = 0; j < keypoints[i].points_num; j++)
+                    {
+                        cJSON *point = cJSON_GetArrayItem(points, j);
+                        if (point != NULL)
+                        {
+                            keypoints[i].points[j].x = get_int_from_array(point, 0);
+                            keypoints[i].points[j].y = get_int_from_array(point, 1);
+                            keypoints[i].points[j].z = 0;
+                            keypoints[i].points[j].score = get_int_from_array(point, 2);
+                            keypoints[i].points[j].target = get_int_from_array(point, 3);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+static void sscma_utils_decode_boxes(json_cursor_t *c, sscma_client_result_t *result)
+{
+    int v[6];
+
+    if (!json_accept(c, '['))
+    {
+        json_skip_value(c);
+        return;
+    }
+    while (json_array_next(c))
+    {
+        json_int_array(c, v, 6);
+        if (result->num_boxes < SSCMA_CLIENT_RESULT_MAX_BOXES)
+        {
+            sscma_client_box_t *box = &result->boxes[result->num_boxes++];
+            box->x = v[0];
+            box->y = v[1];
+            box->w = v[2];
+            box->h = v[3];
+            box->score = v[4];
+            box->target = v[5];
+        }
+        else
+        {
+            result->truncated = true;
+        }
+    }
+}
+
+static void sscma_utils_decode_classes(json_cursor_t *c, sscma_client_result_t *result)
+{
+    int v[2];
+
+    if (!json_accept(c, '['))
+    {
+        json_skip_value(c);
+        return;
+    }
+    while (json_array_next(c))
+    {
+        json_int_array(c, v, 2);
+        if (result->num_classes < SSCMA_CLIENT_RESULT_MAX_CLASSES)
+        {
+            sscma_client_class_t *class = &result->classes[result->num_classes++];
+            class->score = v[0];
+            class->target = v[1];
+        }
+        else
+        {
+            result->truncated = true;
+        }
+    }
+}
+
+static void sscma_utils_decode_point(json_cursor_t *c, sscma_client_point_t *point)
+{
+    int v[4];
+
+    json_int_array(c, v, 4);
+    if (point != NULL)
+    {
+        point->x = v[0];
+        point->y = v[1];
+        point->z = 0;
+        point->score = v[2];
+        point->target = v[3];
+    }
+}
+
+static void sscma_utils_decode_points(json_cursor_t *c, sscma_client_result_t *result)
+{
+    if (!json_accept(c, '['))
+    {
+        json_skip_value(c);
+        return;
+    }
+    while (json_array_next(c))
+    {
+        if (result->num_points < SSCMA_CLIENT_RESULT_MAX_POINTS)
+        {
+            sscma_utils_decode_point(c, &result->points[result->num_points++]);
+        }
+        else
+        {
+            sscma_utils_decode_point(c, NULL);
+            result->truncated = true;
+        }
+    }
+}
+
+static void sscma_utils_decode_keypoints(json_cursor_t *c, sscma_client_result_t *result)
+{
+    int v[6];
+
+    if (!json_accept(c, '['))
+    {
+        json_skip_value(c);
+        return;
+    }
+    while (json_array_next(c))
+    {
+        sscma_client_keypoint_t *keypoint = NULL;
+        if (result->num_keypoints < SSCMA_CLIENT_RESULT_MAX_KEYPOINTS)
+        {
+            keypoint = &result->keypoints[result->num_keypoints++];
+            keypoint->points_num = 0;
+        }
+        else
+        {
+            result->truncated = true;
+        }
+
+        // [[x, y, w, h, score, target], [[x, y, score, target], ...]]
+        if (!json_accept(c, '['))
+        {
+            json_skip_value(c);
+            continue;
+        }
+        for (int i = 0; json_array_next(c); i++)
+        {
+            if (i == 0)
             {
-                cJSON *box = cJSON_GetArrayItem(item, 0);
-                cJSON *points = cJSON_GetArrayItem(item, 1);
-                if (box != NULL && points != NULL)
+                json_int_array(c, v, 6);
+                if (keypoint != NULL)
                 {
-                    (*keypoints)[i].box.x = get_int_from_array(box, 0);
-                    (*keypoints)[i].box.y = get_int_from_array(box, 1);
-                    (*keypoints)[i].box.w = get_int_from_array(box, 2);
-                    (*keypoints)[i].box.h = get_int_from_array(box, 3);
-                    (*keypoints)[i].box.score = get_int_from_array(box, 4);
-                    (*keypoints)[i].box.target = get_int_from_array(box, 5);
-                    (*keypoints)[i].points_num = cJSON_GetArraySize(points) > SSCMA_CLIENT_MODEL_KEYPOINTS_MAX ? SSCMA_CLIENT_MODEL_KEYPOINTS_MAX : cJSON_GetArraySize(points);
-                    for (int j = 0; j < (*keypoints)[i].points_num; j++)
+                    keypoint->box.x = v[0];
+                    keypoint->box.y = v[1];
+                    keypoint->box.w = v[2];
+                    keypoint->box.h = v[3];
+                    keypoint->box.score = v[4];
+                    keypoint->box.target = v[5];
+                }
+            }
+            else if (i == 1 && json_accept(c, '['))
+            {
+                while (json_array_next(c))
+                {
+                    if (keypoint != NULL && keypoint->points_num < SSCMA_CLIENT_MODEL_KEYPOINTS_MAX)
                     {
-                        cJSON *point = cJSON_GetArrayItem(points, j);
-                        if (point != NULL)
-                        {
-                            (*keypoints)[i].points[j].x = get_int_from_array(point, 0);
-                            (*keypoints)[i].points[j].y = get_int_from_array(point, 1);
-                            (*keypoints)[i].points[j].z = 0;
-                            (*keypoints)[i].points[j].score = get_int_from_array(point, 2);
-                            (*keypoints)[i].points[j].target = get_int_from_array(point, 3);
-                        }
+                        sscma_utils_decode_point(c, &keypoint->points[keypoint->points_num++]);
+                    }
+                    else
+                    {
+                        sscma_utils_decode_point(c, NULL);
                     }
                 }
             }
+            else
+            {
+                json_skip_value(c);
+            }
+            if (c->error)
+            {
+                return;
+            }
         }
     }
-
-    return ret;
 }
 
-esp_err_t sscma_utils_copy_keypoints_from_reply(const sscma_client_reply_t *reply, sscma_client_keypoint_t *keypoints, int max_keypoints, int *num_keypoints)
+esp_err_t sscma_utils_decode_result(const sscma_client_reply_t *reply, sscma_client_result_t *result)
 {
-    esp_err_t ret = ESP_OK;
+    const char *key;
+    size_t key_len;
 
-    ESP_RETURN_ON_FALSE(reply != NULL, ESP_ERR_INVALID_ARG, TAG, "reply is NULL");
-    ESP_RETURN_ON_FALSE(keypoints != NULL, ESP_ERR_INVALID_ARG, TAG, "keypoints is NULL");
-    ESP_RETURN_ON_FALSE(num_keypoints != NULL, ESP_ERR_INVALID_ARG, TAG, "num_keypoints is NULL");
-    ESP_RETURN_ON_FALSE(cJSON_IsObject(reply->payload), ESP_ERR_INVALID_ARG, TAG, "reply is not object");
+    ESP_RETURN_ON_FALSE(reply && reply->data && result, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
 
-    *num_keypoints = 0;
+    json_cursor_t c = { .p = reply->data, .end = reply->data + reply->len, .error = false };
 
-    cJSON *data = cJSON_GetObjectItem(reply->payload, "data");
-    if (data != NULL)
-    {
-        cJSON *keypoints_data = cJSON_GetObjectItem(data, "keypoints");
-        if (keypoints_data == NULL)
-            return ESP_OK;
-        *num_keypoints = cJSON_GetArraySize(keypoints_data) > max_keypoints ? max_keypoints : cJSON_GetArraySize(keypoints_data);
+    result->num_boxes = 0;
+    result->num_classes = 0;
+    result->num_points = 0;
+    result->num_keypoints = 0;
+    result->image = NULL;
+    result->image_len = 0;
+    result->truncated = false;
 
-        for (int i = 0; i < *num_keypoints; i++)
+    if (!json_accept(&c, '{'))
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    while (json_object_next(&c, &key, &key_len))
+    {
+        if (JSON_KEY_IS(key, key_len, "data") && json_accept(&c, '{'))
         {
-            cJSON *item = cJSON_GetArrayItem(keypoints_data, i);
-            if (item != NULL)
+            while (json_object_next(&c, &key, &key_len))
             {
-                cJSON *box = cJSON_GetArrayItem(item, 0);
-                cJSON *points = cJSON_GetArrayItem(item, 1);
-                if (box != NULL && points != NULL)
+                if (JSON_KEY_IS(key, key_len, "boxes"))
                 {
-                    keypoints[i].box.x = get_int_from_array(box, 0);
-                    keypoints[i].box.y = get_int_from_array(box, 1);
-                    keypoints[i].box.w = get_int_from_array(box, 2);
-                    keypoints[i].box.h = get_int_from_array(box, 3);
-                    keypoints[i].box.score = get_int_from_array(box, 4);
-                    keypoints[i].box.target = get_int_from_array(box, 5);
-                    keypoints[i].points_num = cJSON_GetArraySize(points) > SSCMA_CLIENT_MODEL_KEYPOINTS_MAX ? SSCMA_CLIENT_MODEL_KEYPOINTS_MAX : cJSON_GetArraySize(points);
-                    for (int j = 0; j < keypoints[i].points_num; j++)
-                    {
-                        cJSON *point = cJSON_GetArrayItem(points, j);
-                        if (point != NULL)
-                        {
-                            keypoints[i].points[j].x = get_int_from_array(point, 0);
-                            keypoints[i].points[j].y = get_int_from_array(point, 1);
-                            keypoints[i].points[j].z = 0;
-                            keypoints[i].points[j].score = get_int_from_array(point, 2);
-                            keypoints[i].points[j].target = get_int_from_array(point, 3);
-                        }
-                    }
+                    sscma_utils_decode_boxes(&c, result);
+                }
+                else if (JSON_KEY_IS(key, key_len, "classes"))
+                {
+                    sscma_utils_decode_classes(&c, result);
+                }
+                else if (JSON_KEY_IS(key, key_len, "points"))
+                {
+                    sscma_utils_decode_points(&c, result);
+                }
+                else if (JSON_KEY_IS(key, key_len, "keypoints"))
+                {
+                    sscma_utils_decode_keypoints(&c, result);
+                }
+                else if (JSON_KEY_IS(key, key_len, "image"))
+                {
+                    json_string(&c, &result->image, &result->image_len);
+                }
+                else
+                {
+                    json_skip_value(&c);
+                }
+                if (c.error)
+                {
+                    break;
                 }
             }
         }
+        else
+        {
+            json_skip_value(&c);
+        }
+        if (c.error)
+        {
+            break;
+        }
     }
 
-    return ret;
+    return c.error ? ESP_ERR_INVALID_RESPONSE : ESP_OK;
 }
 
-esp_err_t sscma_utils_fetch_image_from_reply(const sscma_client_reply_t *reply, char **image, int *image_size)
+/**
+ * Find the base64 image of a reply. The in-place span is used when it holds
+ * no escapes (the common case), otherwise the cJSON string is used.
+ */
+static esp_err_t sscma_utils_locate_image(const sscma_client_reply_t *reply, const char **image, size_t *image_len)
 {
-    ESP_RETURN_ON_FALSE(reply && image && image_size, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
-
-    *image = NULL;
-    *image_size = 0;
+    if (reply->index.image != NULL && memchr(reply->index.image, '\\', reply->index.image_len) == NULL)
+    {
+        *image = reply->index.image;
+        *image_len = reply->index.image_len;
+        return ESP_OK;
+    }
 
-    if (!cJSON_IsObject(reply->payload))
+    cJSON *payload = sscma_client_reply_get_payload(reply);
+    if (!cJSON_IsObject(payload))
     {
         return ESP_ERR_INVALID_ARG;
     }
 
-    cJSON *data = cJSON_GetObjectItem(reply->payload, "data");
+    cJSON *data = cJSON_GetObjectItem(payload, "data");
     if (!data)
     {
         return ESP_FAIL;
@@ -1682,53 +3986,93 @@ esp_err_t sscma_utils_fetch_image_from_reply(const sscma_client_reply_t *reply,
         return ESP_FAIL;
     }
 
-    *image = __strdup(image_str);
+    *image = image_str;
+    *image_len = strlen(image_str);
+
+    return ESP_OK;
+}
+
+esp_err_t sscma_utils_fetch_image_from_reply(const sscma_client_reply_t *reply, char **image, int *image_size)
+{
+    esp_err_t ret = ESP_OK;
+    const char *image_str = NULL;
+    size_t image_str_len = 0;
+
+    ESP_RETURN_ON_FALSE(reply && image && image_size, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    *image = NULL;
+    *image_size = 0;
+
+    ret = sscma_utils_locate_image(reply, &image_str, &image_str_len);
+    if (ret != ESP_OK)
+    {
+        return ret;
+    }
+
+    *image = __malloc(image_str_len + 1);
     if (!(*image))
     {
         return ESP_ERR_NO_MEM;
     }
+    memcpy(*image, image_str, image_str_len);
+    (*image)[image_str_len] = '\0';
 
-    *image_size = strlen(image_str);
+    *image_size = image_str_len;
 
     return ESP_OK;
 }
 
 esp_err_t sscma_utils_copy_image_from_reply(const sscma_client_reply_t *reply, char *image, int max_image_size, int *image_size)
 {
+    esp_err_t ret = ESP_OK;
+    const char *image_str = NULL;
+    size_t image_str_len = 0;
+
     ESP_RETURN_ON_FALSE(reply && image && image_size, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
 
-    if (!cJSON_IsObject(reply->payload))
+    ret = sscma_utils_locate_image(reply, &image_str, &image_str_len);
+    if (ret != ESP_OK)
     {
-        return ESP_ERR_INVALID_ARG;
+        return ret;
     }
 
-    cJSON *data = cJSON_GetObjectItem(reply->payload, "data");
-    if (!data)
+    if (image_str_len > max_image_size)
     {
-        return ESP_FAIL;
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    cJSON *image_data = cJSON_GetObjectItem(data, "image");
-    if (!image_data)
-    {
-        return ESP_FAIL;
-    }
+    *image_size = image_str_len;
+    memcpy(image, image_str, image_str_len);
+    image[image_str_len] = '\0';
 
-    const char *image_str = cJSON_GetStringValue(image_data);
-    if (!image_str)
+    return ESP_OK;
+}
+
+esp_err_t sscma_utils_decode_image_from_reply(const sscma_client_reply_t *reply, uint8_t *jpeg, size_t max_jpeg_size, size_t *jpeg_size)
+{
+    esp_err_t ret = ESP_OK;
+    const char *image_str = NULL;
+    size_t image_str_len = 0;
+
+    ESP_RETURN_ON_FALSE(reply && jpeg && jpeg_size, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    *jpeg_size = 0;
+
+    ret = sscma_utils_locate_image(reply, &image_str, &image_str_len);
+    if (ret != ESP_OK)
     {
-        return ESP_FAIL;
+        return ret;
     }
 
-    size_t image_str_len = strlen(image_str);
-    if (image_str_len > max_image_size)
+    int err = mbedtls_base64_decode(jpeg, max_jpeg_size, jpeg_size, (const unsigned char *)image_str, image_str_len);
+    if (err != 0)
     {
-        return ESP_ERR_INVALID_SIZE;
+        *jpeg_size = 0;
+        ESP_RETURN_ON_FALSE(err != MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL, ESP_ERR_INVALID_SIZE, TAG, "jpeg buffer too small");
+        ESP_LOGE(TAG, "decode image failed: %d", err);
+        return ESP_ERR_INVALID_RESPONSE;
     }
 
-    *image_size = image_str_len;
-    strcpy(image, image_str);
-
     return ESP_OK;
 }
 
@@ -1744,6 +4088,9 @@ esp_err_t sscma_client_ota_start(sscma_client_handle_t client, const sscma_clien
     }
     client->flasher = flasher;
 
+    // the image may replace the firmware or the model behind the cached info
+    sscma_client_cache_erase(client);
+
     sscma_client_reset(client);
 
     sscma_client_break(client);
@@ -1803,4 +4150,268 @@ esp_err_t sscma_client_ota_abort(sscma_client_handle_t client)
 err:
     vTaskResume(client->process_task.handle);
     return ret;
-}
\ No newline at end of file
+}
+typedef enum
+{
+    OTA_CHECKSUM_NONE,
+    OTA_CHECKSUM_CRC32,
+    OTA_CHECKSUM_MD5,
+    OTA_CHECKSUM_SHA256,
+} ota_checksum_type_t;
+
+typedef struct
+{
+    size_t index; /* !< Buffer index */
+    size_t len;   /* !< Bytes in the buffer, 0 once the file is exhausted */
+} ota_chunk_t;
+
+typedef struct
+{
+    FILE *file;                        /* !< Image file */
+    char *buffers[2];                  /* !< Ping-pong buffers */
+    size_t chunk_size;                 /* !< Capacity of each buffer */
+    QueueHandle_t free;                /* !< Buffers owned by the reader */
+    QueueHandle_t full;                /* !< Buffers owned by the writer */
+    TaskHandle_t caller;               /* !< Task notified when the reader exits */
+    volatile bool abort;               /* !< Writer asks the reader to stop */
+    esp_err_t status;                  /* !< Reader result */
+    ota_checksum_type_t checksum_type; /* !< Checksum algorithm */
+    uint32_t crc;                      /* !< Running CRC32 */
+    mbedtls_md_context_t md;           /* !< Running MD5 / SHA256 */
+    uint8_t digest[32];                /* !< Final checksum, big-endian */
+    size_t digest_len;                 /* !< Length of digest */
+} ota_file_ctx_t;
+
+static ota_checksum_type_t ota_checksum_type(const char *checksum, size_t *hex_len)
+{
+    if (checksum == NULL || *checksum == '\0')
+    {
+        return OTA_CHECKSUM_NONE;
+    }
+    if (strncmp(checksum, "0x", 2) == 0 || strncmp(checksum, "0X", 2) == 0)
+    {
+        checksum += 2;
+    }
+    *hex_len = strspn(checksum, "0123456789abcdefABCDEF");
+    if (checksum[*hex_len] != '\0')
+    {
+        return (ota_checksum_type_t)-1;
+    }
+    switch (*hex_len)
+    {
+        case 8:
+            return OTA_CHECKSUM_CRC32;
+        case 32:
+            return OTA_CHECKSUM_MD5;
+        case 64:
+            return OTA_CHECKSUM_SHA256;
+        default:
+            return (ota_checksum_type_t)-1;
+    }
+}
+
+static bool ota_checksum_match(const ota_file_ctx_t *ctx, const char *checksum)
+{
+    char hex[sizeof(ctx->digest) * 2 + 1];
+
+    if (strncmp(checksum, "0x", 2) == 0 || strncmp(checksum, "0X", 2) == 0)
+    {
+        checksum += 2;
+    }
+    for (size_t i = 0; i < ctx->digest_len; i++)
+    {
+        snprintf(hex + i * 2, 3, "%02x", ctx->digest[i]);
+    }
+
+    return strcasecmp(hex, checksum) == 0;
+}
+
+static void ota_file_reader(void *arg)
+{
+    ota_file_ctx_t *ctx = (ota_file_ctx_t *)arg;
+    ota_chunk_t chunk = { 0 };
+
+    while (xQueueReceive(ctx->free, &chunk.index, portMAX_DELAY) == pdTRUE)
+    {
+        if (ctx->abort)
+        {
+            chunk.len = 0;
+            break;
+        }
+        chunk.len = fread(ctx->buffers[chunk.index], 1, ctx->chunk_size, ctx->file);
+        if (chunk.len == 0)
+        {
+            if (ferror(ctx->file))
+            {
+                ctx->status = ESP_FAIL;
+            }
+            break;
+        }
+        switch (ctx->checksum_type)
+        {
+            case OTA_CHECKSUM_CRC32:
+                ctx->crc = esp_rom_crc32_le(ctx->crc, (const uint8_t *)ctx->buffers[chunk.index], chunk.len);
+                break;
+            case OTA_CHECKSUM_MD5:
+            case OTA_CHECKSUM_SHA256:
+                mbedtls_md_update(&ctx->md, (const unsigned char *)ctx->buffers[chunk.index], chunk.len);
+                break;
+            default:
+                break;
+        }
+        // the flasher takes whole XMODEM blocks
+        if (chunk.len % 128 != 0)
+        {
+            size_t pad = 128 - chunk.len % 128;
+            memset(ctx->buffers[chunk.index] + chunk.len, 0xFF, pad);
+            chunk.len += pad;
+        }
+        xQueueSend(ctx->full, &chunk, portMAX_DELAY);
+    }
+
+    switch (ctx->checksum_type)
+    {
+        case OTA_CHECKSUM_CRC32:
+            ctx->digest[0] = ctx->crc >> 24;
+            ctx->digest[1] = ctx->crc >> 16;
+            ctx->digest[2] = ctx->crc >> 8;
+            ctx->digest[3] = ctx->crc;
+            ctx->digest_len = 4;
+            break;
+        case OTA_CHECKSUM_MD5:
+        case OTA_CHECKSUM_SHA256:
+            mbedtls_md_finish(&ctx->md, ctx->digest);
+            ctx->digest_len = ctx->checksum_type == OTA_CHECKSUM_MD5 ? 16 : 32;
+            break;
+        default:
+            break;
+    }
+
+    chunk.len = 0;
+    xQueueSend(ctx->full, &chunk, portMAX_DELAY);
+    xTaskNotifyGive(ctx->caller);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sscma_client_ota_from_file(sscma_client_handle_t client, const sscma_client_flasher_handle_t flasher, const sscma_client_ota_file_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+    ota_file_ctx_t ctx = { 0 };
+    ota_chunk_t chunk = { 0 };
+    size_t hex_len = 0;
+    size_t total = 0;
+    size_t written = 0;
+    int64_t start = 0;
+    uint32_t throughput = 0;
+    bool started = false;
+
+    ESP_RETURN_ON_FALSE(client && flasher && config && config->path, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    ctx.checksum_type = ota_checksum_type(config->checksum, &hex_len);
+    ESP_RETURN_ON_FALSE(ctx.checksum_type != (ota_checksum_type_t)-1, ESP_ERR_NOT_SUPPORTED, TAG, "unknown checksum format: %s", config->checksum);
+    if (ctx.checksum_type == OTA_CHECKSUM_MD5 || ctx.checksum_type == OTA_CHECKSUM_SHA256)
+    {
+        mbedtls_md_init(&ctx.md);
+        ESP_GOTO_ON_FALSE(mbedtls_md_setup(&ctx.md, mbedtls_md_info_from_type(ctx.checksum_type == OTA_CHECKSUM_MD5 ? MBEDTLS_MD_MD5 : MBEDTLS_MD_SHA256), 0) == 0, ESP_ERR_NO_MEM, err, TAG,
+            "setup checksum failed");
+        mbedtls_md_starts(&ctx.md);
+    }
+
+    ctx.file = fopen(config->path, "rb");
+    ESP_GOTO_ON_FALSE(ctx.file, ESP_ERR_NOT_FOUND, err, TAG, "open %s failed", config->path);
+    fseek(ctx.file, 0, SEEK_END);
+    total = ftell(ctx.file);
+    fseek(ctx.file, 0, SEEK_SET);
+
+    ctx.chunk_size = config->chunk_size > 0 ? (config->chunk_size + 127) & ~(size_t)127 : SSCMA_CLIENT_OTA_CHUNK_SIZE;
+    for (size_t i = 0; i < 2; i++)
+    {
+        ctx.buffers[i] = heap_caps_malloc(ctx.chunk_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_GOTO_ON_FALSE(ctx.buffers[i], ESP_ERR_NO_MEM, err, TAG, "no mem for ota buffer");
+    }
+    ctx.free = xQueueCreate(2, sizeof(size_t));
+    ctx.full = xQueueCreate(2, sizeof(ota_chunk_t));
+    ESP_GOTO_ON_FALSE(ctx.free && ctx.full, ESP_ERR_NO_MEM, err, TAG, "no mem for ota queues");
+    for (size_t i = 0; i < 2; i++)
+    {
+        xQueueSend(ctx.free, &i, 0);
+    }
+
+    ESP_GOTO_ON_ERROR(sscma_client_ota_start(client, flasher, config->offset), err, TAG, "start ota failed");
+    started = true;
+
+    ctx.caller = xTaskGetCurrentTaskHandle();
+    ctx.status = ESP_OK;
+    ESP_GOTO_ON_FALSE(xTaskCreate(ota_file_reader, "sscma_ota_reader", 4096, &ctx, uxTaskPriorityGet(NULL), NULL) == pdPASS, ESP_ERR_NO_MEM, err, TAG, "create reader task failed");
+
+    start = esp_timer_get_time();
+    while (xQueueReceive(ctx.full, &chunk, portMAX_DELAY) == pdTRUE && chunk.len > 0)
+    {
+        if (ret == ESP_OK)
+        {
+            ret = sscma_client_ota_write(client, ctx.buffers[chunk.index], chunk.len);
+            if (ret != ESP_OK)
+            {
+                // sscma_client_ota_write() has aborted the transfer, drain the reader
+                ctx.abort = true;
+                started = false;
+            }
+            else
+            {
+                written = written + chunk.len > total ? total : written + chunk.len;
+                throughput = (uint64_t)written * 1000000 / (esp_timer_get_time() - start + 1);
+                if (config->on_progress)
+                {
+                    config->on_progress(client, written, total, throughput, config->user_ctx);
+                }
+            }
+        }
+        xQueueSend(ctx.free, &chunk.index, portMAX_DELAY);
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "write ota failed");
+    ESP_GOTO_ON_ERROR(ctx.status, err, TAG, "read %s failed", config->path);
+    if (ctx.checksum_type != OTA_CHECKSUM_NONE && !ota_checksum_match(&ctx, config->checksum))
+    {
+        ESP_LOGE(TAG, "checksum mismatch, expected %s", config->checksum);
+        ret = ESP_ERR_INVALID_CRC;
+        goto err;
+    }
+
+    started = false;
+    ESP_GOTO_ON_ERROR(sscma_client_ota_finish(client), err, TAG, "finish ota failed");
+
+    ESP_LOGI(TAG, "ota %s: %u bytes in %lld ms, %lu B/s", config->path, (unsigned)total, (long long)((esp_timer_get_time() - start) / 1000), (unsigned long)throughput);
+
+err:
+    if (started)
+    {
+        sscma_client_ota_abort(client);
+    }
+    if (ctx.checksum_type == OTA_CHECKSUM_MD5 || ctx.checksum_type == OTA_CHECKSUM_SHA256)
+    {
+        mbedtls_md_free(&ctx.md);
+    }
+    if (ctx.free)
+    {
+        vQueueDelete(ctx.free);
+    }
+    if (ctx.full)
+    {
+        vQueueDelete(ctx.full);
+    }
+    for (size_t i = 0; i < 2; i++)
+    {
+        if (ctx.buffers[i])
+        {
+            heap_caps_free(ctx.buffers[i]);
+        }
+    }
+    if (ctx.file)
+    {
+        fclose(ctx.file);
+    }
+
+    return ret;
+}
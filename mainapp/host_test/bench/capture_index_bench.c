@@ -0,0 +1,242 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "capture_index.h"
+
+/*
+ * Fills a directory with captures and times capture_index_load() the way the
+ * card sees it across boots: no index, a valid index, a stale index after a
+ * crash, and captures removed from the card on a PC. Each load is checked
+ * against the real count and size of the captures. An estimate is then
+ * recounted the way the writer task does and must come out exact.
+ */
+
+#define BENCH_PREFIX        "image-"
+#define BENCH_VALID_RUNS    100
+#define BENCH_RECOUNT_BATCH 32
+
+typedef struct
+{
+    char dir[64];
+    int captures;
+    int size;
+    uint32_t next;
+    uint32_t count;
+    uint64_t bytes;
+} bench_t;
+
+static int capture_size(const bench_t *bench, uint32_t seq)
+{
+    // JPEG sizes vary with the scene, spread them over size / 2 .. size * 3 / 2
+    return bench->size / 2 + (int)((seq * 2654435761u) % (uint32_t)bench->size);
+}
+
+static void capture_path(const bench_t *bench, uint32_t seq, char *path, size_t len)
+{
+    snprintf(path, len, "%s/" BENCH_PREFIX "%lu", bench->dir, (unsigned long)seq);
+}
+
+static void capture_add(bench_t *bench)
+{
+    char path[96];
+    capture_path(bench, bench->next, path, sizeof(path));
+
+    // sparse, only the size matters
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, capture_size(bench, bench->next)) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+
+    bench->bytes += capture_size(bench, bench->next);
+    bench->count++;
+    bench->next++;
+}
+
+static void capture_remove(bench_t *bench, uint32_t seq)
+{
+    char path[96];
+    capture_path(bench, seq, path, sizeof(path));
+    if (unlink(path) == 0)
+    {
+        bench->bytes -= capture_size(bench, seq);
+        bench->count--;
+    }
+}
+
+static void card_from_pc(const bench_t *bench)
+{
+    // the card comes back from the PC later than the last save, with the directory stamped
+    struct stat st;
+    stat(bench->dir, &st);
+    struct utimbuf times = { .actime = st.st_atime, .modtime = st.st_mtime + 60 };
+    utime(bench->dir, &times);
+}
+
+static bool recount(const bench_t *bench, capture_index_t *index)
+{
+    capture_index_recount_t recount = { .end = index->next };
+
+    int64_t start = esp_timer_get_time();
+    while (!capture_index_recount(bench->dir, BENCH_PREFIX, index, &recount, BENCH_RECOUNT_BATCH))
+    {
+    }
+    double ms = (esp_timer_get_time() - start) / 1000.0;
+
+    index->bytes = index->bytes - index->estimated + recount.bytes;
+    index->estimated = 0;
+    capture_index_save(bench->dir, index);
+
+    bool exact = index->bytes == bench->bytes;
+    printf("%-22s %8.3f ms  %-7s bytes %s\n", "  recount", ms, "", exact ? "exact" : "BAD");
+
+    return exact;
+}
+
+static bool load(const bench_t *bench, const char *what, int runs)
+{
+    capture_index_t index;
+    bool rebuilt = false;
+    esp_err_t ret = ESP_OK;
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < runs && ret == ESP_OK; i++)
+    {
+        ret = capture_index_load(bench->dir, BENCH_PREFIX, &index, &rebuilt);
+    }
+    double ms = (esp_timer_get_time() - start) / 1000.0 / runs;
+
+    if (ret != ESP_OK)
+    {
+        printf("%-22s %s\n", what, esp_err_to_name(ret));
+        return false;
+    }
+
+    double error = bench->bytes ? 100.0 * ((double)index.bytes - (double)bench->bytes) / (double)bench->bytes : 0.0;
+    printf("%-22s %8.3f ms  %-7s count %5lu%s  next %5lu%s  bytes %+6.2f%%\n", what, ms, rebuilt ? "rebuilt" : "loaded", (unsigned long)index.count,
+        index.count == bench->count ? " ok" : " BAD", (unsigned long)index.next, index.next == bench->next ? " ok" : " BAD", error);
+
+    bool ok = index.count == bench->count && index.next == bench->next;
+    if (index.estimated > 0)
+    {
+        ok = recount(bench, &index) && ok;
+    }
+    else if (index.bytes != bench->bytes)
+    {
+        printf("%-22s bytes BAD\n", "");
+        ok = false;
+    }
+
+    return ok;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-n captures] [-m capture_bytes] [-d dir]\n", name);
+    printf("  -d  existing empty directory to fill, a new one in /tmp by default\n");
+}
+
+int main(int argc, char **argv)
+{
+    bench_t bench = {
+        .captures = 10000,
+        .size = 24 * 1024,
+        .next = 1,
+    };
+    const char *dir = NULL;
+    bool ok = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:m:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            bench.captures = atoi(optarg);
+            break;
+        case 'm':
+            bench.size = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    esp_log_level_set("*", ESP_LOG_ERROR);
+
+    if (dir)
+    {
+        snprintf(bench.dir, sizeof(bench.dir), "%s", dir);
+    }
+    else
+    {
+        snprintf(bench.dir, sizeof(bench.dir), "/tmp/capture_index_XXXXXX");
+        if (mkdtemp(bench.dir) == NULL)
+        {
+            perror(bench.dir);
+            return 1;
+        }
+    }
+
+    // a fresh card, the directory is created and numbering starts at 1
+    bench_t fresh = bench;
+    snprintf(fresh.dir, sizeof(fresh.dir), "%s/fresh", bench.dir);
+    ok = load(&fresh, "no directory", 1) && ok;
+
+    for (int i = 0; i < bench.captures; i++)
+    {
+        capture_add(&bench);
+    }
+    printf("%s: %d captures of %d..%d bytes, sample of %d\n", bench.dir, bench.captures, bench.size / 2, bench.size * 3 / 2, CAPTURE_INDEX_SAMPLES);
+
+    ok = load(&bench, "no index", 1) && ok;
+    ok = load(&bench, "valid index", BENCH_VALID_RUNS) && ok;
+
+    // a crash between writing a capture and saving the index
+    capture_add(&bench);
+    ok = load(&bench, "stale index", 1) && ok;
+
+    capture_remove(&bench, bench.next / 2);
+    card_from_pc(&bench);
+    ok = load(&bench, "removed on a PC", 1) && ok;
+
+    // a filesystem that does not stamp the directory is still caught at either end
+    capture_remove(&bench, 1);
+    ok = load(&bench, "oldest removed", 1) && ok;
+    capture_remove(&bench, bench.next - 1);
+    bench.next--;
+    ok = load(&bench, "newest removed", 1) && ok;
+    ok = load(&bench, "valid again", BENCH_VALID_RUNS) && ok;
+
+    if (dir == NULL)
+    {
+        char path[96];
+        for (uint32_t seq = 1; seq < bench.next; seq++)
+        {
+            capture_path(&bench, seq, path, sizeof(path));
+            unlink(path);
+        }
+        snprintf(path, sizeof(path), "%s/.index", fresh.dir);
+        unlink(path);
+        rmdir(fresh.dir);
+        snprintf(path, sizeof(path), "%s/.index", bench.dir);
+        unlink(path);
+        rmdir(bench.dir);
+    }
+
+    return ok ? 0 : 1;
+}
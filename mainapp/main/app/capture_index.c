@@ -0,0 +1,314 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_rom_crc.h"
+
+#include "capture_index.h"
+
+#define CAPTURE_INDEX_FILE     ".index"
+#define CAPTURE_INDEX_TMP_FILE ".index.tmp"
+#define CAPTURE_INDEX_MAGIC    0x33444943 // "CID3"
+#define CAPTURE_INDEX_PATH_MAX 96
+#define CAPTURE_INDEX_MTIME_SLACK 2 // seconds, FAT stamps files with a 2 s resolution
+
+static const char *TAG = "capture_index";
+
+typedef struct
+{
+    uint32_t magic;
+    capture_index_t index;
+    int64_t dir_mtime; // modification time of the directory when the index was saved
+    uint32_t crc;      // CRC32 of index and dir_mtime
+} capture_index_file_t;
+
+static uint32_t capture_index_crc(const capture_index_file_t *file)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&file->index, sizeof(file->index));
+
+    return esp_rom_crc32_le(crc, (const uint8_t *)&file->dir_mtime, sizeof(file->dir_mtime));
+}
+
+static bool capture_index_read(const char *path, capture_index_t *index, int64_t *dir_mtime)
+{
+    capture_index_file_t file;
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    size_t len = fread(&file, 1, sizeof(file), f);
+    fclose(f);
+
+    if (len != sizeof(file) || file.magic != CAPTURE_INDEX_MAGIC || file.crc != capture_index_crc(&file))
+    {
+        ESP_LOGW(TAG, "%s is corrupted", path);
+        return false;
+    }
+
+    *index = file.index;
+    *dir_mtime = file.dir_mtime;
+
+    return true;
+}
+
+static bool capture_index_exists(const char *dir, const char *prefix, uint32_t seq)
+{
+    char path[CAPTURE_INDEX_PATH_MAX];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/%s%lu", dir, prefix, (unsigned long)seq);
+
+    return stat(path, &st) == 0;
+}
+
+static bool capture_index_changed(const char *dir, const char *prefix, const char *path, const capture_index_t *index, int64_t dir_mtime)
+{
+    struct stat dir_st;
+    struct stat index_st;
+
+    if (stat(dir, &dir_st) != 0 || stat(path, &index_st) != 0)
+    {
+        return true;
+    }
+
+    // FatFs never stamps a directory, a PC does on every change. Where our own saves stamp it too, the last one is the index itself
+    if (dir_st.st_mtime != dir_mtime && llabs((long long)(dir_st.st_mtime - index_st.st_mtime)) > CAPTURE_INDEX_MTIME_SLACK)
+    {
+        return true;
+    }
+
+    // catches the oldest or the newest captures removed when the directory is not stamped
+    return index->count > 0 && (!capture_index_exists(dir, prefix, index->first) || !capture_index_exists(dir, prefix, index->next - 1));
+}
+
+static bool capture_index_parse(const char *name, const char *prefix, size_t prefix_len, uint32_t *seq)
+{
+    char *end = NULL;
+
+    if (strncmp(name, prefix, prefix_len) != 0 || name[prefix_len] < '0' || name[prefix_len] > '9')
+    {
+        return false;
+    }
+
+    unsigned long value = strtoul(&name[prefix_len], &end, 10);
+    if (*end != '\0')
+    {
+        return false;
+    }
+
+    *seq = (uint32_t)value;
+
+    return true;
+}
+
+static esp_err_t capture_index_rebuild(const char *dir, const char *prefix, capture_index_t *index, uint32_t *samples, size_t *num_samples)
+{
+    size_t prefix_len = strlen(prefix);
+    uint32_t first = UINT32_MAX;
+    uint32_t last = 0;
+    uint32_t count = 0;
+    uint32_t stride = 1;
+    struct dirent *entry;
+
+    DIR *d = opendir(dir);
+    if (d == NULL && errno == ENOENT)
+    {
+        // a fresh card has no capture directory yet
+        ESP_RETURN_ON_FALSE(mkdir(dir, 0775) == 0, ESP_FAIL, TAG, "create %s failed", dir);
+        d = opendir(dir);
+    }
+    ESP_RETURN_ON_FALSE(d, ESP_ERR_NOT_FOUND, TAG, "open %s failed", dir);
+
+    // names only, a stat per capture would be another directory lookup each
+    while ((entry = readdir(d)) != NULL)
+    {
+        uint32_t seq = 0;
+        if (!capture_index_parse(entry->d_name, prefix, prefix_len, &seq))
+        {
+            continue;
+        }
+
+        // every stride-th capture, the stride doubles whenever the samples fill up
+        if (count % stride == 0 && *num_samples == CAPTURE_INDEX_SAMPLES)
+        {
+            for (size_t i = 0; i < CAPTURE_INDEX_SAMPLES / 2; i++)
+            {
+                samples[i] = samples[i * 2];
+            }
+            *num_samples = CAPTURE_INDEX_SAMPLES / 2;
+            stride *= 2;
+        }
+        if (count % stride == 0)
+        {
+            samples[(*num_samples)++] = seq;
+        }
+
+        count++;
+        first = seq < first ? seq : first;
+        last = seq > last ? seq : last;
+    }
+    closedir(d);
+
+    // numbering starts at 1, as it always has on the card
+    index->next = count > 0 ? last + 1 : 1;
+    index->first = count > 0 ? first : index->next;
+    index->count = count;
+
+    return ESP_OK;
+}
+
+esp_err_t capture_index_load(const char *dir, const char *prefix, capture_index_t *index, bool *rebuilt)
+{
+    char path[CAPTURE_INDEX_PATH_MAX];
+    struct stat st;
+    int64_t dir_mtime = 0;
+    bool valid = false;
+
+    ESP_RETURN_ON_FALSE(dir && prefix && index, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    memset(index, 0, sizeof(capture_index_t));
+
+    snprintf(path, sizeof(path), "%s/" CAPTURE_INDEX_FILE, dir);
+    valid = capture_index_read(path, index, &dir_mtime);
+    if (!valid)
+    {
+        // a save may have stopped between removing the index and renaming the synced temporary file
+        snprintf(path, sizeof(path), "%s/" CAPTURE_INDEX_TMP_FILE, dir);
+        valid = capture_index_read(path, index, &dir_mtime);
+    }
+
+    if (valid && capture_index_changed(dir, prefix, path, index, dir_mtime))
+    {
+        ESP_LOGW(TAG, "%s was changed outside the index", dir);
+        valid = false;
+    }
+    else if (valid && index->estimated > 0)
+    {
+        // the recount never finished, the captures it covered are no longer known
+        valid = false;
+    }
+    else if (valid)
+    {
+        if (!capture_index_exists(dir, prefix, index->next))
+        {
+            if (rebuilt)
+            {
+                *rebuilt = false;
+            }
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "index of %s is stale", dir);
+    }
+
+    capture_index_t found = { 0 };
+    uint32_t samples[CAPTURE_INDEX_SAMPLES];
+    size_t num_samples = 0;
+    ESP_RETURN_ON_ERROR(capture_index_rebuild(dir, prefix, &found, samples, &num_samples), TAG, "rebuild index failed");
+
+    if (valid)
+    {
+        // captures past the stale index are the few written after its last update
+        for (uint32_t seq = index->next; seq < found.next; seq++)
+        {
+            snprintf(path, sizeof(path), "%s/%s%lu", dir, prefix, (unsigned long)seq);
+            if (stat(path, &st) == 0)
+            {
+                index->bytes += st.st_size;
+            }
+        }
+    }
+    else
+    {
+        // a stat is another directory lookup, so only a sample of the captures is sized
+        uint64_t bytes = 0;
+        size_t sized = 0;
+        for (size_t i = 0; i < num_samples; i++)
+        {
+            snprintf(path, sizeof(path), "%s/%s%lu", dir, prefix, (unsigned long)samples[i]);
+            if (stat(path, &st) == 0)
+            {
+                bytes += st.st_size;
+                sized++;
+            }
+        }
+        index->bytes = sized > 0 ? bytes * found.count / sized : 0;
+        index->estimated = sized < found.count ? index->bytes : 0;
+    }
+    index->first = found.first;
+    index->next = found.next;
+    index->count = found.count;
+
+    if (rebuilt)
+    {
+        *rebuilt = true;
+    }
+
+    return capture_index_save(dir, index);
+}
+
+bool capture_index_recount(const char *dir, const char *prefix, const capture_index_t *index, capture_index_recount_t *recount, uint32_t batch)
+{
+    char path[CAPTURE_INDEX_PATH_MAX];
+    struct stat st;
+
+    if (recount->seq < index->first)
+    {
+        recount->seq = index->first;
+    }
+
+    for (; batch > 0 && recount->seq < recount->end; batch--, recount->seq++)
+    {
+        snprintf(path, sizeof(path), "%s/%s%lu", dir, prefix, (unsigned long)recount->seq);
+        if (stat(path, &st) == 0)
+        {
+            recount->bytes += st.st_size;
+        }
+    }
+
+    return recount->seq >= recount->end;
+}
+
+esp_err_t capture_index_save(const char *dir, const capture_index_t *index)
+{
+    char path[CAPTURE_INDEX_PATH_MAX];
+    char tmp[CAPTURE_INDEX_PATH_MAX];
+    struct stat st;
+
+    ESP_RETURN_ON_FALSE(dir && index, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+    ESP_RETURN_ON_FALSE(stat(dir, &st) == 0, ESP_ERR_NOT_FOUND, TAG, "stat %s failed", dir);
+
+    capture_index_file_t file = {
+        .magic = CAPTURE_INDEX_MAGIC,
+        .index = *index,
+        .dir_mtime = st.st_mtime,
+    };
+    file.crc = capture_index_crc(&file);
+
+    snprintf(path, sizeof(path), "%s/" CAPTURE_INDEX_FILE, dir);
+    snprintf(tmp, sizeof(tmp), "%s/" CAPTURE_INDEX_TMP_FILE, dir);
+
+    FILE *f = fopen(tmp, "wb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "open %s failed", tmp);
+    bool ok = fwrite(&file, 1, sizeof(file), f) == sizeof(file) && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    fclose(f);
+    ESP_RETURN_ON_FALSE(ok, ESP_FAIL, TAG, "write %s failed", tmp);
+
+    // FAT does not rename over an existing file, the synced temporary file covers the gap
+    unlink(path);
+    ESP_RETURN_ON_FALSE(rename(tmp, path) == 0, ESP_FAIL, TAG, "rename %s failed", tmp);
+
+    return ESP_OK;
+}
@@ -0,0 +1,98 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAPTURE_INDEX_SAMPLES 16 // captures whose size is read when the bytes are estimated
+
+/**
+ * @brief Capture index, kept next to the captures so boot does not have to look them up
+ */
+typedef struct
+{
+    uint32_t first;     /*!< Sequence number of the oldest capture */
+    uint32_t next;      /*!< Sequence number of the next capture */
+    uint32_t count;     /*!< Captures in the directory */
+    uint64_t bytes;     /*!< Total size of the captures */
+    uint64_t estimated; /*!< Part of bytes estimated from a sample of the captures, 0 once they are all sized */
+} capture_index_t;
+
+/**
+ * @brief Exact recount of the estimated bytes of an index, done a batch of captures at a time
+ */
+typedef struct
+{
+    uint32_t seq;   /*!< Next capture to size */
+    uint32_t end;   /*!< First capture not covered by the estimate */
+    uint64_t bytes; /*!< Size of the captures sized so far */
+} capture_index_recount_t;
+
+/**
+ * @brief Load the capture index of a directory
+ *
+ * The index is stale when a capture numbered next already exists, a crash hit between writing the capture
+ * and updating the index. It is out of date when the directory was changed elsewhere: its modification time
+ * differs from the one saved with the index, or the first or the last capture is gone. A missing, stale or
+ * out of date index is rebuilt from a single readdir pass over the directory. A missing directory is created
+ * and starts an empty index, whose first capture is numbered 1.
+ *
+ * A rebuild counts every capture exactly. Captures past a stale index are added to its bytes. Otherwise the
+ * bytes are estimated from the size of up to CAPTURE_INDEX_SAMPLES captures spread over the directory and
+ * the estimate is kept in estimated, see capture_index_recount(). With capture sizes spread by half either
+ * way, the estimate has come out up to 20% off, so treat it as a rough figure until the recount. An index
+ * loaded with an estimate is rebuilt, since captures written after the estimate are already counted exactly.
+ *
+ * @param[in] dir Directory holding the captures
+ * @param[in] prefix File name prefix of the captures, followed by the sequence number
+ * @param[out] index Index
+ * @param[out] rebuilt Whether the index had to be rebuilt, may be NULL
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NOT_FOUND if the directory cannot be read
+ *          - ESP_FAIL if the directory cannot be created or the index cannot be saved
+ */
+esp_err_t capture_index_load(const char *dir, const char *prefix, capture_index_t *index, bool *rebuilt);
+
+/**
+ * @brief Size the next batch of captures whose bytes were estimated
+ *
+ * Start with recount seq and bytes at 0 and end at index next once the index is loaded, and call it until it
+ * returns true. Then replace the estimate: bytes = bytes - estimated + recount bytes, and clear estimated.
+ * Each capture is a stat, so a few thousand take seconds on an SD card.
+ *
+ * @param[in] dir Directory holding the captures
+ * @param[in] prefix File name prefix of the captures, followed by the sequence number
+ * @param[in] index Index holding the estimate
+ * @param[in,out] recount Recount state
+ * @param[in] batch Captures to size in this call
+ * @return Whether every capture below recount end is sized
+ */
+bool capture_index_recount(const char *dir, const char *prefix, const capture_index_t *index, capture_index_recount_t *recount, uint32_t batch);
+
+/**
+ * @brief Save the capture index of a directory
+ *
+ * Writes and syncs a temporary file and renames it over the index, the previous index stays intact until then.
+ * The modification time of the directory is saved along, see capture_index_load().
+ *
+ * @param[in] dir Directory holding the captures
+ * @param[in] index Index
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t capture_index_save(const char *dir, const capture_index_t *index);
+
+#ifdef __cplusplus
+}
+#endif
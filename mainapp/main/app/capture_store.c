@@ -0,0 +1,314 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "capture_store.h"
+
+#define CAPTURE_STORE_WRITE_CHUNK   (16 * 1024) // multiple of the sector size, written from DMA-capable memory
+#define CAPTURE_STORE_RATE_WINDOW   8           // completed captures the rate is measured over
+#define CAPTURE_STORE_RECOUNT_BATCH 32          // captures sized between two looks at the queue
+
+static const char *TAG = "capture_store";
+
+typedef struct
+{
+    char path[CAPTURE_STORE_PATH_MAX];
+    uint8_t *data; // JPEG, released once written
+    size_t size;
+} capture_job_t;
+
+static struct
+{
+    QueueHandle_t jobs;               // Captures waiting for the writer
+    uint8_t *stage;                   // DMA-capable staging for fwrite, NULL to write straight from PSRAM
+    char dir[CAPTURE_STORE_PATH_MAX]; // Directory of the captures, empty for no index
+    char prefix[16];                  // File name prefix of the captures
+    uint32_t next;                    // Next sequence number handed out
+    capture_index_recount_t recount;  // Exact size of the captures the loaded index estimated
+    portMUX_TYPE lock;                // Guards the statistics, the index and next
+    capture_store_stats_t stats;
+    uint64_t submit_total_us;
+    uint32_t submits;
+    uint64_t write_total_us;
+    int64_t done_us[CAPTURE_STORE_RATE_WINDOW];
+    uint32_t done;
+} s_store = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void capture_store_submitted(int64_t start, bool queued)
+{
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    portENTER_CRITICAL(&s_store.lock);
+    s_store.submits++;
+    s_store.submit_total_us += elapsed;
+    if (elapsed > s_store.stats.submit_max_us)
+    {
+        s_store.stats.submit_max_us = elapsed;
+    }
+    if (!queued)
+    {
+        s_store.stats.dropped++;
+    }
+    portEXIT_CRITICAL(&s_store.lock);
+}
+
+static bool capture_store_seq_of(const char *path, uint32_t *seq)
+{
+    const char *name = strrchr(path, '/');
+    size_t len = strlen(s_store.prefix);
+    char *end = NULL;
+
+    name = name ? name + 1 : path;
+    if (strncmp(name, s_store.prefix, len) != 0)
+    {
+        return false;
+    }
+    *seq = (uint32_t)strtoul(&name[len], &end, 10);
+
+    return end != &name[len];
+}
+
+static esp_err_t capture_store_write(const char *path, const uint8_t *data, size_t size)
+{
+    size_t done = 0;
+
+    FILE *f = fopen(path, "wb");
+    ESP_RETURN_ON_FALSE(f, ESP_FAIL, TAG, "open %s failed", path);
+
+    // every write is a whole chunk already, skip the stdio copy
+    setvbuf(f, NULL, _IONBF, 0);
+
+    while (done < size)
+    {
+        size_t len = size - done > CAPTURE_STORE_WRITE_CHUNK ? CAPTURE_STORE_WRITE_CHUNK : size - done;
+        const uint8_t *src = data + done;
+        if (s_store.stage)
+        {
+            memcpy(s_store.stage, src, len);
+            src = s_store.stage;
+        }
+        if (fwrite(src, 1, len, f) != len)
+        {
+            break;
+        }
+        done += len;
+    }
+
+    bool ok = done == size && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    fclose(f);
+
+    ESP_RETURN_ON_FALSE(ok, ESP_FAIL, TAG, "write %s failed", path);
+
+    return ESP_OK;
+}
+
+static void capture_store_recount(void)
+{
+    capture_index_t index;
+
+    portENTER_CRITICAL(&s_store.lock);
+    index = s_store.stats.index;
+    portEXIT_CRITICAL(&s_store.lock);
+
+    if (!capture_index_recount(s_store.dir, s_store.prefix, &index, &s_store.recount, CAPTURE_STORE_RECOUNT_BATCH))
+    {
+        return;
+    }
+
+    // captures written since the load were added exactly, only the estimate is replaced
+    portENTER_CRITICAL(&s_store.lock);
+    s_store.stats.index.bytes = s_store.stats.index.bytes - s_store.stats.index.estimated + s_store.recount.bytes;
+    s_store.stats.index.estimated = 0;
+    index = s_store.stats.index;
+    portEXIT_CRITICAL(&s_store.lock);
+
+    capture_index_save(s_store.dir, &index);
+
+    ESP_LOGI(TAG, "capture index recounted: %llu bytes", (unsigned long long)index.bytes);
+}
+
+static void capture_store_task(void *arg)
+{
+    capture_job_t job;
+
+    while (true)
+    {
+        // captures come first, an estimated index is sized a batch at a time while the queue is empty
+        if (xQueueReceive(s_store.jobs, &job, s_store.stats.index.estimated > 0 ? 1 : portMAX_DELAY) != pdTRUE)
+        {
+            capture_store_recount();
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        size_t jpeg_size = job.size;
+        esp_err_t ret = capture_store_write(job.path, job.data, jpeg_size);
+
+        free(job.data);
+
+        int64_t end = esp_timer_get_time();
+        uint32_t seq = 0;
+        bool has_seq = capture_store_seq_of(job.path, &seq);
+        capture_index_t index = { 0 };
+
+        portENTER_CRITICAL(&s_store.lock);
+        if (ret == ESP_OK)
+        {
+            // the saved index only moves past captures that are on the card
+            if (has_seq && s_store.stats.index.count == 0)
+            {
+                s_store.stats.index.first = seq;
+            }
+            s_store.stats.index.count++;
+            s_store.stats.index.bytes += jpeg_size;
+            if (has_seq && seq >= s_store.stats.index.next)
+            {
+                s_store.stats.index.next = seq + 1;
+            }
+            index = s_store.stats.index;
+            s_store.stats.written++;
+            s_store.stats.bytes += jpeg_size;
+            s_store.write_total_us += end - start;
+            s_store.done_us[s_store.done % CAPTURE_STORE_RATE_WINDOW] = end;
+            s_store.done++;
+        }
+        else
+        {
+            s_store.stats.failed++;
+        }
+        portEXIT_CRITICAL(&s_store.lock);
+
+        if (ret == ESP_OK && s_store.dir[0] != '\0')
+        {
+            capture_index_save(s_store.dir, &index);
+        }
+
+        ESP_LOGD(TAG, "%s: %u bytes in %lld us", job.path, (unsigned)jpeg_size, (long long)(end - start));
+    }
+}
+
+esp_err_t capture_store_init(const capture_store_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+    BaseType_t res;
+
+    ESP_RETURN_ON_FALSE(config && config->queue_depth > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+    ESP_RETURN_ON_FALSE(s_store.jobs == NULL, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    if (config->dir)
+    {
+        bool rebuilt = false;
+        int64_t start = esp_timer_get_time();
+        snprintf(s_store.dir, sizeof(s_store.dir), "%s", config->dir);
+        snprintf(s_store.prefix, sizeof(s_store.prefix), "%s", config->prefix ? config->prefix : "");
+        ESP_GOTO_ON_ERROR(capture_index_load(s_store.dir, s_store.prefix, &s_store.stats.index, &rebuilt), err, TAG, "load capture index failed");
+        s_store.next = s_store.stats.index.next;
+        s_store.recount.end = s_store.stats.index.next;
+        ESP_LOGI(TAG, "capture index %s in %lld ms: next %lu, %lu captures, %llu bytes", rebuilt ? "rebuilt" : "loaded", (long long)((esp_timer_get_time() - start) / 1000),
+            (unsigned long)s_store.stats.index.next, (unsigned long)s_store.stats.index.count, (unsigned long long)s_store.stats.index.bytes);
+    }
+
+    s_store.jobs = xQueueCreate(config->queue_depth, sizeof(capture_job_t));
+    ESP_GOTO_ON_FALSE(s_store.jobs, ESP_ERR_NO_MEM, err, TAG, "no mem for job queue");
+
+    // the SD driver bounces PSRAM writes sector by sector, a DMA-capable chunk goes out in one transfer
+    s_store.stage = heap_caps_aligned_alloc(4, CAPTURE_STORE_WRITE_CHUNK, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    if (s_store.stage == NULL)
+    {
+        ESP_LOGW(TAG, "no internal mem for staging, writing from PSRAM");
+    }
+
+    if (config->task_affinity < 0)
+    {
+        res = xTaskCreate(capture_store_task, "capture_store", config->task_stack, NULL, config->task_priority, NULL);
+    }
+    else
+    {
+        res = xTaskCreatePinnedToCore(capture_store_task, "capture_store", config->task_stack, NULL, config->task_priority, NULL, config->task_affinity);
+    }
+    ESP_GOTO_ON_FALSE(res == pdPASS, ESP_FAIL, err, TAG, "create writer task failed");
+
+    return ESP_OK;
+
+err:
+    s_store.dir[0] = '\0';
+    free(s_store.stage);
+    s_store.stage = NULL;
+    if (s_store.jobs)
+    {
+        vQueueDelete(s_store.jobs);
+        s_store.jobs = NULL;
+    }
+    return ret;
+}
+
+esp_err_t capture_store_reserve_path(char *path, size_t size)
+{
+    uint32_t seq = 0;
+
+    ESP_RETURN_ON_FALSE(path && size > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+    ESP_RETURN_ON_FALSE(s_store.dir[0] != '\0', ESP_ERR_INVALID_STATE, TAG, "no capture directory");
+
+    portENTER_CRITICAL(&s_store.lock);
+    seq = s_store.next++;
+    portEXIT_CRITICAL(&s_store.lock);
+
+    snprintf(path, size, "%s/%s%lu", s_store.dir, s_store.prefix, (unsigned long)seq);
+
+    return ESP_OK;
+}
+
+esp_err_t capture_store_submit(const char *path, uint8_t *jpeg, size_t size)
+{
+    capture_job_t job = { 0 };
+    int64_t start = esp_timer_get_time();
+
+    ESP_RETURN_ON_FALSE(path && jpeg && size > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+    ESP_RETURN_ON_FALSE(s_store.jobs, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    snprintf(job.path, sizeof(job.path), "%s", path);
+    job.data = jpeg;
+    job.size = size;
+
+    bool queued = xQueueSend(s_store.jobs, &job, 0) == pdTRUE;
+    capture_store_submitted(start, queued);
+
+    return queued ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t capture_store_get_stats(capture_store_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    portENTER_CRITICAL(&s_store.lock);
+    *stats = s_store.stats;
+    stats->submit_avg_us = s_store.submits ? (uint32_t)(s_store.submit_total_us / s_store.submits) : 0;
+    stats->write_avg_us = s_store.stats.written ? (uint32_t)(s_store.write_total_us / s_store.stats.written) : 0;
+    if (s_store.done >= 2)
+    {
+        uint32_t n = s_store.done < CAPTURE_STORE_RATE_WINDOW ? s_store.done : CAPTURE_STORE_RATE_WINDOW;
+        int64_t last = s_store.done_us[(s_store.done - 1) % CAPTURE_STORE_RATE_WINDOW];
+        int64_t first = s_store.done_us[(s_store.done - n) % CAPTURE_STORE_RATE_WINDOW];
+        stats->captures_per_sec = last > first ? (float)(n - 1) * 1000000.0f / (float)(last - first) : 0.0f;
+    }
+    portEXIT_CRITICAL(&s_store.lock);
+
+    return ESP_OK;
+}
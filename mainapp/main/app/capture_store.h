@@ -0,0 +1,102 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "capture_index.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAPTURE_STORE_PATH_MAX 64
+
+/**
+ * @brief Capture storage configuration
+ */
+typedef struct
+{
+    const char *dir;    /*!< Directory of the captures, holds the capture index (NULL for no index) */
+    const char *prefix; /*!< File name prefix of the captures, followed by the sequence number */
+    int queue_depth;    /*!< Captures waiting for the SD card before new ones are rejected */
+    int task_priority;  /*!< Writer task priority */
+    int task_stack;     /*!< Writer task stack size */
+    int task_affinity;  /*!< Writer task pinned to core (-1 is no affinity) */
+} capture_store_config_t;
+
+#define CAPTURE_STORE_CONFIG_DEFAULT()                                                                                  \
+    {                                                                                                                   \
+        .dir = NULL, .prefix = "image-", .queue_depth = 2, .task_priority = 2, .task_stack = 4096, .task_affinity = -1, \
+    }
+
+/**
+ * @brief Capture storage statistics
+ */
+typedef struct
+{
+    uint32_t written;       /*!< Files written and synced */
+    uint32_t failed;        /*!< Files that could not be written */
+    uint32_t dropped;       /*!< Captures rejected because the queue was full */
+    uint64_t bytes;         /*!< JPEG bytes written */
+    float captures_per_sec; /*!< Files written per second over the last few captures */
+    uint32_t submit_avg_us; /*!< Average time a producer spent in a submit call */
+    uint32_t submit_max_us; /*!< Longest time a producer spent in a submit call */
+    uint32_t write_avg_us;  /*!< Average time to write and sync a file */
+    capture_index_t index;  /*!< Capture index as last saved */
+} capture_store_stats_t;
+
+/**
+ * @brief Start the capture writer task
+ *
+ * @param[in] config Storage configuration
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t capture_store_init(const capture_store_config_t *config);
+
+/**
+ * @brief Reserve the path of the next capture
+ *
+ * Sequence numbers come from the capture index, which the writer task updates after each capture.
+ *
+ * @param[out] path File path
+ * @param[in] size Size of path
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_INVALID_STATE if the store has no directory
+ */
+esp_err_t capture_store_reserve_path(char *path, size_t size);
+
+/**
+ * @brief Queue a JPEG to be written to a file
+ *
+ * Takes ownership of jpeg on success, it is released with free() once written.
+ *
+ * @param[in] path File path
+ * @param[in] jpeg JPEG data
+ * @param[in] size JPEG size
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NO_MEM if the queue is full, jpeg stays with the caller
+ */
+esp_err_t capture_store_submit(const char *path, uint8_t *jpeg, size_t size);
+
+/**
+ * @brief Get capture storage statistics
+ *
+ * @param[out] stats Statistics
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t capture_store_get_stats(capture_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,178 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#include "jpeg_decoder.h"
+
+static const char *TAG = "jpeg_decoder";
+
+struct jpeg_decoder_t
+{
+    jpeg_dec_config_t config;     // Configuration the handle was opened with
+    bool dirty;                   // Configuration changed, reopen before the next frame
+    jpeg_dec_handle_t *handle;    // Underlying decoder, NULL until the first frame
+    jpeg_dec_io_t io;             // IO control, reused for every frame
+    jpeg_dec_header_info_t *info; // Header info, a few KiB of tables kept off the stack
+    int width;                    // Resolution the handle last decoded
+    int height;                   // Resolution the handle last decoded
+    jpeg_decoder_stats_t stats;
+    uint64_t decode_total_us;
+};
+
+static esp_err_t jpeg_decoder_open(jpeg_decoder_handle_t dec)
+{
+    int64_t start = esp_timer_get_time();
+
+    if (dec->handle)
+    {
+        jpeg_dec_close(dec->handle);
+        dec->handle = NULL;
+    }
+
+    dec->handle = jpeg_dec_open(&dec->config);
+    ESP_RETURN_ON_FALSE(dec->handle, ESP_ERR_NO_MEM, TAG, "open jpeg decoder failed");
+
+    dec->dirty = false;
+    dec->width = 0;
+    dec->height = 0;
+    dec->stats.opens++;
+    dec->stats.setup_us = (uint32_t)(esp_timer_get_time() - start);
+
+    return ESP_OK;
+}
+
+static esp_err_t jpeg_decoder_parse(jpeg_decoder_handle_t dec, const uint8_t *jpeg, size_t len)
+{
+    dec->io.inbuf = (unsigned char *)jpeg;
+    dec->io.inbuf_len = len;
+    dec->io.inbuf_remain = 0;
+    dec->io.outbuf = NULL;
+
+    ESP_RETURN_ON_FALSE(jpeg_dec_parse_header(dec->handle, &dec->io, dec->info) == JPEG_ERR_OK, ESP_ERR_INVALID_RESPONSE, TAG, "parse jpeg header failed");
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_decoder_new(const jpeg_dec_config_t *config, jpeg_decoder_handle_t *ret_dec)
+{
+    ESP_RETURN_ON_FALSE(config && ret_dec, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    jpeg_decoder_handle_t dec = calloc(1, sizeof(struct jpeg_decoder_t));
+    ESP_RETURN_ON_FALSE(dec, ESP_ERR_NO_MEM, TAG, "no mem for jpeg decoder");
+
+    dec->info = heap_caps_calloc(1, sizeof(jpeg_dec_header_info_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (dec->info == NULL)
+    {
+        free(dec);
+        ESP_LOGE(TAG, "no mem for jpeg header info");
+        return ESP_ERR_NO_MEM;
+    }
+
+    dec->config = *config;
+    dec->dirty = true;
+    *ret_dec = dec;
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_decoder_set_config(jpeg_decoder_handle_t dec, const jpeg_dec_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(dec && config, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    if (dec->config.output_type != config->output_type || dec->config.rotate != config->rotate)
+    {
+        dec->config = *config;
+        dec->dirty = true;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_decoder_decode(jpeg_decoder_handle_t dec, const uint8_t *jpeg, size_t len, uint8_t *out, size_t out_size, int *width, int *height)
+{
+    esp_err_t ret = ESP_OK;
+    int64_t start = esp_timer_get_time();
+
+    ESP_RETURN_ON_FALSE(dec && jpeg && len > 0 && out, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    if (dec->handle == NULL || dec->dirty)
+    {
+        ESP_GOTO_ON_ERROR(jpeg_decoder_open(dec), err, TAG, "configure jpeg decoder failed");
+    }
+
+    ESP_GOTO_ON_ERROR(jpeg_decoder_parse(dec, jpeg, len), err, TAG, "parse failed");
+
+    if (dec->width != dec->info->width || dec->height != dec->info->height)
+    {
+        if (dec->width != 0)
+        {
+            // the handle was set up for another resolution, start over with a fresh one
+            ESP_GOTO_ON_ERROR(jpeg_decoder_open(dec), err, TAG, "reconfigure jpeg decoder failed");
+            ESP_GOTO_ON_ERROR(jpeg_decoder_parse(dec, jpeg, len), err, TAG, "parse failed");
+        }
+        dec->width = dec->info->width;
+        dec->height = dec->info->height;
+    }
+
+    size_t pixel = dec->config.output_type == JPEG_RAW_TYPE_RGB888 ? 3 : 2;
+    ESP_GOTO_ON_FALSE((size_t)dec->width * dec->height * pixel <= out_size, ESP_ERR_INVALID_SIZE, err, TAG, "picture %dx%d too large", dec->width, dec->height);
+
+    dec->io.outbuf = out;
+    dec->io.inbuf = (unsigned char *)jpeg + (dec->io.inbuf_len - dec->io.inbuf_remain);
+    dec->io.inbuf_len = dec->io.inbuf_remain;
+    ESP_GOTO_ON_FALSE(jpeg_dec_process(dec->handle, &dec->io) == JPEG_ERR_OK, ESP_ERR_INVALID_RESPONSE, err, TAG, "decode jpeg failed");
+
+    if (width)
+    {
+        *width = dec->width;
+    }
+    if (height)
+    {
+        *height = dec->height;
+    }
+
+    dec->stats.frames++;
+    dec->stats.width = dec->width;
+    dec->stats.height = dec->height;
+    dec->decode_total_us += esp_timer_get_time() - start;
+
+    return ESP_OK;
+
+err:
+    // the handle may be left mid-stream or sized for a picture that never decoded, the next frame reopens it
+    dec->dirty = true;
+    return ret;
+}
+
+esp_err_t jpeg_decoder_get_stats(jpeg_decoder_handle_t dec, jpeg_decoder_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(dec && stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    *stats = dec->stats;
+    stats->decode_us = dec->stats.frames ? (uint32_t)(dec->decode_total_us / dec->stats.frames) : 0;
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_decoder_del(jpeg_decoder_handle_t dec)
+{
+    ESP_RETURN_ON_FALSE(dec, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    if (dec->handle)
+    {
+        jpeg_dec_close(dec->handle);
+    }
+    free(dec->info);
+    free(dec);
+
+    return ESP_OK;
+}
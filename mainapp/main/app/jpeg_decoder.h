@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_jpeg_dec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct jpeg_decoder_t *jpeg_decoder_handle_t; /*!< Type of persistent JPEG decoder handle */
+
+/**
+ * @brief JPEG decoder statistics
+ */
+typedef struct
+{
+    uint32_t frames;    /*!< Frames decoded */
+    uint32_t opens;     /*!< Times the underlying decoder was (re)configured */
+    uint32_t setup_us;  /*!< Cost of the last (re)configuration, saved on every frame that reuses it */
+    uint32_t decode_us; /*!< Average header parse and decode time */
+    int width;          /*!< Width of the last decoded picture */
+    int height;         /*!< Height of the last decoded picture */
+} jpeg_decoder_stats_t;
+
+/**
+ * @brief Create a persistent JPEG decoder
+ *
+ * The decoder handle, its IO and header structs live across frames and are only reconfigured
+ * when the output format or the resolution changes.
+ *
+ * @param[in] config Decoder configuration
+ * @param[out] ret_dec Decoder handle
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NO_MEM if out of memory
+ */
+esp_err_t jpeg_decoder_new(const jpeg_dec_config_t *config, jpeg_decoder_handle_t *ret_dec);
+
+/**
+ * @brief Change the decoder configuration, the decoder is reopened on the next frame if it differs
+ *
+ * @param[in] dec Decoder handle
+ * @param[in] config Decoder configuration
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t jpeg_decoder_set_config(jpeg_decoder_handle_t dec, const jpeg_dec_config_t *config);
+
+/**
+ * @brief Decode one JPEG picture
+ *
+ * @param[in] dec Decoder handle
+ * @param[in] jpeg JPEG data
+ * @param[in] len JPEG size
+ * @param[out] out Output buffer, 16 byte aligned
+ * @param[in] out_size Size of out
+ * @param[out] width Picture width, may be NULL
+ * @param[out] height Picture height, may be NULL
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_INVALID_SIZE if the picture does not fit in out
+ *          - ESP_ERR_INVALID_RESPONSE if the picture cannot be decoded
+ */
+esp_err_t jpeg_decoder_decode(jpeg_decoder_handle_t dec, const uint8_t *jpeg, size_t len, uint8_t *out, size_t out_size, int *width, int *height);
+
+/**
+ * @brief Get decoder statistics
+ *
+ * @param[in] dec Decoder handle
+ * @param[out] stats Statistics
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t jpeg_decoder_get_stats(jpeg_decoder_handle_t dec, jpeg_decoder_stats_t *stats);
+
+/**
+ * @brief Delete a persistent JPEG decoder
+ *
+ * @param[in] dec Decoder handle
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t jpeg_decoder_del(jpeg_decoder_handle_t dec);
+
+#ifdef __cplusplus
+}
+#endif
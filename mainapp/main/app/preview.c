@@ -0,0 +1,324 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_lvgl_port.h"
+
+#include "preview.h"
+#include "jpeg_decoder.h"
+#include "sscma_client_ops.h"
+
+#define PREVIEW_FRAME_ALIGN 16 // alignment the SIMD JPEG decoder writes at full speed
+#define PREVIEW_JPEG_SLOTS  3  // producer, pending and decoding JPEG of a reply image
+
+static const char *TAG = "preview";
+
+static struct
+{
+    lv_obj_t *image;                        // Image object the frames are shown on
+    TaskHandle_t task;                      // Decode task
+    int buffers;                            // RGB565 frame buffers in use
+    size_t frame_size;                      // Size of each frame buffer
+    uint8_t *frames[PREVIEW_MAX_BUFFERS];   // RGB565 frame buffers
+    lv_img_dsc_t dsc[PREVIEW_MAX_BUFFERS];  // Image descriptor of each frame buffer
+    int front;                              // Frame buffer LVGL shows, -1 before the first frame
+    uint8_t *jpeg[PREVIEW_JPEG_SLOTS];      // JPEG decoded from reply images
+    size_t jpeg_len[PREVIEW_JPEG_SLOTS];    // Length of each JPEG
+    size_t max_size;                        // Largest base64 image accepted
+    size_t jpeg_size;                       // Size of each JPEG slot
+    int write_idx;                          // Slot owned by the producer
+    int pending_idx;                        // Latest complete slot
+    int decode_idx;                         // Slot owned by the decode task
+    bool pending_full;                      // Whether pending_idx holds an undecoded frame
+    jpeg_decoder_handle_t decoder;          // JPEG decoder kept open across frames
+    volatile bool video;                    // Frames go straight to the panel
+    lv_area_t osd[LVGL_PORT_VIDEO_OSD_MAX]; // Areas LVGL keeps drawing in video mode
+    int osd_count;                          // Number of OSD areas
+    portMUX_TYPE lock;                      // Guards the slot indexes and the statistics
+    preview_stats_t stats;
+    uint64_t decode_total_us;
+    uint64_t lock_total_us;
+    int64_t window_us;
+    uint32_t window_frames;
+} s_preview = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+    .front = -1,
+};
+
+static esp_err_t preview_decode_jpeg(const uint8_t *jpeg, size_t len, int index)
+{
+    int width = 0;
+    int height = 0;
+
+    ESP_RETURN_ON_ERROR(jpeg_decoder_decode(s_preview.decoder, jpeg, len, s_preview.frames[index], s_preview.frame_size, &width, &height), TAG, "decode frame failed");
+
+    s_preview.dsc[index].header.w = width;
+    s_preview.dsc[index].header.h = height;
+    s_preview.dsc[index].data_size = (uint32_t)width * height * 2;
+
+    return ESP_OK;
+}
+
+static void preview_swap(int back)
+{
+    int64_t now = 0;
+    uint32_t held = 0;
+
+    // in video mode the frame is pushed to the panel before returning, held covers the whole transfer
+    int64_t start = esp_timer_get_time();
+    if (!s_preview.video || lvgl_port_video_draw(lv_obj_get_disp(s_preview.image), s_preview.frames[back], s_preview.dsc[back].header.w, s_preview.dsc[back].header.h) != ESP_OK)
+    {
+        // the back buffer is complete, LVGL only has to be pointed at it
+        lvgl_port_lock(0);
+        start = esp_timer_get_time();
+        lv_img_set_src(s_preview.image, &s_preview.dsc[back]);
+        lv_obj_invalidate(s_preview.image);
+        lvgl_port_unlock();
+    }
+    now = esp_timer_get_time();
+
+    held = (uint32_t)(now - start);
+
+    portENTER_CRITICAL(&s_preview.lock);
+    s_preview.front = back;
+    s_preview.stats.shown++;
+    s_preview.lock_total_us += held;
+    if (held > s_preview.stats.lock_max_us)
+    {
+        s_preview.stats.lock_max_us = held;
+    }
+    s_preview.window_frames++;
+    if (now - s_preview.window_us >= 1000000)
+    {
+        s_preview.stats.fps = s_preview.window_us > 0 ? (float)s_preview.window_frames * 1000000.0f / (float)(now - s_preview.window_us) : 0.0f;
+        s_preview.window_us = now;
+        s_preview.window_frames = 0;
+    }
+    portEXIT_CRITICAL(&s_preview.lock);
+}
+
+static void preview_task(void *arg)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        bool full = false;
+        portENTER_CRITICAL(&s_preview.lock);
+        if (s_preview.pending_full)
+        {
+            int idx = s_preview.decode_idx;
+            s_preview.decode_idx = s_preview.pending_idx;
+            s_preview.pending_idx = idx;
+            s_preview.pending_full = false;
+            full = true;
+        }
+        portEXIT_CRITICAL(&s_preview.lock);
+        if (!full)
+        {
+            continue;
+        }
+
+        // never decode into the buffer LVGL is showing
+        int back = (s_preview.front + 1) % s_preview.buffers;
+        int64_t start = esp_timer_get_time();
+        size_t jpeg_len = s_preview.jpeg_len[s_preview.decode_idx];
+        esp_err_t ret = preview_decode_jpeg(s_preview.jpeg[s_preview.decode_idx], jpeg_len, back);
+
+        uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+        if (ret != ESP_OK)
+        {
+            portENTER_CRITICAL(&s_preview.lock);
+            s_preview.stats.failed++;
+            portEXIT_CRITICAL(&s_preview.lock);
+            continue;
+        }
+
+        portENTER_CRITICAL(&s_preview.lock);
+        s_preview.decode_total_us += elapsed;
+        portEXIT_CRITICAL(&s_preview.lock);
+
+        preview_swap(back);
+
+        if (s_preview.stats.shown == 1)
+        {
+            jpeg_decoder_stats_t decoder;
+            jpeg_decoder_get_stats(s_preview.decoder, &decoder);
+            ESP_LOGI(TAG, "jpeg decoder set up in %u us at %dx%d, reused for every following frame, decode %u us", (unsigned)decoder.setup_us, decoder.width, decoder.height,
+                (unsigned)decoder.decode_us);
+        }
+
+        ESP_LOGD(TAG, "frame %u bytes, decode %u us, %.1f fps", (unsigned)jpeg_len, (unsigned)elapsed, s_preview.stats.fps);
+    }
+}
+
+esp_err_t preview_init(const preview_config_t *config)
+{
+    esp_err_t ret = ESP_OK;
+    BaseType_t res;
+
+    ESP_RETURN_ON_FALSE(config && config->image && config->width > 0 && config->height > 0 && config->max_size > 0, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+    ESP_RETURN_ON_FALSE(config->buffers >= 2 && config->buffers <= PREVIEW_MAX_BUFFERS, ESP_ERR_INVALID_ARG, TAG, "2 to %d buffers", PREVIEW_MAX_BUFFERS);
+    ESP_RETURN_ON_FALSE(config->osd_count >= 0 && config->osd_count <= LVGL_PORT_VIDEO_OSD_MAX && (config->osd_count == 0 || config->osd), ESP_ERR_INVALID_ARG, TAG, "up to %d OSD areas", LVGL_PORT_VIDEO_OSD_MAX);
+    ESP_RETURN_ON_FALSE(s_preview.task == NULL, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    s_preview.image = config->image;
+    s_preview.buffers = config->buffers;
+    s_preview.frame_size = (size_t)config->width * config->height * 2;
+    s_preview.max_size = config->max_size;
+    s_preview.jpeg_size = config->max_size / 4 * 3 + 3;
+    s_preview.osd_count = config->osd_count;
+    for (int i = 0; i < config->osd_count; i++)
+    {
+        s_preview.osd[i] = config->osd[i];
+    }
+
+    for (int i = 0; i < s_preview.buffers; i++)
+    {
+        s_preview.frames[i] = heap_caps_aligned_alloc(PREVIEW_FRAME_ALIGN, s_preview.frame_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_GOTO_ON_FALSE(s_preview.frames[i], ESP_ERR_NO_MEM, err, TAG, "no mem for frame buffer");
+        s_preview.dsc[i].header.always_zero = 0;
+        s_preview.dsc[i].header.cf = LV_IMG_CF_TRUE_COLOR;
+        s_preview.dsc[i].header.w = config->width;
+        s_preview.dsc[i].header.h = config->height;
+        s_preview.dsc[i].data_size = s_preview.frame_size;
+        s_preview.dsc[i].data = s_preview.frames[i];
+    }
+
+    for (int i = 0; i < PREVIEW_JPEG_SLOTS; i++)
+    {
+        s_preview.jpeg[i] = heap_caps_malloc(s_preview.jpeg_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_GOTO_ON_FALSE(s_preview.jpeg[i], ESP_ERR_NO_MEM, err, TAG, "no mem for jpeg buffer");
+    }
+    s_preview.write_idx = 0;
+    s_preview.pending_idx = 1;
+    s_preview.decode_idx = 2;
+
+    jpeg_dec_config_t decoder_config = { .output_type = JPEG_RAW_TYPE_RGB565_BE, .rotate = JPEG_ROTATE_0D };
+    ESP_GOTO_ON_ERROR(jpeg_decoder_new(&decoder_config, &s_preview.decoder), err, TAG, "create jpeg decoder failed");
+
+    if (config->task_affinity < 0)
+    {
+        res = xTaskCreate(preview_task, "preview", config->task_stack, NULL, config->task_priority, &s_preview.task);
+    }
+    else
+    {
+        res = xTaskCreatePinnedToCore(preview_task, "preview", config->task_stack, NULL, config->task_priority, &s_preview.task, config->task_affinity);
+    }
+    ESP_GOTO_ON_FALSE(res == pdPASS, ESP_FAIL, err, TAG, "create decode task failed");
+
+    return ESP_OK;
+
+err:
+    for (int i = 0; i < PREVIEW_MAX_BUFFERS; i++)
+    {
+        free(s_preview.frames[i]);
+        s_preview.frames[i] = NULL;
+    }
+    for (int i = 0; i < PREVIEW_JPEG_SLOTS; i++)
+    {
+        free(s_preview.jpeg[i]);
+        s_preview.jpeg[i] = NULL;
+    }
+    if (s_preview.decoder)
+    {
+        jpeg_decoder_del(s_preview.decoder);
+        s_preview.decoder = NULL;
+    }
+    s_preview.task = NULL;
+    return ret;
+}
+
+esp_err_t preview_submit_reply(const sscma_client_reply_t *reply)
+{
+    ESP_RETURN_ON_FALSE(reply, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+    ESP_RETURN_ON_FALSE(s_preview.task, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(reply->index.image && reply->index.image_len > 0, ESP_ERR_NOT_FOUND, TAG, "no image in reply");
+    ESP_RETURN_ON_FALSE(reply->index.image_len <= s_preview.max_size, ESP_ERR_INVALID_SIZE, TAG, "image too large");
+
+    // the producer slot is never touched by the decode task, only the swap needs the lock
+    esp_err_t ret = sscma_utils_decode_image_from_reply(reply, s_preview.jpeg[s_preview.write_idx], s_preview.jpeg_size, &s_preview.jpeg_len[s_preview.write_idx]);
+    if (ret != ESP_OK)
+    {
+        portENTER_CRITICAL(&s_preview.lock);
+        s_preview.stats.failed++;
+        portEXIT_CRITICAL(&s_preview.lock);
+        return ret;
+    }
+
+    portENTER_CRITICAL(&s_preview.lock);
+    int idx = s_preview.pending_idx;
+    s_preview.pending_idx = s_preview.write_idx;
+    s_preview.write_idx = idx;
+    if (s_preview.pending_full)
+    {
+        s_preview.stats.replaced++;
+    }
+    s_preview.pending_full = true;
+    portEXIT_CRITICAL(&s_preview.lock);
+
+    xTaskNotifyGive(s_preview.task);
+
+    return ESP_OK;
+}
+
+esp_err_t preview_set_video(bool enable)
+{
+    ESP_RETURN_ON_FALSE(s_preview.task, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    if (enable == s_preview.video)
+    {
+        return ESP_OK;
+    }
+
+    lv_disp_t *disp = lv_obj_get_disp(s_preview.image);
+    if (enable)
+    {
+        lvgl_port_video_cfg_t video_cfg = LVGL_PORT_VIDEO_CONFIG_DEFAULT();
+        video_cfg.osd = s_preview.osd;
+        video_cfg.osd_count = s_preview.osd_count;
+        ESP_RETURN_ON_ERROR(lvgl_port_video_start(disp, &video_cfg), TAG, "start video mode failed");
+    }
+    else
+    {
+        lvgl_port_video_stop(disp);
+    }
+    s_preview.video = enable;
+
+    ESP_LOGI(TAG, "video mode %s, %s path ran at %.1f fps", enable ? "on" : "off", enable ? "LVGL" : "video", s_preview.stats.fps);
+
+    return ESP_OK;
+}
+
+esp_err_t preview_get_stats(preview_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "Invalid argument(s) detected");
+
+    portENTER_CRITICAL(&s_preview.lock);
+    *stats = s_preview.stats;
+    stats->decode_avg_us = s_preview.stats.shown ? (uint32_t)(s_preview.decode_total_us / s_preview.stats.shown) : 0;
+    stats->lock_avg_us = s_preview.stats.shown ? (uint32_t)(s_preview.lock_total_us / s_preview.stats.shown) : 0;
+    portEXIT_CRITICAL(&s_preview.lock);
+
+    jpeg_decoder_stats_t decoder;
+    if (s_preview.decoder && jpeg_decoder_get_stats(s_preview.decoder, &decoder) == ESP_OK)
+    {
+        stats->setup_saved_us = decoder.setup_us;
+        stats->decoder_opens = decoder.opens;
+    }
+
+    return ESP_OK;
+}
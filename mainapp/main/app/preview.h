@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Seeed Technology Co., Ltd.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "lvgl.h"
+#include "sscma_client_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PREVIEW_MAX_BUFFERS 3
+
+/**
+ * @brief Preview configuration
+ */
+typedef struct
+{
+    lv_obj_t *image;      /*!< Image object the frames are shown on */
+    int width;            /*!< Frame width */
+    int height;           /*!< Frame height */
+    int buffers;          /*!< RGB565 frame buffers, 2 or 3 */
+    size_t max_size;      /*!< Largest base64 image accepted from a reply */
+    int task_priority;    /*!< Decode task priority */
+    int task_stack;       /*!< Decode task stack size */
+    int task_affinity;    /*!< Decode task pinned to core (-1 is no affinity) */
+    const lv_area_t *osd; /*!< Screen areas LVGL keeps drawing in video mode, NULL if none */
+    int osd_count;        /*!< Number of OSD areas, at most LVGL_PORT_VIDEO_OSD_MAX */
+} preview_config_t;
+
+#define PREVIEW_CONFIG_DEFAULT()                                                                                                                                                    \
+    {                                                                                                                                                                               \
+        .image = NULL, .width = 416, .height = 416, .buffers = 2, .max_size = 128 * 1024, .task_priority = 3, .task_stack = 4096, .task_affinity = -1, .osd = NULL, .osd_count = 0, \
+    }
+
+/**
+ * @brief Preview statistics
+ */
+typedef struct
+{
+    uint32_t shown;          /*!< Frames swapped to the front */
+    uint32_t replaced;       /*!< Frames replaced by a newer one before being decoded */
+    uint32_t failed;         /*!< Frames whose base64 or JPEG could not be decoded */
+    float fps;               /*!< Frames shown per second over the last second */
+    uint32_t decode_avg_us;  /*!< Average JPEG decode time */
+    uint32_t lock_avg_us;    /*!< Average time the LVGL lock is held for a swap */
+    uint32_t lock_max_us;    /*!< Longest time the LVGL lock was held for a swap */
+    uint32_t setup_saved_us; /*!< JPEG decoder setup time each frame no longer pays */
+    uint32_t decoder_opens;  /*!< Times the JPEG decoder had to be (re)configured */
+} preview_stats_t;
+
+/**
+ * @brief Start the preview decode task
+ *
+ * @param[in] config Preview configuration
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t preview_init(const preview_config_t *config);
+
+/**
+ * @brief Hand the image of a SAMPLE/INVOKE reply over to the preview
+ *
+ * Decodes the base64 image into a JPEG slot so the reply can be recycled on return, a newer frame
+ * replaces one that was not decoded yet. Meant to be called from the SSCMA event callback.
+ *
+ * @param[in] reply Reply holding the image
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_NOT_FOUND if the reply has no image
+ *          - ESP_ERR_INVALID_SIZE if the image is larger than max_size
+ *          - ESP_ERR_INVALID_RESPONSE if the image is not valid base64
+ */
+esp_err_t preview_submit_reply(const sscma_client_reply_t *reply);
+
+/**
+ * @brief Switch the preview between LVGL and video mode
+ *
+ * In video mode decoded frames go straight to the panel, center-cropped to the screen, and LVGL
+ * only draws the OSD areas. Only enable it while the preview owns the screen, the frame rate of the
+ * path being left is logged to compare the two.
+ *
+ * @param[in] enable True for video mode, false to show frames through the LVGL image again
+ * @return
+ *          - ESP_OK on success
+ *          - ESP_ERR_INVALID_STATE if the preview is not initialized
+ */
+esp_err_t preview_set_video(bool enable);
+
+/**
+ * @brief Get preview statistics
+ *
+ * @param[out] stats Statistics
+ * @return
+ *          - ESP_OK on success
+ */
+esp_err_t preview_get_stats(preview_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -19,9 +19,7 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-
-#include "mbedtls/base64.h"
-#include "esp_jpeg_dec.h"
+#include "freertos/queue.h"
 
 #include "sscma_client_io.h"
 #include "sscma_client_ops.h"
@@ -34,9 +32,13 @@
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "esp_spiffs.h"
 #include "sensecap-watcher.h"
 
+#include "capture_store.h"
+#include "preview.h"
+
 // !!!!!!! To change the status of the CPU/FPS counter, edit line 756 in /components/lvgl/src/lv_conf_internal.h
 // I couldn't figure out how you're supposed to do it, so that's how I did it
 
@@ -51,7 +53,12 @@
 #define CAMERA_SENSOR_RESOLUTION_480_480    2
 #define CAMERA_SENSOR_RESOLUTION_640_480    3
 
-#define DECODED_STR_MAX_SIZE (48 * 1028 * 2)
+#define CAPTURE_TIMEOUT_MS                  2000
+
+#define UI_EVENT_QUEUE_LEN                  16
+#define UI_BATTERY_PERIOD_MS                2000
+#define UI_REPORT_EVERY                     5 // battery polls between two load/latency reports
+#define UI_MENU_SELECT_MS                   500
 
 static const char *TAG = "Main";
 
@@ -69,24 +76,91 @@ esp_io_expander_handle_t io_expander = NULL;
 sscma_client_handle_t client = NULL;
 
 lv_obj_t *faceImage;
-int photoNumber = -1;
-char pictureNameBuffer[100];
-
-bool captureInProgress;
-int captureStartedCounter;
-bool captureFinished;
-
-static unsigned char decoded_str[DECODED_STR_MAX_SIZE];
-
-static lv_img_dsc_t preview_img_dsc = {
-    .header.always_zero = 0,
-    .header.w = PREVIEW_IMG_WIDTH,
-    .header.h = PREVIEW_IMG_HEIGHT,
-    .data_size = 640 * 480 * LV_COLOR_DEPTH / 8,
-    .header.cf = LV_IMG_CF_TRUE_COLOR,
-    .data = NULL,
+
+LV_IMG_DECLARE(greeting1);
+LV_IMG_DECLARE(greeting2);
+LV_IMG_DECLARE(greeting3);
+LV_IMG_DECLARE(standby1);
+LV_IMG_DECLARE(standby2);
+LV_IMG_DECLARE(standby3);
+LV_IMG_DECLARE(standby4);
+LV_IMG_DECLARE(detected1);
+LV_IMG_DECLARE(detected2);
+LV_IMG_DECLARE(eyesclosed);
+LV_IMG_DECLARE(eyesopen);
+LV_IMG_DECLARE(eyesleft);
+LV_IMG_DECLARE(eyesright);
+LV_IMG_DECLARE(scanning1);
+LV_IMG_DECLARE(scanning2);
+LV_IMG_DECLARE(scanning3);
+LV_IMG_DECLARE(scanning4);
+LV_IMG_DECLARE(scanning5);
+
+static const lv_img_dsc_t *greetingImages[] = {&greeting1, &greeting2, &greeting3};
+static const lv_img_dsc_t *sleepImages[] = {&standby1, &standby2, &standby3, &standby4};
+static const lv_img_dsc_t *exclaimationImages[] = {&detected1, &detected2};
+static const lv_img_dsc_t *idleImages[] = {&eyesopen, &eyesleft, &eyesright};
+static const lv_img_dsc_t *scanningImages[] = {&scanning1, &scanning2, &scanning3, &scanning4, &scanning5};
+
+typedef enum
+{
+    UI_EVENT_KNOB,    // value: 1 right, 0 left
+    UI_EVENT_BUTTON,  // value: 1 pressed, 0 released
+    UI_EVENT_TOUCH,   // new press on the touchscreen
+    UI_EVENT_BATTERY, // time to read the battery
+    UI_EVENT_MENU,    // selector arc filled up, enter the selection
+    UI_EVENT_CAMERA,  // first camera frame after entering camera mode
+} ui_event_type_t;
+
+typedef struct
+{
+    ui_event_type_t type;
+    int value;
+    int64_t time_us; // when the source raised it, for the input to pixel latency
+} ui_event_t;
+
+static struct
+{
+    QueueHandle_t events;       // Events the main loop sleeps on
+    esp_timer_handle_t battery; // Periodic battery poll
+    lv_timer_t *anim;           // Animation step of the current screen
+    lv_obj_t *selectorArc;
+    lv_obj_t *batteryArc;
+    lv_obj_t *batteryLabel;
+    lv_obj_t *menuLabel;
+    int state;                  // Main system state
+    int faceState;
+    int faceStateTimer;
+    int sleepAnimState;
+    int happyAnimState;
+    int scanAnimState;
+    int battAnimState;
+    int faceSleepTimer;
+    bool goToSleep;
+    int menuSelection;
+    int battPercent;
+    bool batteryLow;            // Low battery warning owns the screen
+    volatile bool buttonDown;   // Knob button held
+    volatile bool cameraWait;   // Waiting for the first frame of camera mode
+    uint32_t batteryPolls;
+    volatile int64_t input_us;  // Input waiting for its first refresh
+    uint32_t latency_count;
+    uint64_t latency_total_us;
+    uint32_t latency_max_us;
+} s_ui = {
+    .menuSelection = 1,
 };
 
+static void ui_event_post(ui_event_type_t type, int value)
+{
+    ui_event_t event = { .type = type, .value = value, .time_us = esp_timer_get_time() };
+
+    if (xQueueSend(s_ui.events, &event, 0) != pdTRUE)
+    {
+        ESP_LOGW(TAG, "UI event %d dropped", type);
+    }
+}
+
 int randomInRange(int min, int max) {
     return rand() % (max - min + 1) + min;
 }
@@ -104,8 +178,6 @@ int clamp(int value, int min, int max) {
 void sscma_log();
 void sscma_event();
 void sscma_event_CAPTURE();
-static esp_err_t write_file();
-void display_one_image();
 
 const sscma_client_callback_t sscmacallback = {
     .on_event = sscma_event,
@@ -119,54 +191,15 @@ const sscma_client_callback_t sscmanocallback = {
 
 void sscma_event(sscma_client_handle_t client, const sscma_client_reply_t *reply, void *user_ctx)
 {
-    if (captureInProgress) {
-        return;
-    }
-
-    char *currentFrame;
-
-    printf("callback'd");
-
-    int img_size = 0;
-
     // Note: reply is automatically recycled after exiting the function.
-    if (sscma_utils_fetch_image_from_reply(reply, &currentFrame, &img_size) == ESP_OK)
-    {
-        if (captureStartedCounter == 3) { // capture ready
-            char *num;
-
-            photoNumber++;
+    // only the JPEG is taken out of the reply, the preview task decodes and swaps it in
+    preview_submit_reply(reply);
 
-            captureInProgress = true;
-            if (asprintf(&num, "%d", photoNumber) == -1) {
-                ESP_LOGE(TAG, "BIG OL STRING ERROR!!!! (USING ERROR NUMBER!!!)");
-                num = "err";
-            } else {
-                // String concatenation using strcpy and strcat
-                strcat(strcpy(pictureNameBuffer, "/sdcard/.unprocessedphotos/image-"), num);
-                printf("%s\n", pictureNameBuffer);
-
-                // Free dynamically allocated memory
-                free(num);
-            }
-            write_file(pictureNameBuffer, currentFrame);
-
-            captureFinished = true; // capture complete
-        } else {
-            if (captureStartedCounter != -1) { captureStartedCounter++; } // increment frames after counter started (to delay capture until the sensor resolution is changed)
-
-            if (lvgl_port_lock(0))
-            {
-                display_one_image(faceImage, (const unsigned char *)currentFrame);
-                lvgl_port_unlock();
-            }
-        }
-        free(currentFrame);
+    if (s_ui.cameraWait)
+    {
+        s_ui.cameraWait = false;
+        ui_event_post(UI_EVENT_CAMERA, 0);
     }
-
-    lv_obj_set_scrollbar_mode(faceImage, LV_SCROLLBAR_MODE_OFF); // Never show the scrollbars
-    lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_SCROLLABLE); // Never allow scrolling on the face
-    lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_CLICKABLE);  /*To not allow adjusting by click*/
 }
 
 void sscma_log(sscma_client_handle_t client, const sscma_client_reply_t *reply, void *user_ctx)
@@ -183,53 +216,38 @@ void sscma_log(sscma_client_handle_t client, const sscma_client_reply_t *reply,
 // File Stuff
 //**********************************************************************************
 
-static esp_err_t write_file(const char *path, char *data)
+static void capture_photo(void)
 {
-    ESP_LOGI(TAG, "Opening file %s", path);
-    FILE *f = fopen(path, "w");
-    if (f == NULL) {
-        ESP_LOGE(TAG, "Failed to open file for writing");
-        return ESP_FAIL;
-    }
-    fprintf(f, data);
-    fclose(f);
-    ESP_LOGI(TAG, "File written");
-
-    return ESP_OK;
-}
+    sscma_client_jpeg_t jpeg;
+    char pictureNameBuffer[CAPTURE_STORE_PATH_MAX];
 
-void getCurrentImageCount(void) {
-    bool hasFoundPicture = false;
-    FILE *file;
-    char *num;
-    int currentTest = 1;
-
-    while (!hasFoundPicture) {
-        if (asprintf(&num, "%d", currentTest) == -1) {
-            ESP_LOGE(TAG, "string error");
-            num = "err";
-        } else {
-            // String concatenation using strcpy and strcat
-            strcat(strcpy(pictureNameBuffer, "/sdcard/.unprocessedphotos/image-"), num);
-
-            file = fopen(pictureNameBuffer, "r");
-
-
-            if (file != NULL) {
-                fclose(file);
-                printf("file exists");
-                currentTest++;
-            } else {
-                photoNumber = currentTest - 1;
-                printf("file doesn't exist");
-                hasFoundPicture = true;
-            }
+    // the client switches to the still mode and back to the preview on its own
+    if (sscma_client_capture_still(client, CAMERA_SENSOR_RESOLUTION_640_480, pdMS_TO_TICKS(CAPTURE_TIMEOUT_MS), &jpeg) != ESP_OK)
+    {
+        printf("capture failed\n");
+        return;
+    }
 
+    if (capture_store_reserve_path(pictureNameBuffer, sizeof(pictureNameBuffer)) != ESP_OK)
+    {
+        printf("no capture storage\n");
+        free(jpeg.data);
+        return;
+    }
+    printf("%s\n", pictureNameBuffer);
 
-            // Free dynamically allocated memory
-            free(num);
-        }
+    // the writer task owns the JPEG from here, the SD card never blocks the camera loop
+    if (capture_store_submit(pictureNameBuffer, jpeg.data, jpeg.size) != ESP_OK)
+    {
+        printf("capture dropped\n");
+        free(jpeg.data);
+        return;
     }
+
+    capture_store_stats_t stats;
+    capture_store_get_stats(&stats);
+    ESP_LOGI(TAG, "Capture queued: %u written, %.2f captures/s, submit avg %u us max %u us", (unsigned)stats.written, stats.captures_per_sec, (unsigned)stats.submit_avg_us,
+        (unsigned)stats.submit_max_us);
 }
 
 //**********************************************************************************
@@ -301,136 +319,530 @@ static void rgb_next_color(bool reverse)
     ESP_ERROR_CHECK(rgb_set(current_color[0] / 2, current_color[1] / 2, current_color[2] / 2));
 }
 
+
 //**********************************************************************************
-// JPEG / Image Stuff
+// Input Sources
 //**********************************************************************************
 
-static int esp_jpeg_decoder_one_picture(uint8_t *input_buf, int len, uint8_t *output_buf)
+static void knob_right_callback(void *arg, void *data)
 {
-    esp_err_t ret = ESP_OK;
-    // Generate default configuration
-    jpeg_dec_config_t config = { .output_type = JPEG_RAW_TYPE_RGB565_BE, .rotate = JPEG_ROTATE_0D };
-
-    // Empty handle to jpeg_decoder
-    jpeg_dec_handle_t jpeg_dec = NULL;
+    ui_event_post(UI_EVENT_KNOB, 1);
+}
 
-    // Create jpeg_dec
-    jpeg_dec = jpeg_dec_open(&config);
+static void knob_left_callback(void *arg, void *data)
+{
+    ui_event_post(UI_EVENT_KNOB, 0);
+}
 
-    // Create io_callback handle
-    jpeg_dec_io_t *jpeg_io = calloc(1, sizeof(jpeg_dec_io_t));
-    if (jpeg_io == NULL)
+static esp_err_t knob_init(void)
+{
+    knob_config_t cfg = {
+        .default_direction = 0,
+        .gpio_encoder_a = BSP_KNOB_A,
+        .gpio_encoder_b = BSP_KNOB_B,
+    };
+    s_knob = iot_knob_create(&cfg);
+    if (NULL == s_knob)
     {
+        ESP_LOGE(TAG, "knob create failed");
         return ESP_FAIL;
     }
 
-    // Create out_info handle
-    jpeg_dec_header_info_t *out_info = calloc(1, sizeof(jpeg_dec_header_info_t));
-    if (out_info == NULL)
-    {
-        return ESP_FAIL;
+    iot_knob_register_cb(s_knob, KNOB_LEFT, knob_left_callback, NULL);
+    iot_knob_register_cb(s_knob, KNOB_RIGHT, knob_right_callback, NULL);
+    return ESP_OK;
+}
+
+static void button_press_callback(void)
+{
+    ui_event_post(UI_EVENT_BUTTON, 1);
+}
+
+static void button_release_callback(void)
+{
+    ui_event_post(UI_EVENT_BUTTON, 0);
+}
+
+static void touch_callback(lv_event_t *e)
+{
+    ui_event_post(UI_EVENT_TOUCH, 0);
+}
+
+static void battery_callback(void *arg)
+{
+    // the ADC reads happen on the main task, not in the esp_timer task
+    ui_event_post(UI_EVENT_BATTERY, 0);
+}
+
+static void menu_arc_callback(void *arc, int32_t value)
+{
+    lv_arc_set_value(arc, value);
+}
+
+static void menu_ready_callback(lv_anim_t *a)
+{
+    ui_event_post(UI_EVENT_MENU, 0);
+}
+
+//**********************************************************************************
+// Screen Animations
+//**********************************************************************************
+
+// Runs in the LVGL task with the LVGL lock held, one step per timer period
+
+static void battery_screen_update(void)
+{
+    if (s_ui.battPercent > 75) {
+        lv_obj_set_style_arc_color(s_ui.batteryArc, lv_palette_main(LV_PALETTE_GREEN), LV_PART_INDICATOR | LV_STATE_DEFAULT);
+        lv_img_set_src(faceImage, greetingImages[s_ui.battAnimState]);
+    } else if (s_ui.battPercent > 25) {
+        lv_obj_set_style_arc_color(s_ui.batteryArc, lv_palette_main(LV_PALETTE_YELLOW), LV_PART_INDICATOR | LV_STATE_DEFAULT);
+        lv_img_set_src(faceImage, idleImages[0]);
+    } else {
+        lv_obj_set_style_arc_color(s_ui.batteryArc, lv_palette_main(LV_PALETTE_RED), LV_PART_INDICATOR | LV_STATE_DEFAULT);
+        lv_img_set_src(faceImage, exclaimationImages[s_ui.battAnimState]);
     }
 
-    // Set input buffer and buffer len to io_callback
-    jpeg_io->inbuf = input_buf;
-    jpeg_io->inbuf_len = len;
+    lv_label_set_text_fmt(s_ui.batteryLabel, "Battery: %d%%", s_ui.battPercent);
 
-    // Parse jpeg picture header and get picture for user and decoder
-    ret = jpeg_dec_parse_header(jpeg_dec, jpeg_io, out_info);
+    lv_arc_set_value(s_ui.batteryArc, s_ui.battPercent);
+}
 
-    if (ret < 0)
+static void face_step(void)
+{
+    // Sleep manager
+    if (s_ui.goToSleep)
     {
-        goto _exit;
+        s_ui.faceState = 3;
+        s_ui.goToSleep = false;
     }
 
-    jpeg_io->outbuf = output_buf;
-    int inbuf_consumed = jpeg_io->inbuf_len - jpeg_io->inbuf_remain;
-    jpeg_io->inbuf = input_buf + inbuf_consumed;
-    jpeg_io->inbuf_len = jpeg_io->inbuf_remain;
+    switch (s_ui.faceState) {
+        case 1: // Idle, Face selected
+            if (randomInRange(0, 39) == 1) // If we roll the 1/40 chance to blink
+            {
+                s_ui.faceState = 2;
+                s_ui.faceStateTimer = -5;
+                lv_img_set_src(faceImage, &eyesclosed);
+            }
+            break;
+        case 2: // Blinking
+            break; // (Do nothing)
+        case 3: // Asleep
+            s_ui.sleepAnimState++;
+            if (s_ui.sleepAnimState >= 4)
+            {
+                s_ui.sleepAnimState = 0;
+            }
+
+            s_ui.faceStateTimer = 5; // This state is perpetual, and lasts until an external "Wakeup" is triggered
 
-    // Start decode jpeg raw data
-    ret = jpeg_dec_process(jpeg_dec, jpeg_io);
+            lv_img_set_src(faceImage, sleepImages[s_ui.sleepAnimState]);
+            break;
+        case 4: // Happy
+            s_ui.happyAnimState++;
+            s_ui.faceStateTimer = 5; // Keep this state running until the animation is done
+            if (s_ui.happyAnimState >= 3) // Animate the happy until the animation finishes
+            {
+                s_ui.happyAnimState = 0;
+                s_ui.faceState = 0;
+            }
+            lv_img_set_src(faceImage, greetingImages[s_ui.happyAnimState]);
+            break;
+        default: // Unknown state
+        case 0:  // Default state (Idle face selection)
+            s_ui.faceState = 1;
+            s_ui.faceStateTimer = randomInRange(5, 25); // Face selection delay
+            lv_img_set_src(faceImage, idleImages[randomInRange(0, 2)]); // set face to a random idle image
 
-    if (ret < 0)
+            if (s_ui.faceSleepTimer <= 0)
+            {
+                s_ui.goToSleep = true;
+            }
+
+            break;
+    }
+
+    if (s_ui.faceStateTimer <= 0) // If faceStateTimer is finished
     {
-        goto _exit;
+        s_ui.faceState = 0; // Select a new Idle Face
+    }
+    else
+    {
+        s_ui.faceStateTimer--; //Decrement stateTimer
     }
 
-    _exit:
-    // Decoder deinitialize
-    jpeg_dec_close(jpeg_dec);
-    free(out_info);
-    free(jpeg_io);
-    return ret;
+    s_ui.faceSleepTimer--;
 }
 
-void display_one_image(lv_obj_t *image, const unsigned char *p_data)
+static void anim_callback(lv_timer_t *timer)
 {
-    if (!p_data)
+    if (s_ui.batteryLow) {
+        s_ui.battAnimState = !s_ui.battAnimState;
+        lv_img_set_src(faceImage, exclaimationImages[s_ui.battAnimState]);
+        lv_label_set_text_fmt(s_ui.batteryLabel, "Battery: %d%%", s_ui.battPercent);
         return;
+    }
+
+    switch (s_ui.state) {
+        case 4: // Battery information
+            s_ui.battAnimState = !s_ui.battAnimState;
+            battery_screen_update();
+            break;
+        case 3: // Flashlight
+            if (s_ui.buttonDown) {
+                rgb_next_color(false);
+            }
+            else
+            {
+                rgb_set(255, 255, 255);
+            }
+
+            s_ui.scanAnimState++;
+            if (s_ui.scanAnimState >= 5)
+            {
+                s_ui.scanAnimState = 0;
+            }
 
-    size_t str_len = strlen((const char *)p_data);
-    size_t output_len = 0;
+            lv_img_set_src(faceImage, scanningImages[s_ui.scanAnimState]);
+            break;
+        case 1: // Face (active)
+            face_step();
+            break;
+        default:
+            break;
+    }
+}
+
+static void anim_run(uint32_t period_ms)
+{
+    lv_timer_set_period(s_ui.anim, period_ms);
+    lv_timer_resume(s_ui.anim);
+    lv_timer_ready(s_ui.anim); // first step on the next LVGL pass, not one period later
+}
 
+//**********************************************************************************
+// UI State Machine
+//**********************************************************************************
 
-    int decode_ret = mbedtls_base64_decode(decoded_str, DECODED_STR_MAX_SIZE, &output_len, p_data, str_len);
+static void monitor_callback(lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px)
+{
+    // first refresh after an input was handled, the pixels it changed are on their way to the panel
+    int64_t input_us = s_ui.input_us;
+    if (input_us == 0)
+    {
+        return;
+    }
+    s_ui.input_us = 0;
 
-    if (decode_ret == 0)
+    uint32_t latency = (uint32_t)(esp_timer_get_time() - input_us);
+    s_ui.latency_count++;
+    s_ui.latency_total_us += latency;
+    if (latency > s_ui.latency_max_us)
     {
-        if (preview_img_dsc.data == NULL)
+        s_ui.latency_max_us = latency;
+    }
+}
+
+static void ui_report(void)
+{
+#if CONFIG_APP_REPORT_IDLE_LOAD
+    // deltas are taken in the counter type, a 32-bit counter wrapping between two reports is harmless
+    static configRUN_TIME_COUNTER_TYPE last_idle = 0;
+    static configRUN_TIME_COUNTER_TYPE last_total = 0;
+    float idle = 0.0f;
+
+    UBaseType_t count = uxTaskGetNumberOfTasks() + 2; // room for tasks created meanwhile
+    TaskStatus_t *tasks = malloc(count * sizeof(TaskStatus_t));
+    if (tasks)
+    {
+        configRUN_TIME_COUNTER_TYPE total = 0;
+        configRUN_TIME_COUNTER_TYPE idle_time = 0;
+        count = uxTaskGetSystemState(tasks, count, &total);
+        for (UBaseType_t i = 0; i < count; i++)
         {
-            preview_img_dsc.data = heap_caps_aligned_alloc(16, preview_img_dsc.data_size, MALLOC_CAP_SPIRAM);
+            if (strncmp(tasks[i].pcTaskName, "IDLE", 4) == 0)
+            {
+                idle_time += tasks[i].ulRunTimeCounter;
+            }
         }
+        free(tasks);
 
-        int ret = esp_jpeg_decoder_one_picture(decoded_str, output_len, preview_img_dsc.data);
-
-        if (ret == ESP_OK)
+        // the total is wall time, every core has its own idle task
+        configRUN_TIME_COUNTER_TYPE idle_delta = idle_time - last_idle;
+        configRUN_TIME_COUNTER_TYPE total_delta = total - last_total;
+        if (total_delta > 0)
         {
-            lv_img_set_src(image, &preview_img_dsc);
+            idle = 100.0f * (float)idle_delta / ((float)total_delta * portNUM_PROCESSORS);
         }
+        last_idle = idle_time;
+        last_total = total;
     }
-    else
+    ESP_LOGI(TAG, "idle %.1f%%, free heap %lu", idle, (unsigned long)esp_get_free_heap_size());
+#else
+    ESP_LOGI(TAG, "free heap %lu", (unsigned long)esp_get_free_heap_size());
+#endif
+
+    lvgl_port_lock(0);
+    uint32_t inputs = s_ui.latency_count;
+    uint32_t avg = inputs ? (uint32_t)(s_ui.latency_total_us / inputs) : 0;
+    uint32_t max = s_ui.latency_max_us;
+    lvgl_port_unlock();
+    ESP_LOGI(TAG, "input to pixel: %u inputs, avg %u us, max %u us", (unsigned)inputs, (unsigned)avg, (unsigned)max);
+}
+
+static void ui_wake(void)
+{
+    s_ui.faceSleepTimer = randomInRange(50, 70); // reset the sleep timer
+    if (s_ui.state == 1) // If we are in the FaceState
     {
-        ESP_LOGE(TAG, "Failed to decode Base64 string, error: %d", decode_ret);
+        if (s_ui.faceState == 3) // If asleep
+        {
+            s_ui.faceState = 0; // Wake up
+        }
     }
 }
 
-//**********************************************************************************
-// Knob Setup
-//**********************************************************************************
+static void ui_menu_move(bool right)
+{
+    if (right) { // Right
+        s_ui.menuSelection++;
+    }
+    else { // Left
+        s_ui.menuSelection--;
+    }
 
-bool knobJustMoved = false;
-bool knobDir = false;
+    if (s_ui.menuSelection >= 7)
+    {
+        s_ui.menuSelection = 1;
+    }
+    if (s_ui.menuSelection <= 0)
+    {
+        s_ui.menuSelection = 6;
+    }
 
-static void knob_right_callback(void *arg, void *data)
+    switch (s_ui.menuSelection) {
+        case 6:
+            lv_label_set_text(s_ui.menuLabel,"#ffffff Camera#");
+            break;
+        case 5:
+            lv_label_set_text(s_ui.menuLabel,"#ffffff Screen Off#");
+            break;
+        case 4:
+            lv_label_set_text(s_ui.menuLabel,"#ffffff Battery Info#");
+            break;
+        case 3:
+            lv_label_set_text(s_ui.menuLabel,"#ffffff Flashlight#");
+            break;
+        case 2:
+            lv_label_set_text(s_ui.menuLabel,"#ff0000 Shutdown#");
+            break;
+        case 1:
+            lv_label_set_text(s_ui.menuLabel,"#ffffff Normal#");
+            break;
+        case 0:
+        default:
+            lv_label_set_text(s_ui.menuLabel,"#ff0000 Error#");
+            break;
+    }
+
+    // every move starts the selection countdown over
+    lv_anim_del(s_ui.selectorArc, menu_arc_callback);
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, s_ui.selectorArc);
+    lv_anim_set_exec_cb(&a, menu_arc_callback);
+    lv_anim_set_values(&a, 0, 100);
+    lv_anim_set_time(&a, UI_MENU_SELECT_MS);
+    lv_anim_set_ready_cb(&a, menu_ready_callback);
+    lv_anim_start(&a);
+}
+
+static void ui_clear_screen(bool video)
 {
-    knobJustMoved = true;
-    knobDir = true;
+    if (!video)
+    {
+        preview_set_video(false);
+    }
+    lv_timer_pause(s_ui.anim);
+    lv_anim_del(s_ui.selectorArc, menu_arc_callback);
+
+    lv_obj_add_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // hide the face
+    lv_obj_add_flag(s_ui.batteryArc, LV_OBJ_FLAG_HIDDEN); // hide the battery arc
+    lv_obj_add_flag(s_ui.batteryLabel, LV_OBJ_FLAG_HIDDEN); // hide the battery label
+    lv_obj_add_flag(s_ui.selectorArc, LV_OBJ_FLAG_HIDDEN); // hide the selection arc
+    lv_obj_add_flag(s_ui.menuLabel, LV_OBJ_FLAG_HIDDEN); // hide the menu label
 }
 
-static void knob_left_callback(void *arg, void *data)
+// Screen layout is set once per state change, called with the LVGL lock held
+static void ui_enter_state(int state)
 {
-    knobJustMoved = true;
-    knobDir = false;
+    s_ui.state = state;
+    ui_clear_screen(state == 6);
+
+    switch (state) {
+        case 6: // Camera mode
+            lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the main image
+            // frames only go straight to the panel while the camera owns the screen
+            preview_set_video(true);
+            break;
+        case -2: // Camera init
+            lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the main image
+            s_ui.cameraWait = true;
+            if (sscma_client_register_callback(client, &sscmacallback, NULL) != ESP_OK)
+            {
+                printf("set callback failed\n");
+                abort();
+            }
+            break;
+        case 5: // Screen off
+            bsp_lcd_brightness_set(0);
+            break;
+        case 4: // Battery information
+            lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
+            lv_obj_clear_flag(s_ui.batteryArc, LV_OBJ_FLAG_HIDDEN); // Show the arc
+            lv_obj_clear_flag(s_ui.batteryLabel, LV_OBJ_FLAG_HIDDEN);
+
+            lv_obj_move_foreground(faceImage); // face goes in the back
+            lv_obj_move_foreground(s_ui.batteryLabel); // label goes in the middle
+            lv_obj_move_foreground(s_ui.batteryArc); // battery arc goes on top
+
+            battery_screen_update();
+            anim_run(200);
+            break;
+        case 3: //Flashlight
+            lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
+            anim_run(120);
+            break;
+        case 2: // shutdown
+            bsp_lcd_brightness_set(0);
+            bsp_system_shutdown();
+            vTaskDelay(pdMS_TO_TICKS(1000)); // This will only run if we are connected to usb-c (or shutdown is broken somehow)
+            esp_restart();
+            break;
+        case 1: // Face (active)
+            lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
+            anim_run(150);
+            break;
+        case -1: // Menu
+            bsp_lcd_brightness_set(100); // reset the screen brightness
+
+            rgb_set(0, 0, 0); // Reset the RGB LED
+
+            s_ui.faceState = 0; // Reset the face state
+
+            if (sscma_client_register_callback(client, &sscmanocallback, NULL) != ESP_OK)
+            {
+                printf("set callback failed\n");
+                abort();
+            }
+
+            lv_obj_clear_flag(s_ui.selectorArc, LV_OBJ_FLAG_HIDDEN); // Show the selector arc
+            lv_obj_clear_flag(s_ui.menuLabel, LV_OBJ_FLAG_HIDDEN); // Show the menu label
+
+            lv_obj_move_foreground(s_ui.menuLabel); // Menu label goes in the middle
+            lv_obj_move_foreground(s_ui.selectorArc); // Selector arc goes on top!
+            break;
+        case 0: // Initializing
+        default: //or an unknown state
+            bsp_lcd_brightness_set(100);
+            ui_enter_state(1);
+            break;
+    }
 }
 
-static esp_err_t knob_init(void)
+static void ui_enter_battery_low(void)
 {
-    knob_config_t cfg = {
-        .default_direction = 0,
-        .gpio_encoder_a = BSP_KNOB_A,
-        .gpio_encoder_b = BSP_KNOB_B,
-    };
-    s_knob = iot_knob_create(&cfg);
-    if (NULL == s_knob)
+    s_ui.state = 0; // Go to init state once the battery recovers
+    s_ui.batteryLow = true;
+    ui_clear_screen(false);
+
+    bsp_lcd_brightness_set(5); // dim the screen
+
+    lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
+    lv_obj_clear_flag(s_ui.batteryLabel, LV_OBJ_FLAG_HIDDEN); // Show the percentage
+
+    lv_obj_move_foreground(faceImage); // face goes in the back
+    lv_obj_move_foreground(s_ui.batteryLabel); // label goes in the middle
+
+    anim_run(100);
+}
+
+static void ui_handle_event(const ui_event_t *event)
+{
+    // a capture blocks for up to CAPTURE_TIMEOUT_MS, keep LVGL running meanwhile
+    if (event->type == UI_EVENT_BUTTON && event->value && s_ui.state == 6 && !s_ui.batteryLow)
     {
-        ESP_LOGE(TAG, "knob create failed");
-        return ESP_FAIL;
+        s_ui.buttonDown = true;
+        capture_photo();
+        return;
     }
 
-    iot_knob_register_cb(s_knob, KNOB_LEFT, knob_left_callback, NULL);
-    iot_knob_register_cb(s_knob, KNOB_RIGHT, knob_right_callback, NULL);
-    return ESP_OK;
+    lvgl_port_lock(0);
+
+    switch (event->type) {
+        case UI_EVENT_KNOB:
+            ui_wake();
+            if (s_ui.batteryLow) { // Battery too low, block all further information
+                break;
+            }
+            if (s_ui.state != -1) {
+                ui_enter_state(-1); // Go to Menu
+            }
+            ui_menu_move(event->value);
+            break;
+        case UI_EVENT_BUTTON:
+            s_ui.buttonDown = event->value;
+            if (event->value) {
+                ui_wake();
+            }
+            break;
+        case UI_EVENT_TOUCH:
+            ui_wake();
+            if (s_ui.state == 1 && !s_ui.batteryLow)
+            {
+                s_ui.faceState = 4;
+                s_ui.happyAnimState = 0;
+                lv_timer_ready(s_ui.anim);
+            }
+            break;
+        case UI_EVENT_BATTERY:
+            s_ui.battPercent = bsp_battery_get_percent(); // Update the battery percentage
+            if (s_ui.battPercent < 3 && !s_ui.batteryLow) {
+                ui_enter_battery_low();
+            }
+            else if (s_ui.battPercent >= 3 && s_ui.batteryLow) {
+                s_ui.batteryLow = false;
+                ui_enter_state(s_ui.state);
+            }
+            else if (s_ui.state == 4 && !s_ui.batteryLow) {
+                battery_screen_update();
+            }
+            break;
+        case UI_EVENT_MENU:
+            if (s_ui.state == -1 && !s_ui.batteryLow) {
+                ui_enter_state(s_ui.menuSelection == 6 ? -2 : s_ui.menuSelection);
+            }
+            break;
+        case UI_EVENT_CAMERA:
+            if (s_ui.state == -2 && !s_ui.batteryLow) {
+                ui_enter_state(6);
+            }
+            break;
+    }
+
+    // the video path and a dark screen never show up in an LVGL refresh
+    if ((event->type == UI_EVENT_KNOB || event->type == UI_EVENT_BUTTON || event->type == UI_EVENT_TOUCH) && s_ui.state != 6 && s_ui.state != 5)
+    {
+        s_ui.input_us = event->time_us;
+    }
+
+    lvgl_port_unlock();
+
+    if (event->type == UI_EVENT_BATTERY && ++s_ui.batteryPolls % UI_REPORT_EVERY == 0)
+    {
+        ui_report();
+    }
 }
 
 //**********************************************************************************
@@ -439,6 +851,9 @@ static esp_err_t knob_init(void)
 
 void app_main(void)
 {
+    s_ui.events = xQueueCreate(UI_EVENT_QUEUE_LEN, sizeof(ui_event_t));
+    assert(s_ui.events != NULL);
+
     // Initialize the IO Expander
     io_expander = bsp_io_expander_init();
     assert(io_expander != NULL);
@@ -451,30 +866,13 @@ void app_main(void)
     lvgl_disp = bsp_lvgl_init();
     assert(lvgl_disp != NULL);
 
-    // Initalize the touchscreen
-    lv_indev_t * tp = NULL;
-    while (1) {
-        tp = lv_indev_get_next(tp);
-        if(tp->driver->type == LV_INDEV_TYPE_POINTER) {
-            break;
-        }
-    }
-    assert(tp != NULL);
-
-    // Initialize some values for the camera stuff
-    captureStartedCounter = -1; // Capture idle
-    captureFinished = false;
-    captureInProgress = false;
-
     // Initialize the RGB Light
     ESP_ERROR_CHECK(rgb_init());
 
     // Initialize the Knob
     ESP_ERROR_CHECK(knob_init());
 
-    // Initalize the touches to offscreen
-    lv_point_t pointTouched = {0, 0};
-    lv_point_t previousPoint = {0, 0};
+    lvgl_port_lock(0);
 
     faceImage = lv_img_create(lv_scr_act());
     lv_obj_add_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // hide it for later
@@ -483,6 +881,13 @@ void app_main(void)
     lv_obj_set_scrollbar_mode(faceImage, LV_SCROLLBAR_MODE_OFF); // Never show the scrollbars
     lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_SCROLLABLE); // Never allow scrolling on the face
 
+    // Camera frames are decoded off the SSCMA callback into their own buffers
+    preview_config_t preview_config = PREVIEW_CONFIG_DEFAULT();
+    preview_config.image = faceImage;
+    preview_config.width = PREVIEW_IMG_WIDTH;
+    preview_config.height = PREVIEW_IMG_HEIGHT;
+    ESP_ERROR_CHECK(preview_init(&preview_config));
+
     // Selection arc defenition
     lv_obj_t * selectorArc = lv_arc_create(lv_scr_act());
     lv_arc_set_rotation(selectorArc, 270);
@@ -519,32 +924,6 @@ void app_main(void)
     lv_obj_set_width(batteryLabel, 200);
     lv_obj_set_style_text_align(batteryLabel, LV_TEXT_ALIGN_CENTER, 0); // Set the text to align to the center
 
-    // Image Declarations
-    LV_IMG_DECLARE(greeting1);
-    LV_IMG_DECLARE(greeting2);
-    LV_IMG_DECLARE(greeting3);
-    LV_IMG_DECLARE(standby1);
-    LV_IMG_DECLARE(standby2);
-    LV_IMG_DECLARE(standby3);
-    LV_IMG_DECLARE(standby4);
-    LV_IMG_DECLARE(detected1);
-    LV_IMG_DECLARE(detected2);
-    LV_IMG_DECLARE(eyesclosed);
-    LV_IMG_DECLARE(eyesopen);
-    LV_IMG_DECLARE(eyesleft);
-    LV_IMG_DECLARE(eyesright);
-    LV_IMG_DECLARE(scanning1);
-    LV_IMG_DECLARE(scanning2);
-    LV_IMG_DECLARE(scanning3);
-    LV_IMG_DECLARE(scanning4);
-    LV_IMG_DECLARE(scanning5);
-
-    lv_img_dsc_t greetingImages[] = {greeting1, greeting2, greeting3};
-    lv_img_dsc_t sleepImages[] = {standby1, standby2, standby3, standby4};
-    lv_img_dsc_t exclaimationImages[] = {detected1, detected2};
-    lv_img_dsc_t idleImages[] = {eyesopen, eyesleft, eyesright};
-    lv_img_dsc_t scanningImages[] = {scanning1, scanning2, scanning3, scanning4, scanning5};
-
     lv_obj_t * menuLabel = lv_label_create(lv_scr_act());
     lv_label_set_long_mode(menuLabel, LV_LABEL_LONG_WRAP);     /*Break the long lines*/
     lv_label_set_recolor(menuLabel, true);
@@ -560,24 +939,18 @@ void app_main(void)
     lv_style_set_bg_color(&backgroundStyle, lv_color_black());
     lv_obj_add_style(lv_scr_act(), &backgroundStyle, 0);
 
-    int faceState = 0;
-    int faceStateTimer = 0;
-    int sleepAnimState = 0;
-    int happyAnimState = 0;
-    int scanAnimState = 0;
-    int battAnimState = 0;
-    int faceSleepTimer = randomInRange(50, 70);
-
-    bool goToSleep = false;
-    bool sleepCanceller = false;
-
-    int menuTimeOut = 0;
-    int menuSelection = 1;
-    bool menuShouldMove = false;
+    s_ui.selectorArc = selectorArc;
+    s_ui.batteryArc = batteryArc;
+    s_ui.batteryLabel = batteryLabel;
+    s_ui.menuLabel = menuLabel;
+    s_ui.faceSleepTimer = randomInRange(50, 70);
+    s_ui.battPercent = bsp_battery_get_percent();
 
-    int battPercent = bsp_battery_get_percent();
+    // Screen animations step on an LVGL timer instead of the main loop
+    s_ui.anim = lv_timer_create(anim_callback, 150, NULL);
+    lv_timer_pause(s_ui.anim);
 
-    int state = 0; // Main System state
+    lvgl_port_unlock();
 
 
     ///////////////////////////////////////////////////////////////////////////////////
@@ -588,7 +961,12 @@ void app_main(void)
         bsp_sdcard_init_default(); // Mount sdcard to /sdcard
         vTaskDelay(10 / portTICK_PERIOD_MS);
 
-        getCurrentImageCount();
+        // the capture index gives the next photo number without looking up every photo
+        capture_store_config_t capture_store_config = CAPTURE_STORE_CONFIG_DEFAULT();
+        capture_store_config.dir = "/sdcard/.unprocessedphotos";
+        if (capture_store_init(&capture_store_config) != ESP_OK) {
+            ESP_LOGE(TAG, "capture store unavailable, photos will not be saved");
+        }
     }
     else {
         while (!bsp_sdcard_is_inserted()) {
@@ -600,16 +978,16 @@ void app_main(void)
             lv_obj_move_foreground(faceImage); // face goes in the back
             lv_obj_move_foreground(batteryLabel); // label goes on top
 
-            if (battAnimState == 1) {
-                battAnimState = 0;
+            if (s_ui.battAnimState == 1) {
+                s_ui.battAnimState = 0;
             } else {
-                battAnimState = 1;
+                s_ui.battAnimState = 1;
             }
 
             lv_label_set_text_fmt(batteryLabel, "Need an SD Card!");
 
 
-            lv_img_set_src(faceImage, &exclaimationImages[battAnimState]);
+            lv_img_set_src(faceImage, exclaimationImages[s_ui.battAnimState]);
             lvgl_port_unlock();
             vTaskDelay(200);
         }
@@ -634,11 +1012,14 @@ void app_main(void)
         abort();
     }
 
-    sscma_client_init(client);
+    // returns once the device has reported INIT@STAT (or answered a probe)
+    if (sscma_client_init(client) != ESP_OK)
+    {
+        printf("sscma init failed\n");
+    }
     sscma_client_set_model(client, 1);
 
     sscma_client_set_sensor(client, 1, CAMERA_SENSOR_RESOLUTION_416_416, true);
-    vTaskDelay(10 / portTICK_PERIOD_MS);
 
     if (sscma_client_sample(client, -1) != ESP_OK)
     {
@@ -647,407 +1028,42 @@ void app_main(void)
 
 
     ///////////////////////////////////////////////////////////////////////////////////
-    //  MAIN LOOP
+    //  Event Sources
     ///////////////////////////////////////////////////////////////////////////////////
 
-    while (1) {
-
-        printf("free_heap_size = %ld\n", esp_get_free_heap_size());
-
-        ///////////////////////////////////////////////////////////////////////////////////
-        //  Sleep Timer
-        ///////////////////////////////////////////////////////////////////////////////////
+    ESP_ERROR_CHECK(bsp_set_btn_press_cb(button_press_callback));
+    ESP_ERROR_CHECK(bsp_set_btn_release_cb(button_release_callback));
 
-        if (sleepCanceller)
-        {
-            faceSleepTimer = randomInRange(50, 70); // reset the sleep timer
-            if (state == 1) // If we are in the FaceState
-            {
-                if (faceState == 3) // If asleep
-                {
-                    faceState = 0; // Wake up
-                }
-            }
-
-
-            sleepCanceller = false;
-        }
-
-        ///////////////////////////////////////////////////////////////////////////////////
-        //  Input Handling
-        ///////////////////////////////////////////////////////////////////////////////////
+    const esp_timer_create_args_t battery_timer_args = {
+        .callback = battery_callback,
+        .name = "battery",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&battery_timer_args, &s_ui.battery));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_ui.battery, UI_BATTERY_PERIOD_MS * 1000));
+
+    lvgl_port_lock(0);
+    // a press anywhere lands on the screen, none of its children are clickable
+    lv_obj_add_event_cb(lv_scr_act(), touch_callback, LV_EVENT_PRESSED, NULL);
+    lvgl_disp->driver->monitor_cb = monitor_callback;
+    if (s_ui.battPercent < 3) {
+        ui_enter_battery_low();
+    }
+    else {
+        ui_enter_state(0);
+    }
+    lvgl_port_unlock();
 
-        battPercent = bsp_battery_get_percent(); // Update the battery percentage
 
-        previousPoint = pointTouched;
-        lv_indev_get_point(tp, &pointTouched); // Get touch
-        if ((pointTouched.x != previousPoint.x) && (pointTouched.y != previousPoint.y)) // If it's a new touch
-        {
-            sleepCanceller = true;
-            if (state == 1)
-            {
-                faceState = 4;
-                happyAnimState = 0;
-            }
-        }
-
-        // If the scroll wheel button is pressed
-        if (bsp_exp_io_get_level(BSP_KNOB_BTN) == 0) {
-            sleepCanceller = true;
-        }
+    ///////////////////////////////////////////////////////////////////////////////////
+    //  MAIN LOOP
+    ///////////////////////////////////////////////////////////////////////////////////
 
-        if (knobJustMoved)
+    // sleeps until a source has something, the screens animate on their own
+    while (1) {
+        ui_event_t event;
+        if (xQueueReceive(s_ui.events, &event, portMAX_DELAY) == pdTRUE)
         {
-            state = -1; // Go to Menu
-            sleepCanceller = true;
-            knobJustMoved = false;
-            menuTimeOut = 0;
-            menuShouldMove = true;
-        }
-
-        ///////////////////////////////////////////////////////////////////////////////////
-        //  Battery Low Warning
-        ///////////////////////////////////////////////////////////////////////////////////
-
-        if (battPercent < 3) { // Battery too low, block all further information
-            lvgl_port_lock(portMAX_DELAY); // Lock the LVGL Port to ensure no weird threading shenanigans
-
-            bsp_lcd_brightness_set(5); // dim the screen
-
-            lv_obj_add_flag(menuLabel, LV_OBJ_FLAG_HIDDEN); // hide the menu label
-            lv_obj_add_flag(batteryArc, LV_OBJ_FLAG_HIDDEN); // hide the battery arc
-            lv_obj_add_flag(selectorArc, LV_OBJ_FLAG_HIDDEN); // hide the selection arc
-
-            lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
-            lv_obj_clear_flag(batteryLabel, LV_OBJ_FLAG_HIDDEN); // Show the percentage
-
-            lv_obj_move_foreground(faceImage); // face goes in the back
-            lv_obj_move_foreground(batteryLabel); // label goes in the middle
-
-            if (battAnimState == 1) {
-                battAnimState = 0;
-            } else {
-                battAnimState = 1;
-            }
-
-            lv_img_set_src(faceImage, &exclaimationImages[battAnimState]);
-            lv_label_set_text_fmt(batteryLabel, "Battery: %d%%", battPercent);
-
-            lvgl_port_unlock();
-            vTaskDelay(100);
-
-            state = 0; // Go to init state
-            menuShouldMove = false;
-
-            continue;
-        }
-        else {
-            lv_obj_add_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // hide the face
-            lv_obj_add_flag(batteryLabel, LV_OBJ_FLAG_HIDDEN); // hide the battery label
-        }
-
-
-        ///////////////////////////////////////////////////////////////////////////////////
-        //  Main state machine
-        ///////////////////////////////////////////////////////////////////////////////////
-
-        switch (state) {
-            case 6: // Camera mode
-                lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the main image
-                if (captureStartedCounter != -1) { // capture in progress
-                    if (captureFinished) {
-                        captureFinished = false;
-                        captureStartedCounter = -1; // Capture idle
-                        captureInProgress = false;
-                        sscma_client_set_sensor(client, 1, CAMERA_SENSOR_RESOLUTION_416_416, true);
-                        vTaskDelay(10 / portTICK_PERIOD_MS);
-                        if (sscma_client_sample(client, -1) != ESP_OK)
-                        {
-                            printf("sample failed\n");
-                        }
-                        printf("Capture Done!");
-                    } else {
-                        printf("Waiting on capture");
-                    }
-                }
-
-                if (bsp_exp_io_get_level(BSP_KNOB_BTN) == 0) {
-                    if (captureStartedCounter == -1) { // Capture idle
-                        printf("Capture scheduled");
-
-                        sscma_client_set_sensor(client, 1, CAMERA_SENSOR_RESOLUTION_640_480, true);
-                        vTaskDelay(10 / portTICK_PERIOD_MS);
-                        if (sscma_client_sample(client, -1) != ESP_OK)
-                        {
-                            printf("sample failed\n");
-                        }
-                        captureStartedCounter = 1; // Capture started
-                        captureFinished = false;
-                    }
-                }
-
-                vTaskDelay(10 / portTICK_PERIOD_MS);
-                break;
-            case -2: // Camera init
-                lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the main image
-                if (sscma_client_register_callback(client, &sscmacallback, NULL) != ESP_OK)
-                {
-                    printf("set callback failed\n");
-                    abort();
-                }
-                state = 6;
-                break;
-            case 5: // Screen off
-                lvgl_port_lock(portMAX_DELAY);
-                bsp_lcd_brightness_set(0);
-                lvgl_port_unlock();
-                break;
-            case 4: // Battery information
-                lvgl_port_lock(portMAX_DELAY); // Lock the LVGL Port to ensure no weird threading shenanigans
-
-                lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
-                lv_obj_clear_flag(batteryArc, LV_OBJ_FLAG_HIDDEN); // Show the arc
-                lv_obj_clear_flag(batteryLabel, LV_OBJ_FLAG_HIDDEN);
-
-                lv_obj_move_foreground(faceImage); // face goes in the back
-                lv_obj_move_foreground(batteryLabel); // label goes in the middle
-                lv_obj_move_foreground(batteryArc); // battery arc goes on top
-
-                if (battAnimState == 1) {
-                    battAnimState = 0;
-                } else {
-                    battAnimState = 1;
-                }
-
-                if (battPercent > 75) {
-                    lv_obj_set_style_arc_color(batteryArc, lv_palette_main(LV_PALETTE_GREEN), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-                    lv_img_set_src(faceImage, &greetingImages[battAnimState]);
-                } else if (battPercent > 25) {
-                    lv_obj_set_style_arc_color(batteryArc, lv_palette_main(LV_PALETTE_YELLOW), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-                    lv_img_set_src(faceImage, &idleImages[0]);
-                } else {
-                    lv_obj_set_style_arc_color(batteryArc, lv_palette_main(LV_PALETTE_RED), LV_PART_INDICATOR | LV_STATE_DEFAULT);
-                    lv_img_set_src(faceImage, &exclaimationImages[battAnimState]);
-                }
-
-                lv_label_set_text_fmt(batteryLabel, "Battery: %d%%", battPercent);
-
-                lv_arc_set_value(batteryArc, battPercent);
-
-                lvgl_port_unlock();
-                vTaskDelay(200);
-
-                break;
-            case 3: //Flashlight
-                lvgl_port_lock(portMAX_DELAY); // Lock the LVGL Port to ensure no weird threading shenanigans
-
-                lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
-
-                if (bsp_exp_io_get_level(BSP_KNOB_BTN) == 0) {
-                    rgb_next_color(false);
-                }
-                else
-                {
-                    rgb_set(255, 255, 255);
-                }
-
-                scanAnimState++;
-                if (scanAnimState >= 5)
-                {
-                    scanAnimState = 0;
-                }
-
-                lv_img_set_src(faceImage, &scanningImages[scanAnimState]);
-
-                lvgl_port_unlock();
-
-                vTaskDelay(120);
-
-                break;
-            case 2: // shutdown
-                bsp_lcd_brightness_set(0);
-                bsp_system_shutdown();
-                vTaskDelay(pdMS_TO_TICKS(1000)); // This will only run if we are connected to usb-c (or shutdown is broken somehow)
-                esp_restart();
-                break;
-            case 1: // Face (active)
-
-                lv_obj_clear_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // Show the face
-
-                // Sleep manager
-                if (goToSleep)
-                {
-                    faceState = 3;
-                    goToSleep = false;
-                }
-
-                lvgl_port_lock(portMAX_DELAY); // Lock the LVGL Port to ensure no weird threading shenanigans
-
-                switch (faceState) {
-                    case 1: // Idle, Face selected
-                        if (randomInRange(0, 39) == 1) // If we roll the 1/40 chance to blink
-                        {
-                            faceState = 2;
-                            faceStateTimer = -5;
-                            lv_img_set_src(faceImage, &eyesclosed);
-                        }
-                        break;
-                    case 2: // Blinking
-                        break; // (Do nothing)
-                    case 3: // Asleep
-                        sleepAnimState++;
-                        if (sleepAnimState >= 4)
-                        {
-                            sleepAnimState = 0;
-                        }
-
-                        faceStateTimer = 5; // This state is perpetual, and lasts until an external "Wakeup" is triggered
-
-                        lv_img_set_src(faceImage, &sleepImages[sleepAnimState]);
-                        break;
-                    case 4: // Happy
-                        happyAnimState++;
-                        faceStateTimer = 5; // Keep this state running until the animation is done
-                        if (happyAnimState >= 3) // Animate the happy until the animation finishes
-                        {
-                            happyAnimState = 0;
-                            faceState = 0;
-                        }
-                        lv_img_set_src(faceImage, &greetingImages[happyAnimState]);
-                        break;
-                    default: // Unknown state
-                    case 0:  // Default state (Idle face selection)
-                        faceState = 1;
-                        faceStateTimer = randomInRange(5, 25); // Face selection delay
-                        lv_img_set_src(faceImage, &idleImages[randomInRange(0, 2)]); // set face to a random idle image
-
-                        if (faceSleepTimer <= 0)
-                        {
-                            goToSleep = true;
-                        }
-
-                        break;
-                }
-
-                if (faceStateTimer <= 0) // If faceStateTimer is finished
-                {
-                    faceState = 0; // Select a new Idle Face
-                }
-                else
-                {
-                    faceStateTimer--; //Decrement stateTimer
-                }
-
-                lvgl_port_unlock();
-
-                vTaskDelay(150);
-
-
-                faceSleepTimer--;
-
-                break;
-            case 0: // Initializing
-            default: //or an unknown state
-                lvgl_port_lock(portMAX_DELAY);
-                bsp_lcd_brightness_set(100);
-                lvgl_port_unlock();
-                state = 1;
-                break;
-            case -1:
-                ///////////////////////////////////////////////////////////////////////////////
-                //  Menu code
-                ///////////////////////////////////////////////////////////////////////////////
-
-                bsp_lcd_brightness_set(100); // reset the screen brightness
-
-                rgb_set(0, 0, 0); // Reset the RGB LED
-
-                faceState = 0; // Reset the face state
-
-                menuTimeOut += 3;
-
-                if (sscma_client_register_callback(client, &sscmanocallback, NULL) != ESP_OK)
-                {
-                    printf("set callback failed\n");
-                    abort();
-                }
-
-                lvgl_port_lock(portMAX_DELAY); // Lock the LVGL Port
-                lv_obj_add_flag(faceImage, LV_OBJ_FLAG_HIDDEN); // hide the face
-                lv_obj_add_flag(batteryArc, LV_OBJ_FLAG_HIDDEN); // hide the battery arc
-                lv_obj_add_flag(batteryLabel, LV_OBJ_FLAG_HIDDEN); // hide the battery label
-
-
-                lv_obj_clear_flag(selectorArc, LV_OBJ_FLAG_HIDDEN); // Show the selector arc
-                lv_obj_clear_flag(menuLabel, LV_OBJ_FLAG_HIDDEN); // Show the menu label
-
-                lv_obj_move_foreground(menuLabel); // Menu label goes in the middle
-                lv_obj_move_foreground(selectorArc); // Selector arc goes on top!
-
-                lv_arc_set_value(selectorArc, menuTimeOut); // Fill in the selector arc
-                if (menuTimeOut >= 100) {
-                    menuTimeOut = 100;
-                    switch (menuSelection) {
-                        case 6:
-                            state = -2;
-                            break;
-                        default:
-                            state = menuSelection;
-                            break;
-                    }
-                    lv_obj_add_flag(selectorArc, LV_OBJ_FLAG_HIDDEN);
-                    lv_obj_add_flag(menuLabel, LV_OBJ_FLAG_HIDDEN); // hide the menu label
-                }
-
-                if (menuShouldMove){
-                    if (knobDir) { // Right
-                        menuSelection++;
-                    }
-                    else { // Left
-                        menuSelection--;
-                    }
-
-                    if (menuSelection >= 7)
-                    {
-                        menuSelection = 1;
-                    }
-                    if (menuSelection <= 0)
-                    {
-                        menuSelection = 6;
-                    }
-
-                    switch (menuSelection) {
-                        case 6:
-                            lv_label_set_text(menuLabel,"#ffffff Camera#");
-                            break;
-                        case 5:
-                            lv_label_set_text(menuLabel,"#ffffff Screen Off#");
-                            break;
-                        case 4:
-                            lv_label_set_text(menuLabel,"#ffffff Battery Info#");
-                            break;
-                        case 3:
-                            lv_label_set_text(menuLabel,"#ffffff Flashlight#");
-                            break;
-                        case 2:
-                            lv_label_set_text(menuLabel,"#ff0000 Shutdown#");
-                            break;
-                        case 1:
-                            lv_label_set_text(menuLabel,"#ffffff Normal#");
-                            break;
-                        case 0:
-                        default:
-                            lv_label_set_text(menuLabel,"#ff0000 Error#");
-                            break;
-                    }
-
-                    menuShouldMove = false;
-                }
-                lvgl_port_unlock(); // Free the LVGL Port
-
-                vTaskDelay(15); // Delay
-                break;
+            ui_handle_event(&event);
         }
     }
 }
-